@@ -1,5 +1,15 @@
 @echo off
 glslc -c -fshader-stage=vertex vertex.glsl -o vertex.spv 
 glslc -c -fshader-stage=fragment fragment.glsl -o fragment.spv 
+glslc -c -fshader-stage=fragment fragment_basic.glsl -o fragment_basic.spv
+glslc -c -fshader-stage=vertex quad_vertex.glsl -o quad_vertex.spv
+glslc -c -fshader-stage=fragment quad_fragment.glsl -o quad_fragment.spv
+glslc -c -fshader-stage=compute cull.glsl -o cull.spv
+glslc -c -fshader-stage=compute saxpy.glsl -o saxpy.spv
+glslc -c -fshader-stage=compute reduce.glsl -o reduce.spv
+glslc -c -fshader-stage=compute scan.glsl -o scan.spv
+glslc -c -fshader-stage=compute scan_add.glsl -o scan_add.spv
+glslc -c -fshader-stage=compute radix_histogram.glsl -o radix_histogram.spv
+glslc -c -fshader-stage=compute radix_scatter.glsl -o radix_scatter.spv
 echo.
 pause
\ No newline at end of file
@@ -0,0 +1,52 @@
+#version 450
+#extension GL_ARB_separate_shader_objects: enable
+
+layout (local_size_x = 64) in;
+
+struct Instance
+{
+	vec2 Position;
+	float Scale;
+	uint MeshIndex;
+};
+
+struct DrawIndexedIndirectCommand
+{
+	uint IndexCount;
+	uint InstanceCount;
+	uint FirstIndex;
+	int VertexOffset;
+	uint FirstInstance;
+};
+
+layout (std430, binding = 0) readonly buffer Instances { Instance u_Instances[]; };
+layout (std430, binding = 1) readonly buffer MeshBounds { float u_MeshRadii[]; };
+layout (std430, binding = 2) writeonly buffer VisibleInstances { Instance u_Visible[]; };
+layout (std430, binding = 3) buffer DrawCommands { DrawIndexedIndirectCommand u_Commands[]; };
+layout (std430, binding = 4) buffer DrawCounts { uint u_DrawCounts[]; };
+
+layout (push_constant) uniform PushConstants
+{
+	uint u_InstanceCount;
+};
+
+void main()
+{
+	uint index = gl_GlobalInvocationID.x;
+	if (index >= u_InstanceCount)
+		return;
+
+	Instance instance = u_Instances[index];
+	float radius = u_MeshRadii[instance.MeshIndex] * instance.Scale;
+
+	// No camera yet, the view volume is the clip space square
+	if (abs(instance.Position.x) - radius > 1.0 || abs(instance.Position.y) - radius > 1.0)
+		return;
+
+	uint slot = atomicAdd(u_Commands[instance.MeshIndex].InstanceCount, 1);
+	u_Visible[u_Commands[instance.MeshIndex].FirstInstance + slot] = instance;
+
+	if (slot == 0)
+		u_DrawCounts[instance.MeshIndex] = 1;
+
+}
\ No newline at end of file
@@ -1,11 +1,31 @@
 #version 450
 #extension GL_ARB_separate_shader_objects: enable
+#extension GL_EXT_nonuniform_qualifier: enable
 
-layout(location = 0) out vec4 o_Color;
+layout (location = 0) in vec3 v_Color;
+layout (location = 1) in vec2 v_Uv;
 
-layout(location = 0) in vec3 v_Color;
+layout (location = 0) out vec4 o_Color;
+
+// The bindless set, see BindlessDescriptors
+layout (set = 1, binding = 1) uniform texture2D u_Textures[];
+layout (set = 1, binding = 2) uniform sampler u_Samplers[];
+
+// DrawConstants, the handles are the same for the whole draw
+layout (push_constant) uniform DrawConstants
+{
+	uint InstanceBuffer;
+	uint Material;
+	uint Sampler;
+} u_Draw;
+
+const uint INVALID_HANDLE = 0xFFFFFFFFu;
 
 void main()
 {
 	o_Color = vec4(v_Color, 1.0);
-}
\ No newline at end of file
+
+	// Untextured draws skip the sample
+	if (u_Draw.Material != INVALID_HANDLE)
+		o_Color *= texture(sampler2D(u_Textures[u_Draw.Material], u_Samplers[u_Draw.Sampler]), v_Uv);
+}
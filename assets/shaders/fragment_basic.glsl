@@ -0,0 +1,13 @@
+#version 450
+#extension GL_ARB_separate_shader_objects: enable
+
+// fragment.glsl without the bindless set, for devices without descriptor indexing
+
+layout(location = 0) out vec4 o_Color;
+
+layout(location = 0) in vec3 v_Color;
+
+void main()
+{
+	o_Color = vec4(v_Color, 1.0);
+}
\ No newline at end of file
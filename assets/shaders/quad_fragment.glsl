@@ -0,0 +1,29 @@
+#version 450
+#extension GL_ARB_separate_shader_objects: enable
+#extension GL_EXT_nonuniform_qualifier: enable
+
+layout (location = 0) in vec4 v_Color;
+layout (location = 1) in vec2 v_Uv;
+
+layout (location = 0) out vec4 o_Color;
+
+// The bindless set, see BindlessDescriptors
+layout (set = 1, binding = 1) uniform texture2D u_Textures[];
+layout (set = 1, binding = 2) uniform sampler u_Samplers[];
+
+layout (push_constant) uniform QuadConstants
+{
+	uint Texture;
+	uint Sampler;
+} u_Quad;
+
+const uint INVALID_HANDLE = 0xFFFFFFFFu;
+
+void main()
+{
+	o_Color = v_Color;
+
+	// Constant across a draw, untextured batches skip the sample
+	if (u_Quad.Texture != INVALID_HANDLE)
+		o_Color *= texture(sampler2D(u_Textures[u_Quad.Texture], u_Samplers[u_Quad.Sampler]), v_Uv);
+}
@@ -0,0 +1,26 @@
+#version 450
+#extension GL_ARB_separate_shader_objects: enable
+
+// One instance per quad, the two triangles are built from the rotated half axes
+layout (location = 0) in vec2 a_Center;
+layout (location = 1) in vec2 a_AxisX;
+layout (location = 2) in vec2 a_AxisY;
+layout (location = 3) in vec4 a_Color;
+layout (location = 4) in vec4 a_Uv;
+
+layout (location = 0) out vec4 v_Color;
+layout (location = 1) out vec2 v_Uv;
+
+const vec2 CORNERS[6] = vec2[](
+	vec2(-1.0, -1.0), vec2(1.0, -1.0), vec2(1.0, 1.0),
+	vec2(-1.0, -1.0), vec2(1.0, 1.0), vec2(-1.0, 1.0)
+);
+
+void main()
+{
+	vec2 corner = CORNERS[gl_VertexIndex];
+
+	gl_Position = vec4(a_Center + a_AxisX * corner.x + a_AxisY * corner.y, 0.0, 1.0);
+	v_Color = a_Color;
+	v_Uv = mix(a_Uv.xy, a_Uv.zw, corner * 0.5 + 0.5);
+}
@@ -0,0 +1,38 @@
+#version 450
+#extension GL_ARB_separate_shader_objects: enable
+
+// Counts the 4 bit digits at u_Shift of each group's keys, one key per invocation
+layout (local_size_x_id = 0) in;
+
+layout (std430, binding = 0) readonly buffer Keys { uint u_Keys[]; };
+layout (std430, binding = 1) writeonly buffer Counts { uint u_Counts[]; };
+
+layout (push_constant) uniform PushConstants
+{
+	uint u_Count;
+	uint u_Shift;
+};
+
+const uint RADIX = 16;
+
+shared uint s_Counts[RADIX];
+
+void main()
+{
+	uint local = gl_LocalInvocationID.x;
+	uint index = gl_GlobalInvocationID.x;
+
+	if (local < RADIX)
+		s_Counts[local] = 0;
+
+	barrier();
+
+	if (index < u_Count)
+		atomicAdd(s_Counts[(u_Keys[index] >> u_Shift) & (RADIX - 1)], 1);
+
+	barrier();
+
+	// Digit major, so an exclusive scan over all counts gives every group its offset per digit
+	if (local < RADIX)
+		u_Counts[local * gl_NumWorkGroups.x + gl_WorkGroupID.x] = s_Counts[local];
+}
@@ -0,0 +1,74 @@
+#version 450
+#extension GL_ARB_separate_shader_objects: enable
+
+// Moves each key to its sorted position for the 4 bit digit at u_Shift. The group first
+// sorts its keys by the digit with one stable split per bit, so a key's rank among the
+// group's keys of the same digit is its distance to the first of them.
+layout (local_size_x_id = 0) in;
+
+layout (std430, binding = 0) readonly buffer KeysIn { uint u_KeysIn[]; };
+layout (std430, binding = 1) readonly buffer Offsets { uint u_Offsets[]; };
+layout (std430, binding = 2) writeonly buffer KeysOut { uint u_KeysOut[]; };
+
+layout (push_constant) uniform PushConstants
+{
+	uint u_Count;
+	uint u_Shift;
+};
+
+const uint RADIX = 16;
+const uint RADIX_BITS = 4;
+
+shared uint s_Keys[gl_WorkGroupSize.x];
+shared uint s_Valid[gl_WorkGroupSize.x];
+shared uint s_Scan[gl_WorkGroupSize.x];
+shared uint s_DigitStart[RADIX];
+
+void main()
+{
+	uint local = gl_LocalInvocationID.x;
+	uint index = gl_GlobalInvocationID.x;
+	uint size = gl_WorkGroupSize.x;
+
+	// Keys past the end have the largest digit and come last in the group,
+	// the stable splits keep them behind every real key
+	bool valid = index < u_Count;
+	uint key = valid ? u_KeysIn[index] : 0xFFFFFFFFu;
+
+	for (uint bit = 0; bit < RADIX_BITS; ++bit)
+	{
+		uint zero = ((key >> (u_Shift + bit)) & 1) == 0 ? 1 : 0;
+		s_Scan[local] = zero;
+		barrier();
+
+		for (uint offset = 1; offset < size; offset *= 2)
+		{
+			uint add = local >= offset ? s_Scan[local - offset] : 0;
+			barrier();
+
+			s_Scan[local] += add;
+			barrier();
+		}
+
+		uint zerosBefore = s_Scan[local] - zero;
+		uint totalZeros = s_Scan[size - 1];
+		uint position = zero == 1 ? zerosBefore : totalZeros + local - zerosBefore;
+
+		s_Keys[position] = key;
+		s_Valid[position] = valid ? 1 : 0;
+		barrier();
+
+		key = s_Keys[local];
+		valid = s_Valid[local] == 1;
+		barrier();
+	}
+
+	uint digit = (key >> u_Shift) & (RADIX - 1);
+	if (local == 0 || digit != ((s_Keys[local - 1] >> u_Shift) & (RADIX - 1)))
+		s_DigitStart[digit] = local;
+
+	barrier();
+
+	if (valid)
+		u_KeysOut[u_Offsets[digit * gl_NumWorkGroups.x + gl_WorkGroupID.x] + local - s_DigitStart[digit]] = key;
+}
@@ -0,0 +1,45 @@
+#version 450
+#extension GL_ARB_separate_shader_objects: enable
+
+// Sums the elements of each group into one, run repeatedly until a single one is left.
+// The group size must be a power of two.
+layout (local_size_x_id = 0) in;
+
+layout (std430, binding = 0) readonly buffer Input { uint u_Input[]; };
+layout (std430, binding = 1) writeonly buffer Output { uint u_Output[]; };
+
+layout (push_constant) uniform PushConstants
+{
+	uint u_Count;
+};
+
+shared uint s_Sums[gl_WorkGroupSize.x];
+
+void main()
+{
+	uint local = gl_LocalInvocationID.x;
+	uint size = gl_WorkGroupSize.x;
+
+	// Every invocation adds two elements while loading, so a group covers twice its size
+	uint index = gl_WorkGroupID.x * size * 2 + local;
+
+	uint sum = 0;
+	if (index < u_Count)
+		sum = u_Input[index];
+	if (index + size < u_Count)
+		sum += u_Input[index + size];
+
+	s_Sums[local] = sum;
+	barrier();
+
+	for (uint stride = size / 2; stride > 0; stride /= 2)
+	{
+		if (local < stride)
+			s_Sums[local] += s_Sums[local + stride];
+
+		barrier();
+	}
+
+	if (local == 0)
+		u_Output[gl_WorkGroupID.x] = s_Sums[0];
+}
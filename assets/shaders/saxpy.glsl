@@ -0,0 +1,22 @@
+#version 450
+#extension GL_ARB_separate_shader_objects: enable
+
+layout (local_size_x_id = 0) in;
+
+layout (std430, binding = 0) readonly buffer X { float u_X[]; };
+layout (std430, binding = 1) buffer Y { float u_Y[]; };
+
+layout (push_constant) uniform PushConstants
+{
+	uint u_Count;
+	float u_A;
+};
+
+void main()
+{
+	uint index = gl_GlobalInvocationID.x;
+	if (index >= u_Count)
+		return;
+
+	u_Y[index] = u_A * u_X[index] + u_Y[index];
+}
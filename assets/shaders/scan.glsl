@@ -0,0 +1,43 @@
+#version 450
+#extension GL_ARB_separate_shader_objects: enable
+
+// Exclusive prefix sum within each group, the group totals go to the block sums.
+// Scanning those and adding them back with scan_add completes the scan.
+layout (local_size_x_id = 0) in;
+
+layout (std430, binding = 0) readonly buffer Input { uint u_Input[]; };
+layout (std430, binding = 1) writeonly buffer Output { uint u_Output[]; };
+layout (std430, binding = 2) writeonly buffer BlockSums { uint u_BlockSums[]; };
+
+layout (push_constant) uniform PushConstants
+{
+	uint u_Count;
+};
+
+shared uint s_Scan[gl_WorkGroupSize.x];
+
+void main()
+{
+	uint local = gl_LocalInvocationID.x;
+	uint index = gl_GlobalInvocationID.x;
+
+	uint value = index < u_Count ? u_Input[index] : 0;
+	s_Scan[local] = value;
+	barrier();
+
+	// Inclusive Hillis-Steele scan, the reads and writes of a step are split by a barrier
+	for (uint offset = 1; offset < gl_WorkGroupSize.x; offset *= 2)
+	{
+		uint add = local >= offset ? s_Scan[local - offset] : 0;
+		barrier();
+
+		s_Scan[local] += add;
+		barrier();
+	}
+
+	if (index < u_Count)
+		u_Output[index] = s_Scan[local] - value;
+
+	if (local == gl_WorkGroupSize.x - 1)
+		u_BlockSums[gl_WorkGroupID.x] = s_Scan[local];
+}
@@ -0,0 +1,22 @@
+#version 450
+#extension GL_ARB_separate_shader_objects: enable
+
+// Adds the scanned block sums to the blocks scan.glsl produced, same group size
+layout (local_size_x_id = 0) in;
+
+layout (std430, binding = 0) buffer Output { uint u_Output[]; };
+layout (std430, binding = 1) readonly buffer BlockOffsets { uint u_BlockOffsets[]; };
+
+layout (push_constant) uniform PushConstants
+{
+	uint u_Count;
+};
+
+void main()
+{
+	uint index = gl_GlobalInvocationID.x;
+	if (index >= u_Count)
+		return;
+
+	u_Output[index] += u_BlockOffsets[gl_WorkGroupID.x];
+}
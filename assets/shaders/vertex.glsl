@@ -1,23 +1,36 @@
 #version 450
 #extension GL_ARB_separate_shader_objects: enable
 
+layout (location = 0) in vec2 a_Position;
+layout (location = 1) in vec3 a_Color;
+
+layout (location = 2) in vec2 a_InstancePosition;
+layout (location = 3) in float a_InstanceScale;
+
 layout (location = 0) out vec3 v_Color;
+layout (location = 1) out vec2 v_Uv;
 
-vec2 positions[3] = vec2[](
-    vec2(-0.5,  0.5),  
-	vec2( 0.0, -0.5),
-	vec2( 0.5,  0.5)
-);
+// The uniform ring, see UniformRing
+layout (set = 0, binding = 0) uniform FrameUniforms
+{
+	float Time;
+	float DeltaTime;
+	vec2 Extent;
+} u_Frame;
 
-vec3 colors[3] = vec3[](
-	vec3(1.0, 0.0, 0.0),
-	vec3(0.0, 1.0, 0.0),
-	vec3(0.0, 0.0, 1.0)
-);
+layout (set = 0, binding = 1) uniform ObjectUniforms
+{
+	mat4 Transform;
+} u_Object;
 
 void main()
 {
-	gl_Position = vec4(positions[gl_VertexIndex], 0.0, 1.0);
-	v_Color = colors[gl_VertexIndex];
+	vec2 position = a_Position * a_InstanceScale + a_InstancePosition;
+	gl_Position = u_Object.Transform * vec4(position, 0.0, 1.0);
+
+	// A slow pulse, so a frame whose uniforms went missing stands out
+	v_Color = a_Color * (0.85 + 0.15 * sin(u_Frame.Time * 2.0));
 
-}
\ No newline at end of file
+	// The placeholder meshes span [-0.5, 0.5], so their positions double as texture coordinates
+	v_Uv = a_Position + 0.5;
+}
@@ -1,6 +1,13 @@
 
 BINARY_DIR = "bin/%{cfg.buildcfg}-%{cfg.system}-%{cfg.architecture}"
 OBJECT_DIR = "bin-int/%{cfg.buildcfg}-%{cfg.system}-%{cfg.architecture}"
+VULKAN_SDK = os.getenv("VULKAN_SDK")
+GLSLC = VULKAN_SDK and (VULKAN_SDK .. "/bin/glslc") or "glslc"
+
+-- Linux builds can use the system Vulkan headers and loader instead
+if not VULKAN_SDK and os.target() == "windows" then
+	error("VULKAN_SDK is not set, install the Vulkan SDK 1.3 or newer")
+end
 
 workspace "Vulkan Sandbox"
 	architecture "x64"
@@ -17,6 +24,16 @@ workspace "Vulkan Sandbox"
 		include "vendor/GLFW"
 	group ""
 
+newoption {
+	trigger = "no-profile",
+	description = "Compile the CPU profiling zones out"
+}
+
+newoption {
+	trigger = "avx",
+	description = "Build for CPUs with AVX, the quad renderer then transforms eight quads at a time"
+}
+
 project "Vulkan Sandbox"
 	kind "ConsoleApp"
 	language "C++"
@@ -28,19 +45,22 @@ project "Vulkan Sandbox"
 
 	files {
 		"src/**.h",
-		"src/**.cpp"
+		"src/**.cpp",
+		"assets/shaders/*.glsl"
 	}
 
 	includedirs {
 		"src",
 		"vendor/GLFW/include",
-		"vendor/spdlog/include",
-		"C:/VulkanSDK/1.1.121.0/include"
+		"vendor/spdlog/include"
 	}
 
+	if VULKAN_SDK then
+		includedirs (VULKAN_SDK .. "/include")
+	end
+
 	links {
-		"GLFW",
-		"C:/VulkanSDK/1.1.121.0/Lib/vulkan-1.lib"
+		"GLFW"
 	}
 
 	defines {
@@ -51,7 +71,38 @@ project "Vulkan Sandbox"
 	filter "system:windows"
 		systemversion "latest"
 		defines "APP_PLATFORM_WINDOWS"
+		links (VULKAN_SDK .. "/Lib/vulkan-1.lib")
+
+	filter "system:linux"
+		defines "APP_PLATFORM_LINUX"
+		links {
+			"vulkan",
+			"dl",
+			"pthread"
+		}
 	
+	filter "options:no-profile"
+		defines "APP_NO_PROFILE"
+
+	filter "options:avx"
+		vectorextensions "AVX"
+
+	-- SPIR-V is rebuilt next to the sources whenever a shader changes,
+	-- the stage comes from the file name and everything else is compute
+	for _, shader in ipairs(os.matchfiles("assets/shaders/*.glsl")) do
+		local stage = "compute"
+		if shader:find("vertex") then
+			stage = "vertex"
+		elseif shader:find("fragment") then
+			stage = "fragment"
+		end
+
+		filter("files:" .. shader)
+			buildmessage "Compiling %{file.name}"
+			buildcommands ('"' .. GLSLC .. '" -c -fshader-stage=' .. stage .. ' "%{file.abspath}" -o "%{file.directory}/%{file.basename}.spv"')
+			buildoutputs "%{file.directory}/%{file.basename}.spv"
+	end
+
 	filter "configurations:Debug"
 		defines "APP_DEBUG"
 		runtime "Debug"
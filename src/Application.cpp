@@ -1,6 +1,10 @@
 
 #include "Application.h"
+#include "Profiler.h"
 #include "Log.h"
+#include "Timer.h"
+
+#include <charconv>
 
 static std::vector<char> ReadFile(const std::string &path)
 {
@@ -23,39 +27,6 @@ static std::vector<char> ReadFile(const std::string &path)
 
 }
 
-QueueFamilyIndices Application::FindQueueFamilies(VkPhysicalDevice device)
-{
-
-	QueueFamilyIndices indices = { 0 };
-
-	uint32_t propCount = 0;
-	vkGetPhysicalDeviceQueueFamilyProperties(device, &propCount, nullptr);
-
-	std::vector<VkQueueFamilyProperties> props(propCount);
-	vkGetPhysicalDeviceQueueFamilyProperties(device, &propCount, props.data());
-
-	uint32_t index = 0;
-	for (const auto &prop : props)
-	{
-		if (prop.queueFlags & VK_QUEUE_GRAPHICS_BIT)
-			indices.GraphicsFamily = index;
-
-		VkBool32 presentSupport = false;
-		vkGetPhysicalDeviceSurfaceSupportKHR(device, index, this->m_Surface, &presentSupport);
-
-		if (presentSupport)
-			indices.PresentFamily = index;
-
-		if (indices.AllAvailable())
-			break;
-
-		++index;
-	}
-
-	return indices;
-
-}
-
 static VKAPI_ATTR VkBool32 VKAPI_CALL DebugCallback(
 	VkDebugUtilsMessageSeverityFlagBitsEXT severity,
 	VkDebugUtilsMessageTypeFlagsEXT type,
@@ -93,49 +64,67 @@ void SetupDebugMessengerInfo(VkDebugUtilsMessengerCreateInfoEXT &createInfo)
 	createInfo.flags = 0;
 
 }
-bool Application::IsDeviceSuitable(VkPhysicalDevice device)
+bool Application::IsDeviceSuitable(const DeviceCapabilities &caps)
 {
 
-	bool RequiredQueuesAvailable = this->FindQueueFamilies(device).AllAvailable();
-	bool RequiredExtensionsSupported = this->CheckDeviceExtensionSupport(device);
-	bool AdequateSwapChain = false;
-	if (RequiredExtensionsSupported)
+	bool RequiredQueuesAvailable = caps.QueueFamilies.AllAvailable(!this->m_Config.Headless);
+	bool RequiredExtensionsSupported = this->CheckDeviceExtensionSupport(caps);
+	bool AdequateSwapChain = this->m_Config.Headless;
+	if (RequiredExtensionsSupported && !this->m_Config.Headless)
 	{
-		SwapChainCapabilities caps = this->RetrieveSwapChainCapabilities(device);
-		AdequateSwapChain = !(caps.formats.empty() || caps.presentModes.empty());
+		SwapChainCapabilities swapChainCaps = this->RetrieveSwapChainCapabilities(caps.Device);
+		AdequateSwapChain = !(swapChainCaps.formats.empty() || swapChainCaps.presentModes.empty());
 	}
 
+	// The extension alone is not enough, the feature has to be there as well
 	return RequiredQueuesAvailable
 		&& RequiredExtensionsSupported
-		&& AdequateSwapChain;
+		&& AdequateSwapChain
+		&& caps.TimelineSemaphore;
 
 }
-bool Application::CheckDeviceExtensionSupport(VkPhysicalDevice device)
+bool Application::CheckDeviceExtensionSupport(const DeviceCapabilities &caps)
 {
 
-	uint32_t propertyCount = 0;
-	vkEnumerateDeviceExtensionProperties(device, nullptr, &propertyCount, nullptr);
-
-	std::vector<VkExtensionProperties> props(propertyCount);
-	vkEnumerateDeviceExtensionProperties(device, nullptr, &propertyCount, props.data());
-
-	std::set<std::string> requestedExtensions(this->m_RequiredExtensions.begin(), this->m_RequiredExtensions.end());
-	for (const auto &prop : props)
-		requestedExtensions.erase(prop.extensionName);
+	for (const char *extension : this->m_RequiredExtensions)
+	{
+		if (!caps.HasExtension(extension))
+			return false;
+	}
 
-	return requestedExtensions.empty();
+	return true;
 }
 
-Application::Application(bool EnableValidationLayers)
-	: m_EnableValidationLayers(EnableValidationLayers)
+Application::Application(const ApplicationConfig &config)
+	: m_Config(config), m_EnableValidationLayers(config.EnableValidationLayers)
 {
+
+	this->m_RequiredExtensions.push_back(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME);
+
+	if (!this->m_Config.Headless)
+		this->m_RequiredExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+
+	uint32_t threadCount = this->m_Config.RecordThreadCount;
+	if (!threadCount)
+		threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+
+	this->m_RecordThreads = std::make_unique<util::ThreadPool>(threadCount);
+
 }
-void Application::Run()
+bool Application::Run()
 {
-	InitWindow();
+	this->m_StartupTimer.Reset();
+
 	InitVulkan();
-	Update();
+
+	bool succeeded = true;
+	if (this->m_Config.ComputeBenchmark)
+		succeeded = RunComputeBenchmark();
+	else
+		Update();
+
 	Shutdown();
+	return succeeded;
 }
 void Application::InitWindow()
 {
@@ -149,7 +138,7 @@ void Application::InitWindow()
 	LOG_INFO("Initialized the GLFW libary with no OpenGL!");
 
 	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-	glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+	glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
 	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
 
 	this->m_Window = glfwCreateWindow(this->m_WindowWidth, this->m_WindowHeight, this->m_WindowTitle, NULL, NULL);
@@ -161,15 +150,37 @@ void Application::InitWindow()
 		return;
 	}
 
+	glfwSetWindowUserPointer(this->m_Window, this);
+	glfwSetFramebufferSizeCallback(this->m_Window, [](GLFWwindow *window, int width, int height)
+	{
+		Application *app = static_cast<Application *>(glfwGetWindowUserPointer(window));
+		app->m_FramebufferResized = true;
+	});
+
+	glfwSetKeyCallback(this->m_Window, [](GLFWwindow *window, int key, int scancode, int action, int mods)
+	{
+		Application *app = static_cast<Application *>(glfwGetWindowUserPointer(window));
+
+		// Written by the collector thread, so the frame loop does not stall on the file
+		if (key == GLFW_KEY_F12 && action == GLFW_PRESS && util::Profiler::IsEnabled())
+			util::Profiler::RequestDump(app->m_Config.ProfileOutput);
+	});
+
 }
 std::vector<const char *> Application::LoadRequiredExtensions()
 {
 
-	uint32_t glfwExtensionCount = 0;
-	const char **glfwExtensions = nullptr;
-	glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+	std::vector<const char *> extensions;
+
+	// Headless runs never initialize GLFW and need no surface extensions
+	if (!this->m_Config.Headless)
+	{
+		uint32_t glfwExtensionCount = 0;
+		const char **glfwExtensions = nullptr;
+		glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
 
-	std::vector<const char *> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+		extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+	}
 
 	if (this->m_EnableValidationLayers)
 		extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
@@ -181,26 +192,174 @@ std::vector<const char *> Application::LoadRequiredExtensions()
 void Application::InitVulkan()
 {
 
-	this->CreateVulkanInstance();
-	this->CreateDebugMessenger();
-	this->CreateVulkanSurface();
-	this->SelectPhysicalDevice();
-	this->CreateLogicalDevice();
-	this->CreateSwapChain();
-	this->CreateSwapChainImageViews();
-	this->CreateRenderPass();
-	this->CreateGraphicsPipeline();
-	this->CreateFramebuffers();
-	this->CreateCommandPool();
-	this->CreateCommandBuffers();
-	this->CreateSyncObjects();
+	PROFILE_FUNCTION();
+
+	// Startup is a dependency graph: shader file I/O, shader modules and pipeline compilation
+	// run on worker threads while the window, instance, device and swap chain are created on
+	// the main thread. A task only touches what its dependencies created.
+	using Affinity = util::TaskGraph::Affinity;
+	util::TaskGraph graph;
+
+	std::vector<char> vertexShaderBytes, fragmentShaderBytes, cullShaderBytes;
+	std::vector<char> quadVertexShaderBytes, quadFragmentShaderBytes;
+	VkShaderModule vertexModule = VK_NULL_HANDLE, fragmentModule = VK_NULL_HANDLE;
+
+	auto readVertexShader = graph.Add("read vertex.spv", [&]() { vertexShaderBytes = ReadFile("assets/shaders/vertex.spv"); });
+	auto readCullShader = graph.Add("read cull.spv", [&]()
+	{
+		// Compiled on first use, so --instances works from a checkout that only has the GLSL
+		if (this->m_Config.InstanceCount > 0)
+			cullShaderBytes = ShaderWatcher::LoadOrCompile("assets/shaders", "cull.glsl", "compute");
+	});
+	auto readQuadShaders = graph.Add("read quad shaders", [&]()
+	{
+		if (this->m_Config.QuadCount > 0)
+		{
+			quadVertexShaderBytes = ReadFile("assets/shaders/quad_vertex.spv");
+			quadFragmentShaderBytes = ReadFile("assets/shaders/quad_fragment.spv");
+		}
+	});
+
+	// GLFW only allows window calls on the main thread, and the instance
+	// extensions it requires are only known once it is initialized.
+	std::vector<util::TaskGraph::TaskId> window;
+	if (!this->m_Config.Headless)
+		window.push_back(graph.Add("window", [this]() { this->InitWindow(); }, {}, Affinity::MainThread));
+
+	auto instance = graph.Add("instance", [this]()
+	{
+		this->CreateVulkanInstance();
+		this->CreateDebugMessenger();
+	}, window, Affinity::MainThread);
+
+	auto surface = instance;
+	if (!this->m_Config.Headless)
+		surface = graph.Add("surface", [this]() { this->CreateVulkanSurface(); }, { instance }, Affinity::MainThread);
+
+	auto device = graph.Add("device", [this]()
+	{
+		this->SelectPhysicalDevice();
+		this->SelectSurfaceFormat();
+		this->CreateLogicalDevice();
+		this->m_FramePacer.Init(this->m_Device, this->m_Config.FramesInFlight);
+	}, { surface }, Affinity::MainThread);
+
+	// Which fragment shader depends on whether the device has the bindless set
+	auto readFragmentShader = graph.Add("read fragment.spv", [&]()
+	{
+		fragmentShaderBytes = ReadFile("assets/shaders/" + this->GetFragmentShaderName() + ".spv");
+	}, { device });
+
+	auto allocator = graph.Add("allocator", [this]() { this->m_Allocator.Init(this->m_PhysicalDevice, this->m_Device, this->m_MemoryBudget); }, { device });
+	auto pipelineCache = graph.Add("pipeline cache", [this]()
+	{
+		this->m_PipelineCache.Init(this->m_PhysicalDevice, this->m_Device, this->m_Config.PipelineCachePath);
+	}, { device });
+
+	auto stagingRing = graph.Add("staging ring", [this]() { this->m_StagingRing.Init(this->m_Allocator, this->STAGING_RING_SIZE); }, { allocator });
+
+	util::TaskGraph::TaskId targets = 0;
+	if (this->m_Config.Headless)
+	{
+		targets = graph.Add("offscreen targets", [this]()
+		{
+			this->CreateOffscreenTargets();
+			this->CreateSwapChainImageViews();
+		}, { allocator });
+	}
+	else
+	{
+		targets = graph.Add("swap chain", [this]()
+		{
+			this->m_LatencyTracker.Init(this->m_Device, this->m_LatencyMeasurement);
+			this->CreateSwapChain();
+			this->CreateSwapChainImageViews();
+		}, { device }, Affinity::MainThread);
+	}
+
+	auto renderGraph = graph.Add("render graph", [this]() { this->CreateRenderGraph(); }, { device });
+	auto bindless = graph.Add("bindless descriptors", [this]()
+	{
+		if (this->m_BindlessEnabled)
+			this->m_Bindless.Init(this->m_Device, this->m_DeviceCaps, FramePacer::MAX_FRAMES_IN_FLIGHT);
+	}, { device });
+
+	auto uniformRing = graph.Add("uniform ring", [this]()
+	{
+		this->m_UniformRing.Init(this->m_Device, this->m_Allocator, this->m_DeviceCaps.Properties.limits,
+			this->UNIFORM_RING_FRAME_SIZE, FramePacer::MAX_FRAMES_IN_FLIGHT);
+	}, { allocator });
+
+	auto pipelineLayout = graph.Add("pipeline layout", [this]() { this->CreatePipelineLayout(); }, { bindless, uniformRing });
+
+	auto shaderModules = graph.Add("shader modules", [&]()
+	{
+		vertexModule = this->CreateShaderModule(vertexShaderBytes);
+		fragmentModule = this->CreateShaderModule(fragmentShaderBytes);
+	}, { device, readVertexShader, readFragmentShader });
+
+	auto graphicsPipeline = graph.Add("graphics pipeline", [&]()
+	{
+		this->CreateGraphicsPipeline(vertexModule, fragmentModule);
+
+		vkDestroyShaderModule(this->m_Device, vertexModule, nullptr);
+		vkDestroyShaderModule(this->m_Device, fragmentModule, nullptr);
+	}, { renderGraph, pipelineLayout, shaderModules, pipelineCache });
+
+	graph.Add("render targets", [this]() { this->CreateRenderTargets(); }, { targets, renderGraph, allocator });
+	graph.Add("command buffers", [this]()
+	{
+		this->CreateCommandPool();
+		this->CreateCommandBuffers();
+	}, { device });
+
+	graph.Add("sync objects", [this]() { this->CreateSyncObjects(); }, { device });
+
+	if (!this->m_Config.GpuProfileOutput.empty())
+	{
+		graph.Add("gpu profiler", [this]()
+		{
+			this->m_GpuProfiler.Init(this->m_Device, this->m_DeviceCaps, this->m_EnabledFeatures, this->m_CalibratedTimestamps,
+				this->m_GraphicsQueue, this->m_QueueFamilies.GraphicsFamily.value(), FramePacer::MAX_FRAMES_IN_FLIGHT, this->m_Config.GpuProfileFrames);
+		}, { device });
+	}
+
+	// Builds the culling pipeline next to the graphics one when instancing is enabled
+	auto scene = graph.Add("scene geometry", [&]()
+	{
+		this->CreateSceneGeometry(cullShaderBytes);
+		this->m_RenderGraph.SetSecondaryContents(this->m_ScenePass, !this->m_GpuDriven);
+	}, { stagingRing, pipelineCache, bindless, readCullShader, renderGraph });
+
+	// Its fallback texture goes through the staging ring, which only one task may use at a time
+	auto textureStreamer = graph.Add("texture streamer", [this]() { this->StartTextureStreaming(); }, { scene });
+
+	// The quads cycle through the streamed textures
+	graph.Add("quad renderer", [&]()
+	{
+		this->CreateQuads(quadVertexShaderBytes, quadFragmentShaderBytes);
+	}, { renderGraph, pipelineLayout, pipelineCache, allocator, readQuadShaders, textureStreamer });
+
+	if (this->m_Config.ShaderHotReload)
+		graph.Add("shader hot reload", [this]() { this->StartShaderHotReload(); }, { graphicsPipeline, scene });
+
+	// A few workers cover the widest part of the graph
+	uint32_t workerCount = std::clamp(std::thread::hardware_concurrency(), 2u, 4u) - 1;
+	graph.Run(workerCount);
+
+	this->m_StartupMillis = graph.GetElapsedMillis();
+	graph.LogTimeline("Startup");
 
 }
 
 void Application::CreateVulkanInstance()
 {
 	if (this->m_EnableValidationLayers && !this->CheckValidationLayerSupport())
-		LOG_WARNING("Validation layers not supported!");
+	{
+		// CI machines frequently ship only the ICD, so carry on without them
+		LOG_WARNING("Validation layers not supported, disabling them!");
+		this->m_EnableValidationLayers = false;
+	}
 
 	VkApplicationInfo appInfo = {};
 	appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
@@ -325,6 +484,30 @@ void Application::CreateVulkanSurface()
 	}
 }
 
+uint64_t Application::ScoreDevice(const DeviceCapabilities &caps)
+{
+
+	// The device type dominates, memory only breaks ties between devices of the same kind.
+	// Headless machines are expected to run on a CPU implementation (e.g. lavapipe).
+	uint64_t typeScore = 0;
+	switch (caps.Properties.deviceType)
+	{
+	case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:		typeScore = 4; break;
+	case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:	typeScore = 3; break;
+	case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:		typeScore = 2; break;
+	case VK_PHYSICAL_DEVICE_TYPE_CPU:				typeScore = this->m_Config.Headless ? 5 : 1; break;
+	default:										typeScore = 0; break;
+	}
+
+	// Dedicated transfer and compute queues let the async paths run next to rendering
+	uint64_t queueScore = (caps.QueueFamilies.TransferFamily.has_value() ? 1 : 0)
+		+ (caps.QueueFamilies.ComputeFamily.has_value() ? 1 : 0);
+
+	uint64_t memoryMiB = std::min<uint64_t>(caps.GetDeviceLocalMemory() / (1024 * 1024), 0xFFFFFF);
+
+	return (typeScore << 48) | (queueScore << 32) | memoryMiB;
+
+}
 void Application::SelectPhysicalDevice()
 {
 
@@ -340,51 +523,119 @@ void Application::SelectPhysicalDevice()
 	std::vector<VkPhysicalDevice> devices(deviceCount);
 	vkEnumeratePhysicalDevices(this->m_VulkanInstance, &deviceCount, devices.data());
 
-	for (const auto &device : devices)
+	// An index or part of the device name, the command line wins over the environment
+	std::string forcedDevice = this->m_Config.Device;
+	if (forcedDevice.empty())
+	{
+		if (const char *env = std::getenv("VULKAN_SANDBOX_DEVICE"))
+			forcedDevice = env;
+	}
+
+	auto matchesForcedDevice = [&forcedDevice](const DeviceCapabilities &caps)
 	{
-		if (IsDeviceSuitable(device))
+		// An index too large for uint32_t cannot match either, so it falls through to the name
+		const char *end = forcedDevice.data() + forcedDevice.size();
+		uint32_t index = 0;
+		auto [last, error] = std::from_chars(forcedDevice.data(), end, index);
+		if (error == std::errc() && last == end)
+			return index == caps.Index;
+
+		std::string name = caps.Properties.deviceName;
+		auto lower = [](std::string str)
 		{
-			VkPhysicalDeviceProperties props = {};
-			vkGetPhysicalDeviceProperties(device, &props);
-
-			LOG_INFO("Selecting Device {0} - {1}", props.deviceID, props.deviceName);
-			LOG_INFO("\tDRIVER VERSION: {0}", 
-				props.driverVersion);
-
-			LOG_INFO("\tAPI VERSION: {0}.{1}.{2}",
-				VK_VERSION_MAJOR(props.apiVersion),
-				VK_VERSION_MINOR(props.apiVersion),
-				VK_VERSION_PATCH(props.apiVersion));
-
-			switch (props.deviceType)
-			{
-			case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:	LOG_INFO("\tTYPE: Integrated GPU"); break;
-			case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:		LOG_INFO("\tTYPE: Dedicated GPU"); break;
-			case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:		LOG_INFO("\tTYPE: Virtual GPU"); break;
-			case VK_PHYSICAL_DEVICE_TYPE_CPU:				LOG_INFO("\tTYPE: CPU"); break;
-			default:										LOG_INFO("\tTYPE: UNKNOWN");
-			}
-
-			this->m_PhysicalDevice = device;
-			break;
+			std::transform(str.begin(), str.end(), str.begin(), [](unsigned char c) { return (char) std::tolower(c); });
+			return str;
+		};
+
+		return lower(name).find(lower(forcedDevice)) != std::string::npos;
+	};
+
+	const DeviceCapabilities *selected = nullptr;
+	const DeviceCapabilities *forced = nullptr;
+	uint64_t bestScore = 0;
+
+	std::vector<DeviceCapabilities> candidates;
+	candidates.reserve(deviceCount);
+
+	for (uint32_t i = 0; i < deviceCount; ++i)
+		candidates.push_back(DeviceCapabilities::Query(devices[i], i, this->m_Surface));
+
+	for (const DeviceCapabilities &caps : candidates)
+	{
+		bool suitable = this->IsDeviceSuitable(caps);
+		uint64_t score = suitable ? this->ScoreDevice(caps) : 0;
+
+		LOG_INFO("Device {0}: {1} ({2}, {3} MiB) {4}",
+			caps.Index, caps.Properties.deviceName, caps.GetTypeName(),
+			caps.GetDeviceLocalMemory() / (1024 * 1024),
+			suitable ? "score " + std::to_string(score) : std::string("unsuitable"));
+
+		if (!forcedDevice.empty() && !forced && matchesForcedDevice(caps))
+		{
+			if (suitable)
+				forced = &caps;
+			else
+				LOG_WARNING("Requested device {0} is not suitable, ignoring the override", caps.Properties.deviceName);
+		}
+
+		if (suitable && (!selected || score > bestScore))
+		{
+			selected = &caps;
+			bestScore = score;
 		}
 	}
 
-	if (!this->m_PhysicalDevice)
+	if (!forcedDevice.empty() && forced)
+		selected = forced;
+	else if (!forcedDevice.empty())
+		LOG_WARNING("No suitable device matches \"{0}\", selecting by score", forcedDevice);
+
+	if (!selected)
 	{
 		LOG_CRITICAL("Failed to find a suitable device for vulkan!");
 		exit(-1);
 	}
+
+	this->m_DeviceCaps = *selected;
+	this->m_PhysicalDevice = selected->Device;
+
+	const VkPhysicalDeviceProperties &props = this->m_DeviceCaps.Properties;
+
+	LOG_INFO("Selecting Device {0} - {1}", props.deviceID, props.deviceName);
+	LOG_INFO("\tDRIVER VERSION: {0}", 
+		props.driverVersion);
+
+	LOG_INFO("\tAPI VERSION: {0}.{1}.{2}",
+		VK_VERSION_MAJOR(props.apiVersion),
+		VK_VERSION_MINOR(props.apiVersion),
+		VK_VERSION_PATCH(props.apiVersion));
+
+	LOG_INFO("\tTYPE: {0}", this->m_DeviceCaps.GetTypeName());
 }
 
 void Application::CreateLogicalDevice()
 {
 
-	QueueFamilyIndices indices = this->FindQueueFamilies(this->m_PhysicalDevice);
+	QueueFamilyIndices indices = this->m_DeviceCaps.QueueFamilies;
 	float queuePriorities[] = { 1.0f };
 
+	if (!this->m_Config.AsyncQueues)
+	{
+		indices.TransferFamily.reset();
+		indices.ComputeFamily.reset();
+	}
+
 	std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-	std::set<uint32_t> uniqueQueueFamilies = { indices.GraphicsFamily.value(), indices.PresentFamily.value() };
+	std::set<uint32_t> uniqueQueueFamilies = { indices.GraphicsFamily.value() };
+
+	if (indices.PresentFamily.has_value())
+		uniqueQueueFamilies.insert(indices.PresentFamily.value());
+
+	if (indices.TransferFamily.has_value())
+		uniqueQueueFamilies.insert(indices.TransferFamily.value());
+
+	if (indices.ComputeFamily.has_value())
+		uniqueQueueFamilies.insert(indices.ComputeFamily.value());
 
 	for (uint32_t queueFamily : uniqueQueueFamilies)
 	{
@@ -400,15 +651,98 @@ void Application::CreateLogicalDevice()
 
 	VkPhysicalDeviceFeatures deviceFeatures = { 0 };
 
+	VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineFeatures = {};
+	timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+	timelineFeatures.timelineSemaphore = VK_TRUE;
+
 	VkDeviceCreateInfo createInfo = {};
 	createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+	createInfo.pNext = &timelineFeatures;
 	createInfo.queueCreateInfoCount = (uint32_t) queueCreateInfos.size();
 	createInfo.pQueueCreateInfos = queueCreateInfos.data();
 	createInfo.pEnabledFeatures = &deviceFeatures;
 
 	// Logical Device extensions
-	createInfo.enabledExtensionCount = (uint32_t) this->m_RequiredExtensions.size();
-	createInfo.ppEnabledExtensionNames = this->m_RequiredExtensions.data();
+	std::vector<const char *> extensions = this->m_RequiredExtensions;
+
+	// The profiler counts pipeline statistics, across secondary command buffers as well, and
+	// lines GPU timestamps up with the CPU clock where the device supports it
+	this->m_CalibratedTimestamps = false;
+	if (!this->m_Config.GpuProfileOutput.empty())
+	{
+		deviceFeatures.pipelineStatisticsQuery = this->m_DeviceCaps.Features.pipelineStatisticsQuery;
+		deviceFeatures.inheritedQueries = this->m_DeviceCaps.Features.inheritedQueries;
+
+		this->m_CalibratedTimestamps = this->m_DeviceCaps.HasExtension(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME);
+		if (this->m_CalibratedTimestamps)
+			extensions.push_back(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME);
+	}
+
+	// Lets the allocator report what the process may still allocate before the driver starts
+	// paging or failing, instead of guessing from the heap sizes
+	this->m_MemoryBudget = this->m_DeviceCaps.HasExtension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+	if (this->m_MemoryBudget)
+		extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
+	bool drawIndirectCount = this->m_DeviceCaps.HasExtension(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+	if (drawIndirectCount)
+		extensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+
+	// Present wait needs its features enabled on top of both extensions
+	VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures = {};
+	presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+	presentIdFeatures.presentId = VK_TRUE;
+
+	VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures = {};
+	presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+	presentWaitFeatures.presentWait = VK_TRUE;
+	presentWaitFeatures.pNext = &presentIdFeatures;
+
+	this->m_LatencyMeasurement = LatencyMeasurement::CpuEstimate;
+	if (!this->m_Config.Headless)
+	{
+		bool presentWait = this->m_DeviceCaps.PresentId && this->m_DeviceCaps.PresentWait;
+
+#ifdef APP_PLATFORM_LINUX
+		// Display timing reports CLOCK_MONOTONIC, the clock steady_clock reads on Linux only
+		if (this->m_DeviceCaps.HasExtension(VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME))
+		{
+			extensions.push_back(VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME);
+			this->m_LatencyMeasurement = LatencyMeasurement::DisplayTiming;
+		}
+		else
+#endif
+		if (presentWait)
+		{
+			extensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+			extensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+			timelineFeatures.pNext = &presentWaitFeatures;
+			this->m_LatencyMeasurement = LatencyMeasurement::PresentWait;
+		}
+	}
+
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = BindlessDescriptors::GetRequiredFeatures();
+
+	this->m_BindlessEnabled = false;
+	if (this->m_Config.Bindless)
+	{
+		this->m_BindlessEnabled = BindlessDescriptors::IsSupported(this->m_DeviceCaps);
+
+		if (this->m_BindlessEnabled)
+		{
+			// Materials index the texture array with handles from push constants
+			deviceFeatures.shaderSampledImageArrayDynamicIndexing = VK_TRUE;
+
+			extensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+			indexingFeatures.pNext = timelineFeatures.pNext;
+			timelineFeatures.pNext = &indexingFeatures;
+		}
+		else
+			LOG_WARNING("Descriptor indexing is not supported, pipelines are created without the bindless set");
+	}
+
+	createInfo.enabledExtensionCount = (uint32_t) extensions.size();
+	createInfo.ppEnabledExtensionNames = extensions.data();
 	//
 
 	// Although ignored in recent API versions
@@ -422,14 +756,31 @@ void Application::CreateLogicalDevice()
 		createInfo.ppEnabledLayerNames = this->m_ValidationLayers.data();
 	}
 
+	this->m_EnabledFeatures = deviceFeatures;
+
 	if (vkCreateDevice(this->m_PhysicalDevice, &createInfo, nullptr, &this->m_Device) != VK_SUCCESS)
 	{
 		LOG_CRITICAL("Failed to create the logical device!");
 		exit(-1);
 	}
 
+	if (drawIndirectCount)
+		this->m_CmdDrawIndexedIndirectCount = (PFN_vkCmdDrawIndexedIndirectCountKHR) vkGetDeviceProcAddr(this->m_Device, "vkCmdDrawIndexedIndirectCountKHR");
+
+	this->m_QueueFamilies = indices;
 	vkGetDeviceQueue(this->m_Device, indices.GraphicsFamily.value(), 0, &this->m_GraphicsQueue);
-	vkGetDeviceQueue(this->m_Device, indices.PresentFamily.value(), 0, &this->m_PresentQueue);
+	vkGetDeviceQueue(this->m_Device, indices.PresentFamily.value_or(indices.GraphicsFamily.value()), 0, &this->m_PresentQueue);
+
+	if (indices.TransferFamily.has_value())
+		vkGetDeviceQueue(this->m_Device, indices.TransferFamily.value(), 0, &this->m_TransferQueue);
+
+	if (indices.ComputeFamily.has_value())
+		vkGetDeviceQueue(this->m_Device, indices.ComputeFamily.value(), 0, &this->m_ComputeQueue);
+
+	LOG_INFO("Queue families: graphics {0}, transfer {1}, compute {2}",
+		indices.GraphicsFamily.value(),
+		indices.TransferFamily.has_value() ? std::to_string(indices.TransferFamily.value()) : "shared",
+		indices.ComputeFamily.has_value() ? std::to_string(indices.ComputeFamily.value()) : "shared");
 
 }
 
@@ -473,14 +824,32 @@ VkSurfaceFormatKHR Application::SelectSwapChainSurfaceFormat(const std::vector<V
 	//
 	return surfaceFormats[0];
 }
+static const char *PresentModeToString(VkPresentModeKHR mode)
+{
+	switch (mode)
+	{
+	case VK_PRESENT_MODE_IMMEDIATE_KHR:		return "IMMEDIATE";
+	case VK_PRESENT_MODE_MAILBOX_KHR:		return "MAILBOX";
+	case VK_PRESENT_MODE_FIFO_KHR:			return "FIFO";
+	case VK_PRESENT_MODE_FIFO_RELAXED_KHR:	return "FIFO_RELAXED";
+	default:								return "UNKNOWN";
+	}
+}
 VkPresentModeKHR Application::SelectSwapChainPresentMode(const std::vector<VkPresentModeKHR> &presentModes)
 {
+	VkPresentModeKHR requested = this->m_Config.PresentMode;
+
 	for (VkPresentModeKHR mode : presentModes)
 	{
-		if (mode == VK_PRESENT_MODE_MAILBOX_KHR)
+		if (mode == requested)
 			return mode;
 	}
 
+	// FIFO is the only mode every implementation has to support. Only reported
+	// for the first swap chain so resizing does not repeat the warning.
+	if (this->m_SwapChain == VK_NULL_HANDLE)
+		LOG_WARNING("Present mode {0} is not supported, falling back to FIFO", PresentModeToString(requested));
+
 	return VK_PRESENT_MODE_FIFO_KHR;
 }
 VkExtent2D Application::SelectSwapChainExtent(const VkSurfaceCapabilitiesKHR &capabilities)
@@ -488,30 +857,56 @@ VkExtent2D Application::SelectSwapChainExtent(const VkSurfaceCapabilitiesKHR &ca
 	if (capabilities.currentExtent.width != UINT32_MAX)
 		return capabilities.currentExtent;
 
-	VkExtent2D extent = { (uint32_t) this->m_WindowWidth, (uint32_t) this->m_WindowHeight };
+	int width = 0, height = 0;
+	glfwGetFramebufferSize(this->m_Window, &width, &height);
+
+	VkExtent2D extent = { (uint32_t) width, (uint32_t) height };
 
 	extent.width = std::max(capabilities.minImageExtent.width, std::min(capabilities.maxImageExtent.width, extent.width));
 	extent.height = std::max(capabilities.minImageExtent.height, std::min(capabilities.maxImageExtent.height, extent.height));
 
 	return extent;
 }
+void Application::SelectSurfaceFormat()
+{
+
+	// Picked once ahead of the swap chain, so the render pass and pipeline can be
+	// created alongside it. Recreated swap chains keep the format.
+	if (this->m_Config.Headless)
+		this->m_SurfaceFormat = { VK_FORMAT_R8G8B8A8_UNORM, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR };
+	else
+		this->m_SurfaceFormat = this->SelectSwapChainSurfaceFormat(this->RetrieveSwapChainCapabilities(this->m_PhysicalDevice).formats);
+
+	this->m_SwapChainFormat = this->m_SurfaceFormat.format;
+
+}
 void Application::CreateSwapChain()
 {
 
 	SwapChainCapabilities swapChainCaps = this->RetrieveSwapChainCapabilities(this->m_PhysicalDevice);
 
-	VkSurfaceFormatKHR format = this->SelectSwapChainSurfaceFormat(swapChainCaps.formats);
+	const VkSurfaceFormatKHR &format = this->m_SurfaceFormat;
 	VkPresentModeKHR presentMode = this->SelectSwapChainPresentMode(swapChainCaps.presentModes);
 	VkExtent2D extent = this->SelectSwapChainExtent(swapChainCaps.capabilities);
 
-	this->m_SwapChainFormat = format.format;
 	this->m_SwapChainExtent = extent;
+	this->m_PresentMode = presentMode;
+
+	// Fewer images queue fewer frames for the display, at the risk of waiting for one to free up
+	uint32_t desiredImageCount = this->m_Config.SwapChainImageCount;
+	if (!desiredImageCount)
+		desiredImageCount = swapChainCaps.capabilities.minImageCount + 1;
+
+	if (desiredImageCount < swapChainCaps.capabilities.minImageCount)
+		desiredImageCount = swapChainCaps.capabilities.minImageCount;
 
-	uint32_t desiredImageCount = swapChainCaps.capabilities.minImageCount + 1;
 	if (swapChainCaps.capabilities.maxImageCount > 0
 	&& desiredImageCount > swapChainCaps.capabilities.maxImageCount)
 		desiredImageCount = swapChainCaps.capabilities.maxImageCount;
 
+	if (this->m_Config.SwapChainImageCount && desiredImageCount != this->m_Config.SwapChainImageCount && this->m_SwapChain == VK_NULL_HANDLE)
+		LOG_WARNING("Swap chain image count clamped to {0}", desiredImageCount);
+
 	VkSwapchainCreateInfoKHR createInfo = {};
 	createInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
 	createInfo.surface = this->m_Surface;
@@ -523,7 +918,7 @@ void Application::CreateSwapChain()
 	createInfo.imageArrayLayers = 1;
 	createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
 
-	QueueFamilyIndices indices = this->FindQueueFamilies(this->m_PhysicalDevice);
+	const QueueFamilyIndices &indices = this->m_QueueFamilies;
 	uint32_t queueFamilyIndices[] = { indices.GraphicsFamily.value(), indices.PresentFamily.value() };
 
 	if (indices.GraphicsFamily != indices.PresentFamily)
@@ -543,20 +938,33 @@ void Application::CreateSwapChain()
 	createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
 	createInfo.presentMode = presentMode;
 	createInfo.clipped = VK_TRUE;
-	createInfo.oldSwapchain = VK_NULL_HANDLE;
+	createInfo.oldSwapchain = this->m_SwapChain;
 
-	if (vkCreateSwapchainKHR(this->m_Device, &createInfo, nullptr, &this->m_SwapChain) != VK_SUCCESS)
+	VkSwapchainKHR swapChain = VK_NULL_HANDLE;
+	if (vkCreateSwapchainKHR(this->m_Device, &createInfo, nullptr, &swapChain) != VK_SUCCESS)
 	{
 		LOG_CRITICAL("Failed to create Swap Chain!");
 		exit(-1);
 	}
 
+	// The old swap chain may still be presenting frames in flight
+	if (this->m_SwapChain)
+		this->m_DeletionQueue.Retire(std::move(this->m_SwapChain), this->m_FramePacer.GetSubmittedFrames());
+
+	this->m_SwapChain = UniqueSwapchain(this->m_Device, swapChain);
+
 	uint32_t swapChainImageCount = 0;
 	vkGetSwapchainImagesKHR(this->m_Device, this->m_SwapChain, &swapChainImageCount, nullptr);
 
 	this->m_SwapChainImages.resize(swapChainImageCount);
 	vkGetSwapchainImagesKHR(this->m_Device, this->m_SwapChain, &swapChainImageCount, this->m_SwapChainImages.data());
 
+	// The driver owns the images, every surface format picked here takes four bytes per texel
+	VkDeviceSize imageBytes = (VkDeviceSize) this->m_SwapChainExtent.width * this->m_SwapChainExtent.height * 4;
+	this->m_Allocator.SetExternalBytes(MemoryCategory::Swapchain, imageBytes * swapChainImageCount);
+
+	this->m_LatencyTracker.SetSwapChain(this->m_SwapChain);
+
 }
 
 void Application::CreateSwapChainImageViews()
@@ -583,7 +991,7 @@ void Application::CreateSwapChainImageViews()
 		createInfo.subresourceRange.baseArrayLayer = 0;
 		createInfo.subresourceRange.layerCount = 1;
 
-		if (vkCreateImageView(this->m_Device, &createInfo, nullptr, &this->m_SwapChainImageViews[i]) != VK_SUCCESS)
+		if (vkCreateImageView(this->m_Device, &createInfo, nullptr, this->m_SwapChainImageViews[i].Replace(this->m_Device)) != VK_SUCCESS)
 		{
 			LOG_CRITICAL("Failed to create Swap Chain image views!");
 			exit(-1);
@@ -591,126 +999,356 @@ void Application::CreateSwapChainImageViews()
 	}
 }
 
-void Application::CreateRenderPass()
-{
-	VkAttachmentDescription colorAttachment = {};
-	colorAttachment.format = this->m_SwapChainFormat;
-	colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-	colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-	colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-	colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-	colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-	colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-
-	VkAttachmentReference colorAttachmentRef = {};
-	colorAttachmentRef.attachment = 0;
-	colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-	VkSubpassDescription subpass = {};
-	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-	subpass.colorAttachmentCount = 1;
-	subpass.pColorAttachments = &colorAttachmentRef;
-
-	VkSubpassDependency dependency = {};
-	dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-	dependency.dstSubpass = 0;
-	dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	dependency.srcAccessMask = 0;
-	dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-
-	VkRenderPassCreateInfo renderPassCreateInfo = {};
-	renderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-	renderPassCreateInfo.attachmentCount = 1;
-	renderPassCreateInfo.pAttachments = &colorAttachment;
-	renderPassCreateInfo.subpassCount = 1;
-	renderPassCreateInfo.pSubpasses = &subpass;
-	renderPassCreateInfo.dependencyCount = 1;
-	renderPassCreateInfo.pDependencies = &dependency;
-
-	if (vkCreateRenderPass(this->m_Device, &renderPassCreateInfo, nullptr, &this->m_RenderPass) != VK_SUCCESS)
-	{
-		LOG_CRITICAL("Failed to create render pass!");
-		exit(-1);
-	}
-}
-
-VkShaderModule Application::CreateShaderModule(const std::vector<char>& bytes)
+void Application::RecreateSwapChain()
 {
 
-	VkShaderModuleCreateInfo createInfo = {};
-	createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-	createInfo.codeSize = bytes.size();
-	createInfo.pCode = reinterpret_cast<const uint32_t*>(bytes.data());
+	int width = 0, height = 0;
+	glfwGetFramebufferSize(this->m_Window, &width, &height);
 
-	VkShaderModule module = nullptr;
-	if (vkCreateShaderModule(this->m_Device, &createInfo, nullptr, &module) != VK_SUCCESS)
+	// A minimized window has no extent to create a swap chain with
+	while ((width == 0 || height == 0) && !glfwWindowShouldClose(this->m_Window))
 	{
-		LOG_ERROR("Failed to create shader module!");
-		return nullptr;
+		glfwWaitEvents();
+		glfwGetFramebufferSize(this->m_Window, &width, &height);
 	}
 
-	return module;
+	if (width == 0 || height == 0)
+		return;
+
+	util::Timer timer;
+
+	// Frames still in flight may reference the current views, so they are only destroyed
+	// once the frame pacer reports those frames complete. CreateSwapChain and the render
+	// graph retire the swap chain and framebuffers the same way.
+	this->m_DeletionQueue.Retire(std::move(this->m_SwapChainImageViews), this->m_FramePacer.GetSubmittedFrames());
+	this->m_SwapChainImageViews.clear();
+
+	// The surface format stays the same across recreation,
+	// so the render passes and pipeline remain compatible.
+	this->CreateSwapChain();
+	this->CreateSwapChainImageViews();
+	this->CreateRenderTargets();
+
+	LOG_INFO("Recreated swap chain ({0}x{1}) in {2:.3f}ms",
+		this->m_SwapChainExtent.width,
+		this->m_SwapChainExtent.height,
+		timer.ElapsedMillis());
 
 }
-void Application::CreateGraphicsPipeline()
+void Application::StartShaderHotReload()
 {
-	auto vertexShaderBytes = ReadFile("assets/shaders/vertex.spv");
-	auto fragmentShaderBytes = ReadFile("assets/shaders/fragment.spv");
 
-	VkShaderModule vertexModule = CreateShaderModule(vertexShaderBytes);
-	VkShaderModule fragmentModule = CreateShaderModule(fragmentShaderBytes);
+	std::map<std::string, std::string> stages = {
+		{ "vertex.glsl", "vertex" },
+		{ this->GetFragmentShaderName() + ".glsl", "fragment" }
+	};
 
-	VkPipelineShaderStageCreateInfo vertexStageCreateInfo = {};
-	vertexStageCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	vertexStageCreateInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-	vertexStageCreateInfo.module = vertexModule;
-	vertexStageCreateInfo.pName = "main";
+	// Also watched when culling failed to start, so a broken cull.glsl can be fixed
+	if (this->m_Config.InstanceCount > 0)
+		stages["cull.glsl"] = "compute";
 
-	VkPipelineShaderStageCreateInfo fragmentStageCreateInfo = {};
-	fragmentStageCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	fragmentStageCreateInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-	fragmentStageCreateInfo.module = fragmentModule;
-	fragmentStageCreateInfo.pName = "main";
+	this->m_ShaderWatcher.Start("assets/shaders", stages, [this](const std::string &source, const std::vector<char> &spirv)
+	{
+		this->OnShaderReloaded(source, spirv);
+	});
 
-	VkPipelineShaderStageCreateInfo shaderStages[] = { vertexStageCreateInfo, fragmentStageCreateInfo };
+}
 
-	VkPipelineVertexInputStateCreateInfo vertexInputCreateInfo = {};
-	vertexInputCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-	vertexInputCreateInfo.vertexBindingDescriptionCount = 0;
-	vertexInputCreateInfo.pVertexBindingDescriptions = nullptr;
-	vertexInputCreateInfo.vertexAttributeDescriptionCount = 0;
-	vertexInputCreateInfo.pVertexAttributeDescriptions = nullptr;
+void Application::OnShaderReloaded(const std::string &source, const std::vector<char> &spirv)
+{
 
-	VkPipelineInputAssemblyStateCreateInfo inputAssemblyCreateInfo = {};
-	inputAssemblyCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-	inputAssemblyCreateInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-	inputAssemblyCreateInfo.primitiveRestartEnable = VK_FALSE;
+	// Runs on the watcher thread, only the swap itself waits for a frame boundary
+	util::Timer timer;
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	bool culling = source == "cull.glsl";
 
-	VkViewport viewport = {};
-	viewport.x = 0;
-	viewport.y = 0;
-	viewport.width = (float) this->m_SwapChainExtent.width;
-	viewport.height = (float) this->m_SwapChainExtent.height;
-	viewport.minDepth = 0.0f;
-	viewport.maxDepth = 1.0f;
+	// The culling buffers are only created at startup
+	if (culling && !this->m_GpuDriven)
+	{
+		LOG_WARNING("{0} compiles now, restart to draw the instances with GPU culling", source);
+		return;
+	}
 
-	VkRect2D scissor = {};
-	scissor.offset = {0, 0};
-	scissor.extent = this->m_SwapChainExtent;
+	if (culling)
+		pipeline = this->m_Culling.CreatePipeline(spirv, this->m_PipelineCache.GetHandle());
+	else if (source == "vertex.glsl")
+		pipeline = this->BuildGraphicsPipeline(spirv, ReadFile("assets/shaders/" + this->GetFragmentShaderName() + ".spv"));
+	else
+		pipeline = this->BuildGraphicsPipeline(ReadFile("assets/shaders/vertex.spv"), spirv);
 
-	VkPipelineViewportStateCreateInfo viewportState = {};
-	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-	viewportState.viewportCount = 1;
-	viewportState.pViewports = &viewport;
-	viewportState.scissorCount = 1;
-	viewportState.pScissors = &scissor;
+	if (!pipeline)
+	{
+		LOG_ERROR("Failed to rebuild the pipeline for {0}, keeping the current one", source);
+		return;
+	}
 
-	VkPipelineRasterizationStateCreateInfo rasterizer = {};
-	rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-	rasterizer.depthClampEnable = VK_FALSE;
-	rasterizer.rasterizerDiscardEnable = VK_FALSE;
+	LOG_INFO("Rebuilt the pipeline for {0} in {1:.3f}ms", source, timer.ElapsedMillis());
+
+	// Replacing one that no frame picked up yet destroys it right away
+	std::lock_guard<std::mutex> lock(this->m_ReloadMutex);
+	UniquePipeline &pending = culling ? this->m_ReloadedCullingPipeline : this->m_ReloadedGraphicsPipeline;
+	pending = UniquePipeline(this->m_Device, pipeline);
+
+}
+
+void Application::ApplyReloadedPipelines()
+{
+
+	// Never waits on the watcher thread, a pipeline that is still being handed over is picked up next frame
+	std::unique_lock<std::mutex> lock(this->m_ReloadMutex, std::try_to_lock);
+	if (!lock.owns_lock())
+		return;
+
+	uint64_t lastUsedFrame = this->m_FramePacer.GetSubmittedFrames();
+
+	if (this->m_ReloadedGraphicsPipeline)
+	{
+		this->m_DeletionQueue.Retire(std::move(this->m_GraphicsPipeline), lastUsedFrame);
+		this->m_GraphicsPipeline = std::move(this->m_ReloadedGraphicsPipeline);
+	}
+
+	// The culling pass owns its pipeline, the old one comes back raw
+	if (this->m_ReloadedCullingPipeline)
+	{
+		VkPipeline retired = this->m_Culling.SwapPipeline(this->m_ReloadedCullingPipeline.Release());
+		this->m_DeletionQueue.Retire(UniquePipeline(this->m_Device, retired), lastUsedFrame);
+	}
+
+}
+
+void Application::CreateOffscreenTargets()
+{
+
+	this->m_SwapChainExtent = { (uint32_t) this->m_WindowWidth, (uint32_t) this->m_WindowHeight };
+
+	this->m_SwapChainImages.resize(this->HEADLESS_IMAGE_COUNT);
+	this->m_OffscreenImages.resize(this->HEADLESS_IMAGE_COUNT);
+
+	AllocationCreateInfo allocInfo = {};
+	allocInfo.RequiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+	allocInfo.Dedicated = true;
+	allocInfo.Category = MemoryCategory::Swapchain;
+
+	for (uint32_t i = 0; i < this->HEADLESS_IMAGE_COUNT; ++i)
+	{
+		VkImageCreateInfo createInfo = {};
+		createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		createInfo.imageType = VK_IMAGE_TYPE_2D;
+		createInfo.format = this->m_SwapChainFormat;
+		createInfo.extent = { this->m_SwapChainExtent.width, this->m_SwapChainExtent.height, 1 };
+		createInfo.mipLevels = 1;
+		createInfo.arrayLayers = 1;
+		createInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		createInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		createInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+		createInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		createInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+		MemoryAllocation memory;
+		if (this->m_Allocator.CreateImage(createInfo, allocInfo, this->m_SwapChainImages[i], memory) != VK_SUCCESS)
+		{
+			LOG_CRITICAL("Failed to create offscreen render target!");
+			exit(-1);
+		}
+
+		this->m_OffscreenImages[i] = UniqueImage(this->m_Allocator, this->m_SwapChainImages[i], memory);
+	}
+
+	LOG_INFO("Created {0} headless render targets ({1}x{2})",
+		this->HEADLESS_IMAGE_COUNT,
+		this->m_SwapChainExtent.width,
+		this->m_SwapChainExtent.height);
+
+}
+void Application::DestroyOffscreenTargets()
+{
+
+	this->m_SwapChainImages.clear();
+	this->m_OffscreenImages.clear();
+
+}
+
+void Application::CreateRenderGraph()
+{
+
+	this->m_RenderGraph.Init(this->m_Device, this->m_Allocator);
+
+	VkImageLayout finalLayout = this->m_Config.Headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	this->m_BackbufferResource = this->m_RenderGraph.ImportImage("backbuffer", this->m_SwapChainFormat, finalLayout);
+
+	this->m_ScenePass = this->m_RenderGraph.AddPass("scene", [this](VkCommandBuffer commandBuffer, uint32_t imageIndex)
+	{
+		this->RecordScenePass(commandBuffer, imageIndex);
+	});
+
+	this->m_RenderGraph.ClearColor(this->m_ScenePass, this->m_BackbufferResource, { { 0.015f, 0.015f, 0.02f, 1.0f } });
+
+	// Quads take their textures from the bindless set
+	this->m_QuadPassEnabled = this->m_Config.QuadCount > 0 && this->m_BindlessEnabled;
+	if (this->m_QuadPassEnabled)
+	{
+		this->m_QuadPass = this->m_RenderGraph.AddPass("quads", [this](VkCommandBuffer commandBuffer, uint32_t imageIndex)
+		{
+			this->RecordQuadPass(commandBuffer, imageIndex);
+		});
+
+		this->m_RenderGraph.WriteColor(this->m_QuadPass, this->m_BackbufferResource);
+	}
+
+	this->m_RenderGraph.Compile();
+
+}
+
+void Application::CreateRenderTargets()
+{
+
+	std::vector<VkImageView> views(this->m_SwapChainImageViews.begin(), this->m_SwapChainImageViews.end());
+	this->m_RenderGraph.SetImportedImages(this->m_BackbufferResource, this->m_SwapChainImages, views);
+	this->m_RenderGraph.CreateTargets(this->m_SwapChainExtent, this->m_DeletionQueue, this->m_FramePacer.GetSubmittedFrames());
+
+}
+
+VkShaderModule Application::CreateShaderModule(const std::vector<char>& bytes)
+{
+
+	VkShaderModuleCreateInfo createInfo = {};
+	createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	createInfo.codeSize = bytes.size();
+	createInfo.pCode = reinterpret_cast<const uint32_t*>(bytes.data());
+
+	VkShaderModule module = nullptr;
+	if (vkCreateShaderModule(this->m_Device, &createInfo, nullptr, &module) != VK_SUCCESS)
+	{
+		LOG_ERROR("Failed to create shader module!");
+		return nullptr;
+	}
+
+	return module;
+
+}
+void Application::CreatePipelineLayout()
+{
+
+	// Every pipeline shares this layout, materials only differ in the handles they push.
+	// Shaders that declare neither the set nor the constants remain compatible with it.
+	VkPushConstantRange pushConstantRange = {};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(DrawConstants);
+
+	VkDescriptorSetLayout setLayouts[] = { this->m_UniformRing.GetLayout(), this->m_Bindless.GetLayout() };
+
+	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {};
+	pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+	pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+	pipelineLayoutCreateInfo.setLayoutCount = this->m_BindlessEnabled ? 2 : 1;
+	pipelineLayoutCreateInfo.pSetLayouts = setLayouts;
+
+	if (vkCreatePipelineLayout(this->m_Device, &pipelineLayoutCreateInfo, nullptr, this->m_PipelineLayout.Replace(this->m_Device)) != VK_SUCCESS)
+	{
+		LOG_ERROR("Failed to create pipeline layout!");
+		exit(-1);
+	}
+
+}
+void Application::CreateGraphicsPipeline(VkShaderModule vertexModule, VkShaderModule fragmentModule)
+{
+
+	if (!vertexModule || !fragmentModule)
+	{
+		LOG_CRITICAL("Failed to create graphics pipeline, the shaders did not load!");
+		exit(-1);
+	}
+
+	util::Timer pipelineTimer;
+	this->m_GraphicsPipeline = UniquePipeline(this->m_Device, this->BuildGraphicsPipeline(vertexModule, fragmentModule));
+
+	if (!this->m_GraphicsPipeline)
+	{
+		LOG_CRITICAL("Failed to create graphics pipeline!");
+		exit(-1);
+	}
+
+	this->m_PipelineCreationMillis = pipelineTimer.ElapsedMillis();
+	LOG_INFO("Created graphics pipeline in {0:.3f}ms ({1} pipeline cache)",
+		this->m_PipelineCreationMillis,
+		this->m_PipelineCache.IsWarm() ? "warm" : "cold");
+
+}
+
+VkPipeline Application::BuildGraphicsPipeline(const std::vector<char> &vertexShaderBytes, const std::vector<char> &fragmentShaderBytes)
+{
+
+	VkShaderModule vertexModule = CreateShaderModule(vertexShaderBytes);
+	VkShaderModule fragmentModule = CreateShaderModule(fragmentShaderBytes);
+
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	if (vertexModule && fragmentModule)
+		pipeline = this->BuildGraphicsPipeline(vertexModule, fragmentModule);
+
+	if (vertexModule)
+		vkDestroyShaderModule(this->m_Device, vertexModule, nullptr);
+
+	if (fragmentModule)
+		vkDestroyShaderModule(this->m_Device, fragmentModule, nullptr);
+
+	return pipeline;
+
+}
+
+VkPipeline Application::BuildGraphicsPipeline(VkShaderModule vertexModule, VkShaderModule fragmentModule)
+{
+
+	VkPipelineShaderStageCreateInfo vertexStageCreateInfo = {};
+	vertexStageCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	vertexStageCreateInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
+	vertexStageCreateInfo.module = vertexModule;
+	vertexStageCreateInfo.pName = "main";
+
+	VkPipelineShaderStageCreateInfo fragmentStageCreateInfo = {};
+	fragmentStageCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	fragmentStageCreateInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+	fragmentStageCreateInfo.module = fragmentModule;
+	fragmentStageCreateInfo.pName = "main";
+
+	VkPipelineShaderStageCreateInfo shaderStages[] = { vertexStageCreateInfo, fragmentStageCreateInfo };
+
+	VkVertexInputBindingDescription bindingDescriptions[] = {
+		Vertex::GetBindingDescription(),
+		InstanceData::GetBindingDescription()
+	};
+
+	auto vertexAttributes = Vertex::GetAttributeDescriptions();
+	auto instanceAttributes = InstanceData::GetAttributeDescriptions();
+
+	std::vector<VkVertexInputAttributeDescription> attributeDescriptions(vertexAttributes.begin(), vertexAttributes.end());
+	attributeDescriptions.insert(attributeDescriptions.end(), instanceAttributes.begin(), instanceAttributes.end());
+
+	VkPipelineVertexInputStateCreateInfo vertexInputCreateInfo = {};
+	vertexInputCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	vertexInputCreateInfo.vertexBindingDescriptionCount = 2;
+	vertexInputCreateInfo.pVertexBindingDescriptions = bindingDescriptions;
+	vertexInputCreateInfo.vertexAttributeDescriptionCount = (uint32_t) attributeDescriptions.size();
+	vertexInputCreateInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+
+	VkPipelineInputAssemblyStateCreateInfo inputAssemblyCreateInfo = {};
+	inputAssemblyCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	inputAssemblyCreateInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	inputAssemblyCreateInfo.primitiveRestartEnable = VK_FALSE;
+
+	// Viewport and scissor are dynamic, so the pipeline survives swap chain recreation
+	VkPipelineViewportStateCreateInfo viewportState = {};
+	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewportState.viewportCount = 1;
+	viewportState.pViewports = nullptr;
+	viewportState.scissorCount = 1;
+	viewportState.pScissors = nullptr;
+
+	VkPipelineRasterizationStateCreateInfo rasterizer = {};
+	rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasterizer.depthClampEnable = VK_FALSE;
+	rasterizer.rasterizerDiscardEnable = VK_FALSE;
 	rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
 	rasterizer.lineWidth = 1.0f;
 	rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
@@ -756,7 +1394,7 @@ void Application::CreateGraphicsPipeline()
 
 	VkDynamicState dynamicStates[] = {
 		VK_DYNAMIC_STATE_VIEWPORT,
-		VK_DYNAMIC_STATE_LINE_WIDTH
+		VK_DYNAMIC_STATE_SCISSOR
 	};
 
 	VkPipelineDynamicStateCreateInfo dynamicState = {};
@@ -764,19 +1402,6 @@ void Application::CreateGraphicsPipeline()
 	dynamicState.dynamicStateCount = 2;
 	dynamicState.pDynamicStates = dynamicStates;
 
-	VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {};
-	pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-	pipelineLayoutCreateInfo.pushConstantRangeCount = 0;
-	pipelineLayoutCreateInfo.pPushConstantRanges = nullptr;
-	pipelineLayoutCreateInfo.setLayoutCount = 0;
-	pipelineLayoutCreateInfo.pSetLayouts = nullptr;
-
-	if (vkCreatePipelineLayout(this->m_Device, &pipelineLayoutCreateInfo, nullptr, &this->m_PipelineLayout) != VK_SUCCESS)
-	{
-		LOG_ERROR("Failed to create pipeline layout!");
-		exit(-1);
-	}
-
 	VkGraphicsPipelineCreateInfo pipelineCreateInfo = {};
 	pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
 	pipelineCreateInfo.stageCount = 2;
@@ -789,80 +1414,87 @@ void Application::CreateGraphicsPipeline()
 	pipelineCreateInfo.pMultisampleState = &multisampling;
 	pipelineCreateInfo.pDepthStencilState = nullptr;
 	pipelineCreateInfo.pColorBlendState = &colorBlending;
-	pipelineCreateInfo.pDynamicState = nullptr;
+	pipelineCreateInfo.pDynamicState = &dynamicState;
 
 	pipelineCreateInfo.layout = this->m_PipelineLayout;
 
-	pipelineCreateInfo.renderPass = this->m_RenderPass;
-	pipelineCreateInfo.subpass = 0;
+	pipelineCreateInfo.renderPass = this->m_RenderGraph.GetRenderPass(this->m_ScenePass);
+	pipelineCreateInfo.subpass = this->m_RenderGraph.GetSubpass(this->m_ScenePass);
 
 	pipelineCreateInfo.basePipelineHandle = nullptr;
 	pipelineCreateInfo.basePipelineIndex = -1;
 
-	if (vkCreateGraphicsPipelines(this->m_Device, VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, &this->m_GraphicsPipeline) != VK_SUCCESS)
-	{
-		LOG_CRITICAL("Failed to create graphics pipeline!");
-		exit(-1);
-	}
+	// The pipeline cache is internally synchronized, so this also runs on the shader watcher thread
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	VkResult result = vkCreateGraphicsPipelines(this->m_Device, this->m_PipelineCache.GetHandle(), 1, &pipelineCreateInfo, nullptr, &pipeline);
 
-	vkDestroyShaderModule(this->m_Device, vertexModule, nullptr);
-	vkDestroyShaderModule(this->m_Device, fragmentModule, nullptr);
+	return result == VK_SUCCESS ? pipeline : VK_NULL_HANDLE;
 
 }
 
-void Application::CreateFramebuffers()
+void Application::CreateCommandPool()
 {
 
-	this->m_SwapChainFramebuffers.resize(this->m_SwapChainImageViews.size());
+	VkCommandPoolCreateInfo poolCreateInfo = {};
+	poolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolCreateInfo.queueFamilyIndex = this->m_QueueFamilies.GraphicsFamily.value();
+	poolCreateInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 
-	for (int i = 0; i < this->m_SwapChainImageViews.size(); ++i)
+	if (vkCreateCommandPool(this->m_Device, &poolCreateInfo, nullptr, this->m_CommandPool.Replace(this->m_Device)) != VK_SUCCESS)
 	{
-		VkImageView attachments[] = {
-			this->m_SwapChainImageViews[i]
-		};
+		LOG_CRITICAL("Failed to create command pool!");
+		exit(-1);
+	}
 
-		VkFramebufferCreateInfo createInfo = {};
-		createInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-		createInfo.renderPass = this->m_RenderPass;
-		createInfo.attachmentCount = 1;
-		createInfo.pAttachments = attachments;
-		createInfo.width = this->m_SwapChainExtent.width;
-		createInfo.height = this->m_SwapChainExtent.height;
-		createInfo.layers = 1;
+	if (this->m_TransferQueue)
+	{
+		poolCreateInfo.queueFamilyIndex = this->m_QueueFamilies.TransferFamily.value();
 
-		if (vkCreateFramebuffer(this->m_Device, &createInfo, nullptr, &m_SwapChainFramebuffers[i]) != VK_SUCCESS)
+		if (vkCreateCommandPool(this->m_Device, &poolCreateInfo, nullptr, this->m_TransferCommandPool.Replace(this->m_Device)) != VK_SUCCESS)
 		{
-			LOG_CRITICAL("Failed to create framebuffer!");
+			LOG_CRITICAL("Failed to create transfer command pool!");
 			exit(-1);
 		}
 	}
-}
 
-void Application::CreateCommandPool()
-{
+	if (this->m_ComputeQueue)
+	{
+		poolCreateInfo.queueFamilyIndex = this->m_QueueFamilies.ComputeFamily.value();
+
+		if (vkCreateCommandPool(this->m_Device, &poolCreateInfo, nullptr, this->m_ComputeCommandPool.Replace(this->m_Device)) != VK_SUCCESS)
+		{
+			LOG_CRITICAL("Failed to create compute command pool!");
+			exit(-1);
+		}
+	}
 
-	QueueFamilyIndices queueFamilyIndices = FindQueueFamilies(this->m_PhysicalDevice);
+	poolCreateInfo.queueFamilyIndex = this->m_QueueFamilies.GraphicsFamily.value();
 
-	VkCommandPoolCreateInfo poolCreateInfo = {};
-	poolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-	poolCreateInfo.queueFamilyIndex = queueFamilyIndices.GraphicsFamily.value();
-	poolCreateInfo.flags = 0;
+	// Command pools are externally synchronized, so every recording thread
+	// gets its own for each frame in flight and resets it as a whole.
+	uint32_t threadCount = this->m_RecordThreads->GetThreadCount();
+	this->m_WorkerCommandPools.resize(FramePacer::MAX_FRAMES_IN_FLIGHT * threadCount);
 
-	if (vkCreateCommandPool(this->m_Device, &poolCreateInfo, nullptr, &this->m_CommandPool) != VK_SUCCESS)
+	poolCreateInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+	for (UniqueCommandPool &pool : this->m_WorkerCommandPools)
 	{
-		LOG_CRITICAL("Failed to create command pool!");
-		exit(-1);
+		if (vkCreateCommandPool(this->m_Device, &poolCreateInfo, nullptr, pool.Replace(this->m_Device)) != VK_SUCCESS)
+		{
+			LOG_CRITICAL("Failed to create worker command pool!");
+			exit(-1);
+		}
 	}
 
 }
 void Application::CreateCommandBuffers()
 {
 
-	this->m_CommandBuffers.resize(this->m_SwapChainFramebuffers.size());
+	this->m_CommandBuffers.resize(FramePacer::MAX_FRAMES_IN_FLIGHT);
 
 	VkCommandBufferAllocateInfo allocInfo = {};
 	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-	allocInfo.commandBufferCount = (uint32_t) this->m_SwapChainFramebuffers.size();
+	allocInfo.commandBufferCount = (uint32_t) this->m_CommandBuffers.size();
 	allocInfo.commandPool = this->m_CommandPool;
 	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
 
@@ -872,194 +1504,1333 @@ void Application::CreateCommandBuffers()
 		exit(-1);
 	}
 
-	for (size_t i = 0; i < this->m_CommandBuffers.size(); ++i)
+	if (this->m_TransferCommandPool)
 	{
-		VkCommandBufferBeginInfo beginInfo = {};
-		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		beginInfo.flags = 0;
-		beginInfo.pInheritanceInfo = nullptr;
+		this->m_TransferCommandBuffers.resize(FramePacer::MAX_FRAMES_IN_FLIGHT);
+		allocInfo.commandPool = this->m_TransferCommandPool;
 
-		if (vkBeginCommandBuffer(this->m_CommandBuffers[i], &beginInfo) != VK_SUCCESS)
+		if (vkAllocateCommandBuffers(this->m_Device, &allocInfo, this->m_TransferCommandBuffers.data()))
 		{
-			LOG_CRITICAL("Failed to begin recording command buffer!");
+			LOG_CRITICAL("Failed to create transfer command buffers");
 			exit(-1);
 		}
+	}
 
-		VkRenderPassBeginInfo renderPassInfo = {};
-		renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-		renderPassInfo.renderPass = this->m_RenderPass;
-		renderPassInfo.framebuffer = this->m_SwapChainFramebuffers[i];
-
-		renderPassInfo.renderArea.offset = { 0, 0 };
-		renderPassInfo.renderArea.extent = this->m_SwapChainExtent;
-
-		VkClearValue clearColor = { 0.015f, 0.015f, 0.02f, 1.0f };
-		renderPassInfo.clearValueCount = 1;
-		renderPassInfo.pClearValues = &clearColor;
-
-		vkCmdBeginRenderPass(this->m_CommandBuffers[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-		vkCmdBindPipeline(this->m_CommandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, this->m_GraphicsPipeline);
-		vkCmdDraw(this->m_CommandBuffers[i], 3, 1, 0, 0);
-		vkCmdEndRenderPass(this->m_CommandBuffers[i]);
+	if (this->m_ComputeCommandPool)
+	{
+		this->m_ComputeCommandBuffers.resize(FramePacer::MAX_FRAMES_IN_FLIGHT);
+		allocInfo.commandPool = this->m_ComputeCommandPool;
 
-		if (vkEndCommandBuffer(this->m_CommandBuffers[i]) != VK_SUCCESS)
+		if (vkAllocateCommandBuffers(this->m_Device, &allocInfo, this->m_ComputeCommandBuffers.data()))
 		{
-			LOG_CRITICAL("Failed to complete the the command buffer!");
+			LOG_CRITICAL("Failed to create compute command buffers");
 			exit(-1);
 		}
 	}
-}
-
-void Application::CreateSyncObjects()
-{
-
-	this->m_ImageAvailableSemaphores.resize(this->MAX_FRAMES_IN_FLIGHT);
-	this->m_RenderFinshedSemaphores.resize(this->MAX_FRAMES_IN_FLIGHT);
-	this->m_InFlightFences.resize(this->MAX_FRAMES_IN_FLIGHT);
-	this->m_ImagesInFlight.resize(this->m_SwapChainImages.size(), VK_NULL_HANDLE);
-
-	VkSemaphoreCreateInfo semaphoreCreateInfo = {};
-	semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
 
-	VkFenceCreateInfo fenceCreateInfo = {};
-	fenceCreateInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-	fenceCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+	this->m_WorkerCommandBuffers.resize(this->m_WorkerCommandPools.size());
 
-	for (int i = 0; i < this->MAX_FRAMES_IN_FLIGHT; ++i)
+	for (size_t i = 0; i < this->m_WorkerCommandPools.size(); ++i)
 	{
-		if (vkCreateSemaphore(this->m_Device, &semaphoreCreateInfo, nullptr, &this->m_ImageAvailableSemaphores[i]) != VK_SUCCESS
-		|| vkCreateSemaphore(this->m_Device, &semaphoreCreateInfo, nullptr, &this->m_RenderFinshedSemaphores[i]) != VK_SUCCESS
-		|| vkCreateFence(this->m_Device, &fenceCreateInfo, nullptr, &this->m_InFlightFences[i]) != VK_SUCCESS)
+		allocInfo.commandBufferCount = 1;
+		allocInfo.commandPool = this->m_WorkerCommandPools[i];
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+
+		if (vkAllocateCommandBuffers(this->m_Device, &allocInfo, &this->m_WorkerCommandBuffers[i]))
 		{
-			LOG_CRITICAL("Failed to create sync objects!");
+			LOG_CRITICAL("Failed to create secondary command buffers");
 			exit(-1);
 		}
 	}
+
 }
 
-bool IsEqual(int x)
+void Application::CreateSceneGeometry(const std::vector<char> &cullShaderBytes)
 {
 
-	int y = 0;
-	return x == y;
+	const std::vector<Vertex> vertices = {
+		{ { -0.5f,  0.5f }, { 1.0f, 0.0f, 0.0f } },
+		{ {  0.0f, -0.5f }, { 0.0f, 1.0f, 0.0f } },
+		{ {  0.5f,  0.5f }, { 0.0f, 0.0f, 1.0f } }
+	};
 
-}
+	const std::vector<uint16_t> indices = { 0, 1, 2 };
 
-void Application::Update()
-{
+	this->m_Mesh = this->CreateMesh(vertices, indices);
+
+	VkBufferCreateInfo bufferInfo = {};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = sizeof(InstanceData);
+	bufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
-	glfwShowWindow(this->m_Window);
-	while (!glfwWindowShouldClose(this->m_Window))
+	AllocationCreateInfo allocInfo = {};
+	allocInfo.RequiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+	VkBuffer instanceBuffer = VK_NULL_HANDLE;
+	MemoryAllocation instanceMemory;
+
+	if (this->m_Allocator.CreateBuffer(bufferInfo, allocInfo, instanceBuffer, instanceMemory) != VK_SUCCESS)
 	{
-		glfwPollEvents();
-		DrawFrame();
+		LOG_CRITICAL("Failed to create instance buffer!");
+		exit(-1);
 	}
 
-	vkDeviceWaitIdle(this->m_Device);
+	this->m_IdentityInstanceBuffer = UniqueBuffer(this->m_Allocator, instanceBuffer, instanceMemory);
 
-}
-void Application::DrawFrame()
-{
-	vkWaitForFences(this->m_Device, 1, &this->m_InFlightFences[current_frame], VK_TRUE, UINT64_MAX);
+	const InstanceData identity = { { 0.0f, 0.0f }, 1.0f, 0 };
+	this->m_StagingRing.Upload(this->m_IdentityInstanceBuffer, 0, &identity, sizeof(identity));
 
-	uint32_t imageIndex = 0;
-	vkAcquireNextImageKHR(this->m_Device, this->m_SwapChain, UINT64_MAX, this->m_ImageAvailableSemaphores[current_frame], VK_NULL_HANDLE, &imageIndex);
+	if (this->m_BindlessEnabled)
+		this->m_IdentityInstanceHandle = this->m_Bindless.AddStorageBuffer(this->m_IdentityInstanceBuffer);
 
-	if (this->m_ImagesInFlight[imageIndex] != VK_NULL_HANDLE)
-		vkWaitForFences(this->m_Device, 1, &this->m_ImagesInFlight[imageIndex], VK_TRUE, UINT64_MAX);
+	if (this->m_Config.InstanceCount > 0)
+		this->CreateInstances(cullShaderBytes);
 
-	this->m_ImagesInFlight[imageIndex] = this->m_InFlightFences[current_frame];
+	if (this->m_GpuDriven)
+		return;
 
-	VkSubmitInfo submitInfo = {};
-	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	// Placeholder scene until there is real content, every entry draws the mesh
+	this->m_DrawList.assign(std::max<uint32_t>(this->m_Config.DrawCount, 1), DrawCommand{ this->m_Mesh.IndexCount, 1, 0, 0, 0 });
 
-	VkSemaphore waitSemaphores[] = { this->m_ImageAvailableSemaphores[current_frame] };
-	VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-	submitInfo.waitSemaphoreCount = 1;
-	submitInfo.pWaitSemaphores = waitSemaphores;
-	submitInfo.pWaitDstStageMask = waitStages;
+	LOG_INFO("Recording {0} draws per frame on {1} threads",
+		this->m_DrawList.size(),
+		this->m_RecordThreads->GetThreadCount());
 
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &this->m_CommandBuffers[imageIndex];
+}
 
-	VkSemaphore signalSemaphores[] = { this->m_RenderFinshedSemaphores[current_frame] };
-	submitInfo.signalSemaphoreCount = 1;
-	submitInfo.pSignalSemaphores = signalSemaphores;
+void Application::CreateInstances(const std::vector<char> &cullShaderBytes)
+{
+
+	// Scattered a bit beyond the clip space square so part of them gets culled
+	std::mt19937 random(1337);
+	std::uniform_real_distribution<float> position(-1.25f, 1.25f);
+	std::uniform_real_distribution<float> scale(0.01f, 0.04f);
 
-	vkResetFences(this->m_Device, 1, &this->m_InFlightFences[current_frame]);
-	if (vkQueueSubmit(this->m_GraphicsQueue, 1, &submitInfo, this->m_InFlightFences[current_frame]) != VK_SUCCESS)
+	std::vector<InstanceData> instances(this->m_Config.InstanceCount);
+	for (InstanceData &instance : instances)
 	{
-		LOG_CRITICAL("Failed to submit draw buffer command!");
-		exit(-1);
+		instance.Position[0] = position(random);
+		instance.Position[1] = position(random);
+		instance.Scale = scale(random);
+		instance.MeshIndex = 0;
 	}
 
-	VkPresentInfoKHR presentInfo = {};
-	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-
-	presentInfo.waitSemaphoreCount = 1;
-	presentInfo.pWaitSemaphores = signalSemaphores;
+	std::vector<const Mesh *> meshes = { &this->m_Mesh };
+	this->m_GpuDriven = this->m_Culling.Init(this->m_Device, this->m_Allocator, this->m_StagingRing,
+		this->m_PipelineCache.GetHandle(), cullShaderBytes, meshes, instances,
+		(uint32_t) FramePacer::MAX_FRAMES_IN_FLIGHT, this->GetResourceQueueFamilies());
 
-	VkSwapchainKHR swapChains[] = { this->m_SwapChain };
-	presentInfo.swapchainCount = 1;
-	presentInfo.pSwapchains = swapChains;
-	presentInfo.pImageIndices = &imageIndex;
-	presentInfo.pResults = nullptr;
+	if (!this->m_GpuDriven)
+	{
+		LOG_WARNING("GPU culling is unavailable (is assets/shaders/cull.spv compiled?), drawing on the CPU instead");
+		return;
+	}
 
-	vkQueuePresentKHR(this->m_GraphicsQueue, &presentInfo);
+	LOG_INFO("Drawing {0} instances with GPU culling ({1}, {2})",
+		instances.size(),
+		this->m_CmdDrawIndexedIndirectCount ? "vkCmdDrawIndexedIndirectCount" : "vkCmdDrawIndexedIndirect",
+		this->m_ComputeQueue ? "async compute" : "graphics queue");
 
-	current_frame = (current_frame + 1) % this->MAX_FRAMES_IN_FLIGHT;
+}
 
+Mesh Application::CreateMesh(const std::vector<Vertex> &vertices, const std::vector<uint16_t> &indices)
+{
+	return this->CreateMesh(vertices, indices.data(), (uint32_t) indices.size(), VK_INDEX_TYPE_UINT16);
 }
-void Application::Shutdown()
+Mesh Application::CreateMesh(const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices)
+{
+	return this->CreateMesh(vertices, indices.data(), (uint32_t) indices.size(), VK_INDEX_TYPE_UINT32);
+}
+Mesh Application::CreateMesh(const std::vector<Vertex> &vertices, const void *indices, uint32_t indexCount, VkIndexType indexType)
 {
 
-	for (int i = 0; i < this->MAX_FRAMES_IN_FLIGHT; ++i)
+	Mesh mesh;
+	mesh.VertexCount = (uint32_t) vertices.size();
+	mesh.IndexCount = indexCount;
+	mesh.IndexType = indexType;
+
+	for (const Vertex &vertex : vertices)
 	{
-		vkDestroySemaphore(this->m_Device, this->m_RenderFinshedSemaphores[i], nullptr);
-		vkDestroySemaphore(this->m_Device, this->m_ImageAvailableSemaphores[i], nullptr);
-		vkDestroyFence(this->m_Device, this->m_InFlightFences[i], nullptr);
+		float radius = std::sqrt(vertex.Position[0] * vertex.Position[0] + vertex.Position[1] * vertex.Position[1]);
+		mesh.BoundingRadius = std::max(mesh.BoundingRadius, radius);
 	}
 
-	vkDestroyCommandPool(this->m_Device, this->m_CommandPool, nullptr);
-
-	for (VkFramebuffer framebuffer : this->m_SwapChainFramebuffers)
-		vkDestroyFramebuffer(this->m_Device, framebuffer, nullptr);
+	VkDeviceSize vertexSize = sizeof(Vertex) * vertices.size();
+	VkDeviceSize indexSize = (indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t)) * (VkDeviceSize) indexCount;
 
-	vkDestroyPipeline(this->m_Device, this->m_GraphicsPipeline, nullptr);
+	VkBufferCreateInfo bufferInfo = {};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
-	vkDestroyPipelineLayout(this->m_Device, this->m_PipelineLayout, nullptr);
-	vkDestroyRenderPass(this->m_Device, this->m_RenderPass, nullptr);
+	AllocationCreateInfo allocInfo = {};
+	allocInfo.RequiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
 
-	for (VkImageView view : this->m_SwapChainImageViews)
-		vkDestroyImageView(this->m_Device, view, nullptr);
+	bufferInfo.size = vertexSize;
+	bufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
 
-	vkDestroySwapchainKHR(this->m_Device, this->m_SwapChain, nullptr);
-	vkDestroySurfaceKHR(this->m_VulkanInstance, this->m_Surface, nullptr);
-	vkDestroyDevice(this->m_Device, nullptr);
+	if (this->m_Allocator.CreateBuffer(bufferInfo, allocInfo, mesh.VertexBuffer, mesh.VertexMemory) != VK_SUCCESS)
+	{
+		LOG_CRITICAL("Failed to create vertex buffer!");
+		exit(-1);
+	}
 
-	if (this->m_EnableValidationLayers)
-		this->DestroyDebugMessenger();
+	bufferInfo.size = indexSize;
+	bufferInfo.usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+	if (this->m_Allocator.CreateBuffer(bufferInfo, allocInfo, mesh.IndexBuffer, mesh.IndexMemory) != VK_SUCCESS)
+	{
+		LOG_CRITICAL("Failed to create index buffer!");
+		exit(-1);
+	}
+
+	// The copies are recorded into the next frame's command buffer, nothing waits on them here
+	this->m_StagingRing.Upload(mesh.VertexBuffer, 0, vertices.data(), vertexSize);
+	this->m_StagingRing.Upload(mesh.IndexBuffer, 0, indices, indexSize);
+
+	return mesh;
+
+}
+void Application::StartTextureStreaming()
+{
+
+	if (this->m_Config.Textures.empty())
+		return;
+
+	if (!this->m_BindlessEnabled)
+	{
+		LOG_WARNING("Streaming textures needs the bindless descriptor set, ignoring {0} textures", this->m_Config.Textures.size());
+		return;
+	}
+
+	VkDeviceSize budget = (VkDeviceSize) this->m_Config.TextureBudgetMiB * 1024 * 1024;
+	budget = std::min(budget, this->m_DeviceCaps.GetDeviceLocalMemory() / 2);
+
+	this->m_TextureStreamer.Init(this->m_Device, this->m_PhysicalDevice, this->m_Allocator, this->m_StagingRing, this->m_Bindless,
+		this->GetResourceQueueFamilies(), budget, this->TEXTURE_UPLOAD_BYTES_PER_FRAME);
+
+	// Handles never change, the streamer swaps the views behind them
+	for (const std::string &path : this->m_Config.Textures)
+	{
+		TextureStreamer::TextureId id = this->m_TextureStreamer.Request(path);
+		this->m_TextureIds.push_back(id);
+		this->m_TextureHandles.push_back(this->m_TextureStreamer.GetHandle(id));
+	}
+
+}
+
+void Application::CreateQuads(const std::vector<char> &vertexShaderBytes, const std::vector<char> &fragmentShaderBytes)
+{
+
+	if (this->m_Config.QuadCount == 0)
+		return;
+
+	if (!this->m_QuadPassEnabled)
+	{
+		LOG_WARNING("Quads need the bindless descriptor set, ignoring {0} quads", this->m_Config.QuadCount);
+		return;
+	}
+
+	bool created = this->m_QuadRenderer.Init(this->m_Device, this->m_Allocator, this->m_PipelineCache.GetHandle(), this->m_PipelineLayout,
+		this->m_RenderGraph.GetRenderPass(this->m_QuadPass), this->m_RenderGraph.GetSubpass(this->m_QuadPass),
+		vertexShaderBytes, fragmentShaderBytes, this->m_Config.QuadCount, FramePacer::MAX_FRAMES_IN_FLIGHT,
+		this->m_TextureStreamer.GetSamplerHandle());
+
+	if (!created)
+	{
+		LOG_WARNING("The quad renderer is unavailable (are assets/shaders/quad_*.spv compiled?)");
+		return;
+	}
+
+	// Scattered a bit beyond the window so part of them gets culled, every third one is translucent
+	float width = (float) this->m_WindowWidth;
+	float height = (float) this->m_WindowHeight;
+
+	std::mt19937 random(1337);
+	std::uniform_real_distribution<float> positionX(-0.1f * width, 1.1f * width);
+	std::uniform_real_distribution<float> positionY(-0.1f * height, 1.1f * height);
+	std::uniform_real_distribution<float> size(4.0f, 24.0f);
+	std::uniform_real_distribution<float> rotation(0.0f, 6.2831853f);
+	std::uniform_int_distribution<uint32_t> color(0, 0x00FFFFFF);
+
+	for (uint32_t i = 0; i < this->m_Config.QuadCount; ++i)
+	{
+		QuadDesc quad;
+		quad.Position[0] = positionX(random);
+		quad.Position[1] = positionY(random);
+		quad.Size[0] = size(random);
+		quad.Size[1] = size(random);
+		quad.Rotation = rotation(random);
+		quad.Blend = i % 3 == 0 ? QuadBlend::Alpha : QuadBlend::Opaque;
+		quad.Color = color(random) | (quad.Blend == QuadBlend::Alpha ? 0x80000000 : 0xFF000000);
+		quad.Layer = (uint16_t) (i % 2);
+
+		if (!this->m_TextureHandles.empty())
+			quad.Texture = this->m_TextureHandles[i % this->m_TextureHandles.size()];
+
+		this->m_QuadRenderer.Add(quad);
+	}
+
+	LOG_INFO("Drawing {0} quads in {1} batches", this->m_QuadRenderer.GetQuadCount(), this->m_QuadRenderer.GetBatchCount());
+
+}
+
+std::vector<uint32_t> Application::GetResourceQueueFamilies() const
+{
+
+	// Every family that touches resources shared through the staging ring
+	std::set<uint32_t> families = { this->m_QueueFamilies.GraphicsFamily.value() };
+
+	if (this->m_TransferQueue)
+		families.insert(this->m_QueueFamilies.TransferFamily.value());
+
+	if (this->m_ComputeQueue)
+		families.insert(this->m_QueueFamilies.ComputeFamily.value());
+
+	return std::vector<uint32_t>(families.begin(), families.end());
+
+}
+
+void Application::DestroyMesh(Mesh &mesh)
+{
+
+	this->m_Allocator.DestroyBuffer(mesh.VertexBuffer, mesh.VertexMemory);
+	this->m_Allocator.DestroyBuffer(mesh.IndexBuffer, mesh.IndexMemory);
+	mesh = Mesh();
+
+}
+
+void Application::RecordWorkerCommands(uint32_t threadIndex, uint32_t imageIndex)
+{
+
+	PROFILE_SCOPE("record draws");
+
+	uint32_t threadCount = this->m_RecordThreads->GetThreadCount();
+	size_t slot = current_frame * threadCount + threadIndex;
+
+	VkCommandBuffer commandBuffer = this->m_WorkerCommandBuffers[slot];
+	vkResetCommandPool(this->m_Device, this->m_WorkerCommandPools[slot], 0);
+
+	VkCommandBufferInheritanceInfo inheritanceInfo = {};
+	inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	inheritanceInfo.renderPass = this->m_RenderGraph.GetRenderPass(this->m_ScenePass);
+	inheritanceInfo.subpass = this->m_RenderGraph.GetSubpass(this->m_ScenePass);
+	inheritanceInfo.framebuffer = this->m_RenderGraph.GetFramebuffer(this->m_ScenePass, imageIndex);
+	inheritanceInfo.pipelineStatistics = this->m_GpuProfiler.GetInheritedStatistics();
+
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+	if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+	{
+		LOG_CRITICAL("Failed to begin recording secondary command buffer!");
+		exit(-1);
+	}
+
+	// Contiguous slice of the draw list, so every thread gets an even share
+	size_t drawCount = this->m_DrawList.size();
+	size_t first = drawCount * threadIndex / threadCount;
+	size_t last = drawCount * (threadIndex + 1) / threadCount;
+	uint32_t zone = GpuProfiler::INVALID_ZONE;
+
+	// The ring already warned when the frame uniforms did not fit, the shaders read them on every draw
+	if (this->m_FrameUniformOffset == UniformRing::INVALID_OFFSET)
+		last = first;
+
+	if (first != last)
+	{
+		zone = this->m_GpuProfiler.BeginZone(commandBuffer, "draws");
+
+		VkViewport viewport = {};
+		viewport.x = 0;
+		viewport.y = 0;
+		viewport.width = (float) this->m_SwapChainExtent.width;
+		viewport.height = (float) this->m_SwapChainExtent.height;
+		viewport.minDepth = 0.0f;
+		viewport.maxDepth = 1.0f;
+
+		VkRect2D scissor = {};
+		scissor.offset = {0, 0};
+		scissor.extent = this->m_SwapChainExtent;
+
+		// Dynamic state is not inherited from the primary, every secondary sets its own
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, this->m_GraphicsPipeline);
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+		if (this->m_BindlessEnabled)
+			this->m_Bindless.Bind(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, this->m_PipelineLayout, PIPELINE_SET_BINDLESS, (uint32_t) current_frame);
+
+		VkDeviceSize vertexOffset = 0;
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &this->m_Mesh.VertexBuffer, &vertexOffset);
+		vkCmdBindVertexBuffers(commandBuffer, 1, 1, this->m_IdentityInstanceBuffer.GetAddress(), &vertexOffset);
+		vkCmdBindIndexBuffer(commandBuffer, this->m_Mesh.IndexBuffer, 0, this->m_Mesh.IndexType);
+	}
+
+	for (size_t i = first; i < last; ++i)
+	{
+		const DrawCommand &draw = this->m_DrawList[i];
+
+		// Placeholder transforms, the copy and the rebind are what a real scene pays per object
+		ObjectUniforms object = {};
+		object.Transform[0] = object.Transform[5] = object.Transform[10] = object.Transform[15] = 1.0f;
+
+		uint32_t objectOffset = this->m_UniformRing.Push(object);
+		if (objectOffset == UniformRing::INVALID_OFFSET)
+			break;
+
+		this->m_UniformRing.Bind(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, this->m_PipelineLayout, PIPELINE_SET_UNIFORMS,
+			this->m_FrameUniformOffset, objectOffset);
+
+		// Placeholder materials cycle through the streamed textures, untextured without them
+		uint32_t material = this->m_TextureHandles.empty() ? BindlessDescriptors::INVALID_HANDLE : this->m_TextureHandles[i % this->m_TextureHandles.size()];
+		DrawConstants constants = { this->m_IdentityInstanceHandle, material, this->m_TextureStreamer.GetSamplerHandle() };
+		vkCmdPushConstants(commandBuffer, this->m_PipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+			0, sizeof(constants), &constants);
+
+		vkCmdDrawIndexed(commandBuffer, draw.IndexCount, draw.InstanceCount, draw.FirstIndex, draw.VertexOffset, draw.FirstInstance);
+	}
+
+	this->m_GpuProfiler.EndZone(commandBuffer, zone);
+
+	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+	{
+		LOG_CRITICAL("Failed to complete the secondary command buffer!");
+		exit(-1);
+	}
+
+}
+
+static void BeginOneTimeCommandBuffer(VkCommandBuffer commandBuffer)
+{
+
+	vkResetCommandBuffer(commandBuffer, 0);
+
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+	{
+		LOG_CRITICAL("Failed to begin recording command buffer!");
+		exit(-1);
+	}
+
+}
+
+void Application::RecordAsyncCommands()
+{
+
+	this->m_TransferRecorded = false;
+	this->m_ComputeRecorded = false;
+
+	uint32_t graphicsFamily = this->m_QueueFamilies.GraphicsFamily.value();
+
+	if (this->m_TransferQueue && this->m_StagingRing.HasPendingUploads())
+	{
+		VkCommandBuffer commandBuffer = this->m_TransferCommandBuffers[current_frame];
+		BeginOneTimeCommandBuffer(commandBuffer);
+
+		this->m_StagingRing.Flush(commandBuffer, this->m_FramePacer.GetSubmittedFrames(), this->m_QueueFamilies.TransferFamily.value(), graphicsFamily, 0);
+
+		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+		{
+			LOG_CRITICAL("Failed to record transfer command buffer!");
+			exit(-1);
+		}
+
+		this->m_TransferRecorded = true;
+	}
+
+	if (this->m_ComputeQueue && this->m_GpuDriven)
+	{
+		VkCommandBuffer commandBuffer = this->m_ComputeCommandBuffers[current_frame];
+		BeginOneTimeCommandBuffer(commandBuffer);
+
+		// Without a transfer queue the uploads come first on this queue, culling reads some of them
+		if (!this->m_TransferRecorded)
+			this->m_StagingRing.Flush(commandBuffer, this->m_FramePacer.GetSubmittedFrames(), this->m_QueueFamilies.ComputeFamily.value(), graphicsFamily,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+		this->m_Culling.RecordCulling(commandBuffer, (uint32_t) current_frame, false);
+
+		if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+		{
+			LOG_CRITICAL("Failed to record compute command buffer!");
+			exit(-1);
+		}
+
+		this->m_ComputeRecorded = true;
+	}
+
+}
+
+VkSemaphore Application::SubmitAsyncCommands()
+{
+
+	// Returns the semaphore the graphics submission has to wait on, null when nothing was submitted
+	VkSemaphore previous = VK_NULL_HANDLE;
+
+	if (this->m_TransferRecorded)
+	{
+		VkSubmitInfo submitInfo = {};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &this->m_TransferCommandBuffers[current_frame];
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = this->m_TransferSemaphores[current_frame].GetAddress();
+
+		if (vkQueueSubmit(this->m_TransferQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+		{
+			LOG_CRITICAL("Failed to submit transfer command buffer!");
+			exit(-1);
+		}
+
+		previous = this->m_TransferSemaphores[current_frame];
+	}
+
+	if (this->m_ComputeRecorded)
+	{
+		VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+		VkSubmitInfo submitInfo = {};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.waitSemaphoreCount = previous ? 1 : 0;
+		submitInfo.pWaitSemaphores = &previous;
+		submitInfo.pWaitDstStageMask = &waitStage;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &this->m_ComputeCommandBuffers[current_frame];
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = this->m_ComputeSemaphores[current_frame].GetAddress();
+
+		if (vkQueueSubmit(this->m_ComputeQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+		{
+			LOG_CRITICAL("Failed to submit compute command buffer!");
+			exit(-1);
+		}
+
+		previous = this->m_ComputeSemaphores[current_frame];
+	}
+
+	return previous;
+
+}
+
+// Runs inside the render pass the graph began, with secondary contents unless GPU driven
+void Application::RecordScenePass(VkCommandBuffer commandBuffer, uint32_t imageIndex)
+{
+
+	if (this->m_GpuDriven)
+	{
+		GpuProfiler::GpuZone zone(this->m_GpuProfiler, commandBuffer, "indirect draws");
+
+		// The GPU decides what gets drawn, so a handful of commands inline is all there is to record
+		VkViewport viewport = {};
+		viewport.x = 0;
+		viewport.y = 0;
+		viewport.width = (float) this->m_SwapChainExtent.width;
+		viewport.height = (float) this->m_SwapChainExtent.height;
+		viewport.minDepth = 0.0f;
+		viewport.maxDepth = 1.0f;
+
+		VkRect2D scissor = {};
+		scissor.offset = {0, 0};
+		scissor.extent = this->m_SwapChainExtent;
+
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, this->m_GraphicsPipeline);
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+		// Instances come from the culled vertex buffer, they all share the first material and object
+		if (this->m_BindlessEnabled)
+			this->m_Bindless.Bind(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, this->m_PipelineLayout, PIPELINE_SET_BINDLESS, (uint32_t) current_frame);
+
+		ObjectUniforms object = {};
+		object.Transform[0] = object.Transform[5] = object.Transform[10] = object.Transform[15] = 1.0f;
+
+		// The vertex shader reads both blocks, without room for them there is nothing valid to draw
+		uint32_t objectOffset = this->m_UniformRing.Push(object);
+		if (this->m_FrameUniformOffset != UniformRing::INVALID_OFFSET && objectOffset != UniformRing::INVALID_OFFSET)
+		{
+			this->m_UniformRing.Bind(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, this->m_PipelineLayout, PIPELINE_SET_UNIFORMS,
+				this->m_FrameUniformOffset, objectOffset);
+
+			uint32_t material = this->m_TextureHandles.empty() ? BindlessDescriptors::INVALID_HANDLE : this->m_TextureHandles[0];
+			DrawConstants constants = { BindlessDescriptors::INVALID_HANDLE, material, this->m_TextureStreamer.GetSamplerHandle() };
+			vkCmdPushConstants(commandBuffer, this->m_PipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+				0, sizeof(constants), &constants);
+
+			this->m_Culling.RecordDraws(commandBuffer, (uint32_t) current_frame, this->m_CmdDrawIndexedIndirectCount);
+		}
+	}
+	else
+	{
+		uint32_t threadCount = this->m_RecordThreads->GetThreadCount();
+		const VkCommandBuffer *secondaries = &this->m_WorkerCommandBuffers[current_frame * threadCount];
+
+		vkCmdExecuteCommands(commandBuffer, threadCount, secondaries);
+	}
+
+}
+
+// Inline in the subpass after the scene, one instanced draw per batch of quads
+void Application::RecordQuadPass(VkCommandBuffer commandBuffer, uint32_t imageIndex)
+{
+
+	if (!this->m_QuadRenderer.IsEnabled())
+		return;
+
+	GpuProfiler::GpuZone zone(this->m_GpuProfiler, commandBuffer, "quads");
+
+	VkViewport viewport = {};
+	viewport.x = 0;
+	viewport.y = 0;
+	viewport.width = (float) this->m_SwapChainExtent.width;
+	viewport.height = (float) this->m_SwapChainExtent.height;
+	viewport.minDepth = 0.0f;
+	viewport.maxDepth = 1.0f;
+
+	VkRect2D scissor = {};
+	scissor.offset = {0, 0};
+	scissor.extent = this->m_SwapChainExtent;
+
+	vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+	vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+	this->m_Bindless.Bind(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, this->m_PipelineLayout, PIPELINE_SET_BINDLESS, (uint32_t) current_frame);
+	this->m_QuadRenderer.Record(commandBuffer);
+
+}
+
+void Application::RecordCommandBuffer(uint32_t imageIndex)
+{
+
+	PROFILE_SCOPE("record");
+
+	if (!this->m_GpuDriven)
+	{
+		this->m_RecordThreads->Execute([this, imageIndex](uint32_t threadIndex)
+		{
+			this->RecordWorkerCommands(threadIndex, imageIndex);
+		});
+	}
+
+	VkCommandBuffer commandBuffer = this->m_CommandBuffers[current_frame];
+	BeginOneTimeCommandBuffer(commandBuffer);
+
+	// Resets the queries the secondaries write as well, they execute after this
+	this->m_GpuProfiler.ResetQueries(commandBuffer);
+	uint32_t frameZone = this->m_GpuProfiler.BeginZone(commandBuffer, "frame");
+
+	// Uploads recorded on another queue family hand exclusive buffers over here
+	uint32_t graphicsFamily = this->m_QueueFamilies.GraphicsFamily.value();
+	this->m_StagingRing.AcquireOwnership(commandBuffer);
+
+	if (!this->m_TransferRecorded && !this->m_ComputeRecorded)
+	{
+		GpuProfiler::GpuZone zone(this->m_GpuProfiler, commandBuffer, "uploads");
+		this->m_StagingRing.Flush(commandBuffer, this->m_FramePacer.GetSubmittedFrames(), graphicsFamily, graphicsFamily,
+			VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+	}
+
+	bool statistics = this->m_GpuProfiler.BeginStatistics(commandBuffer, !this->m_GpuDriven);
+
+	if (this->m_GpuDriven && !this->m_ComputeRecorded)
+	{
+		GpuProfiler::GpuZone zone(this->m_GpuProfiler, commandBuffer, "culling");
+		this->m_Culling.RecordCulling(commandBuffer, (uint32_t) current_frame, true);
+	}
+
+	this->m_RenderGraph.Execute(commandBuffer, imageIndex, &this->m_GpuProfiler);
+
+	if (statistics)
+		this->m_GpuProfiler.EndStatistics(commandBuffer);
+
+	this->m_GpuProfiler.EndZone(commandBuffer, frameZone);
+
+	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+	{
+		LOG_CRITICAL("Failed to complete the the command buffer!");
+		exit(-1);
+	}
+
+}
+
+void Application::CreateSyncObjects()
+{
+
+	// Frame completion is tracked by the frame pacer's timeline semaphore, these only order the queues
+	this->m_ImageAvailableSemaphores.resize(FramePacer::MAX_FRAMES_IN_FLIGHT);
+	this->m_RenderFinshedSemaphores.resize(FramePacer::MAX_FRAMES_IN_FLIGHT);
+	this->m_TransferSemaphores.resize(FramePacer::MAX_FRAMES_IN_FLIGHT);
+	this->m_ComputeSemaphores.resize(FramePacer::MAX_FRAMES_IN_FLIGHT);
+
+	VkSemaphoreCreateInfo semaphoreCreateInfo = {};
+	semaphoreCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+	for (uint32_t i = 0; i < FramePacer::MAX_FRAMES_IN_FLIGHT; ++i)
+	{
+		if (vkCreateSemaphore(this->m_Device, &semaphoreCreateInfo, nullptr, this->m_ImageAvailableSemaphores[i].Replace(this->m_Device)) != VK_SUCCESS
+		|| vkCreateSemaphore(this->m_Device, &semaphoreCreateInfo, nullptr, this->m_RenderFinshedSemaphores[i].Replace(this->m_Device)) != VK_SUCCESS
+		|| vkCreateSemaphore(this->m_Device, &semaphoreCreateInfo, nullptr, this->m_TransferSemaphores[i].Replace(this->m_Device)) != VK_SUCCESS
+		|| vkCreateSemaphore(this->m_Device, &semaphoreCreateInfo, nullptr, this->m_ComputeSemaphores[i].Replace(this->m_Device)) != VK_SUCCESS)
+		{
+			LOG_CRITICAL("Failed to create sync objects!");
+			exit(-1);
+		}
+	}
+}
+
+bool IsEqual(int x)
+{
+
+	int y = 0;
+	return x == y;
+
+}
+
+void Application::Update()
+{
+
+	std::unique_ptr<FrameBenchmark> benchmark;
+	if (this->m_Config.BenchmarkFrames > 0)
+	{
+		LOG_INFO("Running benchmark: {0} warm-up frames, {1} measured frames",
+			this->m_Config.BenchmarkWarmupFrames,
+			this->m_Config.BenchmarkFrames);
+
+		benchmark = std::make_unique<FrameBenchmark>(this->m_Config.BenchmarkWarmupFrames, this->m_Config.BenchmarkFrames);
+	}
+
+	if (!this->m_Config.Headless)
+		glfwShowWindow(this->m_Window);
+
+	util::Timer timer;
+	util::Timer memoryReportTimer;
+	uint32_t frameCount = 0;
+
+	double latencyTotal = 0.0;
+	size_t latencyCount = 0;
+
+	while (true)
+	{
+		if (this->m_Config.Headless)
+		{
+			if (!benchmark && frameCount >= this->m_Config.HeadlessFrameCount)
+				break;
+		}
+		else if (glfwWindowShouldClose(this->m_Window))
+			break;
+
+		// Events are polled inside DrawFrame, right before recording
+		PROFILE_FRAME();
+		bool submitted = DrawFrame();
+		if (submitted)
+			++frameCount;
+
+		if (submitted && frameCount == 1)
+		{
+			this->m_FirstFrameMillis = this->m_StartupTimer.ElapsedMillis();
+			LOG_INFO("First frame submitted {0:.3f}ms after startup", this->m_FirstFrameMillis);
+		}
+
+		for (double latency : this->m_LatencySamples)
+		{
+			latencyTotal += latency;
+
+			if (benchmark)
+				benchmark->AddLatency(latency);
+		}
+
+		latencyCount += this->m_LatencySamples.size();
+		this->m_LatencySamples.clear();
+
+		if (this->m_Config.MemoryReportSeconds > 0.0 && memoryReportTimer.ElapsedSeconds() >= this->m_Config.MemoryReportSeconds)
+		{
+			this->m_Allocator.LogBudget();
+			this->m_Allocator.LogStatistics();
+			memoryReportTimer.Reset();
+		}
+
+		if (benchmark && submitted)
+		{
+			benchmark->AddFrame(this->m_LastFrameTimings);
+			if (benchmark->IsFinished())
+				break;
+		}
+	}
+
+	vkDeviceWaitIdle(this->m_Device);
+
+	if (this->m_Config.Headless)
+	{
+		double seconds = timer.ElapsedSeconds();
+		LOG_INFO("Rendered {0} headless frames in {1:.3f}s ({2:.1f} FPS)",
+			frameCount, seconds, frameCount / seconds);
+	}
+
+	if (latencyCount)
+	{
+		LOG_INFO("Input to present latency: {0:.3f}ms on average over {1} frames ({2})",
+			latencyTotal / latencyCount, latencyCount,
+			LatencyTracker::MeasurementToString(this->m_LatencyTracker.GetMeasurement()));
+	}
+
+	if (benchmark)
+	{
+		if (!benchmark->IsFinished())
+			LOG_WARNING("Benchmark was interrupted, the report only covers the frames rendered so far!");
+
+		benchmark->LogSummary();
+		benchmark->WriteReport(this->m_Config.BenchmarkOutput, this->GetBenchmarkInfo());
+	}
+
+	if (this->m_GpuProfiler.IsEnabled())
+	{
+		this->m_GpuProfiler.Flush();
+		this->m_GpuProfiler.LogSummary();
+		this->m_GpuProfiler.WriteTrace(this->m_Config.GpuProfileOutput);
+	}
+
+	if (this->m_Config.ProfileOnExit && util::Profiler::IsEnabled())
+		util::Profiler::Dump(this->m_Config.ProfileOutput);
+
+}
+bool Application::DrawFrame()
+{
+	FrameTimings &timings = this->m_LastFrameTimings;
+	timings = FrameTimings();
+
+	util::Timer frameTimer;
+	util::Timer phaseTimer;
+	PROFILE_SCOPE("frame");
+
+	{
+		PROFILE_SCOPE("wait for frame");
+		current_frame = this->m_FramePacer.BeginFrame();
+	}
+
+	timings.FenceWait = phaseTimer.ElapsedMillis();
+
+	// The slot's previous frame completed, its queries are read without waiting
+	this->m_GpuProfiler.BeginFrame((uint32_t) current_frame, this->m_FramePacer.GetSubmittedFrames());
+
+	{
+		PROFILE_SCOPE("update resources");
+		this->m_DeletionQueue.Release(this->m_FramePacer.GetCompletedFrames());
+		this->m_StagingRing.Release(this->m_FramePacer.GetCompletedFrames());
+		this->ApplyReloadedPipelines();
+
+		// Before the streamer, which keeps its textures within the budget's headroom
+		this->m_Allocator.UpdateBudget();
+
+		if (!this->m_TextureIds.empty())
+		{
+			for (TextureStreamer::TextureId id : this->m_TextureIds)
+				this->m_TextureStreamer.MarkUsed(id, this->m_FramePacer.GetSubmittedFrames());
+
+			this->m_TextureStreamer.Update(this->m_FramePacer.GetSubmittedFrames(), this->m_FramePacer.GetCompletedFrames());
+		}
+
+		// After the streamer, so views it swapped in are written for this frame
+		if (this->m_BindlessEnabled)
+			this->m_Bindless.BeginFrame((uint32_t) current_frame, this->m_FramePacer.GetCompletedFrames());
+
+		// The slot's last frame completed, so its uniform partition is free again
+		this->m_UniformRing.BeginFrame((uint32_t) current_frame);
+
+		// The quads' region of this slot is free for the same reason
+		if (this->m_QuadRenderer.IsEnabled())
+		{
+			PROFILE_SCOPE("prepare quads");
+			this->m_QuadRenderer.Prepare((uint32_t) current_frame, this->m_SwapChainExtent);
+		}
+
+		double frameSeconds = this->m_StartupTimer.ElapsedSeconds();
+
+		FrameUniforms frameUniforms = {};
+		frameUniforms.Time = (float) frameSeconds;
+		frameUniforms.DeltaTime = (float) (frameSeconds - this->m_LastFrameSeconds);
+		frameUniforms.Extent[0] = (float) this->m_SwapChainExtent.width;
+		frameUniforms.Extent[1] = (float) this->m_SwapChainExtent.height;
+
+		this->m_FrameUniformOffset = this->m_UniformRing.Push(frameUniforms);
+		this->m_LastFrameSeconds = frameSeconds;
+	}
+
+	if (!this->m_Config.Headless)
+		this->m_LatencyTracker.Collect(this->m_LatencySamples);
+
+	phaseTimer.Reset();
+	uint32_t imageIndex = 0;
+	if (this->m_Config.Headless)
+	{
+		imageIndex = this->m_OffscreenImageIndex;
+		this->m_OffscreenImageIndex = (this->m_OffscreenImageIndex + 1) % (uint32_t) this->m_SwapChainImages.size();
+	}
+	else
+	{
+		PROFILE_SCOPE("acquire");
+		VkResult result = vkAcquireNextImageKHR(this->m_Device, this->m_SwapChain, UINT64_MAX, this->m_ImageAvailableSemaphores[current_frame], VK_NULL_HANDLE, &imageIndex);
+
+		// Suboptimal images are still rendered and presented, the swap chain
+		// is recreated after presenting. Out of date ones skip the frame.
+		if (result == VK_ERROR_OUT_OF_DATE_KHR)
+		{
+			this->RecreateSwapChain();
+			timings.Acquire = phaseTimer.ElapsedMillis();
+			timings.Total = frameTimer.ElapsedMillis();
+			return false;
+		}
+
+		if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
+		{
+			LOG_CRITICAL("Failed to acquire swap chain image!");
+			exit(-1);
+		}
+	}
+
+	// No per-image wait: an acquired image was presented before, and that present
+	// waited on the frame that rendered it. Headless images are reused round robin.
+	timings.Acquire = phaseTimer.ElapsedMillis();
+
+	if (!this->m_Config.Headless)
+	{
+		// Any time spent blocked above is time the input could have been sampled later
+		PROFILE_SCOPE("input");
+		phaseTimer.Reset();
+		if (this->m_Config.LatencyPacing)
+		{
+			this->m_LatencyTracker.UpdateInputDelay(timings.FenceWait + timings.Acquire, this->m_Config.LatencyPacingMarginMillis);
+			std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(this->m_LatencyTracker.GetInputDelayMillis()));
+		}
+
+		glfwPollEvents();
+		this->m_LatencyTracker.MarkInputSampled();
+		timings.InputDelay = phaseTimer.ElapsedMillis();
+	}
+
+	phaseTimer.Reset();
+	{
+		PROFILE_SCOPE("record async");
+		this->RecordAsyncCommands();
+	}
+
+	this->RecordCommandBuffer(imageIndex);
+	timings.Record = phaseTimer.ElapsedMillis();
+
+	phaseTimer.Reset();
+	VkSemaphore asyncSemaphore = this->SubmitAsyncCommands();
+
+	VkSubmitInfo submitInfo = {};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+
+	VkSemaphore waitSemaphores[2] = {};
+	VkPipelineStageFlags waitStages[2] = {};
+	uint32_t waitCount = 0;
+
+	if (!this->m_Config.Headless)
+	{
+		waitSemaphores[waitCount] = this->m_ImageAvailableSemaphores[current_frame];
+		waitStages[waitCount++] = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	}
+
+	if (asyncSemaphore)
+	{
+		waitSemaphores[waitCount] = asyncSemaphore;
+		waitStages[waitCount++] = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT
+			| VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+	}
+
+	submitInfo.waitSemaphoreCount = waitCount;
+	submitInfo.pWaitSemaphores = waitSemaphores;
+	submitInfo.pWaitDstStageMask = waitStages;
+
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &this->m_CommandBuffers[current_frame];
+
+	// The timeline value comes first so headless runs can simply drop the binary semaphore
+	VkSemaphore signalSemaphores[] = { this->m_FramePacer.GetSemaphore(), this->m_RenderFinshedSemaphores[current_frame] };
+	submitInfo.signalSemaphoreCount = this->m_Config.Headless ? 1 : 2;
+	submitInfo.pSignalSemaphores = signalSemaphores;
+
+	// Binary semaphores ignore their values
+	uint64_t waitValues[2] = { 0, 0 };
+	uint64_t signalValues[2] = { this->m_FramePacer.GetSignalValue(), 0 };
+
+	VkTimelineSemaphoreSubmitInfoKHR timelineInfo = {};
+	timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO_KHR;
+	timelineInfo.waitSemaphoreValueCount = waitCount;
+	timelineInfo.pWaitSemaphoreValues = waitValues;
+	timelineInfo.signalSemaphoreValueCount = submitInfo.signalSemaphoreCount;
+	timelineInfo.pSignalSemaphoreValues = signalValues;
+	submitInfo.pNext = &timelineInfo;
+
+	{
+		PROFILE_SCOPE("submit");
+		if (vkQueueSubmit(this->m_GraphicsQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+		{
+			LOG_CRITICAL("Failed to submit draw buffer command!");
+			exit(-1);
+		}
+	}
+
+	timings.Submit = phaseTimer.ElapsedMillis();
+	this->m_FramePacer.EndFrame();
+	this->m_GpuProfiler.EndFrame();
+
+	if (this->m_Config.Headless)
+	{
+		timings.Total = frameTimer.ElapsedMillis();
+		return true;
+	}
+
+	VkPresentInfoKHR presentInfo = {};
+	presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+
+	presentInfo.waitSemaphoreCount = 1;
+	presentInfo.pWaitSemaphores = this->m_RenderFinshedSemaphores[current_frame].GetAddress();
+
+	VkSwapchainKHR swapChains[] = { this->m_SwapChain };
+	presentInfo.swapchainCount = 1;
+	presentInfo.pSwapchains = swapChains;
+	presentInfo.pImageIndices = &imageIndex;
+	presentInfo.pResults = nullptr;
+	this->m_LatencyTracker.ChainPresentInfo(presentInfo);
+
+	phaseTimer.Reset();
+	VkResult result = VK_SUCCESS;
+	{
+		PROFILE_SCOPE("present");
+		result = vkQueuePresentKHR(this->m_PresentQueue, &presentInfo);
+	}
+
+	this->m_LatencyTracker.MarkPresented();
+
+	if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || this->m_FramebufferResized)
+	{
+		this->m_FramebufferResized = false;
+		this->RecreateSwapChain();
+	}
+	else if (result != VK_SUCCESS)
+	{
+		LOG_CRITICAL("Failed to present swap chain image!");
+		exit(-1);
+	}
+
+	timings.Present = phaseTimer.ElapsedMillis();
+	timings.Total = frameTimer.ElapsedMillis();
+	return true;
+
+}
+bool Application::RunComputeBenchmark()
+{
+
+	// A dedicated compute family is what async compute would run on, the graphics queue works as well
+	VkQueue queue = this->m_GraphicsQueue;
+	uint32_t queueFamily = this->m_QueueFamilies.GraphicsFamily.value();
+
+	if (this->m_ComputeQueue)
+	{
+		queue = this->m_ComputeQueue;
+		queueFamily = this->m_QueueFamilies.ComputeFamily.value();
+	}
+
+	ComputeBenchmark benchmark;
+	if (!benchmark.Init(this->m_Device, this->m_DeviceCaps, this->m_Allocator, this->m_PipelineCache.GetHandle(), queue, queueFamily))
+	{
+		LOG_ERROR("Compute benchmark unavailable (are the kernels in assets/shaders compiled?)");
+		return false;
+	}
+
+	bool verified = benchmark.Run(this->m_Config.ComputeElements, this->m_Config.ComputeIterations);
+	benchmark.LogSummary();
+	benchmark.WriteReport(this->m_Config.ComputeBenchmarkOutput, this->m_DeviceCaps.Properties.deviceName);
+	benchmark.Shutdown();
+
+	return verified;
+
+}
+
+BenchmarkInfo Application::GetBenchmarkInfo()
+{
+
+	BenchmarkInfo info;
+	info.DeviceName = this->m_DeviceCaps.Properties.deviceName;
+	info.PresentMode = this->m_Config.Headless ? "NONE" : PresentModeToString(this->m_PresentMode);
+	info.FramesInFlight = this->m_FramePacer.GetFramesInFlight();
+	info.ImageCount = (uint32_t) this->m_SwapChainImages.size();
+	info.Width = this->m_SwapChainExtent.width;
+	info.Height = this->m_SwapChainExtent.height;
+	info.Headless = this->m_Config.Headless;
+	info.RecordThreads = this->m_RecordThreads->GetThreadCount();
+	info.DrawCount = (uint32_t) this->m_DrawList.size();
+	info.GpuInstances = this->m_GpuDriven ? this->m_Culling.GetInstanceCount() : 0;
+	info.LatencyMeasurement = this->m_Config.Headless ? "NONE" : LatencyTracker::MeasurementToString(this->m_LatencyTracker.GetMeasurement());
+	info.LatencyPacing = this->m_Config.LatencyPacing && !this->m_Config.Headless;
+	info.PipelineCacheWarm = this->m_PipelineCache.IsWarm();
+	info.PipelineCreationMillis = this->m_PipelineCreationMillis;
+	info.StartupMillis = this->m_StartupMillis;
+	info.FirstFrameMillis = this->m_FirstFrameMillis;
+
+	return info;
+
+}
+
+void Application::Shutdown()
+{
+
+	PROFILE_FUNCTION();
+
+	// The watcher thread builds pipelines, it has to be gone before anything is destroyed
+	this->m_ShaderWatcher.Stop();
+
+	// The handles destroy themselves, but have to go before the device does
+	this->m_ReloadedGraphicsPipeline.Reset();
+	this->m_ReloadedCullingPipeline.Reset();
+
+	this->m_RenderFinshedSemaphores.clear();
+	this->m_ImageAvailableSemaphores.clear();
+	this->m_TransferSemaphores.clear();
+	this->m_ComputeSemaphores.clear();
+
+	this->m_FramePacer.Shutdown();
+	this->m_DeletionQueue.Flush();
+	this->m_GpuProfiler.Shutdown();
+
+	this->m_CommandPool.Reset();
+	this->m_TransferCommandPool.Reset();
+	this->m_ComputeCommandPool.Reset();
+	this->m_WorkerCommandPools.clear();
+
+	this->m_GraphicsPipeline.Reset();
+	this->m_PipelineLayout.Reset();
+
+	if (!this->m_TextureIds.empty())
+		this->m_TextureStreamer.LogStatistics();
+
+	this->m_Allocator.LogBudget();
+
+	this->m_TextureStreamer.Shutdown();
+	this->m_Bindless.Shutdown();
+	this->m_UniformRing.Shutdown();
+	this->m_RenderGraph.Shutdown();
+	this->m_SwapChainImageViews.clear();
+
+	if (this->m_Config.Headless)
+		this->DestroyOffscreenTargets();
+	else
+	{
+		this->m_SwapChain.Reset();
+		vkDestroySurfaceKHR(this->m_VulkanInstance, this->m_Surface, nullptr);
+	}
+
+	this->m_QuadRenderer.Shutdown();
+	this->m_Culling.Shutdown();
+	this->m_IdentityInstanceBuffer.Reset();
+	this->DestroyMesh(this->m_Mesh);
+	this->m_StagingRing.Shutdown();
+	this->m_PipelineCache.Shutdown();
+
+	this->m_Allocator.LogStatistics();
+	this->m_Allocator.Shutdown();
+
+	vkDestroyDevice(this->m_Device, nullptr);
+
+	if (this->m_EnableValidationLayers)
+		this->DestroyDebugMessenger();
 
 	vkDestroyInstance(this->m_VulkanInstance, nullptr);
 
-	glfwDestroyWindow(this->m_Window);
-	glfwTerminate();
+	if (!this->m_Config.Headless)
+	{
+		glfwDestroyWindow(this->m_Window);
+		glfwTerminate();
+	}
 
 }
 
-int main(void)
+// A bad number is reported like an unknown argument and leaves the default in place
+template<typename T>
+static void ParseNumber(const std::string &arg, const char *value, T &result, std::vector<std::string> &warnings)
 {
 
-	util::Log::Init();
-	LOG_INFO("Vulkan Testing");
+	const char *end = value + std::strlen(value);
+	T parsed = {};
+
+	auto [last, error] = std::from_chars(value, end, parsed);
+	if (error != std::errc() || last != end || last == value)
+	{
+		warnings.push_back("Bad value for " + arg + ": " + value);
+		return;
+	}
+
+	result = parsed;
+
+}
+
+// Logging is configured from the command line, so anything worth warning about
+// is collected here and reported once the loggers exist.
+static ApplicationConfig ParseCommandLine(int argc, char **argv, util::LogConfig &logConfig, util::ProfilerConfig &profilerConfig,
+	std::vector<std::string> &warnings)
+{
+
+	ApplicationConfig config;
 
 #ifdef APP_RELEASE
-	Application app(false);
-#else
-	Application app;
+	config.EnableValidationLayers = false;
+	config.ShaderHotReload = false;
 #endif
 
-	app.Run();
-	return 0;
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+
+		if (arg == "--headless")
+			config.Headless = true;
+		else if (arg == "--frames" && i + 1 < argc)
+			ParseNumber(arg, argv[++i], config.HeadlessFrameCount, warnings);
+		else if (arg == "--benchmark" && i + 1 < argc)
+			ParseNumber(arg, argv[++i], config.BenchmarkFrames, warnings);
+		else if (arg == "--warmup" && i + 1 < argc)
+			ParseNumber(arg, argv[++i], config.BenchmarkWarmupFrames, warnings);
+		else if (arg == "--benchmark-output" && i + 1 < argc)
+			config.BenchmarkOutput = argv[++i];
+		else if (arg == "--compute-benchmark")
+			config.ComputeBenchmark = true;
+		else if (arg == "--compute-elements" && i + 1 < argc)
+			ParseNumber(arg, argv[++i], config.ComputeElements, warnings);
+		else if (arg == "--compute-iterations" && i + 1 < argc)
+			ParseNumber(arg, argv[++i], config.ComputeIterations, warnings);
+		else if (arg == "--compute-benchmark-output" && i + 1 < argc)
+			config.ComputeBenchmarkOutput = argv[++i];
+		else if (arg == "--gpu-profile" && i + 1 < argc)
+			config.GpuProfileOutput = argv[++i];
+		else if (arg == "--gpu-profile-frames" && i + 1 < argc)
+			ParseNumber(arg, argv[++i], config.GpuProfileFrames, warnings);
+		else if (arg == "--profile" && i + 1 < argc)
+		{
+			config.ProfileOutput = argv[++i];
+			config.ProfileOnExit = true;
+		}
+		else if (arg == "--profile-frames" && i + 1 < argc)
+			ParseNumber(arg, argv[++i], profilerConfig.HistoryFrames, warnings);
+		else if (arg == "--no-profile")
+			profilerConfig.Enabled = false;
+		else if (arg == "--memory-report" && i + 1 < argc)
+			ParseNumber(arg, argv[++i], config.MemoryReportSeconds, warnings);
+		else if (arg == "--threads" && i + 1 < argc)
+			ParseNumber(arg, argv[++i], config.RecordThreadCount, warnings);
+		else if (arg == "--draws" && i + 1 < argc)
+			ParseNumber(arg, argv[++i], config.DrawCount, warnings);
+		else if (arg == "--instances" && i + 1 < argc)
+			ParseNumber(arg, argv[++i], config.InstanceCount, warnings);
+		else if (arg == "--quads" && i + 1 < argc)
+			ParseNumber(arg, argv[++i], config.QuadCount, warnings);
+		else if (arg == "--pipeline-cache" && i + 1 < argc)
+			config.PipelineCachePath = argv[++i];
+		else if (arg == "--no-pipeline-cache")
+			config.PipelineCachePath.clear();
+		else if (arg == "--hot-reload")
+			config.ShaderHotReload = true;
+		else if (arg == "--no-hot-reload")
+			config.ShaderHotReload = false;
+		else if (arg == "--frames-in-flight" && i + 1 < argc)
+			ParseNumber(arg, argv[++i], config.FramesInFlight, warnings);
+		else if (arg == "--no-async-queues")
+			config.AsyncQueues = false;
+		else if (arg == "--no-bindless")
+			config.Bindless = false;
+		else if (arg == "--texture" && i + 1 < argc)
+			config.Textures.push_back(argv[++i]);
+		else if (arg == "--texture-budget" && i + 1 < argc)
+			ParseNumber(arg, argv[++i], config.TextureBudgetMiB, warnings);
+		else if (arg == "--device" && i + 1 < argc)
+			config.Device = argv[++i];
+		else if (arg == "--present-mode" && i + 1 < argc)
+		{
+			std::string mode = argv[++i];
+
+			if (mode == "fifo")
+				config.PresentMode = VK_PRESENT_MODE_FIFO_KHR;
+			else if (mode == "fifo-relaxed")
+				config.PresentMode = VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+			else if (mode == "mailbox")
+				config.PresentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+			else if (mode == "immediate")
+				config.PresentMode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+			else
+				warnings.push_back("Unknown present mode: " + mode);
+		}
+		else if (arg == "--swapchain-images" && i + 1 < argc)
+			ParseNumber(arg, argv[++i], config.SwapChainImageCount, warnings);
+		else if (arg == "--latency-pacing")
+			config.LatencyPacing = true;
+		else if (arg == "--latency-margin" && i + 1 < argc)
+			ParseNumber(arg, argv[++i], config.LatencyPacingMarginMillis, warnings);
+		else if (arg == "--log-sync")
+			logConfig.Async = false;
+		else if (arg == "--log-queue" && i + 1 < argc)
+			ParseNumber(arg, argv[++i], logConfig.QueueSize, warnings);
+		else if (arg == "--log-overflow" && i + 1 < argc)
+		{
+			std::string policy = argv[++i];
+
+			if (policy == "drop")
+				logConfig.Overflow = util::LogOverflowPolicy::Drop;
+			else if (policy == "block")
+				logConfig.Overflow = util::LogOverflowPolicy::Block;
+			else
+				warnings.push_back("Unknown log overflow policy: " + policy);
+		}
+		else if (arg == "--log-level" && i + 1 < argc)
+		{
+			std::string level = argv[++i];
+			logConfig.Level = spdlog::level::from_str(level);
+
+			if (logConfig.Level == spdlog::level::off && level != "off")
+				warnings.push_back("Unknown log level: " + level);
+		}
+		else if (arg == "--log-file" && i + 1 < argc)
+			logConfig.FilePath = argv[++i];
+		else
+			warnings.push_back("Unknown command line argument: " + arg);
+	}
+
+	return config;
+
+}
+
+int main(int argc, char **argv)
+{
+
+	util::LogConfig logConfig;
+	util::ProfilerConfig profilerConfig;
+	std::vector<std::string> warnings;
+	ApplicationConfig config = ParseCommandLine(argc, argv, logConfig, profilerConfig, warnings);
+
+	util::Log::Init(logConfig);
+	util::Profiler::Init(profilerConfig);
+	util::Profiler::SetThreadName("main");
+	LOG_INFO("Vulkan Testing");
+
+	for (const std::string &warning : warnings)
+		LOG_WARNING(warning);
+
+	// Disabled with --no-profile, or compiled out with premake's --no-profile
+	if (config.ProfileOnExit && !util::Profiler::IsEnabled())
+		LOG_WARNING("The CPU profiler is disabled, no trace will be written to {0}", config.ProfileOutput);
+
+	Application app(config);
+	bool succeeded = app.Run();
+
+	if (uint64_t dropped = util::Log::GetDroppedMessageCount())
+		LOG_WARNING("{0} log messages were dropped because the log queue was full", dropped);
+
+	util::Profiler::Shutdown();
+	util::Log::Flush();
+	return succeeded ? 0 : 1;
 
 }
\ No newline at end of file
@@ -1,7 +1,9 @@
 #pragma once
 
-#define NOMINMAX
-#include <Windows.h>
+#ifdef APP_PLATFORM_WINDOWS
+	#define NOMINMAX
+	#include <Windows.h>
+#endif
 #include <GLFW/glfw3.h>
 
 #include <memory>
@@ -11,20 +13,158 @@
 #include <set>
 #include <algorithm>
 
+#include <string>
+#include <chrono>
+
 #include <cstring>
 #include <cstdint>
+#include <cstdlib>
 #include <fstream>
+#include <random>
+#include <cmath>
+#include <mutex>
+
+#include "Benchmark.h"
+#include "ComputeBenchmark.h"
+#include "MemoryAllocator.h"
+#include "PipelineCache.h"
+#include "ThreadPool.h"
+#include "StagingRing.h"
+#include "Mesh.h"
+#include "GpuCulling.h"
+#include "QuadRenderer.h"
+#include "BindlessDescriptors.h"
+#include "UniformRing.h"
+#include "TextureStreamer.h"
+#include "VulkanHandle.h"
+#include "DeletionQueue.h"
+#include "RenderGraph.h"
+#include "ShaderWatcher.h"
+#include "FramePacer.h"
+#include "LatencyTracker.h"
+#include "GpuProfiler.h"
+#include "TaskGraph.h"
+#include "DeviceCapabilities.h"
+#include "Timer.h"
+
+struct ApplicationConfig
+{
+	bool EnableValidationLayers = true;
+
+	// Render into device-owned images instead of a swap chain and never
+	// touch GLFW, so the renderer can run on machines without a display.
+	bool Headless = false;
+	uint32_t HeadlessFrameCount = 1000;
+
+	// Frame-loop benchmark, enabled when BenchmarkFrames is non-zero.
+	// The report is written as JSON or CSV depending on the file extension.
+	uint32_t BenchmarkWarmupFrames = 100;
+	uint32_t BenchmarkFrames = 0;
+	std::string BenchmarkOutput = "benchmark.json";
+
+	// Runs the compute kernels after startup instead of rendering. Every kernel goes
+	// over ComputeElements elements ComputeIterations times.
+	bool ComputeBenchmark = false;
+	uint32_t ComputeElements = 1 << 22;
+	uint32_t ComputeIterations = 20;
+	std::string ComputeBenchmarkOutput = "compute_benchmark.json";
+
+	// Chrome trace of the CPU and GPU zones of the last GpuProfileFrames frames, written on
+	// exit. An empty path disables the GPU profiler.
+	std::string GpuProfileOutput;
+	uint32_t GpuProfileFrames = 300;
+
+	// Chrome trace of the CPU zones kept by util::Profiler, written when F12 is pressed
+	// and on exit when ProfileOnExit is set.
+	std::string ProfileOutput = "profile.json";
+	bool ProfileOnExit = false;
+
+	// Device memory usage against the budget, by category, is logged this often. 0 disables it.
+	double MemoryReportSeconds = 30.0;
+
+	// Threads recording the draw list each frame, 0 uses every hardware thread.
+	// DrawCount is the number of draws in the placeholder scene.
+	uint32_t RecordThreadCount = 0;
+	uint32_t DrawCount = 1;
+
+	// Instances drawn through GPU culling and indirect draws, 0 disables it
+	uint32_t InstanceCount = 0;
+
+	// Random 2D quads drawn over the scene by the batched quad renderer, needs the bindless set.
+	// 0 disables it.
+	uint32_t QuadCount = 0;
+
+	// Pipeline cache file, an empty path disables loading and saving it
+	std::string PipelineCachePath = "pipeline_cache.bin";
+
+	// Recompile assets/shaders on change and swap the rebuilt pipelines in
+	bool ShaderHotReload = true;
+
+	// Uploads and culling on dedicated transfer and compute queues when the device has them
+	bool AsyncQueues = true;
+
+	// Frames the CPU may queue ahead of the GPU, 1 to FramePacer::MAX_FRAMES_IN_FLIGHT.
+	// Lower trades throughput for input latency.
+	uint32_t FramesInFlight = 2;
+
+	// Unsupported present modes fall back to FIFO. 0 swap chain images uses one more than the minimum.
+	VkPresentModeKHR PresentMode = VK_PRESENT_MODE_MAILBOX_KHR;
+	uint32_t SwapChainImageCount = 0;
+
+	// Delays input sampling until just before recording by the time frames spend blocked
+	// on the GPU or the display beyond the margin, so input is as fresh as possible.
+	bool LatencyPacing = false;
+	double LatencyPacingMarginMillis = 1.0;
+
+	// Global update-after-bind descriptor set shared by every pipeline, when the device supports it
+	bool Bindless = true;
+
+	// KTX2 or DDS files streamed in the background, needs the bindless set. The budget is
+	// clamped to half of the device local memory.
+	std::vector<std::string> Textures;
+	uint32_t TextureBudgetMiB = 256;
+
+	// Forces a device by enumeration index or part of its name, otherwise the best scoring
+	// suitable device is used. Falls back to the VULKAN_SANDBOX_DEVICE environment variable.
+	std::string Device;
+};
+
+struct DrawCommand
+{
+	uint32_t IndexCount;
+	uint32_t InstanceCount;
+	uint32_t FirstIndex;
+	int32_t VertexOffset;
+	uint32_t FirstInstance;
+};
+
+// Pushed before every draw, handles index the arrays of the bindless set
+struct DrawConstants
+{
+	uint32_t InstanceBuffer;
+	uint32_t Material;
+	uint32_t Sampler;
+};
 
-struct QueueFamilyIndices
+// Uniform ring blocks, std140 layout. FrameUniforms is written once per frame,
+// ObjectUniforms once per draw.
+struct FrameUniforms
 {
-	std::optional<uint32_t> GraphicsFamily;
-	std::optional<uint32_t> PresentFamily;
-
-	inline bool AllAvailable()
-	{
-		return GraphicsFamily.has_value()
-			&& PresentFamily.has_value();
-	}
+	float Time;
+	float DeltaTime;
+	float Extent[2];
+};
+
+struct ObjectUniforms
+{
+	float Transform[16];
+};
+
+// Descriptor sets of the graphics pipeline layout, the bindless one is optional so it comes last
+enum PipelineSet : uint32_t
+{
+	PIPELINE_SET_UNIFORMS = 0,
+	PIPELINE_SET_BINDLESS = 1
 };
 
 struct SwapChainCapabilities
@@ -36,12 +176,13 @@ struct SwapChainCapabilities
 
 };
 
-// TODO: maybe create a custom memory allocator for Vulkan.
 class Application
 {
 public:
-	Application(bool EnableValidationLayers = true);
-	void Run();
+	Application(const ApplicationConfig &config = ApplicationConfig());
+
+	// False when the compute benchmark got a wrong result
+	bool Run();
 
 private:
 	void InitWindow();
@@ -58,40 +199,75 @@ private:
 	void CreateVulkanSurface();
 
 	void SelectPhysicalDevice();
-	QueueFamilyIndices FindQueueFamilies(VkPhysicalDevice device);
-	bool IsDeviceSuitable(VkPhysicalDevice device);
-	bool CheckDeviceExtensionSupport(VkPhysicalDevice device);
+	bool IsDeviceSuitable(const DeviceCapabilities &caps);
+	bool CheckDeviceExtensionSupport(const DeviceCapabilities &caps);
+	uint64_t ScoreDevice(const DeviceCapabilities &caps);
 
 	void CreateLogicalDevice();
 
 	SwapChainCapabilities RetrieveSwapChainCapabilities(VkPhysicalDevice device);
 	VkSurfaceFormatKHR SelectSwapChainSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& surfaceFormats);
+	void SelectSurfaceFormat();
 	VkPresentModeKHR SelectSwapChainPresentMode(const std::vector<VkPresentModeKHR>& presentModes);
 	VkExtent2D SelectSwapChainExtent(const VkSurfaceCapabilitiesKHR& capabilities);
 	void CreateSwapChain();
+	void RecreateSwapChain();
 
 	void CreateSwapChainImageViews();
 
-	void CreateRenderPass();
-	VkShaderModule Application::CreateShaderModule(const std::vector<char> &bytes);
-	void CreateGraphicsPipeline();
+	void CreateOffscreenTargets();
+	void DestroyOffscreenTargets();
+
+	void CreateRenderGraph();
+	void CreateRenderTargets();
+	VkShaderModule CreateShaderModule(const std::vector<char> &bytes);
+	void CreatePipelineLayout();
+	void CreateGraphicsPipeline(VkShaderModule vertexModule, VkShaderModule fragmentModule);
+	VkPipeline BuildGraphicsPipeline(const std::vector<char> &vertexShaderBytes, const std::vector<char> &fragmentShaderBytes);
+	VkPipeline BuildGraphicsPipeline(VkShaderModule vertexModule, VkShaderModule fragmentModule);
+
+	// Devices without the bindless set get the fragment shader that does not declare it
+	inline std::string GetFragmentShaderName() const { return m_BindlessEnabled ? "fragment" : "fragment_basic"; }
 
-	void CreateFramebuffers();
+	void StartShaderHotReload();
+	void OnShaderReloaded(const std::string &source, const std::vector<char> &spirv);
+	void ApplyReloadedPipelines();
 
 	void CreateCommandPool();
 	void CreateCommandBuffers();
+	void RecordCommandBuffer(uint32_t imageIndex);
+	void RecordAsyncCommands();
+	VkSemaphore SubmitAsyncCommands();
+	void RecordWorkerCommands(uint32_t threadIndex, uint32_t imageIndex);
+	void RecordScenePass(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+	void RecordQuadPass(VkCommandBuffer commandBuffer, uint32_t imageIndex);
 
 	void CreateSyncObjects();
 
+	void CreateSceneGeometry(const std::vector<char> &cullShaderBytes);
+	void CreateInstances(const std::vector<char> &cullShaderBytes);
+	void StartTextureStreaming();
+	void CreateQuads(const std::vector<char> &vertexShaderBytes, const std::vector<char> &fragmentShaderBytes);
+	std::vector<uint32_t> GetResourceQueueFamilies() const;
+	Mesh CreateMesh(const std::vector<Vertex> &vertices, const std::vector<uint16_t> &indices);
+	Mesh CreateMesh(const std::vector<Vertex> &vertices, const std::vector<uint32_t> &indices);
+	Mesh CreateMesh(const std::vector<Vertex> &vertices, const void *indices, uint32_t indexCount, VkIndexType indexType);
+	void DestroyMesh(Mesh &mesh);
+
 	void Update();
-	void DrawFrame();
+	// False when the frame was skipped without submitting
+	bool DrawFrame();
+	bool RunComputeBenchmark();
 	void Shutdown();
 
+	BenchmarkInfo GetBenchmarkInfo();
+
 private:
+	ApplicationConfig m_Config;
+
 	const char* m_WindowTitle = "Vulkan Testing";
 	const int m_WindowWidth = 1280;
 	const int m_WindowHeight = 720;
-	const int MAX_FRAMES_IN_FLIGHT = 2;
 	size_t current_frame = 0;
 	GLFWwindow *m_Window = nullptr;
 	
@@ -100,39 +276,141 @@ private:
 	VkSurfaceKHR m_Surface = VK_NULL_HANDLE;
 
 	VkPhysicalDevice m_PhysicalDevice = VK_NULL_HANDLE;
+	DeviceCapabilities m_DeviceCaps;
 	VkDevice m_Device = VK_NULL_HANDLE;
+	MemoryAllocator m_Allocator;
+	bool m_MemoryBudget = false;
+	PipelineCache m_PipelineCache;
 
+	QueueFamilyIndices m_QueueFamilies;
 	VkQueue m_GraphicsQueue = VK_NULL_HANDLE;
 	VkQueue m_PresentQueue = VK_NULL_HANDLE;
 
-	VkSwapchainKHR m_SwapChain = VK_NULL_HANDLE;
+	// Null without a dedicated family or with AsyncQueues disabled
+	VkQueue m_TransferQueue = VK_NULL_HANDLE;
+	VkQueue m_ComputeQueue = VK_NULL_HANDLE;
+
+	UniqueSwapchain m_SwapChain;
 	std::vector<VkImage> m_SwapChainImages;
+	VkSurfaceFormatKHR m_SurfaceFormat = {};
 	VkFormat m_SwapChainFormat;
+	VkPresentModeKHR m_PresentMode = VK_PRESENT_MODE_FIFO_KHR;
 	VkExtent2D m_SwapChainExtent = { 0 };
 
-	std::vector<VkImageView> m_SwapChainImageViews;
-
-	VkRenderPass m_RenderPass;
-	VkPipelineLayout m_PipelineLayout;
-	VkPipeline m_GraphicsPipeline;
-
-	std::vector<VkFramebuffer> m_SwapChainFramebuffers;
-
-	VkCommandPool m_CommandPool;
+	std::vector<UniqueImageView> m_SwapChainImageViews;
+	bool m_FramebufferResized = false;
+
+	// In headless mode m_SwapChainImages holds these device-owned render targets
+	// instead of swap chain images, so the rest of the pipeline stays unchanged.
+	// At least as many as frames in flight, so an image is only reused once its last frame completed.
+	const uint32_t HEADLESS_IMAGE_COUNT = FramePacer::MAX_FRAMES_IN_FLIGHT;
+	std::vector<UniqueImage> m_OffscreenImages;
+	uint32_t m_OffscreenImageIndex = 0;
+
+	// Owns the render passes, framebuffers and transient attachments. The swap chain
+	// images are imported as the backbuffer.
+	RenderGraph m_RenderGraph;
+	RenderGraph::ResourceId m_BackbufferResource = 0;
+	RenderGraph::PassId m_ScenePass = 0;
+
+	// Only added with quads, always inline so it gets its own subpass after the scene
+	RenderGraph::PassId m_QuadPass = 0;
+	bool m_QuadPassEnabled = false;
+
+	UniquePipelineLayout m_PipelineLayout;
+	UniquePipeline m_GraphicsPipeline;
+	double m_PipelineCreationMillis = 0.0;
+
+	// Pipelines built by the shader watcher thread, swapped in at the start of a frame
+	ShaderWatcher m_ShaderWatcher;
+	std::mutex m_ReloadMutex;
+	UniquePipeline m_ReloadedGraphicsPipeline;
+	UniquePipeline m_ReloadedCullingPipeline;
+
+	// Swap chains, pipelines and anything else replaced while frames that use it are in flight
+	DeletionQueue m_DeletionQueue;
+
+	// Primary command buffers are re-recorded every frame, one per frame in flight.
+	// Worker pools and their secondary buffers are indexed [frame * threadCount + thread].
+	UniqueCommandPool m_CommandPool;
 	std::vector<VkCommandBuffer> m_CommandBuffers;
-
-	std::vector<VkSemaphore> m_ImageAvailableSemaphores;
-	std::vector<VkSemaphore> m_RenderFinshedSemaphores;
-	std::vector<VkFence> m_InFlightFences;
-	std::vector<VkFence> m_ImagesInFlight;
+	std::vector<UniqueCommandPool> m_WorkerCommandPools;
+	std::vector<VkCommandBuffer> m_WorkerCommandBuffers;
+
+	// One per frame in flight on the async queues. Each frame chains its submissions
+	// transfer -> compute -> graphics through the semaphores, skipping the empty ones.
+	UniqueCommandPool m_TransferCommandPool;
+	std::vector<VkCommandBuffer> m_TransferCommandBuffers;
+	std::vector<UniqueSemaphore> m_TransferSemaphores;
+	bool m_TransferRecorded = false;
+
+	UniqueCommandPool m_ComputeCommandPool;
+	std::vector<VkCommandBuffer> m_ComputeCommandBuffers;
+	std::vector<UniqueSemaphore> m_ComputeSemaphores;
+	bool m_ComputeRecorded = false;
+
+	std::unique_ptr<util::ThreadPool> m_RecordThreads;
+	std::vector<DrawCommand> m_DrawList;
+
+	const VkDeviceSize STAGING_RING_SIZE = 16 * 1024 * 1024;
+
+	// Per frame in flight, enough for 16k draws at the largest common alignment of 256 bytes
+	const VkDeviceSize UNIFORM_RING_FRAME_SIZE = 4 * 1024 * 1024;
+	UniformRing m_UniformRing;
+	uint32_t m_FrameUniformOffset = 0;
+
+	// Seconds on m_StartupTimer when the previous frame began
+	double m_LastFrameSeconds = 0.0;
+	StagingRing m_StagingRing;
+	Mesh m_Mesh;
+
+	// Single instance at the origin bound for the CPU recorded draws
+	UniqueBuffer m_IdentityInstanceBuffer;
+
+	// Disabled when the device lacks descriptor indexing, the pipeline layout then has no sets
+	BindlessDescriptors m_Bindless;
+	bool m_BindlessEnabled = false;
+	uint32_t m_IdentityInstanceHandle = BindlessDescriptors::INVALID_HANDLE;
+
+	// A quarter of the staging ring, so texture mips leave room for other uploads
+	const VkDeviceSize TEXTURE_UPLOAD_BYTES_PER_FRAME = 4 * 1024 * 1024;
+	TextureStreamer m_TextureStreamer;
+	std::vector<TextureStreamer::TextureId> m_TextureIds;
+	std::vector<uint32_t> m_TextureHandles;
+
+	GpuCulling m_Culling;
+	bool m_GpuDriven = false;
+	PFN_vkCmdDrawIndexedIndirectCountKHR m_CmdDrawIndexedIndirectCount = nullptr;
+
+	QuadRenderer m_QuadRenderer;
+
+	std::vector<UniqueSemaphore> m_ImageAvailableSemaphores;
+	std::vector<UniqueSemaphore> m_RenderFinshedSemaphores;
+	FramePacer m_FramePacer;
+
+	// Only used with a window, picked from the present timing extensions the device has
+	LatencyMeasurement m_LatencyMeasurement = LatencyMeasurement::CpuEstimate;
+	LatencyTracker m_LatencyTracker;
+	std::vector<double> m_LatencySamples;
+
+	FrameTimings m_LastFrameTimings;
+
+	// Zones on the graphics queue only, the async queues have their own timelines.
+	// The device features are the ones it was created with, the profiler checks them.
+	GpuProfiler m_GpuProfiler;
+	VkPhysicalDeviceFeatures m_EnabledFeatures = {};
+	bool m_CalibratedTimestamps = false;
+
+	// Time spent in InitVulkan, and from Run until the first frame was submitted
+	util::Timer m_StartupTimer;
+	double m_StartupMillis = 0.0;
+	double m_FirstFrameMillis = 0.0;
 
 	const std::vector<const char *> m_ValidationLayers = {
 		"VK_LAYER_KHRONOS_validation"
 	};
 
-	const std::vector<const char *> m_RequiredExtensions = {
-		VK_KHR_SWAPCHAIN_EXTENSION_NAME
-	};
+	std::vector<const char *> m_RequiredExtensions;
 
 	bool m_EnableValidationLayers = true;
 
@@ -0,0 +1,182 @@
+#include "AsyncLogSink.h"
+
+#include <chrono>
+
+static const size_t SLOT_PAYLOAD_RESERVE = 256;
+
+namespace util {
+
+	AsyncLogSink::AsyncLogSink(std::vector<spdlog::sink_ptr> backends, size_t capacity, LogOverflowPolicy overflow)
+		: m_Backends(std::move(backends)), m_Overflow(overflow)
+	{
+
+		// Capacity is rounded up to a power of two so positions map to slots with a mask
+		size_t size = 2;
+		while (size < capacity)
+			size <<= 1;
+
+		this->m_Slots = std::make_unique<Slot[]>(size);
+		this->m_Mask = size - 1;
+
+		// Reserving payload space up front keeps the first pass over the ring from allocating
+		for (size_t i = 0; i < size; ++i)
+		{
+			this->m_Slots[i].Sequence.store(i, std::memory_order_relaxed);
+			this->m_Slots[i].Payload.reserve(SLOT_PAYLOAD_RESERVE);
+		}
+
+		this->m_Worker = std::thread(&AsyncLogSink::WorkerLoop, this);
+
+	}
+
+	AsyncLogSink::~AsyncLogSink()
+	{
+
+		this->m_Running.store(false, std::memory_order_release);
+
+		if (this->m_Worker.joinable())
+			this->m_Worker.join();
+
+	}
+
+	void AsyncLogSink::log(const spdlog::details::log_msg &msg)
+	{
+
+		size_t position = this->m_EnqueuePosition.load(std::memory_order_relaxed);
+		Slot *slot = nullptr;
+
+		while (true)
+		{
+			slot = &this->m_Slots[position & this->m_Mask];
+			size_t sequence = slot->Sequence.load(std::memory_order_acquire);
+			intptr_t difference = (intptr_t) sequence - (intptr_t) position;
+
+			if (difference == 0)
+			{
+				if (this->m_EnqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+					break;
+			}
+			else if (difference < 0)
+			{
+				// The ring is full, errors always wait since they are usually followed by exit(-1)
+				if (this->m_Overflow == LogOverflowPolicy::Drop && msg.level < spdlog::level::err)
+				{
+					this->m_Dropped.fetch_add(1, std::memory_order_relaxed);
+					return;
+				}
+
+				std::this_thread::yield();
+				position = this->m_EnqueuePosition.load(std::memory_order_relaxed);
+			}
+			else
+				position = this->m_EnqueuePosition.load(std::memory_order_relaxed);
+		}
+
+		slot->Level = msg.level;
+		slot->Time = msg.time;
+		slot->ThreadId = msg.thread_id;
+		slot->LoggerName = msg.logger_name;
+		slot->Payload.assign(msg.payload.data(), msg.payload.size());
+
+		slot->Sequence.store(position + 1, std::memory_order_release);
+
+	}
+
+	bool AsyncLogSink::Dequeue()
+	{
+
+		size_t position = this->m_DequeuePosition.load(std::memory_order_relaxed);
+		Slot &slot = this->m_Slots[position & this->m_Mask];
+
+		if (slot.Sequence.load(std::memory_order_acquire) != position + 1)
+			return false;
+
+		spdlog::details::log_msg msg(slot.Time, spdlog::source_loc{}, slot.LoggerName, slot.Level,
+			spdlog::string_view_t(slot.Payload.data(), slot.Payload.size()));
+		msg.thread_id = slot.ThreadId;
+
+		for (auto &backend : this->m_Backends)
+		{
+			if (backend->should_log(msg.level))
+				backend->log(msg);
+		}
+
+		slot.Sequence.store(position + this->m_Mask + 1, std::memory_order_release);
+		this->m_DequeuePosition.store(position + 1, std::memory_order_release);
+
+		return true;
+
+	}
+
+	void AsyncLogSink::WorkerLoop()
+	{
+
+		uint64_t reportedDrops = 0;
+
+		while (true)
+		{
+			bool running = this->m_Running.load(std::memory_order_acquire);
+
+			bool any = false;
+			while (this->Dequeue())
+				any = true;
+
+			uint64_t dropped = this->GetDroppedCount();
+			if (dropped != reportedDrops)
+			{
+				std::string text = "Log queue overflowed, dropped " + std::to_string(dropped - reportedDrops) + " messages";
+				spdlog::details::log_msg msg("LOG", spdlog::level::warn, text);
+
+				for (auto &backend : this->m_Backends)
+					backend->log(msg);
+
+				reportedDrops = dropped;
+			}
+
+			if (!running)
+				break;
+
+			// Producers never signal, polling keeps the logging calls free of syscalls
+			if (!any)
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+
+		for (auto &backend : this->m_Backends)
+			backend->flush();
+
+	}
+
+	void AsyncLogSink::flush()
+	{
+
+		size_t target = this->m_EnqueuePosition.load(std::memory_order_acquire);
+
+		if (std::this_thread::get_id() != this->m_Worker.get_id())
+		{
+			while (this->m_Running.load(std::memory_order_acquire)
+			&&	this->m_DequeuePosition.load(std::memory_order_acquire) < target)
+				std::this_thread::yield();
+		}
+
+		for (auto &backend : this->m_Backends)
+			backend->flush();
+
+	}
+
+	void AsyncLogSink::set_pattern(const std::string &pattern)
+	{
+
+		for (auto &backend : this->m_Backends)
+			backend->set_pattern(pattern);
+
+	}
+
+	void AsyncLogSink::set_formatter(std::unique_ptr<spdlog::formatter> formatter)
+	{
+
+		for (auto &backend : this->m_Backends)
+			backend->set_formatter(formatter->clone());
+
+	}
+
+}
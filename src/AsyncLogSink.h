@@ -0,0 +1,76 @@
+#pragma once
+
+#include <spdlog/spdlog.h>
+#include <spdlog/sinks/sink.h>
+
+#include <vector>
+#include <string>
+#include <atomic>
+#include <thread>
+#include <memory>
+#include <cstdint>
+
+namespace util {
+
+	enum class LogOverflowPolicy
+	{
+		Drop = 0,	// Discard the message and count it, errors still block
+		Block		// Wait for the background thread to make room
+	};
+
+	// spdlog sink that hands messages to a background thread through a bounded
+	// lock-free ring (one sequence number per slot, Vyukov style). The calling
+	// thread only copies the payload into a slot, the backend sinks do all of the
+	// formatting and I/O on the background thread.
+	class AsyncLogSink : public spdlog::sinks::sink
+	{
+
+	public:
+		AsyncLogSink(std::vector<spdlog::sink_ptr> backends, size_t capacity, LogOverflowPolicy overflow);
+		~AsyncLogSink() override;
+
+		void log(const spdlog::details::log_msg &msg) override;
+
+		// Blocks until everything queued so far has reached the backends
+		void flush() override;
+
+		void set_pattern(const std::string &pattern) override;
+		void set_formatter(std::unique_ptr<spdlog::formatter> formatter) override;
+
+		inline uint64_t GetDroppedCount() const { return m_Dropped.load(std::memory_order_relaxed); }
+
+	private:
+		bool Dequeue();
+		void WorkerLoop();
+
+	private:
+		struct Slot
+		{
+			std::atomic<size_t> Sequence;
+			spdlog::level::level_enum Level;
+			spdlog::log_clock::time_point Time;
+			size_t ThreadId;
+
+			// Logger names are owned by loggers that outlive the sink's queue
+			spdlog::string_view_t LoggerName;
+
+			// Keeps its capacity between messages, so steady state logging does not allocate
+			std::string Payload;
+		};
+
+		std::vector<spdlog::sink_ptr> m_Backends;
+		LogOverflowPolicy m_Overflow;
+
+		std::unique_ptr<Slot[]> m_Slots;
+		size_t m_Mask = 0;
+
+		alignas(64) std::atomic<size_t> m_EnqueuePosition = { 0 };
+		alignas(64) std::atomic<size_t> m_DequeuePosition = { 0 };
+		alignas(64) std::atomic<uint64_t> m_Dropped = { 0 };
+
+		std::atomic<bool> m_Running = { true };
+		std::thread m_Worker;
+
+	};
+
+}
@@ -0,0 +1,324 @@
+#include "Benchmark.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <numeric>
+#include <fstream>
+#include <cmath>
+
+struct PhaseColumn
+{
+	const char *Name;
+	double FrameTimings::*Member;
+};
+
+static const PhaseColumn s_Phases[] = {
+	{ "fence_wait",	&FrameTimings::FenceWait },
+	{ "acquire",	&FrameTimings::Acquire },
+	{ "input_delay",	&FrameTimings::InputDelay },
+	{ "record",		&FrameTimings::Record },
+	{ "submit",		&FrameTimings::Submit },
+	{ "present",	&FrameTimings::Present },
+	{ "frame",		&FrameTimings::Total }
+};
+
+static bool EndsWith(const std::string &str, const std::string &suffix)
+{
+	return str.size() >= suffix.size()
+		&& str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+bool IsJsonReport(const std::string &path)
+{
+	return EndsWith(path, ".json");
+}
+
+std::string EscapeJson(const std::string &str)
+{
+
+	std::string escaped;
+	escaped.reserve(str.size());
+
+	for (char c : str)
+	{
+		if (c == '"' || c == '\\')
+			escaped += '\\';
+
+		// Control characters are not allowed inside JSON strings
+		escaped += (unsigned char) c < 0x20 ? ' ' : c;
+	}
+
+	return escaped;
+
+}
+
+std::string QuoteCsv(const std::string &str)
+{
+
+	// Quotes inside a quoted field are doubled
+	std::string quoted = "\"";
+	for (char c : str)
+	{
+		if (c == '"')
+			quoted += '"';
+
+		quoted += c;
+	}
+
+	return quoted + '"';
+
+}
+
+FrameBenchmark::FrameBenchmark(uint32_t warmupFrames, uint32_t measuredFrames)
+	: m_WarmupFrames(warmupFrames), m_MeasuredFrames(measuredFrames)
+{
+
+	this->m_Samples.reserve(measuredFrames);
+
+}
+
+void FrameBenchmark::AddFrame(const FrameTimings &timings)
+{
+
+	if (this->IsFinished())
+		return;
+
+	if (this->m_FrameCount == this->m_WarmupFrames)
+	{
+		// The wall clock starts at the end of the first measured frame,
+		// so account for the frame itself to not lose one frame worth of time.
+		this->m_Timer.Reset();
+		this->m_MeasuredSeconds = timings.Total / 1000.0;
+		LOG_INFO("Benchmark warm-up finished, measuring {0} frames...", this->m_MeasuredFrames);
+	}
+
+	if (this->IsMeasuring())
+		this->m_Samples.push_back(timings);
+
+	++this->m_FrameCount;
+
+	if (this->IsFinished())
+		this->m_MeasuredSeconds += this->m_Timer.ElapsedSeconds();
+
+}
+
+void FrameBenchmark::AddLatency(double millis)
+{
+
+	if (this->IsMeasuring() && !this->IsFinished())
+		this->m_LatencySamples.push_back(millis);
+
+}
+
+BenchmarkStatistics FrameBenchmark::ComputeStatistics(double FrameTimings::*phase) const
+{
+
+	std::vector<double> samples;
+	samples.reserve(this->m_Samples.size());
+	for (const FrameTimings &timings : this->m_Samples)
+		samples.push_back(timings.*phase);
+
+	return ComputeStatistics(std::move(samples));
+
+}
+
+BenchmarkStatistics FrameBenchmark::ComputeStatistics(std::vector<double> samples)
+{
+
+	BenchmarkStatistics stats;
+	if (samples.empty())
+		return stats;
+
+	std::sort(samples.begin(), samples.end());
+
+	// Nearest-rank percentile on the sorted samples
+	auto percentile = [&samples](double p)
+	{
+		size_t rank = (size_t) std::ceil(p / 100.0 * samples.size());
+		return samples[std::min(samples.size() - 1, rank > 0 ? rank - 1 : 0)];
+	};
+
+	stats.Min = samples.front();
+	stats.Max = samples.back();
+	stats.Mean = std::accumulate(samples.begin(), samples.end(), 0.0) / samples.size();
+	stats.P50 = percentile(50.0);
+	stats.P95 = percentile(95.0);
+	stats.P99 = percentile(99.0);
+
+	return stats;
+
+}
+
+double FrameBenchmark::GetMeasuredSeconds() const
+{
+
+	if (this->IsMeasuring() && !this->IsFinished() && !this->m_Samples.empty())
+		return this->m_MeasuredSeconds + this->m_Timer.ElapsedSeconds();
+
+	return this->m_MeasuredSeconds;
+
+}
+
+double FrameBenchmark::GetThroughput() const
+{
+
+	double seconds = this->GetMeasuredSeconds();
+	if (seconds <= 0.0)
+		return 0.0;
+
+	return this->m_Samples.size() / seconds;
+
+}
+
+bool FrameBenchmark::WriteReport(const std::string &path, const BenchmarkInfo &info) const
+{
+
+	bool written = IsJsonReport(path)
+		? this->WriteJson(path, info)
+		: this->WriteCsv(path, info);
+
+	if (!written)
+	{
+		LOG_ERROR("Failed to write the benchmark report: {0}", path);
+		return false;
+	}
+
+	LOG_INFO("Wrote benchmark report to {0}", path);
+	return true;
+
+}
+
+bool FrameBenchmark::WriteJson(const std::string &path, const BenchmarkInfo &info) const
+{
+
+	std::ofstream file(path);
+	if (!file.is_open())
+		return false;
+
+	file << "{\n";
+	file << "\t\"device\": \"" << EscapeJson(info.DeviceName) << "\",\n";
+	file << "\t\"present_mode\": \"" << info.PresentMode << "\",\n";
+	file << "\t\"frames_in_flight\": " << info.FramesInFlight << ",\n";
+	file << "\t\"image_count\": " << info.ImageCount << ",\n";
+	file << "\t\"extent\": [" << info.Width << ", " << info.Height << "],\n";
+	file << "\t\"headless\": " << (info.Headless ? "true" : "false") << ",\n";
+	file << "\t\"record_threads\": " << info.RecordThreads << ",\n";
+	file << "\t\"draw_count\": " << info.DrawCount << ",\n";
+	file << "\t\"gpu_instances\": " << info.GpuInstances << ",\n";
+	file << "\t\"latency_measurement\": \"" << info.LatencyMeasurement << "\",\n";
+	file << "\t\"latency_pacing\": " << (info.LatencyPacing ? "true" : "false") << ",\n";
+	file << "\t\"pipeline_cache\": \"" << (info.PipelineCacheWarm ? "warm" : "cold") << "\",\n";
+	file << "\t\"pipeline_creation_ms\": " << info.PipelineCreationMillis << ",\n";
+	file << "\t\"startup_ms\": " << info.StartupMillis << ",\n";
+	file << "\t\"first_frame_ms\": " << info.FirstFrameMillis << ",\n";
+	file << "\t\"warmup_frames\": " << this->m_WarmupFrames << ",\n";
+	file << "\t\"measured_frames\": " << this->m_Samples.size() << ",\n";
+	file << "\t\"seconds\": " << this->GetMeasuredSeconds() << ",\n";
+	file << "\t\"fps\": " << this->GetThroughput() << ",\n";
+
+	BenchmarkStatistics latency = ComputeStatistics(this->m_LatencySamples);
+	file << "\t\"input_latency_ms\": { "
+		<< "\"samples\": " << this->m_LatencySamples.size() << ", "
+		<< "\"min\": " << latency.Min << ", "
+		<< "\"mean\": " << latency.Mean << ", "
+		<< "\"p50\": " << latency.P50 << ", "
+		<< "\"p95\": " << latency.P95 << ", "
+		<< "\"p99\": " << latency.P99 << ", "
+		<< "\"max\": " << latency.Max << " },\n";
+
+	file << "\t\"phases_ms\": {\n";
+
+	size_t phaseCount = sizeof(s_Phases) / sizeof(s_Phases[0]);
+	for (size_t i = 0; i < phaseCount; ++i)
+	{
+		BenchmarkStatistics stats = this->ComputeStatistics(s_Phases[i].Member);
+		file << "\t\t\"" << s_Phases[i].Name << "\": { "
+			<< "\"min\": " << stats.Min << ", "
+			<< "\"mean\": " << stats.Mean << ", "
+			<< "\"p50\": " << stats.P50 << ", "
+			<< "\"p95\": " << stats.P95 << ", "
+			<< "\"p99\": " << stats.P99 << ", "
+			<< "\"max\": " << stats.Max << " }"
+			<< (i + 1 < phaseCount ? ",\n" : "\n");
+	}
+
+	file << "\t}\n";
+	file << "}\n";
+
+	return file.good();
+
+}
+
+bool FrameBenchmark::WriteCsv(const std::string &path, const BenchmarkInfo &info) const
+{
+
+	std::ofstream file(path);
+	if (!file.is_open())
+		return false;
+
+	// One row per phase plus one for input latency, the run configuration is
+	// repeated on every row so reports from several builds can simply be concatenated.
+	file << "device,present_mode,frames_in_flight,image_count,width,height,headless,record_threads,draw_count,gpu_instances,latency_measurement,latency_pacing,pipeline_cache,pipeline_creation_ms,startup_ms,first_frame_ms,measured_frames,fps,"
+		<< "phase,min_ms,mean_ms,p50_ms,p95_ms,p99_ms,max_ms\n";
+
+	auto writeRow = [&](const char *name, const BenchmarkStatistics &stats)
+	{
+		file << QuoteCsv(info.DeviceName) << ','
+			<< info.PresentMode << ','
+			<< info.FramesInFlight << ','
+			<< info.ImageCount << ','
+			<< info.Width << ','
+			<< info.Height << ','
+			<< (info.Headless ? 1 : 0) << ','
+			<< info.RecordThreads << ','
+			<< info.DrawCount << ','
+			<< info.GpuInstances << ','
+			<< info.LatencyMeasurement << ','
+			<< (info.LatencyPacing ? 1 : 0) << ','
+			<< (info.PipelineCacheWarm ? "warm" : "cold") << ','
+			<< info.PipelineCreationMillis << ','
+			<< info.StartupMillis << ','
+			<< info.FirstFrameMillis << ','
+			<< this->m_Samples.size() << ','
+			<< this->GetThroughput() << ','
+			<< name << ','
+			<< stats.Min << ','
+			<< stats.Mean << ','
+			<< stats.P50 << ','
+			<< stats.P95 << ','
+			<< stats.P99 << ','
+			<< stats.Max << '\n';
+	};
+
+	for (const PhaseColumn &phase : s_Phases)
+		writeRow(phase.Name, this->ComputeStatistics(phase.Member));
+
+	writeRow("input_latency", ComputeStatistics(this->m_LatencySamples));
+
+	return file.good();
+
+}
+
+void FrameBenchmark::LogSummary() const
+{
+
+	LOG_INFO("Benchmark: {0} frames in {1:.3f}s ({2:.1f} FPS)",
+		this->m_Samples.size(),
+		this->GetMeasuredSeconds(),
+		this->GetThroughput());
+
+	for (const PhaseColumn &phase : s_Phases)
+	{
+		BenchmarkStatistics stats = this->ComputeStatistics(phase.Member);
+		LOG_INFO("\t{0:<10} min {1:.3f}ms mean {2:.3f}ms p50 {3:.3f}ms p95 {4:.3f}ms p99 {5:.3f}ms",
+			phase.Name, stats.Min, stats.Mean, stats.P50, stats.P95, stats.P99);
+	}
+
+	if (!this->m_LatencySamples.empty())
+	{
+		BenchmarkStatistics stats = ComputeStatistics(this->m_LatencySamples);
+		LOG_INFO("\t{0:<10} min {1:.3f}ms mean {2:.3f}ms p50 {3:.3f}ms p95 {4:.3f}ms p99 {5:.3f}ms ({6} samples)",
+			"latency", stats.Min, stats.Mean, stats.P50, stats.P95, stats.P99, this->m_LatencySamples.size());
+	}
+
+}
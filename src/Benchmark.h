@@ -0,0 +1,107 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+#include "Timer.h"
+
+// CPU time (in milliseconds) spent in each phase of Application::DrawFrame
+struct FrameTimings
+{
+	double FenceWait = 0.0;
+	double Acquire = 0.0;
+	double InputDelay = 0.0;
+	double Record = 0.0;
+	double Submit = 0.0;
+	double Present = 0.0;
+	double Total = 0.0;
+};
+
+struct BenchmarkStatistics
+{
+	double Min = 0.0;
+	double Mean = 0.0;
+	double P50 = 0.0;
+	double P95 = 0.0;
+	double P99 = 0.0;
+	double Max = 0.0;
+};
+
+// Describes the configuration a report was captured with, so runs
+// with different present modes or frame counts can be told apart.
+struct BenchmarkInfo
+{
+	std::string DeviceName;
+	std::string PresentMode;
+	uint32_t FramesInFlight = 0;
+	uint32_t ImageCount = 0;
+	uint32_t Width = 0;
+	uint32_t Height = 0;
+	bool Headless = false;
+	uint32_t RecordThreads = 0;
+	uint32_t DrawCount = 0;
+	uint32_t GpuInstances = 0;
+
+	// Input-to-present latency is only comparable between runs measured the same way
+	std::string LatencyMeasurement;
+	bool LatencyPacing = false;
+
+	// Startup cost of pipeline creation, to compare cold and warm pipeline caches
+	bool PipelineCacheWarm = false;
+	double PipelineCreationMillis = 0.0;
+
+	// InitVulkan alone, and everything up to the first submitted frame
+	double StartupMillis = 0.0;
+	double FirstFrameMillis = 0.0;
+};
+
+// Reports ending in ".json" are written as JSON, anything else as CSV
+bool IsJsonReport(const std::string &path);
+
+// Device names come from the driver, so strings in reports are escaped for their format
+std::string EscapeJson(const std::string &str);
+std::string QuoteCsv(const std::string &str);
+
+class FrameBenchmark
+{
+
+public:
+	FrameBenchmark(uint32_t warmupFrames, uint32_t measuredFrames);
+
+	// Feeds the timings of one finished frame, warm-up frames are discarded.
+	void AddFrame(const FrameTimings &timings);
+
+	// Latency arrives some frames after the frame itself, samples are kept while measuring
+	void AddLatency(double millis);
+
+	inline bool IsFinished() const { return m_FrameCount >= m_WarmupFrames + m_MeasuredFrames; }
+	inline bool IsMeasuring() const { return m_FrameCount >= m_WarmupFrames; }
+
+	// Writes a JSON report if the path ends with ".json", CSV otherwise.
+	bool WriteReport(const std::string &path, const BenchmarkInfo &info) const;
+	void LogSummary() const;
+
+	static BenchmarkStatistics ComputeStatistics(std::vector<double> samples);
+
+private:
+	BenchmarkStatistics ComputeStatistics(double FrameTimings::*phase) const;
+
+	bool WriteJson(const std::string &path, const BenchmarkInfo &info) const;
+	bool WriteCsv(const std::string &path, const BenchmarkInfo &info) const;
+
+	// Includes the running measurement when the report is written before the benchmark finished
+	double GetMeasuredSeconds() const;
+	double GetThroughput() const;
+
+private:
+	uint32_t m_WarmupFrames = 0;
+	uint32_t m_MeasuredFrames = 0;
+	uint32_t m_FrameCount = 0;
+
+	util::Timer m_Timer;
+	double m_MeasuredSeconds = 0.0;
+	std::vector<FrameTimings> m_Samples;
+	std::vector<double> m_LatencySamples;
+
+};
@@ -0,0 +1,324 @@
+#include "BindlessDescriptors.h"
+#include "Log.h"
+
+#include <algorithm>
+
+// Upper bounds per array, the device limits usually allow far more
+static const uint32_t DESIRED_CAPACITY[(uint32_t) BindlessType::Count] = { 16384, 16384, 1024 };
+
+static const VkDescriptorType DESCRIPTOR_TYPES[(uint32_t) BindlessType::Count] = {
+	VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+	VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+	VK_DESCRIPTOR_TYPE_SAMPLER
+};
+
+VkPhysicalDeviceDescriptorIndexingFeaturesEXT BindlessDescriptors::GetRequiredFeatures()
+{
+
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT features = {};
+	features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+	features.runtimeDescriptorArray = VK_TRUE;
+	features.descriptorBindingPartiallyBound = VK_TRUE;
+
+	// Also covers the sampler array
+	features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+	features.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+
+	return features;
+
+}
+
+bool BindlessDescriptors::IsSupported(const DeviceCapabilities &caps)
+{
+
+	const VkPhysicalDeviceDescriptorIndexingFeaturesEXT &features = caps.DescriptorIndexing;
+
+	return caps.HasExtension(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME)
+		&& caps.Features.shaderSampledImageArrayDynamicIndexing
+		&& features.runtimeDescriptorArray
+		&& features.descriptorBindingPartiallyBound
+		&& features.descriptorBindingSampledImageUpdateAfterBind
+		&& features.descriptorBindingStorageBufferUpdateAfterBind;
+
+}
+
+void BindlessDescriptors::Init(VkDevice device, const DeviceCapabilities &caps, uint32_t frameCount)
+{
+
+	this->m_Device = device;
+
+	// Each array has to fit the per stage and per set limits, all of them together
+	// the per stage resource limit and every frame's set the pool wide limit
+	const VkPhysicalDeviceDescriptorIndexingPropertiesEXT &limits = caps.DescriptorIndexingLimits;
+	uint32_t maxPerType[(uint32_t) BindlessType::Count] = {
+		std::min(limits.maxPerStageDescriptorUpdateAfterBindStorageBuffers, limits.maxDescriptorSetUpdateAfterBindStorageBuffers),
+		std::min(limits.maxPerStageDescriptorUpdateAfterBindSampledImages, limits.maxDescriptorSetUpdateAfterBindSampledImages),
+		std::min(limits.maxPerStageDescriptorUpdateAfterBindSamplers, limits.maxDescriptorSetUpdateAfterBindSamplers)
+	};
+
+	uint64_t total = 0;
+	for (uint32_t type = 0; type < (uint32_t) BindlessType::Count; ++type)
+		total += std::min(DESIRED_CAPACITY[type], maxPerType[type]);
+
+	uint64_t budget = std::min<uint64_t>(limits.maxPerStageUpdateAfterBindResources, limits.maxUpdateAfterBindDescriptorsInAllPools / frameCount);
+	for (uint32_t type = 0; type < (uint32_t) BindlessType::Count; ++type)
+	{
+		uint64_t capacity = std::min(DESIRED_CAPACITY[type], maxPerType[type]);
+		if (total > budget)
+			capacity = capacity * budget / total;
+
+		this->m_Arrays[type].Capacity = std::max<uint32_t>((uint32_t) capacity, 1);
+	}
+
+	VkDescriptorSetLayoutBinding bindings[(uint32_t) BindlessType::Count] = {};
+	VkDescriptorBindingFlagsEXT bindingFlags[(uint32_t) BindlessType::Count] = {};
+	VkDescriptorPoolSize poolSizes[(uint32_t) BindlessType::Count] = {};
+
+	for (uint32_t type = 0; type < (uint32_t) BindlessType::Count; ++type)
+	{
+		bindings[type].binding = type;
+		bindings[type].descriptorType = DESCRIPTOR_TYPES[type];
+		bindings[type].descriptorCount = this->m_Arrays[type].Capacity;
+		bindings[type].stageFlags = VK_SHADER_STAGE_ALL_GRAPHICS | VK_SHADER_STAGE_COMPUTE_BIT;
+
+		// Handles that were never written stay unbound, shaders just must not use them
+		bindingFlags[type] = VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT | VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT;
+
+		poolSizes[type].type = DESCRIPTOR_TYPES[type];
+		poolSizes[type].descriptorCount = this->m_Arrays[type].Capacity * frameCount;
+	}
+
+	VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsInfo = {};
+	bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+	bindingFlagsInfo.bindingCount = (uint32_t) BindlessType::Count;
+	bindingFlagsInfo.pBindingFlags = bindingFlags;
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.pNext = &bindingFlagsInfo;
+	layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+	layoutInfo.bindingCount = (uint32_t) BindlessType::Count;
+	layoutInfo.pBindings = bindings;
+
+	if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &this->m_Layout) != VK_SUCCESS)
+	{
+		LOG_VK_CRITICAL("Failed to create bindless descriptor set layout!");
+		exit(-1);
+	}
+
+	VkDescriptorPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+	poolInfo.maxSets = frameCount;
+	poolInfo.poolSizeCount = (uint32_t) BindlessType::Count;
+	poolInfo.pPoolSizes = poolSizes;
+
+	if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &this->m_Pool) != VK_SUCCESS)
+	{
+		LOG_VK_CRITICAL("Failed to create bindless descriptor pool!");
+		exit(-1);
+	}
+
+	std::vector<VkDescriptorSetLayout> layouts(frameCount, this->m_Layout);
+
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = this->m_Pool;
+	allocInfo.descriptorSetCount = frameCount;
+	allocInfo.pSetLayouts = layouts.data();
+
+	this->m_Sets.resize(frameCount);
+	if (vkAllocateDescriptorSets(device, &allocInfo, this->m_Sets.data()) != VK_SUCCESS)
+	{
+		LOG_VK_CRITICAL("Failed to allocate bindless descriptor sets!");
+		exit(-1);
+	}
+
+	LOG_VK_INFO("Bindless descriptors: {0} storage buffers, {1} sampled images, {2} samplers in {3} sets",
+		this->GetCapacity(BindlessType::StorageBuffer),
+		this->GetCapacity(BindlessType::SampledImage),
+		this->GetCapacity(BindlessType::Sampler),
+		frameCount);
+
+}
+
+void BindlessDescriptors::Shutdown()
+{
+
+	if (!this->m_Device)
+		return;
+
+	// Destroying the pool frees the sets
+	vkDestroyDescriptorPool(this->m_Device, this->m_Pool, nullptr);
+	vkDestroyDescriptorSetLayout(this->m_Device, this->m_Layout, nullptr);
+
+	this->m_Sets.clear();
+	this->m_Pending.clear();
+	this->m_Retired.clear();
+	this->m_Device = VK_NULL_HANDLE;
+
+}
+
+uint32_t BindlessDescriptors::AddStorageBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+{
+
+	VkDescriptorBufferInfo bufferInfo = {};
+	bufferInfo.buffer = buffer;
+	bufferInfo.offset = offset;
+	bufferInfo.range = range;
+
+	std::lock_guard<std::mutex> lock(this->m_Mutex);
+
+	uint32_t handle = this->Allocate(BindlessType::StorageBuffer);
+	if (handle != INVALID_HANDLE)
+		this->Enqueue(BindlessType::StorageBuffer, handle, &bufferInfo, nullptr);
+
+	return handle;
+
+}
+
+uint32_t BindlessDescriptors::AddSampledImage(VkImageView view, VkImageLayout layout)
+{
+
+	VkDescriptorImageInfo imageInfo = {};
+	imageInfo.imageView = view;
+	imageInfo.imageLayout = layout;
+
+	std::lock_guard<std::mutex> lock(this->m_Mutex);
+
+	uint32_t handle = this->Allocate(BindlessType::SampledImage);
+	if (handle != INVALID_HANDLE)
+		this->Enqueue(BindlessType::SampledImage, handle, nullptr, &imageInfo);
+
+	return handle;
+
+}
+
+uint32_t BindlessDescriptors::AddSampler(VkSampler sampler)
+{
+
+	VkDescriptorImageInfo imageInfo = {};
+	imageInfo.sampler = sampler;
+
+	std::lock_guard<std::mutex> lock(this->m_Mutex);
+
+	uint32_t handle = this->Allocate(BindlessType::Sampler);
+	if (handle != INVALID_HANDLE)
+		this->Enqueue(BindlessType::Sampler, handle, nullptr, &imageInfo);
+
+	return handle;
+
+}
+
+void BindlessDescriptors::UpdateSampledImage(uint32_t handle, VkImageView view, VkImageLayout layout)
+{
+
+	VkDescriptorImageInfo imageInfo = {};
+	imageInfo.imageView = view;
+	imageInfo.imageLayout = layout;
+
+	std::lock_guard<std::mutex> lock(this->m_Mutex);
+	this->Enqueue(BindlessType::SampledImage, handle, nullptr, &imageInfo);
+
+}
+
+void BindlessDescriptors::Release(BindlessType type, uint32_t handle, uint64_t retiredAtFrame)
+{
+
+	if (handle == INVALID_HANDLE)
+		return;
+
+	std::lock_guard<std::mutex> lock(this->m_Mutex);
+	this->m_Retired.push_back({ type, handle, retiredAtFrame });
+
+}
+
+void BindlessDescriptors::BeginFrame(uint32_t frameIndex, uint64_t completedFrames)
+{
+
+	std::lock_guard<std::mutex> lock(this->m_Mutex);
+
+	// Released in frame order, so the completed ones are at the front
+	while (!this->m_Retired.empty() && completedFrames > this->m_Retired.front().RetiredAtFrame)
+	{
+		const RetiredHandle &retired = this->m_Retired.front();
+		this->m_Arrays[(uint32_t) retired.Type].Free.push_back(retired.Handle);
+		this->m_Retired.pop_front();
+	}
+
+	if (this->m_Pending.empty())
+		return;
+
+	uint32_t frameBit = 1u << frameIndex;
+	std::vector<VkWriteDescriptorSet> writes;
+
+	// Later writes to a reused handle come after the earlier ones and win
+	for (PendingWrite &pending : this->m_Pending)
+	{
+		if (!(pending.FrameMask & frameBit))
+			continue;
+
+		VkWriteDescriptorSet write = {};
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.dstSet = this->m_Sets[frameIndex];
+		write.dstBinding = (uint32_t) pending.Type;
+		write.dstArrayElement = pending.Handle;
+		write.descriptorCount = 1;
+		write.descriptorType = DESCRIPTOR_TYPES[(uint32_t) pending.Type];
+		write.pBufferInfo = &pending.Buffer;
+		write.pImageInfo = &pending.Image;
+		writes.push_back(write);
+
+		pending.FrameMask &= ~frameBit;
+	}
+
+	if (!writes.empty())
+		vkUpdateDescriptorSets(this->m_Device, (uint32_t) writes.size(), writes.data(), 0, nullptr);
+
+	this->m_Pending.erase(std::remove_if(this->m_Pending.begin(), this->m_Pending.end(),
+		[](const PendingWrite &pending) { return !pending.FrameMask; }), this->m_Pending.end());
+
+}
+
+void BindlessDescriptors::Bind(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout layout, uint32_t setIndex, uint32_t frameIndex) const
+{
+	vkCmdBindDescriptorSets(commandBuffer, bindPoint, layout, setIndex, 1, &this->m_Sets[frameIndex], 0, nullptr);
+}
+
+uint32_t BindlessDescriptors::Allocate(BindlessType type)
+{
+
+	HandleArray &array = this->m_Arrays[(uint32_t) type];
+
+	if (!array.Free.empty())
+	{
+		uint32_t handle = array.Free.back();
+		array.Free.pop_back();
+		return handle;
+	}
+
+	if (array.Used < array.Capacity)
+		return array.Used++;
+
+	LOG_ERROR("Bindless descriptor array {0} is full ({1} handles)!", (uint32_t) type, array.Capacity);
+	return INVALID_HANDLE;
+
+}
+
+void BindlessDescriptors::Enqueue(BindlessType type, uint32_t handle, const VkDescriptorBufferInfo *buffer, const VkDescriptorImageInfo *image)
+{
+
+	PendingWrite pending = {};
+	pending.Type = type;
+	pending.Handle = handle;
+	pending.FrameMask = (1u << (uint32_t) this->m_Sets.size()) - 1;
+
+	if (buffer)
+		pending.Buffer = *buffer;
+
+	if (image)
+		pending.Image = *image;
+
+	this->m_Pending.push_back(pending);
+
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <cstdint>
+
+#include "DeviceCapabilities.h"
+
+// Binding of every descriptor array in the global set, shaders index them with handles
+enum class BindlessType : uint32_t
+{
+	StorageBuffer = 0,
+	SampledImage = 1,
+	Sampler = 2,
+	Count
+};
+
+// One global descriptor set per frame in flight with large update-after-bind arrays of
+// storage buffers, sampled images and samplers (VK_EXT_descriptor_indexing). Resources
+// are registered once and get a stable handle, their index in the array, which shaders
+// receive through push constants. Every pipeline shares the one set layout, so binding
+// the set once per command buffer covers any number of materials.
+// A frame's set is only written at the start of that frame, when the pacer guarantees
+// the GPU finished the last frame using it. Registering and releasing is thread safe.
+class BindlessDescriptors
+{
+
+public:
+	static constexpr uint32_t INVALID_HANDLE = UINT32_MAX;
+
+	// The features Init relies on. Handles come from push constants and are dynamically
+	// uniform, so no non-uniform indexing is needed.
+	static VkPhysicalDeviceDescriptorIndexingFeaturesEXT GetRequiredFeatures();
+	static bool IsSupported(const DeviceCapabilities &caps);
+
+	// The device must have been created with GetRequiredFeatures enabled
+	void Init(VkDevice device, const DeviceCapabilities &caps, uint32_t frameCount);
+	void Shutdown();
+
+	// INVALID_HANDLE once the array is full. The descriptor shows up in every frame's set
+	// starting with the next BeginFrame, so the resource must stay alive until Release.
+	uint32_t AddStorageBuffer(VkBuffer buffer, VkDeviceSize offset = 0, VkDeviceSize range = VK_WHOLE_SIZE);
+	uint32_t AddSampledImage(VkImageView view, VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	uint32_t AddSampler(VkSampler sampler);
+
+	// Points an existing handle at another view, shaders keep using the same handle.
+	// The previous view has to stay alive until every frame set stopped referencing it.
+	void UpdateSampledImage(uint32_t handle, VkImageView view, VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+	// The handle is reused once the frame that last used it (retiredAtFrame) has completed
+	void Release(BindlessType type, uint32_t handle, uint64_t retiredAtFrame);
+
+	// Writes the pending descriptors into the set of frameIndex and recycles released handles
+	void BeginFrame(uint32_t frameIndex, uint64_t completedFrames);
+
+	void Bind(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout layout, uint32_t setIndex, uint32_t frameIndex) const;
+
+	inline VkDescriptorSetLayout GetLayout() const { return m_Layout; }
+	inline uint32_t GetCapacity(BindlessType type) const { return m_Arrays[(uint32_t) type].Capacity; }
+
+private:
+	uint32_t Allocate(BindlessType type);
+	void Enqueue(BindlessType type, uint32_t handle, const VkDescriptorBufferInfo *buffer, const VkDescriptorImageInfo *image);
+
+private:
+	struct HandleArray
+	{
+		uint32_t Capacity = 0;
+		uint32_t Used = 0;
+		std::vector<uint32_t> Free;
+	};
+
+	struct PendingWrite
+	{
+		BindlessType Type;
+		uint32_t Handle;
+		VkDescriptorBufferInfo Buffer;
+		VkDescriptorImageInfo Image;
+
+		// One bit per frame set that still lacks the descriptor
+		uint32_t FrameMask;
+	};
+
+	struct RetiredHandle
+	{
+		BindlessType Type;
+		uint32_t Handle;
+		uint64_t RetiredAtFrame;
+	};
+
+	VkDevice m_Device = VK_NULL_HANDLE;
+	VkDescriptorSetLayout m_Layout = VK_NULL_HANDLE;
+	VkDescriptorPool m_Pool = VK_NULL_HANDLE;
+	std::vector<VkDescriptorSet> m_Sets;
+
+	std::mutex m_Mutex;
+	HandleArray m_Arrays[(uint32_t) BindlessType::Count];
+	std::vector<PendingWrite> m_Pending;
+	std::deque<RetiredHandle> m_Retired;
+
+};
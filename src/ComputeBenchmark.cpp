@@ -0,0 +1,755 @@
+#include "ComputeBenchmark.h"
+#include "ShaderWatcher.h"
+#include "Log.h"
+#include "Timer.h"
+
+#include <algorithm>
+#include <fstream>
+#include <random>
+#include <cstring>
+#include <cmath>
+
+// Covers the deepest scan, counts of 16 digits per group of 16 invocations
+static const uint32_t MAX_BINDINGS = 16;
+
+static const uint32_t RADIX_BITS = 4;
+static const uint32_t RADIX = 1 << RADIX_BITS;
+
+struct SaxpyConstants
+{
+	uint32_t Count;
+	float A;
+};
+
+struct CountConstants
+{
+	uint32_t Count;
+};
+
+struct RadixConstants
+{
+	uint32_t Count;
+	uint32_t Shift;
+};
+
+static std::vector<char> ReadShader(const std::string &name)
+{
+
+	// Compiled on first use when only the GLSL is there
+	std::vector<char> code = ShaderWatcher::LoadOrCompile("assets/shaders", name + ".glsl", "compute");
+	if (code.empty())
+		LOG_ERROR("Failed to load the compute kernel: assets/shaders/{0}.spv", name);
+
+	return code;
+
+}
+
+double KernelResult::GetGigabytesPerSecond() const
+{
+
+	if (this->Millis.Mean <= 0.0)
+		return 0.0;
+
+	return this->BytesPerIteration / (this->Millis.Mean * 1e6);
+
+}
+
+double KernelResult::GetElementsPerSecond() const
+{
+
+	if (this->Millis.Mean <= 0.0)
+		return 0.0;
+
+	return this->Elements / (this->Millis.Mean / 1000.0);
+
+}
+
+bool ComputeBenchmark::Init(VkDevice device, const DeviceCapabilities &caps, MemoryAllocator &allocator, VkPipelineCache pipelineCache,
+	VkQueue queue, uint32_t queueFamily)
+{
+
+	this->m_Device = device;
+	this->m_Allocator = &allocator;
+	this->m_Queue = queue;
+
+	// The largest power of two up to 256 the device allows. Every device has at least 128,
+	// the radix kernels need one invocation per digit.
+	const VkPhysicalDeviceLimits &limits = caps.Properties.limits;
+	uint32_t maxGroupSize = std::min({ 256u, limits.maxComputeWorkGroupSize[0], limits.maxComputeWorkGroupInvocations });
+
+	this->m_GroupSize = RADIX;
+	while (this->m_GroupSize * 2 <= maxGroupSize)
+		this->m_GroupSize *= 2;
+
+	this->m_MaxGroupCount = limits.maxComputeWorkGroupCount[0];
+	this->m_TimestampValidBits = caps.QueueFamilyProperties[queueFamily].timestampValidBits;
+	this->m_TimestampPeriod = limits.timestampPeriod;
+
+	bool built = ComputePipelineBuilder(device, "saxpy")
+		.SetShader(ReadShader("saxpy"))
+		.AddStorageBuffer(BufferAccess::Read)
+		.AddStorageBuffer(BufferAccess::ReadWrite)
+		.SetPushConstantSize(sizeof(SaxpyConstants))
+		.SetGroupSize(this->m_GroupSize)
+		.Build(pipelineCache, this->m_Saxpy);
+
+	built = built && ComputePipelineBuilder(device, "reduce")
+		.SetShader(ReadShader("reduce"))
+		.AddStorageBuffer(BufferAccess::Read)
+		.AddStorageBuffer(BufferAccess::Write)
+		.SetPushConstantSize(sizeof(CountConstants))
+		.SetGroupSize(this->m_GroupSize)
+		.SetMaxBindings(MAX_BINDINGS)
+		.Build(pipelineCache, this->m_Reduce);
+
+	built = built && ComputePipelineBuilder(device, "scan")
+		.SetShader(ReadShader("scan"))
+		.AddStorageBuffer(BufferAccess::Read)
+		.AddStorageBuffer(BufferAccess::Write)
+		.AddStorageBuffer(BufferAccess::Write)
+		.SetPushConstantSize(sizeof(CountConstants))
+		.SetGroupSize(this->m_GroupSize)
+		.SetMaxBindings(MAX_BINDINGS)
+		.Build(pipelineCache, this->m_Scan);
+
+	built = built && ComputePipelineBuilder(device, "scan add")
+		.SetShader(ReadShader("scan_add"))
+		.AddStorageBuffer(BufferAccess::ReadWrite)
+		.AddStorageBuffer(BufferAccess::Read)
+		.SetPushConstantSize(sizeof(CountConstants))
+		.SetGroupSize(this->m_GroupSize)
+		.SetMaxBindings(MAX_BINDINGS)
+		.Build(pipelineCache, this->m_ScanAdd);
+
+	built = built && ComputePipelineBuilder(device, "radix histogram")
+		.SetShader(ReadShader("radix_histogram"))
+		.AddStorageBuffer(BufferAccess::Read)
+		.AddStorageBuffer(BufferAccess::Write)
+		.SetPushConstantSize(sizeof(RadixConstants))
+		.SetGroupSize(this->m_GroupSize)
+		.SetMaxBindings(2)
+		.Build(pipelineCache, this->m_RadixHistogram);
+
+	built = built && ComputePipelineBuilder(device, "radix scatter")
+		.SetShader(ReadShader("radix_scatter"))
+		.AddStorageBuffer(BufferAccess::Read)
+		.AddStorageBuffer(BufferAccess::Read)
+		.AddStorageBuffer(BufferAccess::Write)
+		.SetPushConstantSize(sizeof(RadixConstants))
+		.SetGroupSize(this->m_GroupSize)
+		.SetMaxBindings(2)
+		.Build(pipelineCache, this->m_RadixScatter);
+
+	if (!built)
+	{
+		this->Shutdown();
+		return false;
+	}
+
+	VkCommandPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.queueFamilyIndex = queueFamily;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+	if (vkCreateCommandPool(device, &poolInfo, nullptr, this->m_CommandPool.Replace(device)) != VK_SUCCESS)
+	{
+		LOG_VK_CRITICAL("Failed to create the compute benchmark command pool!");
+		exit(-1);
+	}
+
+	VkCommandBufferAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.commandPool = this->m_CommandPool;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandBufferCount = 1;
+
+	if (vkAllocateCommandBuffers(device, &allocInfo, &this->m_CommandBuffer) != VK_SUCCESS)
+	{
+		LOG_VK_CRITICAL("Failed to allocate the compute benchmark command buffer!");
+		exit(-1);
+	}
+
+	VkFenceCreateInfo fenceInfo = {};
+	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+	if (vkCreateFence(device, &fenceInfo, nullptr, this->m_Fence.Replace(device)) != VK_SUCCESS)
+	{
+		LOG_VK_CRITICAL("Failed to create the compute benchmark fence!");
+		exit(-1);
+	}
+
+	return true;
+
+}
+
+void ComputeBenchmark::Shutdown()
+{
+
+	this->m_QueryPool.Reset();
+	this->m_QueryCount = 0;
+	this->m_Fence.Reset();
+
+	// Frees the command buffer as well
+	this->m_CommandPool.Reset();
+	this->m_CommandBuffer = VK_NULL_HANDLE;
+
+	this->m_Saxpy = ComputePipeline();
+	this->m_Reduce = ComputePipeline();
+	this->m_Scan = ComputePipeline();
+	this->m_ScanAdd = ComputePipeline();
+	this->m_RadixHistogram = ComputePipeline();
+	this->m_RadixScatter = ComputePipeline();
+
+}
+
+bool ComputeBenchmark::Run(uint32_t elementCount, uint32_t iterations)
+{
+
+	// One invocation per element along x, the grid is as wide as it gets
+	uint32_t maxElements = (uint32_t) std::min<uint64_t>((uint64_t) this->m_MaxGroupCount * this->m_GroupSize, UINT32_MAX / RADIX);
+	if (elementCount > maxElements)
+	{
+		LOG_WARNING("Compute benchmark limited to {0} elements by the dispatch size", maxElements);
+		elementCount = maxElements;
+	}
+
+	elementCount = std::max(elementCount, 1u);
+	iterations = std::max(iterations, 1u);
+
+	LOG_INFO("Running compute benchmark: {0} elements, {1} iterations, groups of {2}, {3}",
+		elementCount, iterations, this->m_GroupSize, this->m_TimestampValidBits ? "GPU timestamps" : "CPU timing");
+
+	this->m_Results.clear();
+	this->BenchmarkSaxpy(elementCount, iterations);
+	this->BenchmarkReduce(elementCount, iterations);
+	this->BenchmarkScan(elementCount, iterations);
+	this->BenchmarkRadixSort(elementCount, iterations);
+
+	return std::all_of(this->m_Results.begin(), this->m_Results.end(), [](const KernelResult &result) { return result.Verified; });
+
+}
+
+void ComputeBenchmark::BenchmarkSaxpy(uint32_t elementCount, uint32_t iterations)
+{
+
+	// Small integers stay exact in floats for a good number of iterations
+	std::mt19937 random(1);
+	std::uniform_int_distribution<int> distribution(0, 999);
+
+	std::vector<float> x(elementCount), y(elementCount);
+	for (uint32_t i = 0; i < elementCount; ++i)
+	{
+		x[i] = (float) distribution(random);
+		y[i] = (float) distribution(random);
+	}
+
+	VkDeviceSize bytes = sizeof(float) * elementCount;
+	UniqueBuffer hostX = this->CreateBuffer(bytes, true);
+	UniqueBuffer hostY = this->CreateBuffer(bytes, true);
+	UniqueBuffer deviceX = this->CreateBuffer(bytes, false);
+	UniqueBuffer deviceY = this->CreateBuffer(bytes, false);
+
+	std::memcpy(hostX.GetMemory().MappedData, x.data(), bytes);
+	std::memcpy(hostY.GetMemory().MappedData, y.data(), bytes);
+
+	this->m_Saxpy.ResetBindings();
+	ComputeBindings bindings = this->m_Saxpy.CreateBindings({ deviceX, deviceY });
+	SaxpyConstants constants = { elementCount, 2.0f };
+
+	std::vector<double> millis = this->Measure(iterations,
+		[&](ComputeCommands &commands)
+		{
+			commands.CopyBuffer(hostX, deviceX, bytes);
+			commands.CopyBuffer(hostY, deviceY, bytes);
+		},
+		nullptr,
+		[&](ComputeCommands &commands) { commands.DispatchElements(bindings, constants, elementCount); },
+		[&](ComputeCommands &commands)
+		{
+			commands.CopyBuffer(deviceY, hostY, bytes);
+			commands.MakeVisible(VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT);
+		});
+
+	// Y accumulates over the warm-up and every measured iteration
+	const float *result = static_cast<const float *>(hostY.GetMemory().MappedData);
+	bool verified = true;
+
+	for (uint32_t i = 0; i < elementCount && verified; ++i)
+	{
+		float expected = y[i];
+		for (uint32_t n = 0; n <= iterations; ++n)
+			expected = constants.A * x[i] + expected;
+
+		verified = std::abs(result[i] - expected) <= 1e-5f * std::max(1.0f, std::abs(expected));
+	}
+
+	// Reads X and Y, writes Y
+	this->AddResult("saxpy", elementCount, 3 * bytes, std::move(millis), verified);
+
+}
+
+void ComputeBenchmark::BenchmarkReduce(uint32_t elementCount, uint32_t iterations)
+{
+
+	std::mt19937 random(2);
+	std::uniform_int_distribution<uint32_t> distribution(0, 999);
+
+	std::vector<uint32_t> values(elementCount);
+	uint32_t expected = 0;
+
+	for (uint32_t &value : values)
+	{
+		value = distribution(random);
+		expected += value;
+	}
+
+	VkDeviceSize bytes = sizeof(uint32_t) * elementCount;
+	VkDeviceSize partialBytes = sizeof(uint32_t) * ((elementCount + this->m_GroupSize * 2 - 1) / (this->m_GroupSize * 2));
+
+	UniqueBuffer host = this->CreateBuffer(bytes, true);
+	UniqueBuffer input = this->CreateBuffer(bytes, false);
+	UniqueBuffer partials[2] = { this->CreateBuffer(partialBytes, false), this->CreateBuffer(partialBytes, false) };
+	std::memcpy(host.GetMemory().MappedData, values.data(), bytes);
+
+	// Every pass sums two group sizes of elements into one,
+	// alternating between the partial buffers until one element is left
+	struct ReducePass
+	{
+		ComputeBindings Bindings;
+		uint32_t Count;
+		uint32_t Groups;
+	};
+
+	this->m_Reduce.ResetBindings();
+
+	std::vector<ReducePass> passes;
+	VkBuffer source = input;
+	uint32_t count = elementCount;
+
+	do
+	{
+		uint32_t groups = (count + this->m_GroupSize * 2 - 1) / (this->m_GroupSize * 2);
+		VkBuffer destination = partials[passes.size() % 2];
+
+		passes.push_back({ this->m_Reduce.CreateBindings({ source, destination }), count, groups });
+		source = destination;
+		count = groups;
+	} while (count > 1);
+
+	std::vector<double> millis = this->Measure(iterations,
+		[&](ComputeCommands &commands) { commands.CopyBuffer(host, input, bytes); },
+		nullptr,
+		[&](ComputeCommands &commands)
+		{
+			for (const ReducePass &pass : passes)
+				commands.Dispatch(pass.Bindings, CountConstants{ pass.Count }, pass.Groups);
+		},
+		[&](ComputeCommands &commands)
+		{
+			commands.CopyBuffer(source, host, sizeof(uint32_t));
+			commands.MakeVisible(VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT);
+		});
+
+	uint32_t result = *static_cast<const uint32_t *>(host.GetMemory().MappedData);
+	this->AddResult("reduce", elementCount, bytes, std::move(millis), result == expected);
+
+}
+
+void ComputeBenchmark::BenchmarkScan(uint32_t elementCount, uint32_t iterations)
+{
+
+	std::mt19937 random(3);
+	std::uniform_int_distribution<uint32_t> distribution(0, 999);
+
+	std::vector<uint32_t> values(elementCount);
+	for (uint32_t &value : values)
+		value = distribution(random);
+
+	VkDeviceSize bytes = sizeof(uint32_t) * elementCount;
+	UniqueBuffer host = this->CreateBuffer(bytes, true);
+	UniqueBuffer input = this->CreateBuffer(bytes, false);
+	UniqueBuffer output = this->CreateBuffer(bytes, false);
+	std::memcpy(host.GetMemory().MappedData, values.data(), bytes);
+
+	this->m_Scan.ResetBindings();
+	this->m_ScanAdd.ResetBindings();
+	std::vector<ScanLevel> levels = this->CreateScan(input, output, elementCount);
+
+	std::vector<double> millis = this->Measure(iterations,
+		[&](ComputeCommands &commands) { commands.CopyBuffer(host, input, bytes); },
+		nullptr,
+		[&](ComputeCommands &commands) { this->RecordScan(commands, levels); },
+		[&](ComputeCommands &commands)
+		{
+			commands.CopyBuffer(output, host, bytes);
+			commands.MakeVisible(VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT);
+		});
+
+	const uint32_t *result = static_cast<const uint32_t *>(host.GetMemory().MappedData);
+	bool verified = true;
+	uint32_t sum = 0;
+
+	for (uint32_t i = 0; i < elementCount && verified; ++i)
+	{
+		verified = result[i] == sum;
+		sum += values[i];
+	}
+
+	// Reads the input, writes the output
+	this->AddResult("scan", elementCount, 2 * bytes, std::move(millis), verified);
+
+}
+
+void ComputeBenchmark::BenchmarkRadixSort(uint32_t elementCount, uint32_t iterations)
+{
+
+	std::mt19937 random(4);
+	std::vector<uint32_t> keys(elementCount);
+	for (uint32_t &key : keys)
+		key = random();
+
+	VkDeviceSize bytes = sizeof(uint32_t) * elementCount;
+	uint32_t groups = this->GetGroupCount(elementCount);
+	VkDeviceSize countBytes = sizeof(uint32_t) * RADIX * groups;
+
+	// Sorting happens in place, every iteration starts over from the unsorted keys
+	UniqueBuffer host = this->CreateBuffer(bytes, true);
+	UniqueBuffer unsorted = this->CreateBuffer(bytes, false);
+	UniqueBuffer keysA = this->CreateBuffer(bytes, false);
+	UniqueBuffer keysB = this->CreateBuffer(bytes, false);
+	UniqueBuffer counts = this->CreateBuffer(countBytes, false);
+	UniqueBuffer offsets = this->CreateBuffer(countBytes, false);
+	std::memcpy(host.GetMemory().MappedData, keys.data(), bytes);
+
+	this->m_RadixHistogram.ResetBindings();
+	this->m_RadixScatter.ResetBindings();
+	this->m_Scan.ResetBindings();
+	this->m_ScanAdd.ResetBindings();
+
+	// Indexed by the buffer the pass reads, an even number of passes ends up in A again
+	ComputeBindings histogram[2] = {
+		this->m_RadixHistogram.CreateBindings({ keysA, counts }),
+		this->m_RadixHistogram.CreateBindings({ keysB, counts })
+	};
+
+	ComputeBindings scatter[2] = {
+		this->m_RadixScatter.CreateBindings({ keysA, offsets, keysB }),
+		this->m_RadixScatter.CreateBindings({ keysB, offsets, keysA })
+	};
+
+	std::vector<ScanLevel> scan = this->CreateScan(counts, offsets, RADIX * groups);
+	uint32_t passCount = 32 / RADIX_BITS;
+
+	std::vector<double> millis = this->Measure(iterations,
+		[&](ComputeCommands &commands) { commands.CopyBuffer(host, unsorted, bytes); },
+		[&](ComputeCommands &commands) { commands.CopyBuffer(unsorted, keysA, bytes); },
+		[&](ComputeCommands &commands)
+		{
+			for (uint32_t pass = 0; pass < passCount; ++pass)
+			{
+				RadixConstants constants = { elementCount, pass * RADIX_BITS };
+
+				commands.Dispatch(histogram[pass % 2], constants, groups);
+				this->RecordScan(commands, scan);
+				commands.Dispatch(scatter[pass % 2], constants, groups);
+			}
+		},
+		[&](ComputeCommands &commands)
+		{
+			commands.CopyBuffer(keysA, host, bytes);
+			commands.MakeVisible(VK_PIPELINE_STAGE_HOST_BIT, VK_ACCESS_HOST_READ_BIT);
+		});
+
+	std::sort(keys.begin(), keys.end());
+	bool verified = std::memcmp(host.GetMemory().MappedData, keys.data(), bytes) == 0;
+
+	// Every pass reads the keys for the histogram, then reads and writes them to scatter
+	this->AddResult("radix_sort", elementCount, 3 * bytes * passCount, std::move(millis), verified);
+
+}
+
+std::vector<double> ComputeBenchmark::Measure(uint32_t iterations, const RecordFunction &prepare, const RecordFunction &reset,
+	const RecordFunction &iteration, const RecordFunction &finish)
+{
+
+	// The first iteration warms up caches and lazily initialized driver state
+	uint32_t total = iterations + 1;
+	bool timestamps = this->m_TimestampValidBits > 0;
+
+	if (timestamps && this->m_QueryCount < total * 2)
+	{
+		VkQueryPoolCreateInfo queryInfo = {};
+		queryInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		queryInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		queryInfo.queryCount = total * 2;
+
+		if (vkCreateQueryPool(this->m_Device, &queryInfo, nullptr, this->m_QueryPool.Replace(this->m_Device)) != VK_SUCCESS)
+		{
+			LOG_VK_CRITICAL("Failed to create the compute benchmark query pool!");
+			exit(-1);
+		}
+
+		this->m_QueryCount = total * 2;
+	}
+
+	VkCommandBuffer commandBuffer = this->m_CommandBuffer;
+	vkResetCommandBuffer(commandBuffer, 0);
+
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+	{
+		LOG_CRITICAL("Failed to begin recording the compute benchmark!");
+		exit(-1);
+	}
+
+	if (timestamps)
+		vkCmdResetQueryPool(commandBuffer, this->m_QueryPool, 0, total * 2);
+
+	ComputeCommands commands(commandBuffer);
+	prepare(commands);
+
+	// Bottom of pipe on both ends, the start is written once the reset completed and the first
+	// dispatch waits for the reset through its barrier, so the iteration is all that is measured
+	for (uint32_t i = 0; i < total; ++i)
+	{
+		if (reset)
+			reset(commands);
+
+		if (timestamps)
+			vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, this->m_QueryPool, i * 2);
+
+		iteration(commands);
+
+		if (timestamps)
+			vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, this->m_QueryPool, i * 2 + 1);
+	}
+
+	finish(commands);
+
+	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+	{
+		LOG_CRITICAL("Failed to record the compute benchmark!");
+		exit(-1);
+	}
+
+	VkSubmitInfo submitInfo = {};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &commandBuffer;
+
+	util::Timer timer;
+	if (vkQueueSubmit(this->m_Queue, 1, &submitInfo, this->m_Fence) != VK_SUCCESS)
+	{
+		LOG_VK_CRITICAL("Failed to submit the compute benchmark!");
+		exit(-1);
+	}
+
+	vkWaitForFences(this->m_Device, 1, this->m_Fence.GetAddress(), VK_TRUE, UINT64_MAX);
+	vkResetFences(this->m_Device, 1, this->m_Fence.GetAddress());
+	double submitMillis = timer.ElapsedMillis();
+
+	if (!timestamps)
+		return std::vector<double>(iterations, submitMillis / total);
+
+	std::vector<uint64_t> ticks(total * 2);
+	vkGetQueryPoolResults(this->m_Device, this->m_QueryPool, 0, total * 2, ticks.size() * sizeof(uint64_t), ticks.data(),
+		sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+
+	uint64_t mask = this->m_TimestampValidBits >= 64 ? ~0ull : (1ull << this->m_TimestampValidBits) - 1;
+
+	std::vector<double> millis;
+	millis.reserve(iterations);
+
+	for (uint32_t i = 1; i < total; ++i)
+		millis.push_back(((ticks[i * 2 + 1] - ticks[i * 2]) & mask) * (double) this->m_TimestampPeriod / 1e6);
+
+	return millis;
+
+}
+
+std::vector<ComputeBenchmark::ScanLevel> ComputeBenchmark::CreateScan(VkBuffer input, VkBuffer output, uint32_t count)
+{
+
+	// Each level scans the block sums of the one before, until a single block is left
+	std::vector<ScanLevel> levels;
+
+	while (true)
+	{
+		ScanLevel level;
+		level.Count = count;
+		level.Blocks = this->GetGroupCount(count);
+		level.Sums = this->CreateBuffer(sizeof(uint32_t) * level.Blocks, false);
+		level.Scan = this->m_Scan.CreateBindings({ input, output, level.Sums });
+
+		if (level.Blocks > 1)
+		{
+			level.Offsets = this->CreateBuffer(sizeof(uint32_t) * level.Blocks, false);
+			level.Add = this->m_ScanAdd.CreateBindings({ output, level.Offsets });
+		}
+
+		input = level.Sums;
+		output = level.Offsets;
+		count = level.Blocks;
+
+		levels.push_back(std::move(level));
+		if (count == 1)
+			return levels;
+	}
+
+}
+
+void ComputeBenchmark::RecordScan(ComputeCommands &commands, const std::vector<ScanLevel> &levels) const
+{
+
+	for (const ScanLevel &level : levels)
+		commands.Dispatch(level.Scan, CountConstants{ level.Count }, level.Blocks);
+
+	for (auto level = levels.rbegin(); level != levels.rend(); ++level)
+	{
+		if (level->Blocks > 1)
+			commands.Dispatch(level->Add, CountConstants{ level->Count }, level->Blocks);
+	}
+
+}
+
+UniqueBuffer ComputeBenchmark::CreateBuffer(VkDeviceSize size, bool hostVisible)
+{
+
+	VkBufferCreateInfo bufferInfo = {};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = size;
+	bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	AllocationCreateInfo allocInfo = {};
+	if (hostVisible)
+	{
+		allocInfo.RequiredFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+		allocInfo.Category = MemoryCategory::Staging;
+	}
+	else
+		allocInfo.PreferredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+	VkBuffer buffer = VK_NULL_HANDLE;
+	MemoryAllocation memory;
+
+	if (this->m_Allocator->CreateBuffer(bufferInfo, allocInfo, buffer, memory) != VK_SUCCESS)
+	{
+		LOG_VK_CRITICAL("Failed to create compute benchmark buffer!");
+		exit(-1);
+	}
+
+	return UniqueBuffer(*this->m_Allocator, buffer, memory);
+
+}
+
+void ComputeBenchmark::AddResult(const std::string &name, uint32_t elements, uint64_t bytes, std::vector<double> millis, bool verified)
+{
+
+	KernelResult result;
+	result.Name = name;
+	result.Elements = elements;
+	result.BytesPerIteration = bytes;
+	result.Millis = FrameBenchmark::ComputeStatistics(std::move(millis));
+	result.Verified = verified;
+
+	if (!verified)
+		LOG_ERROR("Compute kernel {0} produced a wrong result!", name);
+
+	this->m_Results.push_back(result);
+
+}
+
+bool ComputeBenchmark::WriteReport(const std::string &path, const std::string &deviceName) const
+{
+
+	std::ofstream file(path);
+	if (!file.is_open())
+	{
+		LOG_ERROR("Failed to write the compute benchmark report: {0}", path);
+		return false;
+	}
+
+	const char *timing = this->m_TimestampValidBits ? "gpu_timestamps" : "cpu";
+
+	if (IsJsonReport(path))
+	{
+		file << "{\n";
+		file << "\t\"device\": \"" << EscapeJson(deviceName) << "\",\n";
+		file << "\t\"group_size\": " << this->m_GroupSize << ",\n";
+		file << "\t\"timing\": \"" << timing << "\",\n";
+		file << "\t\"kernels\": [\n";
+
+		for (size_t i = 0; i < this->m_Results.size(); ++i)
+		{
+			const KernelResult &result = this->m_Results[i];
+			file << "\t\t{ "
+				<< "\"name\": \"" << result.Name << "\", "
+				<< "\"elements\": " << result.Elements << ", "
+				<< "\"bytes_per_iteration\": " << result.BytesPerIteration << ", "
+				<< "\"verified\": " << (result.Verified ? "true" : "false") << ", "
+				<< "\"gb_per_s\": " << result.GetGigabytesPerSecond() << ", "
+				<< "\"elements_per_s\": " << result.GetElementsPerSecond() << ", "
+				<< "\"ms\": { "
+				<< "\"min\": " << result.Millis.Min << ", "
+				<< "\"mean\": " << result.Millis.Mean << ", "
+				<< "\"p50\": " << result.Millis.P50 << ", "
+				<< "\"p95\": " << result.Millis.P95 << ", "
+				<< "\"p99\": " << result.Millis.P99 << ", "
+				<< "\"max\": " << result.Millis.Max << " } }"
+				<< (i + 1 < this->m_Results.size() ? ",\n" : "\n");
+		}
+
+		file << "\t]\n";
+		file << "}\n";
+	}
+	else
+	{
+		// Same as the frame benchmark, the configuration is repeated on every row
+		file << "device,group_size,timing,kernel,elements,bytes_per_iteration,verified,gb_per_s,elements_per_s,min_ms,mean_ms,p50_ms,p95_ms,p99_ms,max_ms\n";
+
+		for (const KernelResult &result : this->m_Results)
+		{
+			file << QuoteCsv(deviceName) << ','
+				<< this->m_GroupSize << ','
+				<< timing << ','
+				<< result.Name << ','
+				<< result.Elements << ','
+				<< result.BytesPerIteration << ','
+				<< (result.Verified ? 1 : 0) << ','
+				<< result.GetGigabytesPerSecond() << ','
+				<< result.GetElementsPerSecond() << ','
+				<< result.Millis.Min << ','
+				<< result.Millis.Mean << ','
+				<< result.Millis.P50 << ','
+				<< result.Millis.P95 << ','
+				<< result.Millis.P99 << ','
+				<< result.Millis.Max << '\n';
+		}
+	}
+
+	if (!file.good())
+	{
+		LOG_ERROR("Failed to write the compute benchmark report: {0}", path);
+		return false;
+	}
+
+	LOG_INFO("Wrote compute benchmark report to {0}", path);
+	return true;
+
+}
+
+void ComputeBenchmark::LogSummary() const
+{
+
+	for (const KernelResult &result : this->m_Results)
+	{
+		LOG_INFO("\t{0:<10} {1:>8.2f} GB/s {2:>10.1f} M elements/s mean {3:.3f}ms p50 {4:.3f}ms p95 {5:.3f}ms{6}",
+			result.Name, result.GetGigabytesPerSecond(), result.GetElementsPerSecond() / 1e6,
+			result.Millis.Mean, result.Millis.P50, result.Millis.P95, result.Verified ? "" : " (wrong result)");
+	}
+
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <string>
+#include <functional>
+#include <cstdint>
+
+#include "Benchmark.h"
+#include "MemoryAllocator.h"
+#include "DeviceCapabilities.h"
+#include "ComputePipeline.h"
+#include "ComputeCommands.h"
+#include "VulkanHandle.h"
+
+// Throughput of one kernel. Bytes count the element traffic the kernel needs at the
+// least, so GB/s compares against the memory bandwidth of the device.
+struct KernelResult
+{
+	std::string Name;
+	uint32_t Elements = 0;
+	uint64_t BytesPerIteration = 0;
+	BenchmarkStatistics Millis;
+	bool Verified = false;
+
+	double GetGigabytesPerSecond() const;
+	double GetElementsPerSecond() const;
+};
+
+// GPGPU suite on 32-bit elements: a SAXPY bandwidth test, a parallel reduction, an
+// exclusive prefix scan and a 4 bit LSD radix sort. Each kernel is recorded with one
+// warm-up and the measured iterations into a single submission, timed by timestamp
+// queries between iterations (the whole submission on the CPU when the queue has no
+// timestamps), and its result is compared against the CPU afterwards.
+class ComputeBenchmark
+{
+
+public:
+	// Returns false when a kernel is missing, assets/shaders/*.spv are compiled with glslc when absent
+	bool Init(VkDevice device, const DeviceCapabilities &caps, MemoryAllocator &allocator, VkPipelineCache pipelineCache,
+		VkQueue queue, uint32_t queueFamily);
+
+	// The device must be idle
+	void Shutdown();
+
+	// Returns false when a kernel produced a wrong result
+	bool Run(uint32_t elementCount, uint32_t iterations);
+
+	bool WriteReport(const std::string &path, const std::string &deviceName) const;
+	void LogSummary() const;
+
+private:
+	using RecordFunction = std::function<void(ComputeCommands &commands)>;
+
+	// Exclusive scan of Count elements, one level per pass over the block sums
+	struct ScanLevel
+	{
+		uint32_t Count = 0;
+		uint32_t Blocks = 0;
+		UniqueBuffer Sums;
+		UniqueBuffer Offsets;
+		ComputeBindings Scan;
+		ComputeBindings Add;
+	};
+
+	void BenchmarkSaxpy(uint32_t elementCount, uint32_t iterations);
+	void BenchmarkReduce(uint32_t elementCount, uint32_t iterations);
+	void BenchmarkScan(uint32_t elementCount, uint32_t iterations);
+	void BenchmarkRadixSort(uint32_t elementCount, uint32_t iterations);
+
+	// Records prepare, then per iteration reset and the timed iteration, then finish, and
+	// waits for the result. Returns the milliseconds of every measured iteration.
+	std::vector<double> Measure(uint32_t iterations, const RecordFunction &prepare, const RecordFunction &reset,
+		const RecordFunction &iteration, const RecordFunction &finish);
+
+	std::vector<ScanLevel> CreateScan(VkBuffer input, VkBuffer output, uint32_t count);
+	void RecordScan(ComputeCommands &commands, const std::vector<ScanLevel> &levels) const;
+
+	UniqueBuffer CreateBuffer(VkDeviceSize size, bool hostVisible);
+	inline uint32_t GetGroupCount(uint32_t elements) const { return (elements + this->m_GroupSize - 1) / this->m_GroupSize; }
+
+	void AddResult(const std::string &name, uint32_t elements, uint64_t bytes, std::vector<double> millis, bool verified);
+
+private:
+	VkDevice m_Device = VK_NULL_HANDLE;
+	MemoryAllocator *m_Allocator = nullptr;
+	VkQueue m_Queue = VK_NULL_HANDLE;
+
+	uint32_t m_GroupSize = 0;
+	uint32_t m_MaxGroupCount = 0;
+
+	// Zero when the queue has no timestamps
+	uint32_t m_TimestampValidBits = 0;
+	float m_TimestampPeriod = 1.0f;
+
+	ComputePipeline m_Saxpy;
+	ComputePipeline m_Reduce;
+	ComputePipeline m_Scan;
+	ComputePipeline m_ScanAdd;
+	ComputePipeline m_RadixHistogram;
+	ComputePipeline m_RadixScatter;
+
+	UniqueCommandPool m_CommandPool;
+	VkCommandBuffer m_CommandBuffer = VK_NULL_HANDLE;
+	UniqueFence m_Fence;
+	UniqueQueryPool m_QueryPool;
+	uint32_t m_QueryCount = 0;
+
+	std::vector<KernelResult> m_Results;
+
+};
@@ -0,0 +1,151 @@
+#include "ComputeCommands.h"
+
+ComputeCommands::ComputeCommands(VkCommandBuffer commandBuffer)
+	: m_CommandBuffer(commandBuffer)
+{
+}
+
+void ComputeCommands::Dispatch(const ComputeBindings &bindings, const void *pushConstants, uint32_t groupCountX, uint32_t groupCountY, uint32_t groupCountZ)
+{
+
+	const ComputePipeline &pipeline = *bindings.Pipeline;
+	const std::vector<BufferAccess> &accesses = pipeline.GetBufferAccesses();
+
+	for (size_t i = 0; i < bindings.Buffers.size(); ++i)
+	{
+		switch (accesses[i])
+		{
+		case BufferAccess::Read:
+			this->Use(bindings.Buffers[i], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, false);
+			break;
+		case BufferAccess::Write:
+			this->Use(bindings.Buffers[i], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT, true);
+			break;
+		case BufferAccess::ReadWrite:
+			this->Use(bindings.Buffers[i], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, true);
+			break;
+		}
+	}
+
+	this->FlushBarriers();
+
+	if (this->m_BoundPipeline != pipeline.GetHandle())
+	{
+		vkCmdBindPipeline(this->m_CommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.GetHandle());
+		this->m_BoundPipeline = pipeline.GetHandle();
+	}
+
+	vkCmdBindDescriptorSets(this->m_CommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.GetLayout(), 0, 1, &bindings.DescriptorSet, 0, nullptr);
+
+	if (pushConstants && pipeline.GetPushConstantSize() > 0)
+		vkCmdPushConstants(this->m_CommandBuffer, pipeline.GetLayout(), VK_SHADER_STAGE_COMPUTE_BIT, 0, pipeline.GetPushConstantSize(), pushConstants);
+
+	vkCmdDispatch(this->m_CommandBuffer, groupCountX, groupCountY, groupCountZ);
+
+}
+
+void ComputeCommands::CopyBuffer(VkBuffer source, VkBuffer destination, VkDeviceSize size)
+{
+
+	this->Use(source, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, false);
+	this->Use(destination, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, true);
+	this->FlushBarriers();
+
+	VkBufferCopy region = {};
+	region.size = size;
+	vkCmdCopyBuffer(this->m_CommandBuffer, source, destination, 1, &region);
+
+}
+
+void ComputeCommands::FillBuffer(VkBuffer buffer, uint32_t value, VkDeviceSize size)
+{
+
+	this->Use(buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, true);
+	this->FlushBarriers();
+
+	vkCmdFillBuffer(this->m_CommandBuffer, buffer, 0, size, value);
+
+}
+
+void ComputeCommands::MakeVisible(VkPipelineStageFlags stages, VkAccessFlags access)
+{
+
+	for (auto &entry : this->m_Buffers)
+	{
+		if (entry.second.WriteAccess)
+			this->Use(entry.first, stages, access, false);
+	}
+
+	this->FlushBarriers();
+
+}
+
+void ComputeCommands::Use(VkBuffer buffer, VkPipelineStageFlags stage, VkAccessFlags access, bool write)
+{
+
+	BufferState &state = this->m_Buffers[buffer];
+
+	VkPipelineStageFlags sourceStages = 0;
+	VkAccessFlags sourceAccess = 0;
+
+	if (write)
+	{
+		// Writes wait for everything before them, an execution dependency is enough for the reads
+		sourceStages = state.ReadStages | state.WriteStages;
+		sourceAccess = state.WriteAccess;
+	}
+	else if (state.WriteAccess && ((state.VisibleStages & stage) != stage || (state.VisibleAccess & access) != access))
+	{
+		sourceStages = state.WriteStages;
+		sourceAccess = state.WriteAccess;
+	}
+
+	if (sourceStages)
+	{
+		VkBufferMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barrier.srcAccessMask = sourceAccess;
+		barrier.dstAccessMask = access;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.buffer = buffer;
+		barrier.offset = 0;
+		barrier.size = VK_WHOLE_SIZE;
+
+		this->m_PendingBarriers.push_back(barrier);
+		this->m_PendingSourceStages |= sourceStages;
+		this->m_PendingDestinationStages |= stage;
+	}
+
+	if (write)
+	{
+		state.WriteStages = stage;
+		state.WriteAccess = access & (VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT);
+		state.VisibleStages = 0;
+		state.VisibleAccess = 0;
+		state.ReadStages = 0;
+	}
+	else
+	{
+		state.VisibleStages |= stage;
+		state.VisibleAccess |= access;
+		state.ReadStages |= stage;
+	}
+
+}
+
+void ComputeCommands::FlushBarriers()
+{
+
+	if (this->m_PendingBarriers.empty())
+		return;
+
+	vkCmdPipelineBarrier(this->m_CommandBuffer, this->m_PendingSourceStages, this->m_PendingDestinationStages, 0,
+		0, nullptr, (uint32_t) this->m_PendingBarriers.size(), this->m_PendingBarriers.data(), 0, nullptr);
+
+	this->m_BarrierCount += (uint32_t) this->m_PendingBarriers.size();
+	this->m_PendingBarriers.clear();
+	this->m_PendingSourceStages = 0;
+	this->m_PendingDestinationStages = 0;
+
+}
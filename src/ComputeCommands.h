@@ -0,0 +1,75 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+#include "ComputePipeline.h"
+
+// Records dispatches, copies and fills into one command buffer and puts the buffer
+// barriers between them that the declared accesses call for: reads wait for earlier
+// writes, writes wait for earlier reads and writes, reads after reads do not wait.
+// Whole buffers are tracked, buffers are assumed ready when first used in the
+// command buffer.
+class ComputeCommands
+{
+
+public:
+	ComputeCommands(VkCommandBuffer commandBuffer);
+
+	// pushConstants holds GetPushConstantSize bytes of the pipeline, null without any
+	void Dispatch(const ComputeBindings &bindings, const void *pushConstants, uint32_t groupCountX, uint32_t groupCountY = 1, uint32_t groupCountZ = 1);
+
+	template<typename T>
+	void Dispatch(const ComputeBindings &bindings, const T &pushConstants, uint32_t groupCountX, uint32_t groupCountY = 1, uint32_t groupCountZ = 1)
+	{
+		this->Dispatch(bindings, static_cast<const void *>(&pushConstants), groupCountX, groupCountY, groupCountZ);
+	}
+
+	// Enough groups of the pipeline's group size for one invocation per element
+	template<typename T>
+	void DispatchElements(const ComputeBindings &bindings, const T &pushConstants, uint32_t elementCount)
+	{
+		uint32_t groupSize = bindings.Pipeline->GetGroupSize();
+		this->Dispatch(bindings, static_cast<const void *>(&pushConstants), (elementCount + groupSize - 1) / groupSize);
+	}
+
+	void CopyBuffer(VkBuffer source, VkBuffer destination, VkDeviceSize size);
+	void FillBuffer(VkBuffer buffer, uint32_t value, VkDeviceSize size = VK_WHOLE_SIZE);
+
+	// Makes every write so far visible to the given stages, like the host after the fence
+	void MakeVisible(VkPipelineStageFlags stages, VkAccessFlags access);
+
+	inline VkCommandBuffer GetHandle() const { return m_CommandBuffer; }
+	inline uint32_t GetBarrierCount() const { return m_BarrierCount; }
+
+private:
+	struct BufferState
+	{
+		// Last write, and which stages and accesses it was already made visible to
+		VkPipelineStageFlags WriteStages = 0;
+		VkAccessFlags WriteAccess = 0;
+		VkPipelineStageFlags VisibleStages = 0;
+		VkAccessFlags VisibleAccess = 0;
+
+		// Reads since the last write, the next write waits for them
+		VkPipelineStageFlags ReadStages = 0;
+	};
+
+	void Use(VkBuffer buffer, VkPipelineStageFlags stage, VkAccessFlags access, bool write);
+	void FlushBarriers();
+
+private:
+	VkCommandBuffer m_CommandBuffer = VK_NULL_HANDLE;
+	VkPipeline m_BoundPipeline = VK_NULL_HANDLE;
+	std::unordered_map<VkBuffer, BufferState> m_Buffers;
+
+	// Collected for the next command and recorded as one vkCmdPipelineBarrier
+	std::vector<VkBufferMemoryBarrier> m_PendingBarriers;
+	VkPipelineStageFlags m_PendingSourceStages = 0;
+	VkPipelineStageFlags m_PendingDestinationStages = 0;
+	uint32_t m_BarrierCount = 0;
+
+};
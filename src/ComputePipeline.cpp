@@ -0,0 +1,238 @@
+#include "ComputePipeline.h"
+#include "Log.h"
+
+#include <algorithm>
+
+ComputeBindings ComputePipeline::CreateBindings(const std::vector<VkBuffer> &buffers)
+{
+
+	ComputeBindings bindings;
+	bindings.Pipeline = this;
+	bindings.Buffers = buffers;
+
+	if (buffers.size() != this->m_Accesses.size())
+	{
+		LOG_ERROR("{0} binds {1} storage buffers, got {2}", this->m_Name, this->m_Accesses.size(), buffers.size());
+		return bindings;
+	}
+
+	VkDescriptorSetLayout layout = this->m_DescriptorSetLayout;
+
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = this->m_DescriptorPool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &layout;
+
+	if (vkAllocateDescriptorSets(this->m_Device, &allocInfo, &bindings.DescriptorSet) != VK_SUCCESS)
+	{
+		LOG_VK_ERROR("Out of binding sets for {0}!", this->m_Name);
+		bindings.DescriptorSet = VK_NULL_HANDLE;
+		return bindings;
+	}
+
+	std::vector<VkDescriptorBufferInfo> bufferInfos(buffers.size());
+	std::vector<VkWriteDescriptorSet> writes(buffers.size());
+
+	for (uint32_t i = 0; i < (uint32_t) buffers.size(); ++i)
+	{
+		bufferInfos[i].buffer = buffers[i];
+		bufferInfos[i].offset = 0;
+		bufferInfos[i].range = VK_WHOLE_SIZE;
+
+		writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[i].dstSet = bindings.DescriptorSet;
+		writes[i].dstBinding = i;
+		writes[i].descriptorCount = 1;
+		writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		writes[i].pBufferInfo = &bufferInfos[i];
+	}
+
+	vkUpdateDescriptorSets(this->m_Device, (uint32_t) writes.size(), writes.data(), 0, nullptr);
+	return bindings;
+
+}
+
+void ComputePipeline::ResetBindings()
+{
+
+	vkResetDescriptorPool(this->m_Device, this->m_DescriptorPool, 0);
+
+}
+
+ComputePipelineBuilder::ComputePipelineBuilder(VkDevice device, const std::string &name)
+	: m_Device(device), m_Name(name)
+{
+}
+
+ComputePipelineBuilder &ComputePipelineBuilder::SetShader(const std::vector<char> &shaderCode)
+{
+
+	this->m_ShaderCode = shaderCode;
+	return *this;
+
+}
+
+ComputePipelineBuilder &ComputePipelineBuilder::AddStorageBuffer(BufferAccess access)
+{
+
+	this->m_Accesses.push_back(access);
+	return *this;
+
+}
+
+ComputePipelineBuilder &ComputePipelineBuilder::SetPushConstantSize(uint32_t size)
+{
+
+	this->m_PushConstantSize = size;
+	return *this;
+
+}
+
+ComputePipelineBuilder &ComputePipelineBuilder::SetGroupSize(uint32_t size)
+{
+
+	this->m_GroupSize = size;
+	return this->SetConstant(0, size);
+
+}
+
+ComputePipelineBuilder &ComputePipelineBuilder::SetConstant(uint32_t id, uint32_t value)
+{
+
+	for (size_t i = 0; i < this->m_ConstantEntries.size(); ++i)
+	{
+		if (this->m_ConstantEntries[i].constantID == id)
+		{
+			this->m_ConstantValues[i] = value;
+			return *this;
+		}
+	}
+
+	VkSpecializationMapEntry entry = {};
+	entry.constantID = id;
+	entry.offset = (uint32_t) (this->m_ConstantValues.size() * sizeof(uint32_t));
+	entry.size = sizeof(uint32_t);
+
+	this->m_ConstantEntries.push_back(entry);
+	this->m_ConstantValues.push_back(value);
+	return *this;
+
+}
+
+ComputePipelineBuilder &ComputePipelineBuilder::SetMaxBindings(uint32_t count)
+{
+
+	this->m_MaxBindings = std::max(count, 1u);
+	return *this;
+
+}
+
+bool ComputePipelineBuilder::Build(VkPipelineCache pipelineCache, ComputePipeline &pipeline) const
+{
+
+	if (this->m_ShaderCode.empty())
+	{
+		LOG_ERROR("No shader code for compute pipeline {0}", this->m_Name);
+		return false;
+	}
+
+	pipeline.m_Device = this->m_Device;
+	pipeline.m_Name = this->m_Name;
+	pipeline.m_Accesses = this->m_Accesses;
+	pipeline.m_PushConstantSize = this->m_PushConstantSize;
+	pipeline.m_GroupSize = this->m_GroupSize;
+
+	std::vector<VkDescriptorSetLayoutBinding> bindings(this->m_Accesses.size());
+	for (uint32_t i = 0; i < (uint32_t) bindings.size(); ++i)
+	{
+		bindings[i].binding = i;
+		bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+
+	VkDescriptorSetLayoutCreateInfo setLayoutInfo = {};
+	setLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	setLayoutInfo.bindingCount = (uint32_t) bindings.size();
+	setLayoutInfo.pBindings = bindings.data();
+
+	if (vkCreateDescriptorSetLayout(this->m_Device, &setLayoutInfo, nullptr, pipeline.m_DescriptorSetLayout.Replace(this->m_Device)) != VK_SUCCESS)
+	{
+		LOG_VK_CRITICAL("Failed to create the descriptor set layout of {0}!", this->m_Name);
+		exit(-1);
+	}
+
+	// A pool must have at least one pool size, even for kernels without buffers
+	VkDescriptorPoolSize poolSize = {};
+	poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSize.descriptorCount = std::max<uint32_t>((uint32_t) bindings.size(), 1) * this->m_MaxBindings;
+
+	VkDescriptorPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.maxSets = this->m_MaxBindings;
+	poolInfo.poolSizeCount = 1;
+	poolInfo.pPoolSizes = &poolSize;
+
+	if (vkCreateDescriptorPool(this->m_Device, &poolInfo, nullptr, pipeline.m_DescriptorPool.Replace(this->m_Device)) != VK_SUCCESS)
+	{
+		LOG_VK_CRITICAL("Failed to create the descriptor pool of {0}!", this->m_Name);
+		exit(-1);
+	}
+
+	VkDescriptorSetLayout setLayout = pipeline.m_DescriptorSetLayout;
+
+	VkPushConstantRange pushConstantRange = {};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = this->m_PushConstantSize;
+
+	VkPipelineLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	layoutInfo.setLayoutCount = 1;
+	layoutInfo.pSetLayouts = &setLayout;
+	layoutInfo.pushConstantRangeCount = this->m_PushConstantSize > 0 ? 1 : 0;
+	layoutInfo.pPushConstantRanges = &pushConstantRange;
+
+	if (vkCreatePipelineLayout(this->m_Device, &layoutInfo, nullptr, pipeline.m_PipelineLayout.Replace(this->m_Device)) != VK_SUCCESS)
+	{
+		LOG_VK_CRITICAL("Failed to create the pipeline layout of {0}!", this->m_Name);
+		exit(-1);
+	}
+
+	VkShaderModuleCreateInfo moduleInfo = {};
+	moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	moduleInfo.codeSize = this->m_ShaderCode.size();
+	moduleInfo.pCode = reinterpret_cast<const uint32_t *>(this->m_ShaderCode.data());
+
+	UniqueShaderModule shaderModule;
+	if (vkCreateShaderModule(this->m_Device, &moduleInfo, nullptr, shaderModule.Replace(this->m_Device)) != VK_SUCCESS)
+	{
+		LOG_VK_ERROR("Failed to create the shader module of {0}!", this->m_Name);
+		return false;
+	}
+
+	VkSpecializationInfo specialization = {};
+	specialization.mapEntryCount = (uint32_t) this->m_ConstantEntries.size();
+	specialization.pMapEntries = this->m_ConstantEntries.data();
+	specialization.dataSize = this->m_ConstantValues.size() * sizeof(uint32_t);
+	specialization.pData = this->m_ConstantValues.data();
+
+	VkComputePipelineCreateInfo pipelineInfo = {};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipelineInfo.stage.module = shaderModule;
+	pipelineInfo.stage.pName = "main";
+	pipelineInfo.stage.pSpecializationInfo = this->m_ConstantEntries.empty() ? nullptr : &specialization;
+	pipelineInfo.layout = pipeline.m_PipelineLayout;
+
+	if (vkCreateComputePipelines(this->m_Device, pipelineCache, 1, &pipelineInfo, nullptr, pipeline.m_Pipeline.Replace(this->m_Device)) != VK_SUCCESS)
+	{
+		LOG_VK_ERROR("Failed to create compute pipeline {0}!", this->m_Name);
+		return false;
+	}
+
+	return true;
+
+}
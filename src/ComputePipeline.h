@@ -0,0 +1,105 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+#include "VulkanHandle.h"
+
+// How a dispatch uses a storage buffer binding, ComputeCommands derives the barriers from it
+enum class BufferAccess
+{
+	Read = 0,
+	Write,
+	ReadWrite
+};
+
+class ComputePipeline;
+
+// Buffers bound to the storage buffer bindings of one pipeline, in binding order.
+// The descriptor set lives as long as the pipeline.
+struct ComputeBindings
+{
+	const ComputePipeline *Pipeline = nullptr;
+	VkDescriptorSet DescriptorSet = VK_NULL_HANDLE;
+	std::vector<VkBuffer> Buffers;
+};
+
+// Compute pipeline with one descriptor set of storage buffers and an optional
+// push constant block, together with the pool its binding sets come from.
+// Created by ComputePipelineBuilder.
+class ComputePipeline
+{
+
+public:
+	// Null once every set of the pool is taken
+	ComputeBindings CreateBindings(const std::vector<VkBuffer> &buffers);
+
+	// Returns every binding set to the pool, none may be in use anymore
+	void ResetBindings();
+
+	inline const std::string &GetName() const { return m_Name; }
+	inline VkPipeline GetHandle() const { return m_Pipeline; }
+	inline VkPipelineLayout GetLayout() const { return m_PipelineLayout; }
+	inline uint32_t GetPushConstantSize() const { return m_PushConstantSize; }
+	inline const std::vector<BufferAccess> &GetBufferAccesses() const { return m_Accesses; }
+
+	// Invocations per workgroup along x, set through the builder
+	inline uint32_t GetGroupSize() const { return m_GroupSize; }
+
+private:
+	friend class ComputePipelineBuilder;
+
+	VkDevice m_Device = VK_NULL_HANDLE;
+	std::string m_Name;
+
+	std::vector<BufferAccess> m_Accesses;
+	uint32_t m_PushConstantSize = 0;
+	uint32_t m_GroupSize = 1;
+
+	UniqueDescriptorSetLayout m_DescriptorSetLayout;
+	UniqueDescriptorPool m_DescriptorPool;
+	UniquePipelineLayout m_PipelineLayout;
+	UniquePipeline m_Pipeline;
+
+};
+
+// Describes a compute pipeline step by step, Build creates it. Storage buffers are
+// bound to set 0 in the order they were added. The group size is passed to the shader
+// as specialization constant 0, so kernels declare layout(local_size_x_id = 0) in.
+class ComputePipelineBuilder
+{
+
+public:
+	ComputePipelineBuilder(VkDevice device, const std::string &name);
+
+	ComputePipelineBuilder &SetShader(const std::vector<char> &shaderCode);
+	ComputePipelineBuilder &AddStorageBuffer(BufferAccess access);
+	ComputePipelineBuilder &SetPushConstantSize(uint32_t size);
+	ComputePipelineBuilder &SetGroupSize(uint32_t size);
+
+	// Further specialization constants, ids from 1 on
+	ComputePipelineBuilder &SetConstant(uint32_t id, uint32_t value);
+
+	// Binding sets CreateBindings can hand out
+	ComputePipelineBuilder &SetMaxBindings(uint32_t count);
+
+	// Returns false when the shader is missing or the pipeline cannot be created
+	bool Build(VkPipelineCache pipelineCache, ComputePipeline &pipeline) const;
+
+private:
+	VkDevice m_Device = VK_NULL_HANDLE;
+	std::string m_Name;
+
+	std::vector<char> m_ShaderCode;
+	std::vector<BufferAccess> m_Accesses;
+	uint32_t m_PushConstantSize = 0;
+	uint32_t m_GroupSize = 1;
+	uint32_t m_MaxBindings = 1;
+
+	std::vector<VkSpecializationMapEntry> m_ConstantEntries;
+	std::vector<uint32_t> m_ConstantValues;
+
+};
@@ -0,0 +1,23 @@
+#include "DeletionQueue.h"
+
+#include <algorithm>
+
+void DeletionQueue::Release(uint64_t completedFrames)
+{
+
+	// Stable, so objects retired together go in the order they were retired
+	auto it = std::stable_partition(this->m_Entries.begin(), this->m_Entries.end(), [completedFrames](const Entry &entry)
+	{
+		return completedFrames <= entry.LastUsedFrame;
+	});
+
+	this->m_Entries.erase(it, this->m_Entries.end());
+
+}
+
+void DeletionQueue::Flush()
+{
+
+	this->m_Entries.clear();
+
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <utility>
+#include <type_traits>
+#include <cstdint>
+
+// Keeps objects alive until the GPU is done with them. Anything owning Vulkan
+// handles (VulkanHandle, UniqueBuffer, vectors of them...) is moved in with the
+// last frame that may use it and destroyed once the frame pacer reports that frame
+// complete, so resources can be replaced at runtime without waiting on the device.
+// Main thread only.
+class DeletionQueue
+{
+
+public:
+	~DeletionQueue() { Flush(); }
+
+	// lastUsedFrame is a frame number from FramePacer, usually the one being recorded
+	template<typename T>
+	void Retire(T &&object, uint64_t lastUsedFrame)
+	{
+		static_assert(std::is_rvalue_reference<T &&>::value, "Retire takes ownership, move the object in");
+		m_Entries.push_back({ lastUsedFrame, std::make_unique<Retired<std::decay_t<T>>>(std::move(object)) });
+	}
+
+	// Destroys everything whose frame completed, in the order it was retired
+	void Release(uint64_t completedFrames);
+
+	// Destroys everything, the device must be idle
+	void Flush();
+
+	inline size_t GetPendingCount() const { return m_Entries.size(); }
+
+private:
+	struct RetiredObject
+	{
+		virtual ~RetiredObject() = default;
+	};
+
+	template<typename T>
+	struct Retired : RetiredObject
+	{
+		Retired(T &&object) : Object(std::move(object)) {}
+		T Object;
+	};
+
+	struct Entry
+	{
+		uint64_t LastUsedFrame;
+		std::unique_ptr<RetiredObject> Object;
+	};
+
+private:
+	std::vector<Entry> m_Entries;
+
+};
@@ -0,0 +1,145 @@
+#include "DeviceCapabilities.h"
+
+DeviceCapabilities DeviceCapabilities::Query(VkPhysicalDevice device, uint32_t index, VkSurfaceKHR surface)
+{
+
+	DeviceCapabilities caps;
+	caps.Device = device;
+	caps.Index = index;
+
+	vkGetPhysicalDeviceProperties(device, &caps.Properties);
+	vkGetPhysicalDeviceMemoryProperties(device, &caps.Memory);
+
+	uint32_t extensionCount = 0;
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+	std::vector<VkExtensionProperties> extensions(extensionCount);
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, extensions.data());
+
+	for (const VkExtensionProperties &extension : extensions)
+		caps.Extensions.insert(extension.extensionName);
+
+	// Feature structs of missing extensions must stay out of the chain
+	VkPhysicalDeviceTimelineSemaphoreFeaturesKHR timelineFeatures = {};
+	timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES_KHR;
+
+	VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures = {};
+	presentIdFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR;
+
+	VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures = {};
+	presentWaitFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR;
+
+	caps.DescriptorIndexing.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT;
+
+	VkPhysicalDeviceFeatures2 features = {};
+	features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+
+	void **next = &features.pNext;
+	if (caps.HasExtension(VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME))
+	{
+		*next = &timelineFeatures;
+		next = &timelineFeatures.pNext;
+	}
+
+	if (caps.HasExtension(VK_KHR_PRESENT_ID_EXTENSION_NAME))
+	{
+		*next = &presentIdFeatures;
+		next = &presentIdFeatures.pNext;
+	}
+
+	if (caps.HasExtension(VK_KHR_PRESENT_WAIT_EXTENSION_NAME))
+	{
+		*next = &presentWaitFeatures;
+		next = &presentWaitFeatures.pNext;
+	}
+
+	bool descriptorIndexing = caps.HasExtension(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+	if (descriptorIndexing)
+	{
+		*next = &caps.DescriptorIndexing;
+		next = &caps.DescriptorIndexing.pNext;
+	}
+
+	vkGetPhysicalDeviceFeatures2(device, &features);
+	caps.Features = features.features;
+	caps.TimelineSemaphore = timelineFeatures.timelineSemaphore;
+	caps.PresentId = presentIdFeatures.presentId;
+	caps.PresentWait = presentWaitFeatures.presentWait;
+	caps.DescriptorIndexing.pNext = nullptr;
+
+	caps.DescriptorIndexingLimits.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES_EXT;
+	if (descriptorIndexing)
+	{
+		VkPhysicalDeviceProperties2 properties = {};
+		properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+		properties.pNext = &caps.DescriptorIndexingLimits;
+
+		vkGetPhysicalDeviceProperties2(device, &properties);
+		caps.DescriptorIndexingLimits.pNext = nullptr;
+	}
+
+	uint32_t familyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(device, &familyCount, nullptr);
+
+	caps.QueueFamilyProperties.resize(familyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(device, &familyCount, caps.QueueFamilyProperties.data());
+
+	// Every family is visited since the dedicated ones tend to come last
+	QueueFamilyIndices &indices = caps.QueueFamilies;
+	for (uint32_t family = 0; family < familyCount; ++family)
+	{
+		VkQueueFlags flags = caps.QueueFamilyProperties[family].queueFlags;
+
+		bool graphics = flags & VK_QUEUE_GRAPHICS_BIT;
+		bool compute = flags & VK_QUEUE_COMPUTE_BIT;
+		bool transfer = flags & VK_QUEUE_TRANSFER_BIT;
+
+		if (graphics && !indices.GraphicsFamily.has_value())
+			indices.GraphicsFamily = family;
+
+		if (compute && !graphics && !indices.ComputeFamily.has_value())
+			indices.ComputeFamily = family;
+
+		if (transfer && !graphics && !compute && !indices.TransferFamily.has_value())
+			indices.TransferFamily = family;
+
+		// Without a surface (headless) there is nothing to present to
+		if (surface != VK_NULL_HANDLE && !indices.PresentFamily.has_value())
+		{
+			VkBool32 presentSupport = false;
+			vkGetPhysicalDeviceSurfaceSupportKHR(device, family, surface, &presentSupport);
+
+			if (presentSupport)
+				indices.PresentFamily = family;
+		}
+	}
+
+	return caps;
+
+}
+
+VkDeviceSize DeviceCapabilities::GetDeviceLocalMemory() const
+{
+
+	VkDeviceSize size = 0;
+	for (uint32_t i = 0; i < this->Memory.memoryHeapCount; ++i)
+	{
+		if (this->Memory.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+			size += this->Memory.memoryHeaps[i].size;
+	}
+
+	return size;
+
+}
+
+const char *DeviceCapabilities::GetTypeName() const
+{
+	switch (this->Properties.deviceType)
+	{
+	case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:	return "Integrated GPU";
+	case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:		return "Dedicated GPU";
+	case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:		return "Virtual GPU";
+	case VK_PHYSICAL_DEVICE_TYPE_CPU:				return "CPU";
+	default:										return "UNKNOWN";
+	}
+}
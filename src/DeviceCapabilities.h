@@ -0,0 +1,59 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <string>
+#include <optional>
+#include <unordered_set>
+#include <cstdint>
+
+struct QueueFamilyIndices
+{
+	std::optional<uint32_t> GraphicsFamily;
+	std::optional<uint32_t> PresentFamily;
+
+	// Only set for families without graphics support, so work on them runs next to rendering.
+	// TransferFamily also lacks compute, which usually means a DMA engine.
+	std::optional<uint32_t> TransferFamily;
+	std::optional<uint32_t> ComputeFamily;
+
+	inline bool AllAvailable(bool requirePresent = true) const
+	{
+		return GraphicsFamily.has_value()
+			&& (PresentFamily.has_value() || !requirePresent);
+	}
+};
+
+// Everything the renderer asks a physical device, queried once when the devices are
+// enumerated. Selection, device creation and later queue or extension checks all read
+// from here instead of going back to the driver.
+struct DeviceCapabilities
+{
+	VkPhysicalDevice Device = VK_NULL_HANDLE;
+	uint32_t Index = 0;
+
+	VkPhysicalDeviceProperties Properties = {};
+	VkPhysicalDeviceFeatures Features = {};
+	VkPhysicalDeviceMemoryProperties Memory = {};
+	std::vector<VkQueueFamilyProperties> QueueFamilyProperties;
+	std::unordered_set<std::string> Extensions;
+
+	// Extension features, only true when the extension is there as well
+	bool TimelineSemaphore = false;
+	bool PresentId = false;
+	bool PresentWait = false;
+
+	// VK_EXT_descriptor_indexing, zeroed without the extension. pNext is cleared after the query.
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT DescriptorIndexing = {};
+	VkPhysicalDeviceDescriptorIndexingPropertiesEXT DescriptorIndexingLimits = {};
+
+	// Present support depends on the surface, none is looked up without one
+	QueueFamilyIndices QueueFamilies;
+
+	static DeviceCapabilities Query(VkPhysicalDevice device, uint32_t index, VkSurfaceKHR surface);
+
+	inline bool HasExtension(const char *extension) const { return Extensions.count(extension) > 0; }
+	VkDeviceSize GetDeviceLocalMemory() const;
+	const char *GetTypeName() const;
+};
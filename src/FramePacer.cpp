@@ -0,0 +1,91 @@
+#include "FramePacer.h"
+#include "Log.h"
+
+#include <algorithm>
+
+void FramePacer::Init(VkDevice device, uint32_t framesInFlight)
+{
+
+	this->m_Device = device;
+	this->SetFramesInFlight(framesInFlight);
+
+	this->m_WaitSemaphores = (PFN_vkWaitSemaphoresKHR) vkGetDeviceProcAddr(device, "vkWaitSemaphoresKHR");
+	this->m_GetSemaphoreCounterValue = (PFN_vkGetSemaphoreCounterValueKHR) vkGetDeviceProcAddr(device, "vkGetSemaphoreCounterValueKHR");
+
+	if (!this->m_WaitSemaphores || !this->m_GetSemaphoreCounterValue)
+	{
+		LOG_VK_CRITICAL("VK_KHR_timeline_semaphore entry points are missing!");
+		exit(-1);
+	}
+
+	VkSemaphoreTypeCreateInfoKHR typeInfo = {};
+	typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO_KHR;
+	typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE_KHR;
+	typeInfo.initialValue = 0;
+
+	VkSemaphoreCreateInfo semaphoreInfo = {};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	semaphoreInfo.pNext = &typeInfo;
+
+	if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &this->m_Semaphore) != VK_SUCCESS)
+	{
+		LOG_VK_CRITICAL("Failed to create the frame timeline semaphore!");
+		exit(-1);
+	}
+
+}
+
+void FramePacer::Shutdown()
+{
+
+	vkDestroySemaphore(this->m_Device, this->m_Semaphore, nullptr);
+	this->m_Semaphore = VK_NULL_HANDLE;
+
+}
+
+uint32_t FramePacer::BeginFrame()
+{
+
+	// Frame N may start once frame N - depth has completed
+	if (this->m_SubmittedFrames >= this->m_FramesInFlight)
+		this->WaitForFrames(this->m_SubmittedFrames + 1 - this->m_FramesInFlight);
+
+	return this->GetFrameIndex();
+
+}
+
+uint64_t FramePacer::GetCompletedFrames() const
+{
+
+	uint64_t value = 0;
+	this->m_GetSemaphoreCounterValue(this->m_Device, this->m_Semaphore, &value);
+	return value;
+
+}
+
+void FramePacer::WaitForFrames(uint64_t frameCount) const
+{
+
+	VkSemaphoreWaitInfoKHR waitInfo = {};
+	waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO_KHR;
+	waitInfo.semaphoreCount = 1;
+	waitInfo.pSemaphores = &this->m_Semaphore;
+	waitInfo.pValues = &frameCount;
+
+	if (this->m_WaitSemaphores(this->m_Device, &waitInfo, UINT64_MAX) != VK_SUCCESS)
+	{
+		LOG_VK_CRITICAL("Failed to wait on the frame timeline semaphore!");
+		exit(-1);
+	}
+
+}
+
+void FramePacer::SetFramesInFlight(uint32_t framesInFlight)
+{
+
+	this->m_FramesInFlight = std::clamp<uint32_t>(framesInFlight, 1, MAX_FRAMES_IN_FLIGHT);
+
+	if (this->m_FramesInFlight != framesInFlight)
+		LOG_WARNING("Frames in flight clamped to {0}", this->m_FramesInFlight);
+
+}
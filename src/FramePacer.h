@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+
+// Paces the CPU against the GPU with one timeline semaphore. The submission
+// that finishes frame N signals the value N + 1, so the counter value is the
+// number of frames the GPU has completed. That is the frame counter every
+// system that retires resources should compare against, and the only thing
+// BeginFrame waits on: no per-frame fences and no per-image fence aliasing.
+class FramePacer
+{
+
+public:
+	// Per-frame resources are allocated for this many slots, the pacing depth can change freely below it
+	static constexpr uint32_t MAX_FRAMES_IN_FLIGHT = 4;
+
+	void Init(VkDevice device, uint32_t framesInFlight);
+	void Shutdown();
+
+	// Waits until starting another frame keeps at most the pacing depth on the GPU
+	// and returns the resource slot of the new frame, which nothing uses anymore.
+	uint32_t BeginFrame();
+
+	// The submission finishing the frame signals GetSemaphore with GetSignalValue, then calls EndFrame
+	inline VkSemaphore GetSemaphore() const { return m_Semaphore; }
+	inline uint64_t GetSignalValue() const { return m_SubmittedFrames + 1; }
+	inline void EndFrame() { ++m_SubmittedFrames; }
+
+	// Monotonic, a resource last used by frame N can go once GetCompletedFrames() > N
+	inline uint64_t GetSubmittedFrames() const { return m_SubmittedFrames; }
+	uint64_t GetCompletedFrames() const;
+	void WaitForFrames(uint64_t frameCount) const;
+
+	// 1 gives the lowest latency, MAX_FRAMES_IN_FLIGHT the most CPU/GPU overlap
+	void SetFramesInFlight(uint32_t framesInFlight);
+	inline uint32_t GetFramesInFlight() const { return m_FramesInFlight; }
+	inline uint32_t GetFrameIndex() const { return (uint32_t) (m_SubmittedFrames % MAX_FRAMES_IN_FLIGHT); }
+
+private:
+	VkDevice m_Device = VK_NULL_HANDLE;
+	VkSemaphore m_Semaphore = VK_NULL_HANDLE;
+
+	// Vulkan 1.1 only exposes these through VK_KHR_timeline_semaphore
+	PFN_vkWaitSemaphoresKHR m_WaitSemaphores = nullptr;
+	PFN_vkGetSemaphoreCounterValueKHR m_GetSemaphoreCounterValue = nullptr;
+
+	uint64_t m_SubmittedFrames = 0;
+	uint32_t m_FramesInFlight = 2;
+
+};
@@ -0,0 +1,352 @@
+#include "GpuCulling.h"
+#include "Log.h"
+
+#include <algorithm>
+
+static const uint32_t CULLING_GROUP_SIZE = 64;
+static const uint32_t CULLING_BINDING_COUNT = 5;
+
+bool GpuCulling::Init(VkDevice device, MemoryAllocator &allocator, StagingRing &stagingRing, VkPipelineCache pipelineCache,
+	const std::vector<char> &shaderCode, const std::vector<const Mesh *> &meshes, const std::vector<InstanceData> &instances,
+	uint32_t frameCount, const std::vector<uint32_t> &queueFamilies)
+{
+
+	this->m_Device = device;
+	this->m_Allocator = &allocator;
+	this->m_QueueFamilies = queueFamilies;
+	this->m_Meshes = meshes;
+	this->m_InstanceCount = (uint32_t) instances.size();
+
+	if (shaderCode.empty())
+		return false;
+
+	// Every mesh owns a contiguous range of the visible buffer large
+	// enough for all of its instances, starting at FirstInstance.
+	this->m_CommandTemplate.resize(meshes.size());
+	std::vector<float> radii(meshes.size());
+
+	for (size_t i = 0; i < meshes.size(); ++i)
+	{
+		this->m_CommandTemplate[i] = { meshes[i]->IndexCount, 0, 0, 0, 0 };
+		radii[i] = meshes[i]->BoundingRadius;
+	}
+
+	for (const InstanceData &instance : instances)
+		++this->m_CommandTemplate[instance.MeshIndex].firstInstance;
+
+	uint32_t first = 0;
+	for (VkDrawIndexedIndirectCommand &command : this->m_CommandTemplate)
+	{
+		uint32_t count = command.firstInstance;
+		command.firstInstance = first;
+		first += count;
+	}
+
+	VkDeviceSize instanceBytes = sizeof(InstanceData) * std::max<size_t>(instances.size(), 1);
+	VkDeviceSize commandBytes = sizeof(VkDrawIndexedIndirectCommand) * meshes.size();
+
+	this->CreateBuffer(instanceBytes, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, this->m_InstanceBuffer, this->m_InstanceMemory);
+	this->CreateBuffer(sizeof(float) * meshes.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, this->m_BoundsBuffer, this->m_BoundsMemory);
+
+	this->m_Frames.resize(frameCount);
+	for (FrameOutputs &frame : this->m_Frames)
+	{
+		this->CreateBuffer(instanceBytes, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, frame.VisibleBuffer, frame.VisibleMemory);
+		this->CreateBuffer(commandBytes, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, frame.CommandBuffer, frame.CommandMemory);
+		this->CreateBuffer(sizeof(uint32_t) * meshes.size(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, frame.CountBuffer, frame.CountMemory);
+	}
+
+	this->CreateDescriptors();
+
+	VkPushConstantRange pushConstantRange = {};
+	pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	pushConstantRange.offset = 0;
+	pushConstantRange.size = sizeof(uint32_t);
+
+	VkPipelineLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	layoutInfo.setLayoutCount = 1;
+	layoutInfo.pSetLayouts = &this->m_DescriptorSetLayout;
+	layoutInfo.pushConstantRangeCount = 1;
+	layoutInfo.pPushConstantRanges = &pushConstantRange;
+
+	if (vkCreatePipelineLayout(device, &layoutInfo, nullptr, &this->m_PipelineLayout) != VK_SUCCESS)
+	{
+		LOG_VK_CRITICAL("Failed to create culling pipeline layout!");
+		exit(-1);
+	}
+
+	this->m_Pipeline = this->CreatePipeline(shaderCode, pipelineCache);
+	if (!this->m_Pipeline)
+	{
+		this->Shutdown();
+		return false;
+	}
+
+	// Only queued once nothing can fail anymore, the buffers must outlive the copies
+	VkSharingMode sharing = this->m_QueueFamilies.size() > 1 ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+	stagingRing.Upload(this->m_InstanceBuffer, 0, instances.data(), sizeof(InstanceData) * instances.size(), sharing);
+	stagingRing.Upload(this->m_BoundsBuffer, 0, radii.data(), sizeof(float) * radii.size(), sharing);
+
+	LOG_VK_INFO("GPU culling {0} instances of {1} meshes", this->m_InstanceCount, meshes.size());
+	return true;
+
+}
+
+VkPipeline GpuCulling::CreatePipeline(const std::vector<char> &shaderCode, VkPipelineCache pipelineCache) const
+{
+
+	VkShaderModuleCreateInfo moduleInfo = {};
+	moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	moduleInfo.codeSize = shaderCode.size();
+	moduleInfo.pCode = reinterpret_cast<const uint32_t *>(shaderCode.data());
+
+	VkShaderModule shaderModule = VK_NULL_HANDLE;
+	if (vkCreateShaderModule(this->m_Device, &moduleInfo, nullptr, &shaderModule) != VK_SUCCESS)
+		return VK_NULL_HANDLE;
+
+	VkComputePipelineCreateInfo pipelineInfo = {};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipelineInfo.stage.module = shaderModule;
+	pipelineInfo.stage.pName = "main";
+	pipelineInfo.layout = this->m_PipelineLayout;
+
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	VkResult result = vkCreateComputePipelines(this->m_Device, pipelineCache, 1, &pipelineInfo, nullptr, &pipeline);
+	vkDestroyShaderModule(this->m_Device, shaderModule, nullptr);
+
+	return result == VK_SUCCESS ? pipeline : VK_NULL_HANDLE;
+
+}
+
+VkPipeline GpuCulling::SwapPipeline(VkPipeline pipeline)
+{
+
+	std::swap(this->m_Pipeline, pipeline);
+	return pipeline;
+
+}
+
+void GpuCulling::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer &buffer, MemoryAllocation &allocation)
+{
+
+	VkBufferCreateInfo bufferInfo = {};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = size;
+	bufferInfo.usage = usage;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	// Uploads, culling and drawing may each happen on another queue family
+	if (this->m_QueueFamilies.size() > 1)
+	{
+		bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+		bufferInfo.queueFamilyIndexCount = (uint32_t) this->m_QueueFamilies.size();
+		bufferInfo.pQueueFamilyIndices = this->m_QueueFamilies.data();
+	}
+
+	AllocationCreateInfo allocInfo = {};
+	allocInfo.RequiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+	if (this->m_Allocator->CreateBuffer(bufferInfo, allocInfo, buffer, allocation) != VK_SUCCESS)
+	{
+		LOG_VK_CRITICAL("Failed to create culling buffer!");
+		exit(-1);
+	}
+
+}
+
+void GpuCulling::CreateDescriptors()
+{
+
+	VkDescriptorSetLayoutBinding bindings[CULLING_BINDING_COUNT] = {};
+	for (uint32_t i = 0; i < CULLING_BINDING_COUNT; ++i)
+	{
+		bindings[i].binding = i;
+		bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = CULLING_BINDING_COUNT;
+	layoutInfo.pBindings = bindings;
+
+	if (vkCreateDescriptorSetLayout(this->m_Device, &layoutInfo, nullptr, &this->m_DescriptorSetLayout) != VK_SUCCESS)
+	{
+		LOG_VK_CRITICAL("Failed to create culling descriptor set layout!");
+		exit(-1);
+	}
+
+	uint32_t frameCount = (uint32_t) this->m_Frames.size();
+
+	VkDescriptorPoolSize poolSize = {};
+	poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSize.descriptorCount = CULLING_BINDING_COUNT * frameCount;
+
+	VkDescriptorPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.maxSets = frameCount;
+	poolInfo.poolSizeCount = 1;
+	poolInfo.pPoolSizes = &poolSize;
+
+	if (vkCreateDescriptorPool(this->m_Device, &poolInfo, nullptr, &this->m_DescriptorPool) != VK_SUCCESS)
+	{
+		LOG_VK_CRITICAL("Failed to create culling descriptor pool!");
+		exit(-1);
+	}
+
+	std::vector<VkDescriptorSetLayout> layouts(frameCount, this->m_DescriptorSetLayout);
+	std::vector<VkDescriptorSet> sets(frameCount);
+
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = this->m_DescriptorPool;
+	allocInfo.descriptorSetCount = frameCount;
+	allocInfo.pSetLayouts = layouts.data();
+
+	if (vkAllocateDescriptorSets(this->m_Device, &allocInfo, sets.data()) != VK_SUCCESS)
+	{
+		LOG_VK_CRITICAL("Failed to allocate culling descriptor sets!");
+		exit(-1);
+	}
+
+	for (uint32_t frameIndex = 0; frameIndex < frameCount; ++frameIndex)
+	{
+		FrameOutputs &frame = this->m_Frames[frameIndex];
+		frame.DescriptorSet = sets[frameIndex];
+
+		VkBuffer buffers[CULLING_BINDING_COUNT] = {
+			this->m_InstanceBuffer,
+			this->m_BoundsBuffer,
+			frame.VisibleBuffer,
+			frame.CommandBuffer,
+			frame.CountBuffer
+		};
+
+		VkDescriptorBufferInfo bufferInfos[CULLING_BINDING_COUNT] = {};
+		VkWriteDescriptorSet writes[CULLING_BINDING_COUNT] = {};
+
+		for (uint32_t i = 0; i < CULLING_BINDING_COUNT; ++i)
+		{
+			bufferInfos[i].buffer = buffers[i];
+			bufferInfos[i].offset = 0;
+			bufferInfos[i].range = VK_WHOLE_SIZE;
+
+			writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			writes[i].dstSet = frame.DescriptorSet;
+			writes[i].dstBinding = i;
+			writes[i].descriptorCount = 1;
+			writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			writes[i].pBufferInfo = &bufferInfos[i];
+		}
+
+		vkUpdateDescriptorSets(this->m_Device, CULLING_BINDING_COUNT, writes, 0, nullptr);
+	}
+
+}
+
+void GpuCulling::Shutdown()
+{
+
+	if (!this->m_Device)
+		return;
+
+	if (this->m_Pipeline)
+		vkDestroyPipeline(this->m_Device, this->m_Pipeline, nullptr);
+
+	if (this->m_PipelineLayout)
+		vkDestroyPipelineLayout(this->m_Device, this->m_PipelineLayout, nullptr);
+
+	if (this->m_DescriptorPool)
+		vkDestroyDescriptorPool(this->m_Device, this->m_DescriptorPool, nullptr);
+
+	if (this->m_DescriptorSetLayout)
+		vkDestroyDescriptorSetLayout(this->m_Device, this->m_DescriptorSetLayout, nullptr);
+
+	if (this->m_Allocator)
+	{
+		this->m_Allocator->DestroyBuffer(this->m_InstanceBuffer, this->m_InstanceMemory);
+		this->m_Allocator->DestroyBuffer(this->m_BoundsBuffer, this->m_BoundsMemory);
+
+		for (FrameOutputs &frame : this->m_Frames)
+		{
+			this->m_Allocator->DestroyBuffer(frame.VisibleBuffer, frame.VisibleMemory);
+			this->m_Allocator->DestroyBuffer(frame.CommandBuffer, frame.CommandMemory);
+			this->m_Allocator->DestroyBuffer(frame.CountBuffer, frame.CountMemory);
+		}
+	}
+
+	*this = GpuCulling();
+
+}
+
+void GpuCulling::RecordCulling(VkCommandBuffer commandBuffer, uint32_t frameIndex, bool graphicsQueue)
+{
+
+	// The outputs were last read by the frame that used this slot before,
+	// which the caller already waited for before recording this one.
+	FrameOutputs &frame = this->m_Frames[frameIndex];
+
+	vkCmdUpdateBuffer(commandBuffer, frame.CommandBuffer, 0,
+		sizeof(VkDrawIndexedIndirectCommand) * this->m_CommandTemplate.size(),
+		this->m_CommandTemplate.data());
+	vkCmdFillBuffer(commandBuffer, frame.CountBuffer, 0, VK_WHOLE_SIZE, 0);
+
+	VkMemoryBarrier resetBarrier = {};
+	resetBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	resetBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	resetBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+		1, &resetBarrier, 0, nullptr, 0, nullptr);
+
+	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, this->m_Pipeline);
+	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, this->m_PipelineLayout, 0, 1, &frame.DescriptorSet, 0, nullptr);
+	vkCmdPushConstants(commandBuffer, this->m_PipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t), &this->m_InstanceCount);
+	vkCmdDispatch(commandBuffer, (this->m_InstanceCount + CULLING_GROUP_SIZE - 1) / CULLING_GROUP_SIZE, 1, 1);
+
+	if (!graphicsQueue)
+		return;
+
+	VkMemoryBarrier cullBarrier = {};
+	cullBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	cullBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	cullBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0,
+		1, &cullBarrier, 0, nullptr, 0, nullptr);
+
+}
+
+void GpuCulling::RecordDraws(VkCommandBuffer commandBuffer, uint32_t frameIndex, PFN_vkCmdDrawIndexedIndirectCountKHR drawIndirectCount)
+{
+
+	const FrameOutputs &frame = this->m_Frames[frameIndex];
+
+	VkDeviceSize instanceOffset = 0;
+	vkCmdBindVertexBuffers(commandBuffer, 1, 1, &frame.VisibleBuffer, &instanceOffset);
+
+	for (size_t i = 0; i < this->m_Meshes.size(); ++i)
+	{
+		const Mesh *mesh = this->m_Meshes[i];
+
+		VkDeviceSize vertexOffset = 0;
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &mesh->VertexBuffer, &vertexOffset);
+		vkCmdBindIndexBuffer(commandBuffer, mesh->IndexBuffer, 0, mesh->IndexType);
+
+		VkDeviceSize commandOffset = sizeof(VkDrawIndexedIndirectCommand) * i;
+
+		// With the count the draw of a fully culled mesh is skipped entirely,
+		// without it the draw still happens with an instance count of zero.
+		if (drawIndirectCount)
+			drawIndirectCount(commandBuffer, frame.CommandBuffer, commandOffset, frame.CountBuffer, sizeof(uint32_t) * i, 1, sizeof(VkDrawIndexedIndirectCommand));
+		else
+			vkCmdDrawIndexedIndirect(commandBuffer, frame.CommandBuffer, commandOffset, 1, sizeof(VkDrawIndexedIndirectCommand));
+	}
+
+}
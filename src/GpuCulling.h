@@ -0,0 +1,83 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <cstdint>
+
+#include "MemoryAllocator.h"
+#include "StagingRing.h"
+#include "Mesh.h"
+
+// GPU-driven instanced rendering. A compute pass culls every instance against
+// the view volume and compacts the visible ones into per-mesh ranges of one
+// buffer, bumping the instance count of that mesh's indirect draw. The CPU cost
+// per frame only depends on the number of meshes, not the number of instances.
+// Every frame in flight has its own outputs, so culling on an async compute
+// queue overlaps drawing the previous frame.
+class GpuCulling
+{
+
+public:
+	// Returns false when the compute pipeline cannot be created,
+	// the caller should then draw the instances itself. queueFamilies lists every
+	// family using the buffers, with more than one they are shared concurrently.
+	bool Init(VkDevice device, MemoryAllocator &allocator, StagingRing &stagingRing, VkPipelineCache pipelineCache,
+		const std::vector<char> &shaderCode, const std::vector<const Mesh *> &meshes, const std::vector<InstanceData> &instances,
+		uint32_t frameCount, const std::vector<uint32_t> &queueFamilies);
+	void Shutdown();
+
+	// Resets the draws and records the culling dispatch, outside of a render pass.
+	// On a compute queue the semaphore to the graphics queue replaces the final barrier.
+	void RecordCulling(VkCommandBuffer commandBuffer, uint32_t frameIndex, bool graphicsQueue);
+
+	// Records one indirect draw per mesh, the graphics pipeline must already be bound.
+	// drawIndirectCount is null when VK_KHR_draw_indirect_count is not available.
+	void RecordDraws(VkCommandBuffer commandBuffer, uint32_t frameIndex, PFN_vkCmdDrawIndexedIndirectCountKHR drawIndirectCount);
+
+	// Builds a culling pipeline from other shader code for the existing layout, null on failure.
+	// Thread safe, the new pipeline is only used once SwapPipeline installs it.
+	VkPipeline CreatePipeline(const std::vector<char> &shaderCode, VkPipelineCache pipelineCache) const;
+
+	// Returns the previous pipeline, which the caller destroys once no frame uses it anymore
+	VkPipeline SwapPipeline(VkPipeline pipeline);
+
+	inline uint32_t GetInstanceCount() const { return m_InstanceCount; }
+
+private:
+	void CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkBuffer &buffer, MemoryAllocation &allocation);
+	void CreateDescriptors();
+
+private:
+	struct FrameOutputs
+	{
+		VkBuffer VisibleBuffer = VK_NULL_HANDLE;
+		MemoryAllocation VisibleMemory;
+		VkBuffer CommandBuffer = VK_NULL_HANDLE;
+		MemoryAllocation CommandMemory;
+		VkBuffer CountBuffer = VK_NULL_HANDLE;
+		MemoryAllocation CountMemory;
+		VkDescriptorSet DescriptorSet = VK_NULL_HANDLE;
+	};
+
+	VkDevice m_Device = VK_NULL_HANDLE;
+	MemoryAllocator *m_Allocator = nullptr;
+	std::vector<uint32_t> m_QueueFamilies;
+
+	std::vector<const Mesh *> m_Meshes;
+	std::vector<VkDrawIndexedIndirectCommand> m_CommandTemplate;
+	uint32_t m_InstanceCount = 0;
+
+	VkBuffer m_InstanceBuffer = VK_NULL_HANDLE;
+	MemoryAllocation m_InstanceMemory;
+	VkBuffer m_BoundsBuffer = VK_NULL_HANDLE;
+	MemoryAllocation m_BoundsMemory;
+	std::vector<FrameOutputs> m_Frames;
+
+	VkDescriptorSetLayout m_DescriptorSetLayout = VK_NULL_HANDLE;
+	VkDescriptorPool m_DescriptorPool = VK_NULL_HANDLE;
+
+	VkPipelineLayout m_PipelineLayout = VK_NULL_HANDLE;
+	VkPipeline m_Pipeline = VK_NULL_HANDLE;
+
+};
@@ -0,0 +1,565 @@
+#include "GpuProfiler.h"
+#include "Profiler.h"
+#include "Benchmark.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <cstring>
+
+// Zones per frame, the begin and end timestamp take one query each
+static const uint32_t MAX_ZONES = 256;
+
+static const VkQueryPipelineStatisticFlags STATISTIC_FLAGS =
+	VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT
+	| VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT
+	| VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT
+	| VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT
+	| VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT
+	| VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT
+	| VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+
+// One counter per flag above followed by the availability value
+static const uint32_t STATISTIC_COUNT = 7;
+static_assert(sizeof(PipelineStatistics) == STATISTIC_COUNT * sizeof(uint64_t), "PipelineStatistics has to match the query results");
+
+// Chrome trace process id, util::Profiler writes the CPU as process 1
+static const uint32_t GPU_PROCESS = 2;
+
+GpuProfiler::GpuZone::GpuZone(GpuProfiler &profiler, VkCommandBuffer commandBuffer, const char *name)
+	: m_Profiler(profiler), m_CommandBuffer(commandBuffer)
+{
+
+	this->m_Zone = profiler.BeginZone(commandBuffer, name);
+
+}
+
+GpuProfiler::GpuZone::~GpuZone()
+{
+
+	this->m_Profiler.EndZone(this->m_CommandBuffer, this->m_Zone);
+
+}
+
+void GpuProfiler::Init(VkDevice device, const DeviceCapabilities &caps, const VkPhysicalDeviceFeatures &enabledFeatures,
+	bool calibratedTimestamps, VkQueue queue, uint32_t queueFamily, uint32_t frameCount, uint32_t traceFrames)
+{
+
+	this->m_Device = device;
+	this->m_Queue = queue;
+	this->m_QueueFamily = queueFamily;
+
+	this->m_TimestampValidBits = caps.QueueFamilyProperties[queueFamily].timestampValidBits;
+	if (!this->m_TimestampValidBits)
+	{
+		LOG_WARNING("Queue family {0} has no timestamps, GPU profiling is disabled", queueFamily);
+		return;
+	}
+
+	this->m_TimestampMask = this->m_TimestampValidBits >= 64 ? UINT64_MAX : (1ull << this->m_TimestampValidBits) - 1;
+	this->m_TimestampPeriod = caps.Properties.limits.timestampPeriod;
+	this->m_MaxZones = MAX_ZONES;
+	this->m_TraceFrames = std::max(traceFrames, 1u);
+
+	this->m_StatisticFlags = enabledFeatures.pipelineStatisticsQuery ? STATISTIC_FLAGS : 0;
+	this->m_InheritedQueries = this->m_StatisticFlags && enabledFeatures.inheritedQueries;
+
+	this->m_Frames.resize(frameCount);
+	for (FrameQueries &queries : this->m_Frames)
+	{
+		VkQueryPoolCreateInfo poolInfo = {};
+		poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		poolInfo.queryCount = this->m_MaxZones * 2;
+
+		if (vkCreateQueryPool(device, &poolInfo, nullptr, queries.Timestamps.Replace(device)) != VK_SUCCESS)
+		{
+			LOG_VK_CRITICAL("Failed to create the profiler timestamp query pool!");
+			exit(-1);
+		}
+
+		if (this->m_StatisticFlags)
+		{
+			poolInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+			poolInfo.queryCount = 1;
+			poolInfo.pipelineStatistics = this->m_StatisticFlags;
+
+			if (vkCreateQueryPool(device, &poolInfo, nullptr, queries.Statistics.Replace(device)) != VK_SUCCESS)
+			{
+				LOG_VK_CRITICAL("Failed to create the profiler pipeline statistics query pool!");
+				exit(-1);
+			}
+		}
+
+		queries.ZoneNames.resize(this->m_MaxZones, nullptr);
+	}
+
+	if (calibratedTimestamps)
+		this->m_GetCalibratedTimestamps = (PFN_vkGetCalibratedTimestampsEXT) vkGetDeviceProcAddr(device, "vkGetCalibratedTimestampsEXT");
+
+	this->m_Epoch = util::Profiler::GetEpoch();
+	this->m_Enabled = true;
+
+	LOG_INFO("GPU profiler: {0} zones per frame, {1}, {2}", this->m_MaxZones,
+		this->m_StatisticFlags ? (this->m_InheritedQueries ? "pipeline statistics" : "pipeline statistics without secondaries") : "no pipeline statistics",
+		this->m_GetCalibratedTimestamps ? "calibrated timestamps" : "calibrated once by a submission");
+
+}
+
+void GpuProfiler::Shutdown()
+{
+
+	this->m_Enabled = false;
+	this->m_Current = nullptr;
+	this->m_Frames.clear();
+
+}
+
+void GpuProfiler::BeginFrame(uint32_t slot, uint64_t frame)
+{
+
+	if (!this->m_Enabled)
+		return;
+
+	this->Calibrate();
+
+	FrameQueries &queries = this->m_Frames[slot];
+	this->Collect(queries);
+
+	queries.ZoneCount = 0;
+	queries.StatisticsRecorded = false;
+
+	this->m_Current = &queries;
+	this->m_ZoneCount = 0;
+	this->m_Frame = frame;
+
+	std::lock_guard<std::mutex> lock(this->m_Mutex);
+	this->TrimEvents();
+
+}
+
+void GpuProfiler::EndFrame()
+{
+
+	if (!this->m_Enabled || !this->m_Current)
+		return;
+
+	this->m_Current->ZoneCount = std::min(this->m_ZoneCount.load(), this->m_MaxZones);
+	this->m_Current->Frame = this->m_Frame;
+	this->m_Current->Pending = true;
+	this->m_Current = nullptr;
+
+}
+
+void GpuProfiler::Flush()
+{
+
+	if (!this->m_Enabled)
+		return;
+
+	std::vector<FrameQueries *> pending;
+	for (FrameQueries &queries : this->m_Frames)
+	{
+		if (queries.Pending)
+			pending.push_back(&queries);
+	}
+
+	std::sort(pending.begin(), pending.end(), [](const FrameQueries *a, const FrameQueries *b) { return a->Frame < b->Frame; });
+
+	for (FrameQueries *queries : pending)
+		this->Collect(*queries);
+
+}
+
+void GpuProfiler::ResetQueries(VkCommandBuffer commandBuffer)
+{
+
+	if (!this->m_Enabled || !this->m_Current)
+		return;
+
+	vkCmdResetQueryPool(commandBuffer, this->m_Current->Timestamps, 0, this->m_MaxZones * 2);
+
+	if (this->m_StatisticFlags)
+		vkCmdResetQueryPool(commandBuffer, this->m_Current->Statistics, 0, 1);
+
+}
+
+uint32_t GpuProfiler::BeginZone(VkCommandBuffer commandBuffer, const char *name)
+{
+
+	if (!this->m_Enabled || !this->m_Current)
+		return INVALID_ZONE;
+
+	uint32_t zone = this->m_ZoneCount.fetch_add(1);
+	if (zone >= this->m_MaxZones)
+		return INVALID_ZONE;
+
+	this->m_Current->ZoneNames[zone] = name;
+	vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, this->m_Current->Timestamps, zone * 2);
+
+	return zone;
+
+}
+
+void GpuProfiler::EndZone(VkCommandBuffer commandBuffer, uint32_t zone)
+{
+
+	if (zone == INVALID_ZONE || !this->m_Current)
+		return;
+
+	vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, this->m_Current->Timestamps, zone * 2 + 1);
+
+}
+
+bool GpuProfiler::BeginStatistics(VkCommandBuffer commandBuffer, bool secondaries)
+{
+
+	if (!this->m_Enabled || !this->m_Current || !this->m_StatisticFlags)
+		return false;
+
+	if (secondaries && !this->m_InheritedQueries)
+		return false;
+
+	vkCmdBeginQuery(commandBuffer, this->m_Current->Statistics, 0, 0);
+	this->m_Current->StatisticsRecorded = true;
+
+	return true;
+
+}
+
+void GpuProfiler::EndStatistics(VkCommandBuffer commandBuffer)
+{
+
+	if (this->m_Current && this->m_Current->StatisticsRecorded)
+		vkCmdEndQuery(commandBuffer, this->m_Current->Statistics, 0);
+
+}
+
+void GpuProfiler::Collect(FrameQueries &queries)
+{
+
+	if (!queries.Pending)
+		return;
+
+	queries.Pending = false;
+
+	// Not ready only means some zone was left open, the availability values tell which.
+	// Every value is followed by its availability.
+	uint32_t queryCount = queries.ZoneCount * 2;
+	this->m_Results.assign((size_t) queryCount * 2, 0);
+
+	if (queryCount)
+	{
+		vkGetQueryPoolResults(this->m_Device, queries.Timestamps, 0, queryCount, this->m_Results.size() * sizeof(uint64_t), this->m_Results.data(),
+			2 * sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+	}
+
+	std::lock_guard<std::mutex> lock(this->m_Mutex);
+
+	double frameStart = -1.0;
+	for (uint32_t zone = 0; zone < queries.ZoneCount; ++zone)
+	{
+		const uint64_t *result = &this->m_Results[(size_t) zone * 4];
+		if (!result[1] || !result[3])
+			continue;
+
+		uint64_t ticks = (result[2] - result[0]) & this->m_TimestampMask;
+
+		TraceEvent event;
+		event.Name = queries.ZoneNames[zone];
+		event.Frame = queries.Frame;
+		event.StartMicros = this->ToMicros(result[0]);
+		event.DurationMicros = ticks * this->m_TimestampPeriod / 1000.0;
+		this->m_Events.push_back(event);
+
+		ZoneTotals &totals = this->m_GpuTotals[event.Name];
+		totals.Millis += event.DurationMicros / 1000.0;
+		++totals.Count;
+
+		if (frameStart < 0.0 || event.StartMicros < frameStart)
+			frameStart = event.StartMicros;
+	}
+
+	if (queries.StatisticsRecorded)
+	{
+		uint64_t values[STATISTIC_COUNT + 1] = {};
+		VkResult result = vkGetQueryPoolResults(this->m_Device, queries.Statistics, 0, 1, sizeof(values), values, sizeof(values),
+			VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+
+		if (result == VK_SUCCESS && values[STATISTIC_COUNT])
+		{
+			StatisticsSample sample;
+			sample.Frame = queries.Frame;
+			sample.Micros = frameStart < 0.0 ? this->ToMicros(std::chrono::steady_clock::now()) : frameStart;
+			std::memcpy(&sample.Counters, values, sizeof(sample.Counters));
+			this->m_Statistics.push_back(sample);
+
+			for (uint32_t i = 0; i < STATISTIC_COUNT; ++i)
+				reinterpret_cast<uint64_t *>(&this->m_StatisticTotals)[i] += values[i];
+
+			++this->m_StatisticFrames;
+		}
+	}
+
+	++this->m_CollectedFrames;
+
+}
+
+void GpuProfiler::Calibrate()
+{
+
+	if (!this->m_GetCalibratedTimestamps)
+	{
+		if (!this->m_Calibrated)
+			this->CalibrateWithSubmit();
+
+		return;
+	}
+
+	// Only the device clock is sampled, steady_clock is read around the call. That is off by
+	// the duration of the call at most, and needs no knowledge of which clock steady_clock is.
+	VkCalibratedTimestampInfoEXT timestampInfo = {};
+	timestampInfo.sType = VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT;
+	timestampInfo.timeDomain = VK_TIME_DOMAIN_DEVICE_EXT;
+
+	uint64_t ticks = 0;
+	uint64_t maxDeviation = 0;
+
+	auto before = std::chrono::steady_clock::now();
+	VkResult result = this->m_GetCalibratedTimestamps(this->m_Device, 1, &timestampInfo, &ticks, &maxDeviation);
+	auto after = std::chrono::steady_clock::now();
+
+	// A submission would reset the first slot's queries, which a frame in flight may still use.
+	// Once calibrated, a failure keeps the last point and the clocks are no longer renewed.
+	if (result != VK_SUCCESS)
+	{
+		this->m_GetCalibratedTimestamps = nullptr;
+
+		if (this->m_Calibrated)
+		{
+			LOG_VK_WARNING("Calibrated device timestamps failed, keeping the last calibration");
+			return;
+		}
+
+		LOG_VK_WARNING("Calibrated device timestamps failed, calibrating once by a submission instead");
+		this->CalibrateWithSubmit();
+		return;
+	}
+
+	this->m_CalibrationTicks = ticks & this->m_TimestampMask;
+	this->m_CalibrationMicros = (this->ToMicros(before) + this->ToMicros(after)) / 2.0;
+	this->m_Calibrated = true;
+
+}
+
+void GpuProfiler::CalibrateWithSubmit()
+{
+
+	// The timestamp is written somewhere between the submission and the fence signaling,
+	// taking the midpoint is off by up to half of that. Only ever done before the first
+	// frame is recorded, so it cannot stall the frame loop later on.
+	UniqueCommandPool commandPool;
+	UniqueFence fence;
+
+	VkCommandPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.queueFamilyIndex = this->m_QueueFamily;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+	VkFenceCreateInfo fenceInfo = {};
+	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+	if (vkCreateCommandPool(this->m_Device, &poolInfo, nullptr, commandPool.Replace(this->m_Device)) != VK_SUCCESS
+	|| vkCreateFence(this->m_Device, &fenceInfo, nullptr, fence.Replace(this->m_Device)) != VK_SUCCESS)
+	{
+		LOG_VK_CRITICAL("Failed to create the profiler calibration objects!");
+		exit(-1);
+	}
+
+	VkCommandBufferAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.commandPool = commandPool;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandBufferCount = 1;
+
+	VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+	if (vkAllocateCommandBuffers(this->m_Device, &allocInfo, &commandBuffer) != VK_SUCCESS)
+	{
+		LOG_VK_CRITICAL("Failed to allocate the profiler calibration command buffer!");
+		exit(-1);
+	}
+
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	// The first slot's pool is reset again by its first frame
+	VkQueryPool queryPool = this->m_Frames[0].Timestamps;
+
+	vkBeginCommandBuffer(commandBuffer, &beginInfo);
+	vkCmdResetQueryPool(commandBuffer, queryPool, 0, 1);
+	vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 0);
+	vkEndCommandBuffer(commandBuffer);
+
+	VkSubmitInfo submitInfo = {};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &commandBuffer;
+
+	auto before = std::chrono::steady_clock::now();
+	if (vkQueueSubmit(this->m_Queue, 1, &submitInfo, fence) != VK_SUCCESS)
+	{
+		LOG_VK_CRITICAL("Failed to submit the profiler calibration!");
+		exit(-1);
+	}
+
+	vkWaitForFences(this->m_Device, 1, fence.GetAddress(), VK_TRUE, UINT64_MAX);
+	auto after = std::chrono::steady_clock::now();
+
+	uint64_t ticks = 0;
+	vkGetQueryPoolResults(this->m_Device, queryPool, 0, 1, sizeof(ticks), &ticks, sizeof(ticks), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+
+	this->m_CalibrationTicks = ticks & this->m_TimestampMask;
+	this->m_CalibrationMicros = (this->ToMicros(before) + this->ToMicros(after)) / 2.0;
+	this->m_Calibrated = true;
+
+	LOG_INFO("GPU clock calibrated by a submission, accurate to {0:.1f}us",
+		std::chrono::duration<double, std::micro>(after - before).count() / 2.0);
+
+}
+
+double GpuProfiler::ToMicros(uint64_t ticks) const
+{
+
+	// Timestamps before the calibration point come out negative, also across a wrap of the valid bits
+	int64_t delta = (int64_t) ((ticks - this->m_CalibrationTicks) & this->m_TimestampMask);
+	if (this->m_TimestampValidBits < 64 && delta >= (int64_t) (1ull << (this->m_TimestampValidBits - 1)))
+		delta -= (int64_t) (1ull << this->m_TimestampValidBits);
+
+	return this->m_CalibrationMicros + delta * this->m_TimestampPeriod / 1000.0;
+
+}
+
+double GpuProfiler::ToMicros(std::chrono::steady_clock::time_point time) const
+{
+
+	return std::chrono::duration<double, std::micro>(time - this->m_Epoch).count();
+
+}
+
+void GpuProfiler::TrimEvents()
+{
+
+	// Events arrive in frame order, a few frames late
+	uint64_t frame = this->m_Frame;
+
+	while (!this->m_Events.empty() && this->m_Events.front().Frame + this->m_TraceFrames <= frame)
+		this->m_Events.pop_front();
+
+	while (!this->m_Statistics.empty() && this->m_Statistics.front().Frame + this->m_TraceFrames <= frame)
+		this->m_Statistics.pop_front();
+
+}
+
+bool GpuProfiler::WriteTrace(const std::string &path) const
+{
+
+	if (!this->m_Enabled)
+		return false;
+
+	std::ofstream file(path);
+	if (!file.is_open())
+	{
+		LOG_ERROR("Failed to write the GPU profile: {0}", path);
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(this->m_Mutex);
+
+	file << std::fixed << std::setprecision(3);
+	file << "{\n";
+	file << "\"displayTimeUnit\": \"ms\",\n";
+	file << "\"traceEvents\": [\n";
+
+	file << "{ \"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 0, \"args\": { \"name\": \"CPU\" } },\n";
+	file << "{ \"name\": \"process_name\", \"ph\": \"M\", \"pid\": " << GPU_PROCESS << ", \"tid\": 0, \"args\": { \"name\": \"GPU\" } },\n";
+	file << "{ \"name\": \"thread_name\", \"ph\": \"M\", \"pid\": " << GPU_PROCESS << ", \"tid\": 0, \"args\": { \"name\": \"graphics queue\" } }";
+
+	util::Profiler::WriteTraceEvents(file);
+
+	for (const TraceEvent &event : this->m_Events)
+	{
+		file << ",\n{ \"name\": \"" << EscapeJson(event.Name) << "\", "
+			<< "\"cat\": \"gpu\", "
+			<< "\"ph\": \"X\", "
+			<< "\"pid\": " << GPU_PROCESS << ", "
+			<< "\"tid\": 0, "
+			<< "\"ts\": " << event.StartMicros << ", "
+			<< "\"dur\": " << event.DurationMicros << ", "
+			<< "\"args\": { \"frame\": " << event.Frame << " } }";
+	}
+
+	for (const StatisticsSample &sample : this->m_Statistics)
+	{
+		const PipelineStatistics &counters = sample.Counters;
+		file << ",\n{ \"name\": \"pipeline statistics\", \"ph\": \"C\", \"pid\": " << GPU_PROCESS << ", "
+			<< "\"ts\": " << sample.Micros << ", "
+			<< "\"args\": { "
+			<< "\"input_vertices\": " << counters.InputVertices << ", "
+			<< "\"input_primitives\": " << counters.InputPrimitives << ", "
+			<< "\"vertex_invocations\": " << counters.VertexInvocations << ", "
+			<< "\"clipping_invocations\": " << counters.ClippingInvocations << ", "
+			<< "\"clipping_primitives\": " << counters.ClippingPrimitives << ", "
+			<< "\"fragment_invocations\": " << counters.FragmentInvocations << ", "
+			<< "\"compute_invocations\": " << counters.ComputeInvocations << " } }";
+	}
+
+	file << "\n]\n";
+	file << "}\n";
+
+	if (!file.good())
+	{
+		LOG_ERROR("Failed to write the GPU profile: {0}", path);
+		return false;
+	}
+
+	LOG_INFO("Wrote GPU profile of the last {0} frames to {1}", std::min<uint64_t>(this->m_TraceFrames, this->m_CollectedFrames), path);
+	return true;
+
+}
+
+void GpuProfiler::LogSummary() const
+{
+
+	if (!this->m_Enabled || !this->m_CollectedFrames)
+		return;
+
+	std::lock_guard<std::mutex> lock(this->m_Mutex);
+
+	// Zones that occur several times a frame, like one per recording thread, are summed up per frame
+	std::vector<std::pair<std::string, ZoneTotals>> zones(this->m_GpuTotals.begin(), this->m_GpuTotals.end());
+	std::sort(zones.begin(), zones.end(), [](const auto &a, const auto &b) { return a.second.Millis > b.second.Millis; });
+
+	double frames = (double) this->m_CollectedFrames;
+	LOG_INFO("GPU time per frame over {0} frames:", this->m_CollectedFrames);
+
+	for (const auto &zone : zones)
+	{
+		LOG_INFO("\t{0:<16} {1:>8.3f}ms {2:>6.1f}x", zone.first, zone.second.Millis / frames, zone.second.Count / frames);
+	}
+
+	if (this->m_StatisticFrames)
+	{
+		const PipelineStatistics &totals = this->m_StatisticTotals;
+		double statisticFrames = (double) this->m_StatisticFrames;
+
+		LOG_INFO("Pipeline statistics per frame: {0:.0f} vertices, {1:.0f} primitives, {2:.0f} vertex invocations, "
+			"{3:.0f} primitives clipped into {4:.0f}, {5:.0f} fragment invocations, {6:.0f} compute invocations",
+			totals.InputVertices / statisticFrames, totals.InputPrimitives / statisticFrames,
+			totals.VertexInvocations / statisticFrames, totals.ClippingInvocations / statisticFrames,
+			totals.ClippingPrimitives / statisticFrames, totals.FragmentInvocations / statisticFrames,
+			totals.ComputeInvocations / statisticFrames);
+	}
+
+}
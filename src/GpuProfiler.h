@@ -0,0 +1,183 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+#include "DeviceCapabilities.h"
+#include "VulkanHandle.h"
+
+// One frame's pipeline statistics query, in the order the device returns the counters
+struct PipelineStatistics
+{
+	uint64_t InputVertices = 0;
+	uint64_t InputPrimitives = 0;
+	uint64_t VertexInvocations = 0;
+	uint64_t ClippingInvocations = 0;
+	uint64_t ClippingPrimitives = 0;
+	uint64_t FragmentInvocations = 0;
+	uint64_t ComputeInvocations = 0;
+};
+
+// Times zones of the graphics command buffers with timestamp queries and counts pipeline
+// statistics. Every frame in flight has its own query pools, read back once the frame pacer
+// hands the slot out again, so results arrive a few frames late but are never waited for.
+// GPU ticks are moved onto the CPU clock through a calibration point, so the trace lines up
+// with the CPU zones of util::Profiler (chrome://tracing or ui.perfetto.dev).
+class GpuProfiler
+{
+
+public:
+	static const uint32_t INVALID_ZONE = UINT32_MAX;
+
+	// GPU time of the commands recorded into commandBuffer from construction to destruction
+	class GpuZone
+	{
+
+	public:
+		GpuZone(GpuProfiler &profiler, VkCommandBuffer commandBuffer, const char *name);
+		~GpuZone();
+
+	private:
+		GpuProfiler &m_Profiler;
+		VkCommandBuffer m_CommandBuffer;
+		uint32_t m_Zone;
+
+	};
+
+	// Profiles the given queue with one set of query pools per frame slot and keeps the last
+	// traceFrames frames for the trace. enabledFeatures are the features the device was created
+	// with. Every call is a no-op when the queue family has no timestamps.
+	void Init(VkDevice device, const DeviceCapabilities &caps, const VkPhysicalDeviceFeatures &enabledFeatures,
+		bool calibratedTimestamps, VkQueue queue, uint32_t queueFamily, uint32_t frameCount, uint32_t traceFrames);
+
+	// The device must be idle
+	void Shutdown();
+
+	// Right after the frame pacer handed out slot, whose previous frame has completed.
+	// Collects that frame's results without waiting.
+	void BeginFrame(uint32_t slot, uint64_t frame);
+
+	// After the frame's command buffers were submitted
+	void EndFrame();
+
+	// Collects every submitted frame, the device must be idle
+	void Flush();
+
+	// First command of the frame's primary command buffer, outside any render pass
+	void ResetQueries(VkCommandBuffer commandBuffer);
+
+	// Any thread may record zones into the frame's command buffers, secondaries included.
+	// Names have to outlive the profiler. Zones past the per-frame limit are dropped.
+	uint32_t BeginZone(VkCommandBuffer commandBuffer, const char *name);
+	void EndZone(VkCommandBuffer commandBuffer, uint32_t zone);
+
+	// Counts everything between the two calls in the primary command buffer, once per frame.
+	// Returns false when unsupported, or when secondaries are executed inside and the device
+	// cannot inherit the query.
+	bool BeginStatistics(VkCommandBuffer commandBuffer, bool secondaries);
+	void EndStatistics(VkCommandBuffer commandBuffer);
+
+	// For the inheritance info of secondaries executed while the statistics query is active
+	inline VkQueryPipelineStatisticFlags GetInheritedStatistics() const { return m_InheritedQueries ? m_StatisticFlags : 0; }
+
+	// Includes the CPU history of util::Profiler
+	bool WriteTrace(const std::string &path) const;
+	void LogSummary() const;
+
+	inline bool IsEnabled() const { return m_Enabled; }
+
+private:
+	struct FrameQueries
+	{
+		UniqueQueryPool Timestamps;
+		UniqueQueryPool Statistics;
+
+		// Indexed by zone, the begin and end timestamps are queries 2 * zone and 2 * zone + 1
+		std::vector<const char *> ZoneNames;
+		uint32_t ZoneCount = 0;
+		bool StatisticsRecorded = false;
+
+		// Submitted and not collected yet
+		bool Pending = false;
+		uint64_t Frame = 0;
+	};
+
+	struct TraceEvent
+	{
+		const char *Name = nullptr;
+		uint64_t Frame = 0;
+		double StartMicros = 0.0;
+		double DurationMicros = 0.0;
+	};
+
+	struct StatisticsSample
+	{
+		uint64_t Frame = 0;
+		double Micros = 0.0;
+		PipelineStatistics Counters;
+	};
+
+	struct ZoneTotals
+	{
+		double Millis = 0.0;
+		uint64_t Count = 0;
+	};
+
+	void Collect(FrameQueries &queries);
+	void Calibrate();
+	void CalibrateWithSubmit();
+	double ToMicros(uint64_t ticks) const;
+	double ToMicros(std::chrono::steady_clock::time_point time) const;
+	void TrimEvents();
+
+private:
+	bool m_Enabled = false;
+	VkDevice m_Device = VK_NULL_HANDLE;
+	VkQueue m_Queue = VK_NULL_HANDLE;
+	uint32_t m_QueueFamily = 0;
+
+	uint32_t m_MaxZones = 0;
+	uint32_t m_TraceFrames = 0;
+	uint64_t m_TimestampMask = 0;
+	uint32_t m_TimestampValidBits = 0;
+	double m_TimestampPeriod = 1.0;
+
+	VkQueryPipelineStatisticFlags m_StatisticFlags = 0;
+	bool m_InheritedQueries = false;
+
+	std::vector<FrameQueries> m_Frames;
+	FrameQueries *m_Current = nullptr;
+	std::atomic<uint32_t> m_ZoneCount = 0;
+	std::atomic<uint64_t> m_Frame = 0;
+
+	// A GPU tick and the steady_clock time it was taken at. With calibrated timestamps it
+	// is renewed every frame, otherwise taken once by waiting on a timestamp.
+	PFN_vkGetCalibratedTimestampsEXT m_GetCalibratedTimestamps = nullptr;
+	bool m_Calibrated = false;
+	uint64_t m_CalibrationTicks = 0;
+	double m_CalibrationMicros = 0.0;
+
+	// Trace times are microseconds since util::Profiler's epoch
+	std::chrono::steady_clock::time_point m_Epoch;
+
+	// Only written on the frame loop thread, guarded for the trace and summary
+	mutable std::mutex m_Mutex;
+	std::deque<TraceEvent> m_Events;
+	std::deque<StatisticsSample> m_Statistics;
+
+	std::unordered_map<std::string, ZoneTotals> m_GpuTotals;
+	PipelineStatistics m_StatisticTotals;
+	uint64_t m_StatisticFrames = 0;
+	uint64_t m_CollectedFrames = 0;
+
+	std::vector<uint64_t> m_Results;
+
+};
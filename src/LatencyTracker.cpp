@@ -0,0 +1,207 @@
+#include "LatencyTracker.h"
+#include "Log.h"
+
+#include <algorithm>
+
+// Frames are dropped from the pending list if their timing never shows up, e.g. replaced in mailbox mode
+static const size_t MAX_PENDING_PRESENTS = 64;
+
+// Upper bound for the input delay, about two frames at 60Hz
+static const double MAX_INPUT_DELAY_MILLIS = 33.0;
+
+// Fraction of the measured slack applied per frame, below 1 so the delay settles instead of oscillating
+static const double INPUT_DELAY_GAIN = 0.5;
+
+static double ElapsedMillis(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to)
+{
+	return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+void LatencyTracker::Init(VkDevice device, LatencyMeasurement measurement)
+{
+
+	this->m_Device = device;
+	this->m_Measurement = measurement;
+
+	if (measurement == LatencyMeasurement::DisplayTiming)
+	{
+		this->m_GetPastPresentationTiming = (PFN_vkGetPastPresentationTimingGOOGLE) vkGetDeviceProcAddr(device, "vkGetPastPresentationTimingGOOGLE");
+		if (!this->m_GetPastPresentationTiming)
+			this->m_Measurement = LatencyMeasurement::CpuEstimate;
+	}
+	else if (measurement == LatencyMeasurement::PresentWait)
+	{
+		this->m_WaitForPresent = (PFN_vkWaitForPresentKHR) vkGetDeviceProcAddr(device, "vkWaitForPresentKHR");
+		if (!this->m_WaitForPresent)
+			this->m_Measurement = LatencyMeasurement::CpuEstimate;
+	}
+
+	if (this->m_Measurement != measurement)
+		LOG_WARNING("{0} entry points are missing, estimating latency on the CPU", MeasurementToString(measurement));
+
+	LOG_INFO("Measuring input latency with {0}", MeasurementToString(this->m_Measurement));
+
+}
+
+void LatencyTracker::SetSwapChain(VkSwapchainKHR swapChain)
+{
+
+	this->m_SwapChain = swapChain;
+	this->m_Pending.clear();
+
+}
+
+void LatencyTracker::MarkInputSampled()
+{
+
+	this->m_InputTime = std::chrono::steady_clock::now();
+
+}
+
+void LatencyTracker::ChainPresentInfo(VkPresentInfoKHR &presentInfo)
+{
+
+	// Present ids have to increase per swap chain, they simply keep counting across recreations
+	++this->m_PresentId;
+
+	if (this->m_Measurement == LatencyMeasurement::DisplayTiming)
+	{
+		// No desired time, the image is shown as soon as possible
+		this->m_PresentTime.presentID = (uint32_t) this->m_PresentId;
+		this->m_PresentTime.desiredPresentTime = 0;
+
+		this->m_PresentTimesInfo.sType = VK_STRUCTURE_TYPE_PRESENT_TIMES_INFO_GOOGLE;
+		this->m_PresentTimesInfo.pNext = presentInfo.pNext;
+		this->m_PresentTimesInfo.swapchainCount = 1;
+		this->m_PresentTimesInfo.pTimes = &this->m_PresentTime;
+		presentInfo.pNext = &this->m_PresentTimesInfo;
+	}
+	else if (this->m_Measurement == LatencyMeasurement::PresentWait)
+	{
+		this->m_PresentIdValue = this->m_PresentId;
+
+		this->m_PresentIdInfo.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR;
+		this->m_PresentIdInfo.pNext = presentInfo.pNext;
+		this->m_PresentIdInfo.swapchainCount = 1;
+		this->m_PresentIdInfo.pPresentIds = &this->m_PresentIdValue;
+		presentInfo.pNext = &this->m_PresentIdInfo;
+	}
+
+}
+
+void LatencyTracker::MarkPresented()
+{
+
+	if (this->m_Measurement == LatencyMeasurement::CpuEstimate)
+	{
+		this->m_CpuLatencies.push_back(ElapsedMillis(this->m_InputTime, std::chrono::steady_clock::now()));
+		return;
+	}
+
+	PendingPresent pending;
+	pending.PresentId = this->m_PresentId;
+	pending.InputTime = this->m_InputTime;
+	this->m_Pending.push_back(pending);
+
+	if (this->m_Pending.size() > MAX_PENDING_PRESENTS)
+		this->m_Pending.pop_front();
+
+}
+
+void LatencyTracker::Collect(std::vector<double> &latencies)
+{
+
+	switch (this->m_Measurement)
+	{
+	case LatencyMeasurement::DisplayTiming:
+		this->CollectDisplayTiming(latencies);
+		break;
+	case LatencyMeasurement::PresentWait:
+		this->CollectPresentWait(latencies);
+		break;
+	case LatencyMeasurement::CpuEstimate:
+		latencies.insert(latencies.end(), this->m_CpuLatencies.begin(), this->m_CpuLatencies.end());
+		this->m_CpuLatencies.clear();
+		break;
+	}
+
+}
+
+void LatencyTracker::CollectDisplayTiming(std::vector<double> &latencies)
+{
+
+	if (this->m_Pending.empty())
+		return;
+
+	uint32_t count = 0;
+	if (this->m_GetPastPresentationTiming(this->m_Device, this->m_SwapChain, &count, nullptr) != VK_SUCCESS || !count)
+		return;
+
+	this->m_PastTimings.resize(count);
+	VkResult result = this->m_GetPastPresentationTiming(this->m_Device, this->m_SwapChain, &count, this->m_PastTimings.data());
+	if (result != VK_SUCCESS && result != VK_INCOMPLETE)
+		return;
+
+	// Reported in presentation order. The presentation engine reports CLOCK_MONOTONIC
+	// nanoseconds, which is the clock steady_clock reads on Linux.
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		const VkPastPresentationTimingGOOGLE &timing = this->m_PastTimings[i];
+
+		while (!this->m_Pending.empty() && (uint32_t) this->m_Pending.front().PresentId < timing.presentID)
+			this->m_Pending.pop_front();
+
+		if (this->m_Pending.empty() || (uint32_t) this->m_Pending.front().PresentId != timing.presentID)
+			continue;
+
+		uint64_t inputTime = (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(this->m_Pending.front().InputTime.time_since_epoch()).count();
+		if (timing.actualPresentTime > inputTime)
+			latencies.push_back((timing.actualPresentTime - inputTime) / 1000000.0);
+
+		this->m_Pending.pop_front();
+	}
+
+}
+
+void LatencyTracker::CollectPresentWait(std::vector<double> &latencies)
+{
+
+	// A zero timeout only polls, the frame loop never blocks on the display here
+	while (!this->m_Pending.empty())
+	{
+		const PendingPresent &pending = this->m_Pending.front();
+
+		VkResult result = this->m_WaitForPresent(this->m_Device, this->m_SwapChain, pending.PresentId, 0);
+		if (result == VK_TIMEOUT)
+			break;
+
+		if (result != VK_SUCCESS)
+		{
+			this->m_Pending.clear();
+			break;
+		}
+
+		latencies.push_back(ElapsedMillis(pending.InputTime, std::chrono::steady_clock::now()));
+		this->m_Pending.pop_front();
+	}
+
+}
+
+void LatencyTracker::UpdateInputDelay(double blockedMillis, double marginMillis)
+{
+
+	double delay = this->m_InputDelayMillis + INPUT_DELAY_GAIN * (blockedMillis - marginMillis);
+	this->m_InputDelayMillis = std::clamp(delay, 0.0, MAX_INPUT_DELAY_MILLIS);
+
+}
+
+const char *LatencyTracker::MeasurementToString(LatencyMeasurement measurement)
+{
+	switch (measurement)
+	{
+	case LatencyMeasurement::DisplayTiming:	return "VK_GOOGLE_display_timing";
+	case LatencyMeasurement::PresentWait:	return "VK_KHR_present_wait";
+	case LatencyMeasurement::CpuEstimate:	return "CPU estimate";
+	default:								return "UNKNOWN";
+	}
+}
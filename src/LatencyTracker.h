@@ -0,0 +1,86 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <deque>
+#include <vector>
+#include <chrono>
+#include <cstdint>
+
+// How input-to-present latency is measured, from most to least accurate
+enum class LatencyMeasurement
+{
+	// Time the image actually reached the display, from VK_GOOGLE_display_timing
+	DisplayTiming,
+
+	// Time vkWaitForPresentKHR first reports the present id as displayed. Polled once
+	// per frame, so a sample can be late by up to one frame.
+	PresentWait,
+
+	// Time vkQueuePresentKHR returned, misses the compositor and scanout entirely
+	CpuEstimate
+};
+
+// Measures the time from sampling input for a frame until that frame is presented,
+// and paces input sampling: the delay before sampling grows while frames still end up
+// blocked waiting for the GPU or the display, so the wait happens before the input is
+// read instead of after.
+class LatencyTracker
+{
+
+public:
+	void Init(VkDevice device, LatencyMeasurement measurement);
+
+	// Frames still waiting for their presentation timing are dropped
+	void SetSwapChain(VkSwapchainKHR swapChain);
+
+	// Called in this order for every presented frame
+	void MarkInputSampled();
+	void ChainPresentInfo(VkPresentInfoKHR &presentInfo);
+	void MarkPresented();
+
+	// Gathers the latency of frames presented since the last call, in milliseconds
+	void Collect(std::vector<double> &latencies);
+
+	// blockedMillis is the time the last frame spent waiting on the GPU and for an image.
+	// Anything above the margin is added to the delay, anything below taken off it again.
+	void UpdateInputDelay(double blockedMillis, double marginMillis);
+	inline double GetInputDelayMillis() const { return m_InputDelayMillis; }
+
+	inline LatencyMeasurement GetMeasurement() const { return m_Measurement; }
+	static const char *MeasurementToString(LatencyMeasurement measurement);
+
+private:
+	struct PendingPresent
+	{
+		uint64_t PresentId = 0;
+		std::chrono::steady_clock::time_point InputTime;
+	};
+
+	void CollectDisplayTiming(std::vector<double> &latencies);
+	void CollectPresentWait(std::vector<double> &latencies);
+
+private:
+	VkDevice m_Device = VK_NULL_HANDLE;
+	VkSwapchainKHR m_SwapChain = VK_NULL_HANDLE;
+	LatencyMeasurement m_Measurement = LatencyMeasurement::CpuEstimate;
+
+	PFN_vkGetPastPresentationTimingGOOGLE m_GetPastPresentationTiming = nullptr;
+	PFN_vkWaitForPresentKHR m_WaitForPresent = nullptr;
+
+	uint64_t m_PresentId = 0;
+	std::chrono::steady_clock::time_point m_InputTime;
+	std::deque<PendingPresent> m_Pending;
+	std::vector<double> m_CpuLatencies;
+
+	// Referenced by the present info chained in ChainPresentInfo
+	uint64_t m_PresentIdValue = 0;
+	VkPresentIdKHR m_PresentIdInfo = {};
+	VkPresentTimeGOOGLE m_PresentTime = {};
+	VkPresentTimesInfoGOOGLE m_PresentTimesInfo = {};
+
+	std::vector<VkPastPresentationTimingGOOGLE> m_PastTimings;
+
+	double m_InputDelayMillis = 0.0;
+
+};
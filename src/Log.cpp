@@ -1,26 +1,74 @@
 #include "Log.h"
 
+#include <spdlog/sinks/basic_file_sink.h>
+
+#include <vector>
+
+// The Windows console sink uses attribute flags, the ANSI sink escape codes
+#ifdef APP_PLATFORM_WINDOWS
+	#define LOG_COLOR_CYAN(sink) (sink)->CYAN
+#else
+	#define LOG_COLOR_CYAN(sink) (sink)->cyan
+#endif
+
 namespace util {
 
 	std::shared_ptr<spdlog::logger> Log::m_AppLogger = nullptr;
 	std::shared_ptr<spdlog::logger> Log::m_VulkanLogger = nullptr;
+	std::shared_ptr<AsyncLogSink> Log::m_AsyncSink = nullptr;
 
-	void Log::Init()
+	void Log::Init(const LogConfig &config)
 	{
 
-		spdlog::set_pattern("%^[%T] %n: %v%$");
+		auto color_sink = std::make_shared<spdlog::sinks::stdout_color_sink_mt>();
+		color_sink->set_color(spdlog::level::info, LOG_COLOR_CYAN(color_sink));
+
+		std::vector<spdlog::sink_ptr> sinks = { color_sink };
+
+		if (!config.FilePath.empty())
+			sinks.push_back(std::make_shared<spdlog::sinks::basic_file_sink_mt>(config.FilePath, true));
+
+		for (auto &sink : sinks)
+			sink->set_pattern("%^[%T] %n: %v%$");
 
-		m_AppLogger = spdlog::stdout_color_mt("APP");
-		m_AppLogger->set_level(spdlog::level::trace);
+		// Both loggers share one queue so their messages stay in order
+		if (config.Async)
+		{
+			m_AsyncSink = std::make_shared<AsyncLogSink>(sinks, config.QueueSize, config.Overflow);
+			sinks = { m_AsyncSink };
+		}
 
-		m_VulkanLogger = spdlog::stdout_color_mt("VULKAN");
-		m_VulkanLogger->set_level(spdlog::level::trace);
+		m_AppLogger = std::make_shared<spdlog::logger>("APP", sinks.begin(), sinks.end());
+		m_VulkanLogger = std::make_shared<spdlog::logger>("VULKAN", sinks.begin(), sinks.end());
 
-		auto color_sink = static_cast<spdlog::sinks::stdout_color_sink_mt *>(m_AppLogger->sinks()[0].get());
-		color_sink->set_color(spdlog::level::info, color_sink->CYAN);
+		// Errors are usually followed by exit(-1), so they wait for the queue to drain
+		m_AppLogger->flush_on(spdlog::level::err);
+		m_VulkanLogger->flush_on(spdlog::level::err);
+
+		SetLevel(config.Level);
+
+	}
+
+	void Log::Flush()
+	{
+
+		m_AppLogger->flush();
+		m_VulkanLogger->flush();
+
+	}
+
+	void Log::SetLevel(spdlog::level::level_enum level)
+	{
+
+		m_AppLogger->set_level(level);
+		m_VulkanLogger->set_level(level);
+
+	}
+
+	uint64_t Log::GetDroppedMessageCount()
+	{
 
-		color_sink = static_cast<spdlog::sinks::stdout_color_sink_mt *>(m_VulkanLogger->sinks()[0].get());
-		color_sink->set_color(spdlog::level::info, color_sink->CYAN);
+		return m_AsyncSink ? m_AsyncSink->GetDroppedCount() : 0;
 
 	}
 }
@@ -4,20 +4,43 @@
 #include <spdlog/sinks/stdout_color_sinks.h>
 
 #include <memory>
+#include <string>
+#include <cstdint>
+
+#include "AsyncLogSink.h"
 
 namespace util {
 
+	struct LogConfig
+	{
+		// Hands messages to a background thread instead of writing them on the calling thread
+		bool Async = true;
+		size_t QueueSize = 8192;
+		LogOverflowPolicy Overflow = LogOverflowPolicy::Block;
+
+		spdlog::level::level_enum Level = spdlog::level::trace;
+
+		// Also write every message to this file, an empty path disables it
+		std::string FilePath;
+	};
+
 	class Log
 	{
 
 	public:
-		static void Init();
+		static void Init(const LogConfig &config = LogConfig());
+		static void Flush();
+
+		static void SetLevel(spdlog::level::level_enum level);
+		static uint64_t GetDroppedMessageCount();
+
 		inline static std::shared_ptr<spdlog::logger>& GetAppLogger() { return m_AppLogger; }
 		inline static std::shared_ptr<spdlog::logger> &GetVulkanLogger() { return m_VulkanLogger; }
 
 	private:
 		static std::shared_ptr<spdlog::logger> m_AppLogger;
 		static std::shared_ptr<spdlog::logger> m_VulkanLogger;
+		static std::shared_ptr<AsyncLogSink> m_AsyncSink;
 
 	};
 
@@ -33,4 +56,4 @@ namespace util {
 #define LOG_VK_INFO(...)		::util::Log::GetVulkanLogger()->info(__VA_ARGS__)
 #define LOG_VK_WARNING(...)		::util::Log::GetVulkanLogger()->warn(__VA_ARGS__)
 #define LOG_VK_ERROR(...)		::util::Log::GetVulkanLogger()->error(__VA_ARGS__)
-#define LOG_VK_CRITICAL(...)	::util::Log::GetVulkanLogger()->critical(__VA_ARGS__)
\ No newline at end of file
+#define LOG_VK_CRITICAL(...)	::util::Log::GetVulkanLogger()->critical(__VA_ARGS__)
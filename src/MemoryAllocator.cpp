@@ -0,0 +1,1039 @@
+#include "MemoryAllocator.h"
+#include "Log.h"
+
+#include <algorithm>
+
+static const VkDeviceSize MIN_SUBALLOCATION_SIZE = 256;
+static const VkDeviceSize DEFAULT_BLOCK_SIZE = 64ull * 1024 * 1024;
+static const VkDeviceSize MIN_BLOCK_SIZE = 1ull * 1024 * 1024;
+
+// Without VK_EXT_memory_budget a heap is assumed to be this full before others get in the way
+static const VkDeviceSize FALLBACK_BUDGET_PERCENT = 80;
+
+// Heaps above this share of their budget are warned about when the budget is logged
+static const double BUDGET_WARNING_RATIO = 0.9;
+
+static VkDeviceSize NextPowerOfTwo(VkDeviceSize value)
+{
+	VkDeviceSize result = 1;
+	while (result < value)
+		result <<= 1;
+
+	return result;
+}
+
+static VkDeviceSize PreviousPowerOfTwo(VkDeviceSize value)
+{
+	VkDeviceSize result = 1;
+	while ((result << 1) <= value)
+		result <<= 1;
+
+	return result;
+}
+
+static VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment)
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+static const char *CategoryToString(MemoryCategory category)
+{
+	switch (category)
+	{
+	case MemoryCategory::Buffer:	return "buffers";
+	case MemoryCategory::Image:		return "images";
+	case MemoryCategory::Staging:	return "staging";
+	case MemoryCategory::Swapchain:	return "swap chain";
+	default:						return "other";
+	}
+}
+
+BuddyAllocator::BuddyAllocator(VkDeviceSize size, VkDeviceSize minBlockSize)
+	: m_MinBlockSize(minBlockSize)
+{
+
+	while (this->OrderSize(this->m_MaxOrder + 1) <= size)
+		++this->m_MaxOrder;
+
+	this->m_FreeLists.resize(this->m_MaxOrder + 1);
+	this->m_FreeLists[this->m_MaxOrder].insert(0);
+
+}
+
+uint32_t BuddyAllocator::OrderForSize(VkDeviceSize size) const
+{
+
+	uint32_t order = 0;
+	while (this->OrderSize(order) < size)
+		++order;
+
+	return order;
+
+}
+
+bool BuddyAllocator::Allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize &offset)
+{
+
+	uint32_t order = this->OrderForSize(std::max(size, alignment));
+	if (order > this->m_MaxOrder)
+		return false;
+
+	uint32_t current = order;
+	while (current <= this->m_MaxOrder && this->m_FreeLists[current].empty())
+		++current;
+
+	if (current > this->m_MaxOrder)
+		return false;
+
+	VkDeviceSize blockOffset = *this->m_FreeLists[current].begin();
+	this->m_FreeLists[current].erase(this->m_FreeLists[current].begin());
+
+	// Split down to the requested order, keeping the lower half each time
+	while (current > order)
+	{
+		--current;
+		this->m_FreeLists[current].insert(blockOffset + this->OrderSize(current));
+	}
+
+	this->m_Allocated[blockOffset] = order;
+	this->m_UsedSize += this->OrderSize(order);
+
+	offset = blockOffset;
+	return true;
+
+}
+
+void BuddyAllocator::Free(VkDeviceSize offset)
+{
+
+	auto it = this->m_Allocated.find(offset);
+	if (it == this->m_Allocated.end())
+	{
+		LOG_VK_ERROR("Freeing an unknown sub-allocation at offset {0}!", offset);
+		return;
+	}
+
+	uint32_t order = it->second;
+	this->m_Allocated.erase(it);
+	this->m_UsedSize -= this->OrderSize(order);
+
+	// Merge with the buddy for as long as it is free as well
+	while (order < this->m_MaxOrder)
+	{
+		VkDeviceSize buddy = offset ^ this->OrderSize(order);
+
+		auto buddyIt = this->m_FreeLists[order].find(buddy);
+		if (buddyIt == this->m_FreeLists[order].end())
+			break;
+
+		this->m_FreeLists[order].erase(buddyIt);
+		offset = std::min(offset, buddy);
+		++order;
+	}
+
+	this->m_FreeLists[order].insert(offset);
+
+}
+
+VkDeviceSize BuddyAllocator::GetLargestFreeBlock() const
+{
+
+	for (uint32_t order = this->m_MaxOrder + 1; order > 0; --order)
+	{
+		if (!this->m_FreeLists[order - 1].empty())
+			return this->OrderSize(order - 1);
+	}
+
+	return 0;
+
+}
+
+struct AllocationRecord
+{
+	VkDeviceSize Size = 0;
+	VkDeviceSize Alignment = 0;
+	bool Movable = false;
+	void *UserData = nullptr;
+	MemoryCategory Category = MemoryCategory::Other;
+};
+
+struct MemoryBlock
+{
+	VkDeviceMemory Memory = VK_NULL_HANDLE;
+	void *MappedData = nullptr;
+	uint32_t MemoryType = 0;
+	ResourceKind Kind = ResourceKind::Linear;
+
+	BuddyAllocator Buddy;
+	std::unordered_map<VkDeviceSize, AllocationRecord> Records;
+
+	MemoryBlock(VkDeviceSize size)
+		: Buddy(size, MIN_SUBALLOCATION_SIZE)
+	{
+	}
+};
+
+MemoryAllocator::MemoryAllocator() = default;
+MemoryAllocator::~MemoryAllocator() = default;
+
+void MemoryAllocator::Init(VkPhysicalDevice physicalDevice, VkDevice device, bool memoryBudget)
+{
+
+	this->m_PhysicalDevice = physicalDevice;
+	this->m_Device = device;
+	this->m_MemoryBudget = memoryBudget;
+
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &this->m_MemoryProperties);
+
+	VkPhysicalDeviceProperties props = {};
+	vkGetPhysicalDeviceProperties(physicalDevice, &props);
+	this->m_MaxAllocationCount = props.limits.maxMemoryAllocationCount;
+
+	// Small heaps (e.g. the 256MB host-visible device-local window) get
+	// smaller blocks so a single block never takes a large share of them.
+	for (uint32_t i = 0; i < this->m_MemoryProperties.memoryTypeCount; ++i)
+	{
+		uint32_t heapIndex = this->m_MemoryProperties.memoryTypes[i].heapIndex;
+		VkDeviceSize heapSize = this->m_MemoryProperties.memoryHeaps[heapIndex].size;
+
+		VkDeviceSize blockSize = std::min(DEFAULT_BLOCK_SIZE, PreviousPowerOfTwo(heapSize / 8));
+		this->m_BlockSizes[i] = std::max(blockSize, MIN_BLOCK_SIZE);
+	}
+
+	this->UpdateBudget();
+
+	LOG_VK_INFO("Initialized memory allocator ({0} memory types, {1} heaps, allocation limit {2}, {3})",
+		this->m_MemoryProperties.memoryTypeCount,
+		this->m_MemoryProperties.memoryHeapCount,
+		this->m_MaxAllocationCount,
+		memoryBudget ? "driver memory budget" : "estimated memory budget");
+
+}
+
+void MemoryAllocator::Shutdown()
+{
+
+	std::lock_guard<std::mutex> lock(this->m_Mutex);
+
+	uint32_t leaked = 0;
+	for (uint32_t type = 0; type < VK_MAX_MEMORY_TYPES; ++type)
+	{
+		leaked += this->m_DedicatedCount[type];
+
+		for (auto &blocks : this->m_Blocks[type])
+		{
+			for (auto &block : blocks)
+			{
+				leaked += (uint32_t) block->Records.size();
+				this->DestroyBlock(block.get());
+			}
+
+			blocks.clear();
+		}
+	}
+
+	// Freeing mapped memory implicitly unmaps it
+	for (VkDeviceMemory memory : this->m_DedicatedMemory)
+		vkFreeMemory(this->m_Device, memory, nullptr);
+
+	this->m_DedicatedMemory.clear();
+
+	if (leaked)
+		LOG_VK_WARNING("Memory allocator shut down with {0} live allocations!", leaked);
+
+}
+
+bool MemoryAllocator::IsHostVisible(uint32_t memoryType) const
+{
+	return (this->m_MemoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
+}
+
+uint32_t MemoryAllocator::FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred) const
+{
+
+	VkMemoryPropertyFlags desired = required | preferred;
+	uint32_t fallback = UINT32_MAX;
+
+	for (uint32_t i = 0; i < this->m_MemoryProperties.memoryTypeCount; ++i)
+	{
+		if (!(typeFilter & (1u << i)))
+			continue;
+
+		VkMemoryPropertyFlags flags = this->m_MemoryProperties.memoryTypes[i].propertyFlags;
+		if ((flags & desired) == desired)
+			return i;
+
+		if ((flags & required) == required && fallback == UINT32_MAX)
+			fallback = i;
+	}
+
+	return fallback;
+
+}
+
+MemoryBlock *MemoryAllocator::CreateBlock(uint32_t memoryType, ResourceKind kind)
+{
+
+	if (this->m_DeviceMemoryCount >= this->m_MaxAllocationCount)
+		return nullptr;
+
+	VkDeviceSize blockSize = this->m_BlockSizes[memoryType];
+
+	VkMemoryAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = blockSize;
+	allocInfo.memoryTypeIndex = memoryType;
+
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	if (vkAllocateMemory(this->m_Device, &allocInfo, nullptr, &memory) != VK_SUCCESS)
+		return nullptr;
+
+	auto block = std::make_unique<MemoryBlock>(blockSize);
+	block->Memory = memory;
+	block->MemoryType = memoryType;
+	block->Kind = kind;
+
+	if (this->IsHostVisible(memoryType))
+		vkMapMemory(this->m_Device, memory, 0, VK_WHOLE_SIZE, 0, &block->MappedData);
+
+	++this->m_DeviceMemoryCount;
+	this->TrackDeviceMemory(memoryType, blockSize);
+
+	MemoryBlock *result = block.get();
+	this->m_Blocks[memoryType][(size_t) kind].push_back(std::move(block));
+
+	return result;
+
+}
+
+void MemoryAllocator::DestroyBlock(MemoryBlock *block)
+{
+
+	if (block->MappedData)
+		vkUnmapMemory(this->m_Device, block->Memory);
+
+	vkFreeMemory(this->m_Device, block->Memory, nullptr);
+	--this->m_DeviceMemoryCount;
+	this->UntrackDeviceMemory(block->MemoryType, this->m_BlockSizes[block->MemoryType]);
+
+}
+
+void MemoryAllocator::TrackDeviceMemory(uint32_t memoryType, VkDeviceSize size)
+{
+
+	uint32_t heap = this->m_MemoryProperties.memoryTypes[memoryType].heapIndex;
+
+	this->m_HeapBytes[heap] += size;
+	this->m_HeapPeakBytes[heap] = std::max(this->m_HeapPeakBytes[heap], this->m_HeapBytes[heap]);
+
+}
+
+void MemoryAllocator::UntrackDeviceMemory(uint32_t memoryType, VkDeviceSize size)
+{
+
+	uint32_t heap = this->m_MemoryProperties.memoryTypes[memoryType].heapIndex;
+	this->m_HeapBytes[heap] -= size;
+
+}
+
+void MemoryAllocator::TrackAllocation(const MemoryAllocation &allocation)
+{
+
+	MemoryCategoryStatistics &category = this->m_Categories[(size_t) allocation.Category];
+
+	++category.AllocationCount;
+	category.Bytes += allocation.Size;
+	category.PeakBytes = std::max(category.PeakBytes, category.Bytes);
+
+}
+
+void MemoryAllocator::ReleaseEmptyBlocks(uint32_t memoryType, ResourceKind kind)
+{
+
+	// One empty block is kept around so an allocate/free pattern
+	// at the boundary does not turn into vkAllocateMemory churn.
+	auto &blocks = this->m_Blocks[memoryType][(size_t) kind];
+	bool keptEmpty = false;
+
+	for (auto it = blocks.begin(); it != blocks.end();)
+	{
+		if (!(*it)->Buddy.IsEmpty())
+		{
+			++it;
+			continue;
+		}
+
+		if (!keptEmpty)
+		{
+			keptEmpty = true;
+			++it;
+			continue;
+		}
+
+		this->DestroyBlock(it->get());
+		it = blocks.erase(it);
+	}
+
+}
+
+static bool AllocateInBlock(MemoryBlock *block, VkDeviceSize size, VkDeviceSize alignment, const AllocationCreateInfo &allocInfo, MemoryAllocation &allocation)
+{
+
+	VkDeviceSize offset = 0;
+	if (!block->Buddy.Allocate(size, alignment, offset))
+		return false;
+
+	AllocationRecord &record = block->Records[offset];
+	record.Size = size;
+	record.Alignment = alignment;
+	record.Movable = allocInfo.Movable;
+	record.UserData = allocInfo.UserData;
+	record.Category = allocInfo.Category;
+
+	allocation.Memory = block->Memory;
+	allocation.Offset = offset;
+	allocation.Size = size;
+	allocation.MemoryTypeIndex = block->MemoryType;
+	allocation.Category = allocInfo.Category;
+	allocation.MappedData = block->MappedData ? static_cast<char *>(block->MappedData) + offset : nullptr;
+	allocation.Block = block;
+
+	return true;
+
+}
+
+VkResult MemoryAllocator::AllocateFromBlocks(const VkMemoryRequirements &requirements, uint32_t memoryType, ResourceKind kind, const AllocationCreateInfo &allocInfo, MemoryAllocation &allocation)
+{
+
+	for (auto &block : this->m_Blocks[memoryType][(size_t) kind])
+	{
+		if (AllocateInBlock(block.get(), requirements.size, requirements.alignment, allocInfo, allocation))
+			return VK_SUCCESS;
+	}
+
+	MemoryBlock *block = this->CreateBlock(memoryType, kind);
+	if (!block)
+		return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+
+	if (!AllocateInBlock(block, requirements.size, requirements.alignment, allocInfo, allocation))
+		return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+
+	return VK_SUCCESS;
+
+}
+
+VkResult MemoryAllocator::AllocateDedicated(const VkMemoryRequirements &requirements, uint32_t memoryType, VkImage image, VkBuffer buffer, MemoryAllocation &allocation)
+{
+
+	if (this->m_DeviceMemoryCount >= this->m_MaxAllocationCount)
+		return VK_ERROR_TOO_MANY_OBJECTS;
+
+	VkMemoryDedicatedAllocateInfo dedicatedInfo = {};
+	dedicatedInfo.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+	dedicatedInfo.image = image;
+	dedicatedInfo.buffer = buffer;
+
+	VkMemoryAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.pNext = (image || buffer) ? &dedicatedInfo : nullptr;
+	allocInfo.allocationSize = requirements.size;
+	allocInfo.memoryTypeIndex = memoryType;
+
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VkResult result = vkAllocateMemory(this->m_Device, &allocInfo, nullptr, &memory);
+	if (result != VK_SUCCESS)
+		return result;
+
+	allocation.Memory = memory;
+	allocation.Offset = 0;
+	allocation.Size = requirements.size;
+	allocation.MemoryTypeIndex = memoryType;
+	allocation.MappedData = nullptr;
+	allocation.Block = nullptr;
+
+	if (this->IsHostVisible(memoryType))
+		vkMapMemory(this->m_Device, memory, 0, VK_WHOLE_SIZE, 0, &allocation.MappedData);
+
+	++this->m_DeviceMemoryCount;
+	this->m_DedicatedMemory.insert(memory);
+	++this->m_DedicatedCount[memoryType];
+	this->m_DedicatedBytes[memoryType] += requirements.size;
+	this->TrackDeviceMemory(memoryType, requirements.size);
+
+	return VK_SUCCESS;
+
+}
+
+VkResult MemoryAllocator::Allocate(const VkMemoryRequirements &requirements, const AllocationCreateInfo &allocInfo, ResourceKind kind, MemoryAllocation &allocation)
+{
+	return this->AllocateInternal(requirements, allocInfo, kind, VK_NULL_HANDLE, VK_NULL_HANDLE, false, allocation);
+}
+
+VkResult MemoryAllocator::AllocateInternal(const VkMemoryRequirements &requirements, const AllocationCreateInfo &allocInfo, ResourceKind kind, VkImage image, VkBuffer buffer, bool prefersDedicated, MemoryAllocation &allocation)
+{
+
+	std::lock_guard<std::mutex> lock(this->m_Mutex);
+
+	// Walk every compatible memory type, best match first, so running out of
+	// the preferred type degrades to a slower one instead of failing outright.
+	uint32_t typeFilter = requirements.memoryTypeBits;
+	VkResult result = VK_ERROR_OUT_OF_DEVICE_MEMORY;
+
+	while (true)
+	{
+		uint32_t memoryType = this->FindMemoryType(typeFilter, allocInfo.RequiredFlags, allocInfo.PreferredFlags);
+		if (memoryType == UINT32_MAX)
+			return result;
+
+		bool dedicated = allocInfo.Dedicated
+			|| prefersDedicated
+			|| requirements.size > this->m_BlockSizes[memoryType] / 2;
+
+		result = dedicated
+			? this->AllocateDedicated(requirements, memoryType, image, buffer, allocation)
+			: this->AllocateFromBlocks(requirements, memoryType, kind, allocInfo, allocation);
+
+		if (result == VK_SUCCESS)
+		{
+			allocation.Category = allocInfo.Category;
+			this->TrackAllocation(allocation);
+			return result;
+		}
+
+		typeFilter &= ~(1u << memoryType);
+	}
+
+}
+
+VkResult MemoryAllocator::CreateBuffer(const VkBufferCreateInfo &bufferInfo, const AllocationCreateInfo &allocInfo, VkBuffer &buffer, MemoryAllocation &allocation)
+{
+
+	VkResult result = vkCreateBuffer(this->m_Device, &bufferInfo, nullptr, &buffer);
+	if (result != VK_SUCCESS)
+		return result;
+
+	VkMemoryDedicatedRequirements dedicatedRequirements = {};
+	dedicatedRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+
+	VkMemoryRequirements2 requirements = {};
+	requirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+	requirements.pNext = &dedicatedRequirements;
+
+	VkBufferMemoryRequirementsInfo2 requirementsInfo = {};
+	requirementsInfo.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_REQUIREMENTS_INFO_2;
+	requirementsInfo.buffer = buffer;
+
+	vkGetBufferMemoryRequirements2(this->m_Device, &requirementsInfo, &requirements);
+
+	AllocationCreateInfo bufferAllocInfo = allocInfo;
+	if (bufferAllocInfo.Category == MemoryCategory::Other)
+		bufferAllocInfo.Category = MemoryCategory::Buffer;
+
+	bool prefersDedicated = dedicatedRequirements.prefersDedicatedAllocation || dedicatedRequirements.requiresDedicatedAllocation;
+	result = this->AllocateInternal(requirements.memoryRequirements, bufferAllocInfo, ResourceKind::Linear, VK_NULL_HANDLE, buffer, prefersDedicated, allocation);
+
+	if (result == VK_SUCCESS)
+		result = vkBindBufferMemory(this->m_Device, buffer, allocation.Memory, allocation.Offset);
+
+	if (result != VK_SUCCESS)
+	{
+		vkDestroyBuffer(this->m_Device, buffer, nullptr);
+		buffer = VK_NULL_HANDLE;
+		this->Free(allocation);
+	}
+
+	return result;
+
+}
+
+VkResult MemoryAllocator::CreateImage(const VkImageCreateInfo &imageInfo, const AllocationCreateInfo &allocInfo, VkImage &image, MemoryAllocation &allocation)
+{
+
+	VkResult result = vkCreateImage(this->m_Device, &imageInfo, nullptr, &image);
+	if (result != VK_SUCCESS)
+		return result;
+
+	VkMemoryDedicatedRequirements dedicatedRequirements = {};
+	dedicatedRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+
+	VkMemoryRequirements2 requirements = {};
+	requirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+	requirements.pNext = &dedicatedRequirements;
+
+	VkImageMemoryRequirementsInfo2 requirementsInfo = {};
+	requirementsInfo.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2;
+	requirementsInfo.image = image;
+
+	vkGetImageMemoryRequirements2(this->m_Device, &requirementsInfo, &requirements);
+
+	AllocationCreateInfo imageAllocInfo = allocInfo;
+	if (imageAllocInfo.Category == MemoryCategory::Other)
+		imageAllocInfo.Category = MemoryCategory::Image;
+
+	ResourceKind kind = imageInfo.tiling == VK_IMAGE_TILING_LINEAR ? ResourceKind::Linear : ResourceKind::Optimal;
+	bool prefersDedicated = dedicatedRequirements.prefersDedicatedAllocation || dedicatedRequirements.requiresDedicatedAllocation;
+	result = this->AllocateInternal(requirements.memoryRequirements, imageAllocInfo, kind, image, VK_NULL_HANDLE, prefersDedicated, allocation);
+
+	if (result == VK_SUCCESS)
+		result = vkBindImageMemory(this->m_Device, image, allocation.Memory, allocation.Offset);
+
+	if (result != VK_SUCCESS)
+	{
+		vkDestroyImage(this->m_Device, image, nullptr);
+		image = VK_NULL_HANDLE;
+		this->Free(allocation);
+	}
+
+	return result;
+
+}
+
+void MemoryAllocator::DestroyBuffer(VkBuffer buffer, MemoryAllocation &allocation)
+{
+
+	if (buffer)
+		vkDestroyBuffer(this->m_Device, buffer, nullptr);
+
+	this->Free(allocation);
+
+}
+
+void MemoryAllocator::DestroyImage(VkImage image, MemoryAllocation &allocation)
+{
+
+	if (image)
+		vkDestroyImage(this->m_Device, image, nullptr);
+
+	this->Free(allocation);
+
+}
+
+void MemoryAllocator::Free(MemoryAllocation &allocation)
+{
+
+	std::lock_guard<std::mutex> lock(this->m_Mutex);
+	this->FreeLocked(allocation);
+
+}
+
+void MemoryAllocator::FreeLocked(MemoryAllocation &allocation)
+{
+
+	if (!allocation.IsValid())
+		return;
+
+	MemoryCategoryStatistics &category = this->m_Categories[(size_t) allocation.Category];
+	--category.AllocationCount;
+	category.Bytes -= allocation.Size;
+
+	if (allocation.Block)
+	{
+		MemoryBlock *block = allocation.Block;
+		block->Buddy.Free(allocation.Offset);
+		block->Records.erase(allocation.Offset);
+
+		if (block->Buddy.IsEmpty())
+			this->ReleaseEmptyBlocks(block->MemoryType, block->Kind);
+	}
+	else
+	{
+		if (allocation.MappedData)
+			vkUnmapMemory(this->m_Device, allocation.Memory);
+
+		vkFreeMemory(this->m_Device, allocation.Memory, nullptr);
+
+		--this->m_DeviceMemoryCount;
+		this->m_DedicatedMemory.erase(allocation.Memory);
+		--this->m_DedicatedCount[allocation.MemoryTypeIndex];
+		this->m_DedicatedBytes[allocation.MemoryTypeIndex] -= allocation.Size;
+		this->UntrackDeviceMemory(allocation.MemoryTypeIndex, allocation.Size);
+	}
+
+	allocation = MemoryAllocation();
+
+}
+
+std::vector<DefragmentationMove> MemoryAllocator::BeginDefragmentation(uint32_t maxMoves)
+{
+
+	std::lock_guard<std::mutex> lock(this->m_Mutex);
+	std::vector<DefragmentationMove> moves;
+
+	for (uint32_t type = 0; type < this->m_MemoryProperties.memoryTypeCount; ++type)
+	{
+		for (size_t kind = 0; kind < (size_t) ResourceKind::Count; ++kind)
+		{
+			auto &blocks = this->m_Blocks[type][kind];
+			if (blocks.size() < 2)
+				continue;
+
+			// Drain the emptiest blocks into the fullest ones
+			std::vector<MemoryBlock *> sorted;
+			for (auto &block : blocks)
+				sorted.push_back(block.get());
+
+			std::sort(sorted.begin(), sorted.end(), [](const MemoryBlock *a, const MemoryBlock *b)
+			{
+				return a->Buddy.GetUsedSize() < b->Buddy.GetUsedSize();
+			});
+
+			// The data only moves after this returns, so a block that received
+			// allocations must not give any away in the same pass
+			std::vector<bool> destinations(sorted.size(), false);
+
+			for (size_t src = 0; src + 1 < sorted.size(); ++src)
+			{
+				if (destinations[src])
+					continue;
+
+				MemoryBlock *source = sorted[src];
+
+				for (const auto &entry : source->Records)
+				{
+					if (moves.size() >= maxMoves)
+						return moves;
+
+					const AllocationRecord &record = entry.second;
+					if (!record.Movable)
+						continue;
+
+					AllocationCreateInfo allocInfo = {};
+					allocInfo.Movable = true;
+					allocInfo.UserData = record.UserData;
+					allocInfo.Category = record.Category;
+
+					DefragmentationMove move;
+					move.UserData = record.UserData;
+					move.Source.Memory = source->Memory;
+					move.Source.Offset = entry.first;
+					move.Source.Size = record.Size;
+					move.Source.MemoryTypeIndex = source->MemoryType;
+					move.Source.Category = record.Category;
+					move.Source.MappedData = source->MappedData ? static_cast<char *>(source->MappedData) + entry.first : nullptr;
+					move.Source.Block = source;
+
+					for (size_t dst = sorted.size() - 1; dst > src; --dst)
+					{
+						if (AllocateInBlock(sorted[dst], record.Size, record.Alignment, allocInfo, move.Destination))
+						{
+							this->TrackAllocation(move.Destination);
+							moves.push_back(move);
+							destinations[dst] = true;
+							break;
+						}
+					}
+				}
+			}
+		}
+	}
+
+	return moves;
+
+}
+
+void MemoryAllocator::EndDefragmentation(const std::vector<DefragmentationMove> &moves)
+{
+
+	std::lock_guard<std::mutex> lock(this->m_Mutex);
+
+	for (const DefragmentationMove &move : moves)
+	{
+		MemoryAllocation source = move.Source;
+		this->FreeLocked(source);
+	}
+
+	if (!moves.empty())
+		LOG_VK_INFO("Defragmentation relocated {0} allocations, {1} device memory objects remain",
+			moves.size(), this->m_DeviceMemoryCount);
+
+}
+
+MemoryStatistics MemoryAllocator::GetStatistics()
+{
+
+	std::lock_guard<std::mutex> lock(this->m_Mutex);
+	MemoryStatistics stats;
+
+	VkDeviceSize largestFreeTotal = 0;
+
+	for (uint32_t type = 0; type < this->m_MemoryProperties.memoryTypeCount; ++type)
+	{
+		MemoryTypeStatistics &typeStats = stats.Types[type];
+
+		for (auto &blocks : this->m_Blocks[type])
+		{
+			for (auto &block : blocks)
+			{
+				++typeStats.BlockCount;
+				typeStats.AllocationCount += (uint32_t) block->Buddy.GetAllocationCount();
+				typeStats.BlockBytes += block->Buddy.GetSize();
+				typeStats.UsedBytes += block->Buddy.GetUsedSize();
+				typeStats.LargestFreeRange = std::max(typeStats.LargestFreeRange, block->Buddy.GetLargestFreeBlock());
+			}
+		}
+
+		typeStats.DedicatedCount = this->m_DedicatedCount[type];
+		typeStats.DedicatedBytes = this->m_DedicatedBytes[type];
+
+		VkDeviceSize freeBytes = typeStats.BlockBytes - typeStats.UsedBytes;
+		if (freeBytes)
+			typeStats.Fragmentation = 1.0f - (float) typeStats.LargestFreeRange / freeBytes;
+
+		largestFreeTotal += typeStats.LargestFreeRange;
+
+		stats.Total.BlockCount += typeStats.BlockCount;
+		stats.Total.AllocationCount += typeStats.AllocationCount;
+		stats.Total.DedicatedCount += typeStats.DedicatedCount;
+		stats.Total.BlockBytes += typeStats.BlockBytes;
+		stats.Total.UsedBytes += typeStats.UsedBytes;
+		stats.Total.DedicatedBytes += typeStats.DedicatedBytes;
+		stats.Total.LargestFreeRange = std::max(stats.Total.LargestFreeRange, typeStats.LargestFreeRange);
+	}
+
+	// Weighted by each type's free space, a type only ever allocates from its own blocks
+	VkDeviceSize freeTotal = stats.Total.BlockBytes - stats.Total.UsedBytes;
+	if (freeTotal)
+		stats.Total.Fragmentation = 1.0f - (float) largestFreeTotal / freeTotal;
+
+	for (size_t category = 0; category < (size_t) MemoryCategory::Count; ++category)
+		stats.Categories[category] = this->m_Categories[category];
+
+	stats.DeviceMemoryCount = this->m_DeviceMemoryCount;
+	stats.MaxDeviceMemoryCount = this->m_MaxAllocationCount;
+
+	return stats;
+
+}
+
+void MemoryAllocator::LogStatistics()
+{
+
+	MemoryStatistics stats = this->GetStatistics();
+	const double MB = 1024.0 * 1024.0;
+
+	LOG_VK_INFO("Device memory: {0}/{1} allocations, {2} blocks ({3:.2f}MB, {4:.2f}MB used, {5:.0f}% fragmented), {6} dedicated ({7:.2f}MB)",
+		stats.DeviceMemoryCount, stats.MaxDeviceMemoryCount,
+		stats.Total.BlockCount, stats.Total.BlockBytes / MB, stats.Total.UsedBytes / MB, stats.Total.Fragmentation * 100.0f,
+		stats.Total.DedicatedCount, stats.Total.DedicatedBytes / MB);
+
+	for (uint32_t type = 0; type < this->m_MemoryProperties.memoryTypeCount; ++type)
+	{
+		const MemoryTypeStatistics &typeStats = stats.Types[type];
+		if (!typeStats.BlockCount && !typeStats.DedicatedCount)
+			continue;
+
+		LOG_VK_INFO("\tTYPE {0} (heap {1}): {2} sub-allocations in {3} blocks, {4:.2f}/{5:.2f}MB used, largest free range {6:.2f}MB ({7:.0f}% fragmented), {8} dedicated",
+			type, this->m_MemoryProperties.memoryTypes[type].heapIndex,
+			typeStats.AllocationCount, typeStats.BlockCount,
+			typeStats.UsedBytes / MB, typeStats.BlockBytes / MB,
+			typeStats.LargestFreeRange / MB, typeStats.Fragmentation * 100.0f, typeStats.DedicatedCount);
+	}
+
+	for (size_t category = 0; category < (size_t) MemoryCategory::Count; ++category)
+	{
+		const MemoryCategoryStatistics &categoryStats = stats.Categories[category];
+		if (!categoryStats.PeakBytes)
+			continue;
+
+		LOG_VK_INFO("\t{0}: {1} allocations, {2:.2f}MB, peak {3:.2f}MB",
+			CategoryToString((MemoryCategory) category), categoryStats.AllocationCount,
+			categoryStats.Bytes / MB, categoryStats.PeakBytes / MB);
+	}
+
+}
+
+void MemoryAllocator::UpdateBudget()
+{
+
+	if (!this->m_MemoryBudget)
+		return;
+
+	VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProps = {};
+	budgetProps.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+	VkPhysicalDeviceMemoryProperties2 props = {};
+	props.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+	props.pNext = &budgetProps;
+
+	// Under the lock, so no allocation slips in between the driver's numbers and ours
+	std::lock_guard<std::mutex> lock(this->m_Mutex);
+	vkGetPhysicalDeviceMemoryProperties2(this->m_PhysicalDevice, &props);
+
+	for (uint32_t heap = 0; heap < this->m_MemoryProperties.memoryHeapCount; ++heap)
+	{
+		this->m_DriverBudget[heap] = budgetProps.heapBudget[heap];
+		this->m_DriverUsage[heap] = budgetProps.heapUsage[heap];
+		this->m_HeapBytesAtUpdate[heap] = this->m_HeapBytes[heap];
+	}
+
+}
+
+MemoryBudget MemoryAllocator::GetBudget()
+{
+
+	std::lock_guard<std::mutex> lock(this->m_Mutex);
+	return this->GetBudgetLocked();
+
+}
+
+MemoryBudget MemoryAllocator::GetBudgetLocked() const
+{
+
+	MemoryBudget budget;
+	budget.HeapCount = this->m_MemoryProperties.memoryHeapCount;
+
+	for (uint32_t heap = 0; heap < budget.HeapCount; ++heap)
+	{
+		const VkMemoryHeap &memoryHeap = this->m_MemoryProperties.memoryHeaps[heap];
+		MemoryHeapBudget &heapBudget = budget.Heaps[heap];
+
+		heapBudget.Size = memoryHeap.size;
+		heapBudget.DeviceLocal = (memoryHeap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+		heapBudget.AllocatedBytes = this->m_HeapBytes[heap];
+		heapBudget.PeakBytes = this->m_HeapPeakBytes[heap];
+
+		if (!this->m_MemoryBudget)
+		{
+			heapBudget.Budget = memoryHeap.size * FALLBACK_BUDGET_PERCENT / 100;
+			heapBudget.Usage = this->m_HeapBytes[heap];
+			continue;
+		}
+
+		VkDeviceSize before = this->m_HeapBytesAtUpdate[heap];
+		VkDeviceSize now = this->m_HeapBytes[heap];
+
+		heapBudget.Budget = this->m_DriverBudget[heap];
+		heapBudget.Usage = now >= before
+			? this->m_DriverUsage[heap] + (now - before)
+			: this->m_DriverUsage[heap] - std::min(this->m_DriverUsage[heap], before - now);
+	}
+
+	return budget;
+
+}
+
+VkDeviceSize MemoryAllocator::GetHeadroom(VkMemoryHeapFlags heapFlags)
+{
+
+	std::lock_guard<std::mutex> lock(this->m_Mutex);
+	MemoryBudget budget = this->GetBudgetLocked();
+
+	const MemoryHeapBudget *largest = nullptr;
+	for (uint32_t heap = 0; heap < budget.HeapCount; ++heap)
+	{
+		if ((this->m_MemoryProperties.memoryHeaps[heap].flags & heapFlags) != heapFlags)
+			continue;
+
+		if (!largest || budget.Heaps[heap].Size > largest->Size)
+			largest = &budget.Heaps[heap];
+	}
+
+	if (!largest || largest->Usage >= largest->Budget)
+		return 0;
+
+	return largest->Budget - largest->Usage;
+
+}
+
+void MemoryAllocator::LogBudget()
+{
+
+	MemoryBudget budget = this->GetBudget();
+	const double MB = 1024.0 * 1024.0;
+
+	for (uint32_t heap = 0; heap < budget.HeapCount; ++heap)
+	{
+		const MemoryHeapBudget &heapBudget = budget.Heaps[heap];
+		double ratio = heapBudget.Budget ? (double) heapBudget.Usage / heapBudget.Budget : 0.0;
+
+		LOG_VK_INFO("HEAP {0}{1}: {2:.2f}/{3:.2f}MB of the budget used ({4:.0f}%), {5:.2f}MB allocated here, peak {6:.2f}MB, heap size {7:.2f}MB",
+			heap, heapBudget.DeviceLocal ? " (device local)" : "",
+			heapBudget.Usage / MB, heapBudget.Budget / MB, ratio * 100.0,
+			heapBudget.AllocatedBytes / MB, heapBudget.PeakBytes / MB, heapBudget.Size / MB);
+
+		if (ratio > BUDGET_WARNING_RATIO)
+			LOG_VK_WARNING("Heap {0} is at {1:.0f}% of its memory budget!", heap, ratio * 100.0);
+	}
+
+}
+
+void MemoryAllocator::SetExternalBytes(MemoryCategory category, VkDeviceSize bytes)
+{
+
+	std::lock_guard<std::mutex> lock(this->m_Mutex);
+	MemoryCategoryStatistics &categoryStats = this->m_Categories[(size_t) category];
+
+	categoryStats.Bytes = categoryStats.Bytes - this->m_ExternalBytes[(size_t) category] + bytes;
+	categoryStats.PeakBytes = std::max(categoryStats.PeakBytes, categoryStats.Bytes);
+	this->m_ExternalBytes[(size_t) category] = bytes;
+
+}
+
+void FrameLinearAllocator::Init(MemoryAllocator &allocator, VkDeviceSize frameSize, uint32_t frameCount, VkBufferUsageFlags usage)
+{
+
+	this->m_Allocator = &allocator;
+
+	// Keeping every region 256-byte aligned satisfies any offset alignment
+	// the device can report, so alignment only has to be applied within a region.
+	this->m_FrameSize = AlignUp(frameSize, 256);
+
+	VkBufferCreateInfo bufferInfo = {};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = this->m_FrameSize * frameCount;
+	bufferInfo.usage = usage;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	AllocationCreateInfo allocInfo = {};
+	allocInfo.RequiredFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	allocInfo.PreferredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+	if (allocator.CreateBuffer(bufferInfo, allocInfo, this->m_Buffer, this->m_Allocation) != VK_SUCCESS)
+	{
+		LOG_VK_CRITICAL("Failed to create the per-frame linear allocator buffer!");
+		exit(-1);
+	}
+
+}
+
+void FrameLinearAllocator::Shutdown()
+{
+
+	if (this->m_Allocator)
+		this->m_Allocator->DestroyBuffer(this->m_Buffer, this->m_Allocation);
+
+	this->m_Buffer = VK_NULL_HANDLE;
+	this->m_Allocator = nullptr;
+
+}
+
+void FrameLinearAllocator::BeginFrame(uint32_t frameIndex)
+{
+
+	this->m_FrameBase = this->m_FrameSize * frameIndex;
+	this->m_Head.store(0, std::memory_order_relaxed);
+
+}
+
+FrameLinearAllocator::Slice FrameLinearAllocator::Allocate(VkDeviceSize size, VkDeviceSize alignment)
+{
+
+	VkDeviceSize current = this->m_Head.load(std::memory_order_relaxed);
+	VkDeviceSize aligned = 0;
+
+	do
+	{
+		aligned = AlignUp(current, std::max<VkDeviceSize>(alignment, 1));
+		if (aligned + size > this->m_FrameSize)
+			return Slice();
+	}
+	while (!this->m_Head.compare_exchange_weak(current, aligned + size, std::memory_order_relaxed));
+
+	Slice slice;
+	slice.Buffer = this->m_Buffer;
+	slice.Offset = this->m_FrameBase + aligned;
+	slice.Data = static_cast<char *>(this->m_Allocation.MappedData) + slice.Offset;
+
+	return slice;
+
+}
@@ -0,0 +1,296 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+
+// Power-of-two buddy sub-allocator for a single range of memory.
+// Offsets handed out are aligned to the size of the buddy they come from,
+// which covers every alignment Vulkan reports (always a power of two).
+class BuddyAllocator
+{
+
+public:
+	BuddyAllocator(VkDeviceSize size, VkDeviceSize minBlockSize);
+
+	bool Allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize &offset);
+	void Free(VkDeviceSize offset);
+
+	inline VkDeviceSize GetSize() const { return m_MinBlockSize << m_MaxOrder; }
+	inline VkDeviceSize GetUsedSize() const { return m_UsedSize; }
+	inline size_t GetAllocationCount() const { return m_Allocated.size(); }
+	inline bool IsEmpty() const { return m_Allocated.empty(); }
+	VkDeviceSize GetLargestFreeBlock() const;
+
+private:
+	uint32_t OrderForSize(VkDeviceSize size) const;
+	inline VkDeviceSize OrderSize(uint32_t order) const { return m_MinBlockSize << order; }
+
+private:
+	VkDeviceSize m_MinBlockSize = 0;
+	uint32_t m_MaxOrder = 0;
+	VkDeviceSize m_UsedSize = 0;
+
+	std::vector<std::set<VkDeviceSize>> m_FreeLists;
+	std::unordered_map<VkDeviceSize, uint32_t> m_Allocated;
+
+};
+
+// Buffers and optimal-tiling images never share a block, which keeps
+// bufferImageGranularity from ever having to be considered.
+enum class ResourceKind
+{
+	Linear = 0,
+	Optimal,
+	Count
+};
+
+// What an allocation is for, only used for the statistics. CreateBuffer and CreateImage
+// turn Other into Buffer and Image.
+enum class MemoryCategory
+{
+	Other = 0,
+	Buffer,
+	Image,
+	Staging,
+	Swapchain,
+	Count
+};
+
+struct AllocationCreateInfo
+{
+	VkMemoryPropertyFlags RequiredFlags = 0;
+	VkMemoryPropertyFlags PreferredFlags = 0;
+
+	// Forces a VkDeviceMemory of its own, otherwise only used for
+	// resources that are too large for a block or ask for it via
+	// VkMemoryDedicatedRequirements.
+	bool Dedicated = false;
+
+	// Movable allocations may be relocated by the defragmenter,
+	// UserData is handed back in the move so the owner can find the resource.
+	bool Movable = false;
+	void *UserData = nullptr;
+
+	MemoryCategory Category = MemoryCategory::Other;
+};
+
+struct MemoryBlock;
+
+struct MemoryAllocation
+{
+	VkDeviceMemory Memory = VK_NULL_HANDLE;
+	VkDeviceSize Offset = 0;
+	VkDeviceSize Size = 0;
+	void *MappedData = nullptr;
+	uint32_t MemoryTypeIndex = 0;
+	MemoryCategory Category = MemoryCategory::Other;
+
+	// nullptr for dedicated allocations
+	MemoryBlock *Block = nullptr;
+
+	inline bool IsValid() const { return Memory != VK_NULL_HANDLE; }
+};
+
+struct DefragmentationMove
+{
+	MemoryAllocation Source;
+	MemoryAllocation Destination;
+	void *UserData = nullptr;
+};
+
+struct MemoryTypeStatistics
+{
+	uint32_t BlockCount = 0;
+	uint32_t AllocationCount = 0;
+	uint32_t DedicatedCount = 0;
+	VkDeviceSize BlockBytes = 0;
+	VkDeviceSize UsedBytes = 0;
+	VkDeviceSize DedicatedBytes = 0;
+	VkDeviceSize LargestFreeRange = 0;
+
+	// Share of the free block space outside the largest free range, 0 while one
+	// allocation could still take all of it
+	float Fragmentation = 0.0f;
+};
+
+struct MemoryCategoryStatistics
+{
+	uint32_t AllocationCount = 0;
+	VkDeviceSize Bytes = 0;
+	VkDeviceSize PeakBytes = 0;
+};
+
+struct MemoryStatistics
+{
+	MemoryTypeStatistics Types[VK_MAX_MEMORY_TYPES];
+	MemoryTypeStatistics Total;
+	MemoryCategoryStatistics Categories[(size_t) MemoryCategory::Count];
+
+	// Number of live VkDeviceMemory objects against the device limit
+	uint32_t DeviceMemoryCount = 0;
+	uint32_t MaxDeviceMemoryCount = 0;
+};
+
+struct MemoryHeapBudget
+{
+	VkDeviceSize Size = 0;
+	bool DeviceLocal = false;
+
+	// What the process may and does use of the heap, other allocators included. Reported by
+	// VK_EXT_memory_budget when enabled, otherwise 80% of the heap and what this allocator has.
+	VkDeviceSize Budget = 0;
+	VkDeviceSize Usage = 0;
+
+	// VkDeviceMemory allocated through this allocator and its high-water mark
+	VkDeviceSize AllocatedBytes = 0;
+	VkDeviceSize PeakBytes = 0;
+};
+
+struct MemoryBudget
+{
+	MemoryHeapBudget Heaps[VK_MAX_MEMORY_HEAPS];
+	uint32_t HeapCount = 0;
+};
+
+class MemoryAllocator
+{
+
+public:
+	// Defined out of line since MemoryBlock is only complete in the translation unit
+	MemoryAllocator();
+	~MemoryAllocator();
+
+	// memoryBudget is whether the device was created with VK_EXT_memory_budget
+	void Init(VkPhysicalDevice physicalDevice, VkDevice device, bool memoryBudget = false);
+	void Shutdown();
+
+	// Returns UINT32_MAX when no type satisfies the required flags.
+	// Types that also have the preferred flags win over those that only have the required ones.
+	uint32_t FindMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred = 0) const;
+
+	VkResult CreateBuffer(const VkBufferCreateInfo &bufferInfo, const AllocationCreateInfo &allocInfo, VkBuffer &buffer, MemoryAllocation &allocation);
+	VkResult CreateImage(const VkImageCreateInfo &imageInfo, const AllocationCreateInfo &allocInfo, VkImage &image, MemoryAllocation &allocation);
+	void DestroyBuffer(VkBuffer buffer, MemoryAllocation &allocation);
+	void DestroyImage(VkImage image, MemoryAllocation &allocation);
+
+	VkResult Allocate(const VkMemoryRequirements &requirements, const AllocationCreateInfo &allocInfo, ResourceKind kind, MemoryAllocation &allocation);
+	void Free(MemoryAllocation &allocation);
+
+	// Plans up to maxMoves relocations of movable allocations out of the
+	// emptiest blocks into fuller ones. The caller copies the data, rebinds
+	// its resources to the destinations, and then ends the defragmentation
+	// which frees the old locations and releases blocks that became empty.
+	std::vector<DefragmentationMove> BeginDefragmentation(uint32_t maxMoves);
+	void EndDefragmentation(const std::vector<DefragmentationMove> &moves);
+
+	MemoryStatistics GetStatistics();
+	void LogStatistics();
+
+	// Re-reads the driver's budget, once per frame at most. Allocations made in between are
+	// added on top, so GetBudget stays current without querying the driver.
+	void UpdateBudget();
+	MemoryBudget GetBudget();
+
+	// What can still be allocated before the largest heap with all of heapFlags goes over budget
+	VkDeviceSize GetHeadroom(VkMemoryHeapFlags heapFlags);
+
+	// Heap usage against budget, allocations by category and fragmentation
+	void LogBudget();
+
+	// Memory the driver allocates for us, like the swap chain images, only known as an estimate
+	void SetExternalBytes(MemoryCategory category, VkDeviceSize bytes);
+
+	inline VkDeviceSize GetBlockSize(uint32_t memoryTypeIndex) const { return m_BlockSizes[memoryTypeIndex]; }
+	inline const VkPhysicalDeviceMemoryProperties &GetMemoryProperties() const { return m_MemoryProperties; }
+
+private:
+	VkResult AllocateInternal(const VkMemoryRequirements &requirements, const AllocationCreateInfo &allocInfo, ResourceKind kind, VkImage image, VkBuffer buffer, bool prefersDedicated, MemoryAllocation &allocation);
+	VkResult AllocateDedicated(const VkMemoryRequirements &requirements, uint32_t memoryType, VkImage image, VkBuffer buffer, MemoryAllocation &allocation);
+	VkResult AllocateFromBlocks(const VkMemoryRequirements &requirements, uint32_t memoryType, ResourceKind kind, const AllocationCreateInfo &allocInfo, MemoryAllocation &allocation);
+	MemoryBlock *CreateBlock(uint32_t memoryType, ResourceKind kind);
+	void DestroyBlock(MemoryBlock *block);
+	void ReleaseEmptyBlocks(uint32_t memoryType, ResourceKind kind);
+	void FreeLocked(MemoryAllocation &allocation);
+	bool IsHostVisible(uint32_t memoryType) const;
+
+	void TrackDeviceMemory(uint32_t memoryType, VkDeviceSize size);
+	void UntrackDeviceMemory(uint32_t memoryType, VkDeviceSize size);
+	void TrackAllocation(const MemoryAllocation &allocation);
+	MemoryBudget GetBudgetLocked() const;
+
+private:
+	VkPhysicalDevice m_PhysicalDevice = VK_NULL_HANDLE;
+	VkDevice m_Device = VK_NULL_HANDLE;
+
+	VkPhysicalDeviceMemoryProperties m_MemoryProperties = {};
+	VkDeviceSize m_BlockSizes[VK_MAX_MEMORY_TYPES] = {};
+	uint32_t m_MaxAllocationCount = 0;
+
+	std::vector<std::unique_ptr<MemoryBlock>> m_Blocks[VK_MAX_MEMORY_TYPES][(size_t) ResourceKind::Count];
+
+	// Kept so Shutdown can release dedicated allocations that were never freed
+	std::unordered_set<VkDeviceMemory> m_DedicatedMemory;
+	uint32_t m_DedicatedCount[VK_MAX_MEMORY_TYPES] = {};
+	VkDeviceSize m_DedicatedBytes[VK_MAX_MEMORY_TYPES] = {};
+	uint32_t m_DeviceMemoryCount = 0;
+
+	VkDeviceSize m_HeapBytes[VK_MAX_MEMORY_HEAPS] = {};
+	VkDeviceSize m_HeapPeakBytes[VK_MAX_MEMORY_HEAPS] = {};
+	MemoryCategoryStatistics m_Categories[(size_t) MemoryCategory::Count];
+	VkDeviceSize m_ExternalBytes[(size_t) MemoryCategory::Count] = {};
+
+	// The driver's numbers as of the last UpdateBudget, and what this allocator had then
+	bool m_MemoryBudget = false;
+	VkDeviceSize m_DriverBudget[VK_MAX_MEMORY_HEAPS] = {};
+	VkDeviceSize m_DriverUsage[VK_MAX_MEMORY_HEAPS] = {};
+	VkDeviceSize m_HeapBytesAtUpdate[VK_MAX_MEMORY_HEAPS] = {};
+
+	std::mutex m_Mutex;
+
+};
+
+// Bump allocator over a persistently mapped host-visible buffer, split into
+// one region per frame in flight. Allocations live until the region is
+// reused, i.e. until the frame that recorded them has finished on the GPU.
+class FrameLinearAllocator
+{
+
+public:
+	struct Slice
+	{
+		VkBuffer Buffer = VK_NULL_HANDLE;
+		VkDeviceSize Offset = 0;
+		void *Data = nullptr;
+	};
+
+	void Init(MemoryAllocator &allocator, VkDeviceSize frameSize, uint32_t frameCount, VkBufferUsageFlags usage);
+	void Shutdown();
+
+	// Must only be called once the GPU is done with the frame's region.
+	void BeginFrame(uint32_t frameIndex);
+
+	// Thread-safe, returns a slice with a null Data pointer when the region is exhausted.
+	Slice Allocate(VkDeviceSize size, VkDeviceSize alignment);
+
+	inline VkBuffer GetBuffer() const { return m_Buffer; }
+	inline VkDeviceSize GetFrameSize() const { return m_FrameSize; }
+
+private:
+	MemoryAllocator *m_Allocator = nullptr;
+
+	VkBuffer m_Buffer = VK_NULL_HANDLE;
+	MemoryAllocation m_Allocation;
+
+	VkDeviceSize m_FrameSize = 0;
+	VkDeviceSize m_FrameBase = 0;
+	std::atomic<VkDeviceSize> m_Head = { 0 };
+
+};
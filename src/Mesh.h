@@ -0,0 +1,93 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <array>
+#include <cstdint>
+
+#include "MemoryAllocator.h"
+
+struct Vertex
+{
+	float Position[2];
+	float Color[3];
+
+	static VkVertexInputBindingDescription GetBindingDescription()
+	{
+		VkVertexInputBindingDescription binding = {};
+		binding.binding = 0;
+		binding.stride = sizeof(Vertex);
+		binding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+		return binding;
+	}
+
+	static std::array<VkVertexInputAttributeDescription, 2> GetAttributeDescriptions()
+	{
+		std::array<VkVertexInputAttributeDescription, 2> attributes = {};
+
+		attributes[0].binding = 0;
+		attributes[0].location = 0;
+		attributes[0].format = VK_FORMAT_R32G32_SFLOAT;
+		attributes[0].offset = offsetof(Vertex, Position);
+
+		attributes[1].binding = 0;
+		attributes[1].location = 1;
+		attributes[1].format = VK_FORMAT_R32G32B32_SFLOAT;
+		attributes[1].offset = offsetof(Vertex, Color);
+
+		return attributes;
+	}
+};
+
+// Per-instance data, read by the culling shader and streamed to the vertex shader
+struct InstanceData
+{
+	float Position[2];
+	float Scale;
+	uint32_t MeshIndex;
+
+	static VkVertexInputBindingDescription GetBindingDescription()
+	{
+		VkVertexInputBindingDescription binding = {};
+		binding.binding = 1;
+		binding.stride = sizeof(InstanceData);
+		binding.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+		return binding;
+	}
+
+	static std::array<VkVertexInputAttributeDescription, 2> GetAttributeDescriptions()
+	{
+		std::array<VkVertexInputAttributeDescription, 2> attributes = {};
+
+		attributes[0].binding = 1;
+		attributes[0].location = 2;
+		attributes[0].format = VK_FORMAT_R32G32_SFLOAT;
+		attributes[0].offset = offsetof(InstanceData, Position);
+
+		attributes[1].binding = 1;
+		attributes[1].location = 3;
+		attributes[1].format = VK_FORMAT_R32_SFLOAT;
+		attributes[1].offset = offsetof(InstanceData, Scale);
+
+		return attributes;
+	}
+};
+
+// Device-local geometry, filled through the staging ring
+struct Mesh
+{
+	VkBuffer VertexBuffer = VK_NULL_HANDLE;
+	MemoryAllocation VertexMemory;
+
+	VkBuffer IndexBuffer = VK_NULL_HANDLE;
+	MemoryAllocation IndexMemory;
+
+	VkIndexType IndexType = VK_INDEX_TYPE_UINT16;
+	uint32_t VertexCount = 0;
+	uint32_t IndexCount = 0;
+
+	// Radius around the origin enclosing every vertex, used for culling
+	float BoundingRadius = 0.0f;
+};
@@ -0,0 +1,207 @@
+#include "PipelineCache.h"
+#include "Log.h"
+
+#include <vector>
+#include <fstream>
+#include <cstring>
+#include <cstdio>
+
+// The Vulkan header inside the cache data carries no driver version,
+// so the file is prefixed with one of our own that does.
+struct PipelineCacheFileHeader
+{
+	uint32_t Magic;
+	uint32_t Version;
+	uint32_t VendorID;
+	uint32_t DeviceID;
+	uint32_t DriverVersion;
+	uint8_t CacheUUID[VK_UUID_SIZE];
+	uint64_t DataSize;
+	uint64_t DataHash;
+};
+
+static const uint32_t PIPELINE_CACHE_MAGIC = 0x43504B56; // "VKPC"
+static const uint32_t PIPELINE_CACHE_VERSION = 1;
+
+// FNV-1a, only used to catch truncated or corrupted files
+static uint64_t HashData(const char *data, size_t size)
+{
+
+	uint64_t hash = 14695981039346656037ull;
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash ^= (uint8_t) data[i];
+		hash *= 1099511628211ull;
+	}
+
+	return hash;
+
+}
+
+void PipelineCache::Init(VkPhysicalDevice physicalDevice, VkDevice device, const std::string &path)
+{
+
+	this->m_Device = device;
+	this->m_Path = path;
+	vkGetPhysicalDeviceProperties(physicalDevice, &this->m_DeviceProperties);
+
+	std::string data;
+	this->m_Warm = !path.empty() && this->Load(data);
+
+	VkPipelineCacheCreateInfo createInfo = {};
+	createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	createInfo.initialDataSize = this->m_Warm ? data.size() : 0;
+	createInfo.pInitialData = this->m_Warm ? data.data() : nullptr;
+
+	if (vkCreatePipelineCache(device, &createInfo, nullptr, &this->m_Cache) != VK_SUCCESS)
+	{
+		// Drivers may still reject data that passed our checks, retry empty
+		LOG_VK_WARNING("Pipeline cache data rejected by the driver, starting with an empty cache");
+
+		this->m_Warm = false;
+		createInfo.initialDataSize = 0;
+		createInfo.pInitialData = nullptr;
+
+		if (vkCreatePipelineCache(device, &createInfo, nullptr, &this->m_Cache) != VK_SUCCESS)
+		{
+			LOG_VK_CRITICAL("Failed to create pipeline cache!");
+			exit(-1);
+		}
+	}
+
+	if (this->m_Warm)
+		LOG_VK_INFO("Loaded pipeline cache from {0} ({1} bytes)", path, data.size());
+
+}
+
+void PipelineCache::Shutdown()
+{
+
+	if (!this->m_Path.empty())
+		this->Save();
+
+	vkDestroyPipelineCache(this->m_Device, this->m_Cache, nullptr);
+	this->m_Cache = VK_NULL_HANDLE;
+
+}
+
+bool PipelineCache::Load(std::string &data) const
+{
+
+	std::ifstream file(this->m_Path, std::ios::binary | std::ios::ate);
+	if (!file.is_open())
+	{
+		LOG_VK_INFO("No pipeline cache at {0}, starting cold", this->m_Path);
+		return false;
+	}
+
+	uint64_t fileSize = (uint64_t) file.tellg();
+	file.seekg(0);
+
+	PipelineCacheFileHeader header = {};
+	if (!file.read(reinterpret_cast<char *>(&header), sizeof(header))
+	||	header.Magic != PIPELINE_CACHE_MAGIC
+	||	header.Version != PIPELINE_CACHE_VERSION)
+	{
+		LOG_VK_WARNING("Ignoring pipeline cache {0}: unrecognized file", this->m_Path);
+		return false;
+	}
+
+	const VkPhysicalDeviceProperties &props = this->m_DeviceProperties;
+	if (header.VendorID != props.vendorID
+	||	header.DeviceID != props.deviceID
+	||	header.DriverVersion != props.driverVersion
+	||	std::memcmp(header.CacheUUID, props.pipelineCacheUUID, VK_UUID_SIZE) != 0)
+	{
+		LOG_VK_WARNING("Ignoring pipeline cache {0}: written for a different device or driver", this->m_Path);
+		return false;
+	}
+
+	// The size is checked before allocating, a corrupt header must not ask for gigabytes
+	if (header.DataSize > fileSize - sizeof(header))
+	{
+		LOG_VK_WARNING("Ignoring pipeline cache {0}: data is truncated or corrupt", this->m_Path);
+		return false;
+	}
+
+	data.resize((size_t) header.DataSize);
+	if (!file.read(&data[0], data.size())
+	||	HashData(data.data(), data.size()) != header.DataHash)
+	{
+		LOG_VK_WARNING("Ignoring pipeline cache {0}: data is truncated or corrupt", this->m_Path);
+		return false;
+	}
+
+	// Cross-check the header the driver wrote into the data itself
+	VkPipelineCacheHeaderVersionOne vkHeader = {};
+	if (data.size() < sizeof(vkHeader))
+	{
+		LOG_VK_WARNING("Ignoring pipeline cache {0}: data is too small", this->m_Path);
+		return false;
+	}
+
+	std::memcpy(&vkHeader, data.data(), sizeof(vkHeader));
+	if (vkHeader.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+	||	vkHeader.vendorID != props.vendorID
+	||	vkHeader.deviceID != props.deviceID
+	||	std::memcmp(vkHeader.pipelineCacheUUID, props.pipelineCacheUUID, VK_UUID_SIZE) != 0)
+	{
+		LOG_VK_WARNING("Ignoring pipeline cache {0}: driver header mismatch", this->m_Path);
+		return false;
+	}
+
+	return true;
+
+}
+
+void PipelineCache::Save() const
+{
+
+	size_t size = 0;
+	if (vkGetPipelineCacheData(this->m_Device, this->m_Cache, &size, nullptr) != VK_SUCCESS || !size)
+		return;
+
+	std::vector<char> data(size);
+	if (vkGetPipelineCacheData(this->m_Device, this->m_Cache, &size, data.data()) != VK_SUCCESS)
+	{
+		LOG_VK_WARNING("Failed to retrieve pipeline cache data");
+		return;
+	}
+
+	const VkPhysicalDeviceProperties &props = this->m_DeviceProperties;
+
+	PipelineCacheFileHeader header = {};
+	header.Magic = PIPELINE_CACHE_MAGIC;
+	header.Version = PIPELINE_CACHE_VERSION;
+	header.VendorID = props.vendorID;
+	header.DeviceID = props.deviceID;
+	header.DriverVersion = props.driverVersion;
+	std::memcpy(header.CacheUUID, props.pipelineCacheUUID, VK_UUID_SIZE);
+	header.DataSize = size;
+	header.DataHash = HashData(data.data(), size);
+
+	// Write next to the target and rename, so a crash mid-write
+	// never leaves a half written cache behind.
+	std::string tempPath = this->m_Path + ".tmp";
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+		file.write(data.data(), size);
+
+		if (!file.good())
+		{
+			LOG_VK_WARNING("Failed to write pipeline cache to {0}", tempPath);
+			return;
+		}
+	}
+
+	std::remove(this->m_Path.c_str());
+	if (std::rename(tempPath.c_str(), this->m_Path.c_str()) != 0)
+	{
+		LOG_VK_WARNING("Failed to move pipeline cache to {0}", this->m_Path);
+		return;
+	}
+
+	LOG_VK_INFO("Saved pipeline cache to {0} ({1} bytes)", this->m_Path, size);
+
+}
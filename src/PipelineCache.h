@@ -0,0 +1,35 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <string>
+#include <cstdint>
+
+// VkPipelineCache that is loaded from and saved back to disk.
+// The file is only trusted if it was written for the same vendor, device,
+// driver version and pipeline cache UUID, anything else starts a cold cache.
+class PipelineCache
+{
+
+public:
+	void Init(VkPhysicalDevice physicalDevice, VkDevice device, const std::string &path);
+	void Shutdown();
+
+	inline VkPipelineCache GetHandle() const { return m_Cache; }
+
+	// True when the cache was created from data previously saved to disk
+	inline bool IsWarm() const { return m_Warm; }
+
+private:
+	bool Load(std::string &data) const;
+	void Save() const;
+
+private:
+	VkDevice m_Device = VK_NULL_HANDLE;
+	VkPhysicalDeviceProperties m_DeviceProperties = {};
+
+	VkPipelineCache m_Cache = VK_NULL_HANDLE;
+	std::string m_Path;
+	bool m_Warm = false;
+
+};
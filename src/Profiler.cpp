@@ -0,0 +1,348 @@
+#include "Profiler.h"
+#include "Benchmark.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+
+// How often the collector drains the rings, each ring has to hold this much of its thread's zones
+static const std::chrono::milliseconds COLLECT_INTERVAL(10);
+
+// Bounds the history when no frames are marked, like during startup or the compute benchmark
+static const size_t MAX_EVENTS_PER_FRAME = 1024;
+
+namespace util {
+
+	ProfilerConfig Profiler::m_Config;
+	std::atomic<bool> Profiler::m_Enabled = { false };
+	std::chrono::steady_clock::time_point Profiler::m_Epoch;
+
+	std::mutex Profiler::m_BufferMutex;
+	std::vector<std::unique_ptr<Profiler::ThreadBuffer>> Profiler::m_Buffers;
+
+	std::atomic<uint64_t> Profiler::m_FrameNumber = { 0 };
+
+	std::mutex Profiler::m_HistoryMutex;
+	std::deque<Profiler::TrackEvent> Profiler::m_History;
+	std::deque<Profiler::FrameMarker> Profiler::m_Frames;
+
+	std::mutex Profiler::m_InternMutex;
+	std::unordered_set<std::string> Profiler::m_Interned;
+
+	std::thread Profiler::m_Collector;
+	std::mutex Profiler::m_CollectorMutex;
+	std::condition_variable Profiler::m_CollectorWake;
+	std::string Profiler::m_PendingDump;
+	bool Profiler::m_Running = false;
+
+	// The calling thread's ring, ThreadBuffer is private to the profiler
+	static thread_local void *t_Buffer = nullptr;
+
+	void Profiler::Init(const ProfilerConfig &config)
+	{
+
+		m_Config = config;
+		m_Config.HistoryFrames = std::max(config.HistoryFrames, 1u);
+
+		size_t size = 2;
+		while (size < config.ThreadBufferSize)
+			size <<= 1;
+
+		m_Config.ThreadBufferSize = size;
+		m_Epoch = std::chrono::steady_clock::now();
+
+#ifdef APP_NO_PROFILE
+		// No zones are compiled in, a collector would only ever drain empty rings
+		m_Config.Enabled = false;
+#endif
+
+		if (!m_Config.Enabled)
+			return;
+
+		m_Running = true;
+		m_Collector = std::thread(&Profiler::CollectorLoop);
+		m_Enabled.store(true, std::memory_order_relaxed);
+
+	}
+
+	void Profiler::Shutdown()
+	{
+
+		m_Enabled.store(false, std::memory_order_relaxed);
+
+		{
+			std::lock_guard<std::mutex> lock(m_CollectorMutex);
+			m_Running = false;
+		}
+
+		m_CollectorWake.notify_all();
+
+		if (m_Collector.joinable())
+			m_Collector.join();
+
+		if (uint64_t dropped = GetDroppedCount())
+			LOG_WARNING("{0} profile zones were dropped because a thread's buffer was full", dropped);
+
+	}
+
+	void Profiler::MarkFrame()
+	{
+
+		if (!IsEnabled())
+			return;
+
+		// The frame number rides in place of the start time
+		Record(nullptr, m_FrameNumber.fetch_add(1, std::memory_order_relaxed), Now());
+
+	}
+
+	void Profiler::SetThreadName(const std::string &name)
+	{
+
+		if (!IsEnabled())
+			return;
+
+		ThreadBuffer &buffer = GetThreadBuffer();
+
+		std::lock_guard<std::mutex> lock(m_BufferMutex);
+		buffer.Name = name;
+
+	}
+
+	void Profiler::Record(const char *name, uint64_t startNanos, uint64_t endNanos)
+	{
+
+		ThreadBuffer &buffer = GetThreadBuffer();
+
+		// Only this thread writes, so the position it loads is current
+		size_t write = buffer.WritePosition.load(std::memory_order_relaxed);
+		if (write - buffer.ReadPosition.load(std::memory_order_acquire) > buffer.Mask)
+		{
+			buffer.Dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+
+		ProfileEvent &event = buffer.Events[write & buffer.Mask];
+		event.Name = name;
+		event.StartNanos = startNanos;
+		event.EndNanos = endNanos;
+
+		buffer.WritePosition.store(write + 1, std::memory_order_release);
+
+	}
+
+	const char *Profiler::Intern(const std::string &name)
+	{
+
+		std::lock_guard<std::mutex> lock(m_InternMutex);
+		return m_Interned.insert(name).first->c_str();
+
+	}
+
+	bool Profiler::Dump(const std::string &path)
+	{
+
+		std::ofstream file(path);
+		if (!file.is_open())
+		{
+			LOG_ERROR("Failed to write the profile: {0}", path);
+			return false;
+		}
+
+		file << "{\n";
+		file << "\"displayTimeUnit\": \"ms\",\n";
+		file << "\"traceEvents\": [\n";
+		file << "{ \"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": 0, \"args\": { \"name\": \"CPU\" } }";
+
+		WriteTraceEvents(file);
+
+		file << "\n]\n";
+		file << "}\n";
+
+		if (!file.good())
+		{
+			LOG_ERROR("Failed to write the profile: {0}", path);
+			return false;
+		}
+
+		LOG_INFO("Wrote the CPU profile to {0}", path);
+		return true;
+
+	}
+
+	void Profiler::RequestDump(const std::string &path)
+	{
+
+		{
+			std::lock_guard<std::mutex> lock(m_CollectorMutex);
+			if (!m_Running)
+				return;
+
+			m_PendingDump = path;
+		}
+
+		m_CollectorWake.notify_all();
+
+	}
+
+	void Profiler::WriteTraceEvents(std::ostream &file)
+	{
+
+		std::lock_guard<std::mutex> lock(m_HistoryMutex);
+
+		Collect();
+		WriteHistory(file);
+
+	}
+
+	uint64_t Profiler::GetDroppedCount()
+	{
+
+		std::lock_guard<std::mutex> lock(m_BufferMutex);
+
+		uint64_t dropped = 0;
+		for (const auto &buffer : m_Buffers)
+			dropped += buffer->Dropped.load(std::memory_order_relaxed);
+
+		return dropped;
+
+	}
+
+	Profiler::ThreadBuffer &Profiler::GetThreadBuffer()
+	{
+
+		if (t_Buffer)
+			return *static_cast<ThreadBuffer *>(t_Buffer);
+
+		auto buffer = std::make_unique<ThreadBuffer>();
+		buffer->Events = std::make_unique<ProfileEvent[]>(m_Config.ThreadBufferSize);
+		buffer->Mask = m_Config.ThreadBufferSize - 1;
+
+		std::lock_guard<std::mutex> lock(m_BufferMutex);
+
+		buffer->Index = (uint32_t) m_Buffers.size();
+		buffer->Name = "thread " + std::to_string(buffer->Index);
+
+		t_Buffer = buffer.get();
+		m_Buffers.push_back(std::move(buffer));
+
+		return *m_Buffers.back();
+
+	}
+
+	void Profiler::Collect()
+	{
+
+		// Rings are never removed, so the pointers stay valid once the lock is gone
+		std::vector<ThreadBuffer *> buffers;
+		{
+			std::lock_guard<std::mutex> lock(m_BufferMutex);
+			for (const auto &buffer : m_Buffers)
+				buffers.push_back(buffer.get());
+		}
+
+		for (ThreadBuffer *buffer : buffers)
+		{
+			size_t read = buffer->ReadPosition.load(std::memory_order_relaxed);
+			size_t write = buffer->WritePosition.load(std::memory_order_acquire);
+
+			for (; read != write; ++read)
+			{
+				const ProfileEvent &event = buffer->Events[read & buffer->Mask];
+
+				if (event.Name)
+					m_History.push_back({ event, buffer->Index });
+				else
+					m_Frames.push_back({ event.StartNanos, event.EndNanos });
+			}
+
+			buffer->ReadPosition.store(write, std::memory_order_release);
+		}
+
+		while (m_Frames.size() > m_Config.HistoryFrames)
+			m_Frames.pop_front();
+
+		// Drained a ring at a time, so the history is only roughly in time order. An old zone
+		// stuck behind a newer one goes with it later.
+		uint64_t cutoff = m_Frames.empty() ? 0 : m_Frames.front().Nanos;
+		size_t maxEvents = (size_t) m_Config.HistoryFrames * MAX_EVENTS_PER_FRAME;
+
+		while (!m_History.empty() && (m_History.front().Event.EndNanos < cutoff || m_History.size() > maxEvents))
+			m_History.pop_front();
+
+	}
+
+	void Profiler::WriteHistory(std::ostream &file)
+	{
+
+		std::ios::fmtflags flags = file.flags();
+		std::streamsize precision = file.precision();
+		file << std::fixed << std::setprecision(3);
+
+		{
+			std::lock_guard<std::mutex> lock(m_BufferMutex);
+
+			for (const auto &buffer : m_Buffers)
+			{
+				file << ",\n{ \"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << buffer->Index
+					<< ", \"args\": { \"name\": \"" << EscapeJson(buffer->Name) << "\" } }";
+			}
+		}
+
+		uint64_t cutoff = m_Frames.empty() ? 0 : m_Frames.front().Nanos;
+
+		for (const TrackEvent &track : m_History)
+		{
+			if (track.Event.EndNanos < cutoff)
+				continue;
+
+			file << ",\n{ \"name\": \"" << EscapeJson(track.Event.Name) << "\", "
+				<< "\"cat\": \"cpu\", "
+				<< "\"ph\": \"X\", "
+				<< "\"pid\": 1, "
+				<< "\"tid\": " << track.Thread << ", "
+				<< "\"ts\": " << track.Event.StartNanos / 1000.0 << ", "
+				<< "\"dur\": " << (track.Event.EndNanos - track.Event.StartNanos) / 1000.0 << " }";
+		}
+
+		for (const FrameMarker &frame : m_Frames)
+		{
+			file << ",\n{ \"name\": \"frame " << frame.Number << "\", "
+				<< "\"ph\": \"i\", \"s\": \"g\", "
+				<< "\"pid\": 1, \"tid\": 0, "
+				<< "\"ts\": " << frame.Nanos / 1000.0 << " }";
+		}
+
+		file.flags(flags);
+		file.precision(precision);
+
+	}
+
+	void Profiler::CollectorLoop()
+	{
+
+		std::unique_lock<std::mutex> lock(m_CollectorMutex);
+
+		while (m_Running)
+		{
+			m_CollectorWake.wait_for(lock, COLLECT_INTERVAL, []() { return !m_Running || !m_PendingDump.empty(); });
+
+			std::string dump = std::move(m_PendingDump);
+			m_PendingDump.clear();
+			lock.unlock();
+
+			if (!dump.empty())
+				Dump(dump);
+			else
+			{
+				std::lock_guard<std::mutex> history(m_HistoryMutex);
+				Collect();
+			}
+
+			lock.lock();
+		}
+
+	}
+
+}
@@ -0,0 +1,182 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <unordered_set>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <ostream>
+#include <cstdint>
+
+namespace util {
+
+	struct ProfilerConfig
+	{
+		// Zones compiled in still cost a flag check when disabled at runtime
+		bool Enabled = true;
+
+		// Frames kept in the rolling history, older zones are dropped
+		uint32_t HistoryFrames = 600;
+
+		// Zones a thread can record before the collector catches up, rounded up to a power of two.
+		// Zones beyond that are dropped and counted.
+		size_t ThreadBufferSize = 16384;
+	};
+
+	struct ProfileEvent
+	{
+		// Literal or interned, never freed
+		const char *Name = nullptr;
+		uint64_t StartNanos = 0;
+		uint64_t EndNanos = 0;
+	};
+
+	// CPU zones recorded through the PROFILE_* macros. Every thread writes its zones into
+	// its own single producer ring without locking, a collector thread drains the rings
+	// into a history of the last HistoryFrames frames, which can be dumped as a Chrome
+	// trace at any time. Times are steady_clock nanoseconds since Init.
+	class Profiler
+	{
+
+	public:
+		static void Init(const ProfilerConfig &config = ProfilerConfig());
+
+		// Stops the collector, pending dumps are written first
+		static void Shutdown();
+
+		inline static bool IsEnabled() { return m_Enabled.load(std::memory_order_relaxed); }
+
+		// Marks the start of a frame on the calling thread
+		static void MarkFrame();
+
+		// Names the calling thread's track in the trace
+		static void SetThreadName(const std::string &name);
+
+		static void Record(const char *name, uint64_t startNanos, uint64_t endNanos);
+
+		// For names that do not live as long as the program, takes a lock
+		static const char *Intern(const std::string &name);
+
+		// Writes the history now, or lets the collector write it so the caller is not held up
+		static bool Dump(const std::string &path);
+		static void RequestDump(const std::string &path);
+
+		// Metadata and zones of the history as Chrome trace events, each preceded by a comma.
+		// Timestamps are microseconds since GetEpoch, so other traces can be lined up with them.
+		static void WriteTraceEvents(std::ostream &file);
+
+		inline static std::chrono::steady_clock::time_point GetEpoch() { return m_Epoch; }
+
+		inline static uint64_t Now()
+		{
+			return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_Epoch).count();
+		}
+
+		static uint64_t GetDroppedCount();
+
+	private:
+		struct ThreadBuffer
+		{
+			std::unique_ptr<ProfileEvent[]> Events;
+			size_t Mask = 0;
+			uint32_t Index = 0;
+			std::string Name;
+
+			alignas(64) std::atomic<size_t> WritePosition = { 0 };
+			alignas(64) std::atomic<size_t> ReadPosition = { 0 };
+			std::atomic<uint64_t> Dropped = { 0 };
+		};
+
+		struct TrackEvent
+		{
+			ProfileEvent Event;
+			uint32_t Thread = 0;
+		};
+
+		struct FrameMarker
+		{
+			uint64_t Number = 0;
+			uint64_t Nanos = 0;
+		};
+
+		static ThreadBuffer &GetThreadBuffer();
+		static void Collect();
+		static void WriteHistory(std::ostream &file);
+		static void CollectorLoop();
+
+	private:
+		static ProfilerConfig m_Config;
+		static std::atomic<bool> m_Enabled;
+		static std::chrono::steady_clock::time_point m_Epoch;
+
+		// Registration happens once per thread, the rings are never freed so zones of
+		// threads that already exited still reach the history
+		static std::mutex m_BufferMutex;
+		static std::vector<std::unique_ptr<ThreadBuffer>> m_Buffers;
+
+		// Frame markers go through the marking thread's ring as events without a name
+		static std::atomic<uint64_t> m_FrameNumber;
+
+		// Rings are only drained with the history lock held, so there is one consumer at a time
+		static std::mutex m_HistoryMutex;
+		static std::deque<TrackEvent> m_History;
+		static std::deque<FrameMarker> m_Frames;
+
+		static std::mutex m_InternMutex;
+		static std::unordered_set<std::string> m_Interned;
+
+		static std::thread m_Collector;
+		static std::mutex m_CollectorMutex;
+		static std::condition_variable m_CollectorWake;
+		static std::string m_PendingDump;
+		static bool m_Running;
+
+	};
+
+	// Records the time between construction and destruction
+	class ProfileScope
+	{
+
+	public:
+		inline ProfileScope(const char *name)
+			: m_Name(name), m_Start(Profiler::IsEnabled() ? Profiler::Now() : 0)
+		{
+		}
+
+		inline ~ProfileScope()
+		{
+			if (this->m_Start)
+				Profiler::Record(this->m_Name, this->m_Start, Profiler::Now());
+		}
+
+		ProfileScope(const ProfileScope &) = delete;
+		ProfileScope &operator=(const ProfileScope &) = delete;
+
+	private:
+		const char *m_Name;
+		uint64_t m_Start;
+
+	};
+
+}
+
+// Compiled out entirely with APP_NO_PROFILE, premake's --no-profile option
+#ifndef APP_NO_PROFILE
+	#define PROFILE_CONCAT_INNER(a, b) a##b
+	#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+	#define PROFILE_SCOPE(name)			::util::ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+	#define PROFILE_SCOPE_DYNAMIC(name)	::util::ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(::util::Profiler::IsEnabled() ? ::util::Profiler::Intern(name) : nullptr)
+	#define PROFILE_FUNCTION()			PROFILE_SCOPE(__func__)
+	#define PROFILE_FRAME()				::util::Profiler::MarkFrame()
+#else
+	#define PROFILE_SCOPE(name)
+	#define PROFILE_SCOPE_DYNAMIC(name)
+	#define PROFILE_FUNCTION()
+	#define PROFILE_FRAME()
+#endif
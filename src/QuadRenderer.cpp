@@ -0,0 +1,519 @@
+#include "QuadRenderer.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// premake's --avx option builds the eight wide path, x64 always has SSE2
+#if defined(__AVX__)
+	#include <immintrin.h>
+	#define QUAD_SIMD_AVX
+	#define QUAD_SIMD_SSE2
+	static const char *QUAD_SIMD_NAME = "AVX";
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define QUAD_SIMD_SSE2
+	static const char *QUAD_SIMD_NAME = "SSE2";
+#else
+	static const char *QUAD_SIMD_NAME = "scalar";
+#endif
+
+static const uint32_t QUAD_INSTANCE_FLOATS = sizeof(QuadInstance) / sizeof(float);
+
+static uint32_t PackUnorm16(float x, float y)
+{
+
+	uint32_t ux = (uint32_t) (std::clamp(x, 0.0f, 1.0f) * 65535.0f + 0.5f);
+	uint32_t uy = (uint32_t) (std::clamp(y, 0.0f, 1.0f) * 65535.0f + 0.5f);
+
+	return ux | (uy << 16);
+
+}
+
+#ifdef QUAD_SIMD_SSE2
+// Interleaves four quads into instances and moves out past the visible ones. Every quad
+// is written, an invisible one is overwritten by the next, so there are no branches.
+static inline float *StoreQuads(float *out, __m128 cx, __m128 cy, __m128 axx, __m128 axy, __m128 ayx, __m128 ayy,
+	const uint32_t *color, const uint32_t *uv0, const uint32_t *uv1, int mask)
+{
+
+	__m128 col = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i *>(color)));
+	__m128 uv = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i *>(uv0)));
+
+	_MM_TRANSPOSE4_PS(cx, cy, axx, axy);
+	_MM_TRANSPOSE4_PS(ayx, ayy, col, uv);
+
+	__m128 first[4] = { cx, cy, axx, axy };
+	__m128 second[4] = { ayx, ayy, col, uv };
+
+	for (int lane = 0; lane < 4; ++lane)
+	{
+		_mm_storeu_ps(out, first[lane]);
+		_mm_storeu_ps(out + 4, second[lane]);
+		std::memcpy(out + 8, &uv1[lane], sizeof(uint32_t));
+
+		out += QUAD_INSTANCE_FLOATS * ((mask >> lane) & 1);
+	}
+
+	return out;
+
+}
+#endif
+
+bool QuadRenderer::Init(VkDevice device, MemoryAllocator &allocator, VkPipelineCache pipelineCache, VkPipelineLayout pipelineLayout,
+	VkRenderPass renderPass, uint32_t subpass, const std::vector<char> &vertexCode, const std::vector<char> &fragmentCode,
+	uint32_t maxQuads, uint32_t frameCount, uint32_t samplerHandle)
+{
+
+	this->m_Device = device;
+	this->m_PipelineLayout = pipelineLayout;
+	this->m_SamplerHandle = samplerHandle;
+	this->m_MaxQuads = maxQuads;
+
+	if (vertexCode.empty() || fragmentCode.empty())
+		return false;
+
+	VkShaderModuleCreateInfo moduleInfo = {};
+	moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	moduleInfo.codeSize = vertexCode.size();
+	moduleInfo.pCode = reinterpret_cast<const uint32_t *>(vertexCode.data());
+
+	VkShaderModule vertexModule = VK_NULL_HANDLE;
+	VkShaderModule fragmentModule = VK_NULL_HANDLE;
+	vkCreateShaderModule(device, &moduleInfo, nullptr, &vertexModule);
+
+	moduleInfo.codeSize = fragmentCode.size();
+	moduleInfo.pCode = reinterpret_cast<const uint32_t *>(fragmentCode.data());
+	vkCreateShaderModule(device, &moduleInfo, nullptr, &fragmentModule);
+
+	if (vertexModule && fragmentModule)
+	{
+		for (size_t blend = 0; blend < (size_t) QuadBlend::Count; ++blend)
+		{
+			VkPipeline pipeline = this->CreatePipeline(vertexModule, fragmentModule, (QuadBlend) blend,
+				pipelineCache, pipelineLayout, renderPass, subpass);
+
+			this->m_Pipelines[blend] = UniquePipeline(device, pipeline);
+		}
+	}
+
+	if (vertexModule)
+		vkDestroyShaderModule(device, vertexModule, nullptr);
+
+	if (fragmentModule)
+		vkDestroyShaderModule(device, fragmentModule, nullptr);
+
+	for (const UniquePipeline &pipeline : this->m_Pipelines)
+	{
+		if (!pipeline)
+		{
+			this->Shutdown();
+			return false;
+		}
+	}
+
+	this->m_Memory.Init(allocator, (VkDeviceSize) maxQuads * sizeof(QuadInstance), frameCount, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+
+	LOG_VK_INFO("Quad renderer: up to {0} quads, {1} KiB per frame, {2} transforms",
+		maxQuads, this->m_Memory.GetFrameSize() / 1024, QUAD_SIMD_NAME);
+
+	return true;
+
+}
+
+void QuadRenderer::Shutdown()
+{
+
+	for (UniquePipeline &pipeline : this->m_Pipelines)
+		pipeline.Reset();
+
+	this->m_Memory.Shutdown();
+	this->m_FrameBuffer = VK_NULL_HANDLE;
+
+	this->m_Batches.clear();
+	this->m_BatchIndices.clear();
+	this->m_LastBatch = SIZE_MAX;
+	this->m_QuadCount = 0;
+	this->m_VisibleCount = 0;
+
+}
+
+void QuadRenderer::Clear()
+{
+
+	for (Batch &batch : this->m_Batches)
+	{
+		batch.PositionX.clear();
+		batch.PositionY.clear();
+		batch.AxisXx.clear();
+		batch.AxisXy.clear();
+		batch.AxisYx.clear();
+		batch.AxisYy.clear();
+		batch.Color.clear();
+		batch.Uv0.clear();
+		batch.Uv1.clear();
+	}
+
+	this->m_QuadCount = 0;
+
+}
+
+bool QuadRenderer::Add(const QuadDesc &quad)
+{
+
+	if (this->m_QuadCount >= this->m_MaxQuads)
+		return false;
+
+	Batch &batch = this->GetBatch(quad);
+
+	// Rotating here leaves only a scale and offset for the per frame transform
+	float halfWidth = quad.Size[0] * 0.5f;
+	float halfHeight = quad.Size[1] * 0.5f;
+	float cosine = std::cos(quad.Rotation);
+	float sine = std::sin(quad.Rotation);
+
+	batch.PositionX.push_back(quad.Position[0]);
+	batch.PositionY.push_back(quad.Position[1]);
+	batch.AxisXx.push_back(cosine * halfWidth);
+	batch.AxisXy.push_back(sine * halfWidth);
+	batch.AxisYx.push_back(-sine * halfHeight);
+	batch.AxisYy.push_back(cosine * halfHeight);
+	batch.Color.push_back(quad.Color);
+	batch.Uv0.push_back(PackUnorm16(quad.Uv[0], quad.Uv[1]));
+	batch.Uv1.push_back(PackUnorm16(quad.Uv[2], quad.Uv[3]));
+
+	++this->m_QuadCount;
+	return true;
+
+}
+
+void QuadRenderer::Prepare(uint32_t frameIndex, VkExtent2D extent)
+{
+
+	this->m_Memory.BeginFrame(frameIndex);
+	this->m_VisibleCount = 0;
+
+	if (this->m_Unsorted)
+		this->SortBatches();
+
+	for (Batch &batch : this->m_Batches)
+		batch.VisibleCount = 0;
+
+	// A minimized window has nothing to draw into
+	if (this->m_QuadCount == 0 || extent.width == 0 || extent.height == 0)
+		return;
+
+	FrameLinearAllocator::Slice slice = this->m_Memory.Allocate((VkDeviceSize) this->m_QuadCount * sizeof(QuadInstance), sizeof(float) * 4);
+	if (!slice.Data)
+		return;
+
+	this->m_FrameBuffer = slice.Buffer;
+	this->m_FrameOffset = slice.Offset;
+
+	float scaleX = 2.0f / (float) extent.width;
+	float scaleY = 2.0f / (float) extent.height;
+
+	QuadInstance *instances = static_cast<QuadInstance *>(slice.Data);
+	for (Batch &batch : this->m_Batches)
+	{
+		batch.FirstInstance = this->m_VisibleCount;
+		batch.VisibleCount = TransformBatch(batch, scaleX, scaleY, instances + this->m_VisibleCount);
+		this->m_VisibleCount += batch.VisibleCount;
+	}
+
+}
+
+void QuadRenderer::Record(VkCommandBuffer commandBuffer) const
+{
+
+	if (this->m_VisibleCount == 0)
+		return;
+
+	vkCmdBindVertexBuffers(commandBuffer, 0, 1, &this->m_FrameBuffer, &this->m_FrameOffset);
+
+	VkPipeline boundPipeline = VK_NULL_HANDLE;
+	for (const Batch &batch : this->m_Batches)
+	{
+		if (batch.VisibleCount == 0)
+			continue;
+
+		VkPipeline pipeline = this->m_Pipelines[(size_t) batch.Blend];
+		if (pipeline != boundPipeline)
+		{
+			vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+			boundPipeline = pipeline;
+		}
+
+		uint32_t constants[] = { batch.Texture, this->m_SamplerHandle };
+		vkCmdPushConstants(commandBuffer, this->m_PipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+			0, sizeof(constants), constants);
+
+		vkCmdDraw(commandBuffer, 6, batch.VisibleCount, 0, batch.FirstInstance);
+	}
+
+}
+
+VkPipeline QuadRenderer::CreatePipeline(VkShaderModule vertexModule, VkShaderModule fragmentModule, QuadBlend blend,
+	VkPipelineCache pipelineCache, VkPipelineLayout pipelineLayout, VkRenderPass renderPass, uint32_t subpass) const
+{
+
+	VkPipelineShaderStageCreateInfo shaderStages[2] = {};
+	shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+	shaderStages[0].module = vertexModule;
+	shaderStages[0].pName = "main";
+	shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+	shaderStages[1].module = fragmentModule;
+	shaderStages[1].pName = "main";
+
+	VkVertexInputBindingDescription bindingDescription = QuadInstance::GetBindingDescription();
+	auto attributeDescriptions = QuadInstance::GetAttributeDescriptions();
+
+	VkPipelineVertexInputStateCreateInfo vertexInputCreateInfo = {};
+	vertexInputCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	vertexInputCreateInfo.vertexBindingDescriptionCount = 1;
+	vertexInputCreateInfo.pVertexBindingDescriptions = &bindingDescription;
+	vertexInputCreateInfo.vertexAttributeDescriptionCount = (uint32_t) attributeDescriptions.size();
+	vertexInputCreateInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
+
+	VkPipelineInputAssemblyStateCreateInfo inputAssemblyCreateInfo = {};
+	inputAssemblyCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	inputAssemblyCreateInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	inputAssemblyCreateInfo.primitiveRestartEnable = VK_FALSE;
+
+	VkPipelineViewportStateCreateInfo viewportState = {};
+	viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewportState.viewportCount = 1;
+	viewportState.scissorCount = 1;
+
+	// Mirrored and rotated quads keep both windings
+	VkPipelineRasterizationStateCreateInfo rasterizer = {};
+	rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+	rasterizer.lineWidth = 1.0f;
+	rasterizer.cullMode = VK_CULL_MODE_NONE;
+	rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
+
+	VkPipelineMultisampleStateCreateInfo multisampling = {};
+	multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+	multisampling.minSampleShading = 1.0f;
+
+	VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
+	colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT |
+										  VK_COLOR_COMPONENT_G_BIT |
+										  VK_COLOR_COMPONENT_B_BIT |
+										  VK_COLOR_COMPONENT_A_BIT;
+	colorBlendAttachment.blendEnable = blend == QuadBlend::Alpha ? VK_TRUE : VK_FALSE;
+	colorBlendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+	colorBlendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+	colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+	colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+	colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+	colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+
+	VkPipelineColorBlendStateCreateInfo colorBlending = {};
+	colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	colorBlending.logicOp = VK_LOGIC_OP_COPY;
+	colorBlending.attachmentCount = 1;
+	colorBlending.pAttachments = &colorBlendAttachment;
+
+	VkDynamicState dynamicStates[] = {
+		VK_DYNAMIC_STATE_VIEWPORT,
+		VK_DYNAMIC_STATE_SCISSOR
+	};
+
+	VkPipelineDynamicStateCreateInfo dynamicState = {};
+	dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamicState.dynamicStateCount = 2;
+	dynamicState.pDynamicStates = dynamicStates;
+
+	VkGraphicsPipelineCreateInfo pipelineCreateInfo = {};
+	pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	pipelineCreateInfo.stageCount = 2;
+	pipelineCreateInfo.pStages = shaderStages;
+	pipelineCreateInfo.pVertexInputState = &vertexInputCreateInfo;
+	pipelineCreateInfo.pInputAssemblyState = &inputAssemblyCreateInfo;
+	pipelineCreateInfo.pViewportState = &viewportState;
+	pipelineCreateInfo.pRasterizationState = &rasterizer;
+	pipelineCreateInfo.pMultisampleState = &multisampling;
+	pipelineCreateInfo.pColorBlendState = &colorBlending;
+	pipelineCreateInfo.pDynamicState = &dynamicState;
+	pipelineCreateInfo.layout = pipelineLayout;
+	pipelineCreateInfo.renderPass = renderPass;
+	pipelineCreateInfo.subpass = subpass;
+	pipelineCreateInfo.basePipelineIndex = -1;
+
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	VkResult result = vkCreateGraphicsPipelines(this->m_Device, pipelineCache, 1, &pipelineCreateInfo, nullptr, &pipeline);
+
+	return result == VK_SUCCESS ? pipeline : VK_NULL_HANDLE;
+
+}
+
+QuadRenderer::Batch &QuadRenderer::GetBatch(const QuadDesc &quad)
+{
+
+	// Layer first, so sorting by key is the draw order
+	uint64_t key = ((uint64_t) quad.Layer << 40) | ((uint64_t) quad.Blend << 32) | quad.Texture;
+
+	// Quads are usually added in runs of the same batch
+	if (this->m_LastBatch < this->m_Batches.size() && this->m_Batches[this->m_LastBatch].Key == key)
+		return this->m_Batches[this->m_LastBatch];
+
+	auto it = this->m_BatchIndices.find(key);
+	if (it != this->m_BatchIndices.end())
+	{
+		this->m_LastBatch = it->second;
+		return this->m_Batches[it->second];
+	}
+
+	Batch batch;
+	batch.Key = key;
+	batch.Texture = quad.Texture;
+	batch.Blend = quad.Blend;
+
+	this->m_LastBatch = this->m_Batches.size();
+	this->m_BatchIndices[key] = this->m_LastBatch;
+	this->m_Batches.push_back(std::move(batch));
+	this->m_Unsorted = true;
+
+	return this->m_Batches.back();
+
+}
+
+void QuadRenderer::SortBatches()
+{
+
+	std::sort(this->m_Batches.begin(), this->m_Batches.end(), [](const Batch &a, const Batch &b) { return a.Key < b.Key; });
+
+	this->m_BatchIndices.clear();
+	for (size_t i = 0; i < this->m_Batches.size(); ++i)
+		this->m_BatchIndices[this->m_Batches[i].Key] = i;
+
+	this->m_LastBatch = SIZE_MAX;
+	this->m_Unsorted = false;
+
+}
+
+uint32_t QuadRenderer::TransformBatch(const Batch &batch, float scaleX, float scaleY, QuadInstance *out)
+{
+
+	// Pixels to clip space, then a quad is visible when its bounding box overlaps [-1, 1]
+	const uint32_t count = (uint32_t) batch.PositionX.size();
+	float *write = reinterpret_cast<float *>(out);
+	uint32_t i = 0;
+
+	// The SIMD stores may alias anything, so the vectors' data pointers are loaded once up front
+	const float *positionX = batch.PositionX.data();
+	const float *positionY = batch.PositionY.data();
+	const float *axisXx = batch.AxisXx.data();
+	const float *axisXy = batch.AxisXy.data();
+	const float *axisYx = batch.AxisYx.data();
+	const float *axisYy = batch.AxisYy.data();
+	const uint32_t *color = batch.Color.data();
+	const uint32_t *uv0 = batch.Uv0.data();
+	const uint32_t *uv1 = batch.Uv1.data();
+
+#if defined(QUAD_SIMD_AVX)
+	{
+		const __m256 sx = _mm256_set1_ps(scaleX);
+		const __m256 sy = _mm256_set1_ps(scaleY);
+		const __m256 one = _mm256_set1_ps(1.0f);
+		const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+
+		for (; i + 8 <= count; i += 8)
+		{
+			__m256 cx = _mm256_sub_ps(_mm256_mul_ps(_mm256_loadu_ps(positionX + i), sx), one);
+			__m256 cy = _mm256_sub_ps(_mm256_mul_ps(_mm256_loadu_ps(positionY + i), sy), one);
+			__m256 axx = _mm256_mul_ps(_mm256_loadu_ps(axisXx + i), sx);
+			__m256 axy = _mm256_mul_ps(_mm256_loadu_ps(axisXy + i), sy);
+			__m256 ayx = _mm256_mul_ps(_mm256_loadu_ps(axisYx + i), sx);
+			__m256 ayy = _mm256_mul_ps(_mm256_loadu_ps(axisYy + i), sy);
+
+			__m256 extentX = _mm256_add_ps(_mm256_and_ps(axx, absMask), _mm256_and_ps(ayx, absMask));
+			__m256 extentY = _mm256_add_ps(_mm256_and_ps(axy, absMask), _mm256_and_ps(ayy, absMask));
+
+			__m256 visibleX = _mm256_cmp_ps(_mm256_sub_ps(_mm256_and_ps(cx, absMask), extentX), one, _CMP_LT_OQ);
+			__m256 visibleY = _mm256_cmp_ps(_mm256_sub_ps(_mm256_and_ps(cy, absMask), extentY), one, _CMP_LT_OQ);
+			int mask = _mm256_movemask_ps(_mm256_and_ps(visibleX, visibleY));
+
+			// The interleave is done a 128 bit half at a time
+			write = StoreQuads(write,
+				_mm256_castps256_ps128(cx), _mm256_castps256_ps128(cy),
+				_mm256_castps256_ps128(axx), _mm256_castps256_ps128(axy),
+				_mm256_castps256_ps128(ayx), _mm256_castps256_ps128(ayy),
+				color + i, uv0 + i, uv1 + i, mask & 0xF);
+
+			write = StoreQuads(write,
+				_mm256_extractf128_ps(cx, 1), _mm256_extractf128_ps(cy, 1),
+				_mm256_extractf128_ps(axx, 1), _mm256_extractf128_ps(axy, 1),
+				_mm256_extractf128_ps(ayx, 1), _mm256_extractf128_ps(ayy, 1),
+				color + i + 4, uv0 + i + 4, uv1 + i + 4, mask >> 4);
+		}
+	}
+#endif
+
+#if defined(QUAD_SIMD_SSE2)
+	{
+		const __m128 sx = _mm_set1_ps(scaleX);
+		const __m128 sy = _mm_set1_ps(scaleY);
+		const __m128 one = _mm_set1_ps(1.0f);
+		const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128 cx = _mm_sub_ps(_mm_mul_ps(_mm_loadu_ps(positionX + i), sx), one);
+			__m128 cy = _mm_sub_ps(_mm_mul_ps(_mm_loadu_ps(positionY + i), sy), one);
+			__m128 axx = _mm_mul_ps(_mm_loadu_ps(axisXx + i), sx);
+			__m128 axy = _mm_mul_ps(_mm_loadu_ps(axisXy + i), sy);
+			__m128 ayx = _mm_mul_ps(_mm_loadu_ps(axisYx + i), sx);
+			__m128 ayy = _mm_mul_ps(_mm_loadu_ps(axisYy + i), sy);
+
+			__m128 extentX = _mm_add_ps(_mm_and_ps(axx, absMask), _mm_and_ps(ayx, absMask));
+			__m128 extentY = _mm_add_ps(_mm_and_ps(axy, absMask), _mm_and_ps(ayy, absMask));
+
+			__m128 visibleX = _mm_cmplt_ps(_mm_sub_ps(_mm_and_ps(cx, absMask), extentX), one);
+			__m128 visibleY = _mm_cmplt_ps(_mm_sub_ps(_mm_and_ps(cy, absMask), extentY), one);
+			int mask = _mm_movemask_ps(_mm_and_ps(visibleX, visibleY));
+
+			write = StoreQuads(write, cx, cy, axx, axy, ayx, ayy, color + i, uv0 + i, uv1 + i, mask);
+		}
+	}
+#endif
+
+	// The remainder, or everything without SIMD
+	for (; i < count; ++i)
+	{
+		float cx = positionX[i] * scaleX - 1.0f;
+		float cy = positionY[i] * scaleY - 1.0f;
+		float axx = axisXx[i] * scaleX;
+		float axy = axisXy[i] * scaleY;
+		float ayx = axisYx[i] * scaleX;
+		float ayy = axisYy[i] * scaleY;
+
+		float extentX = std::abs(axx) + std::abs(ayx);
+		float extentY = std::abs(axy) + std::abs(ayy);
+
+		if (std::abs(cx) - extentX >= 1.0f || std::abs(cy) - extentY >= 1.0f)
+			continue;
+
+		QuadInstance &instance = *reinterpret_cast<QuadInstance *>(write);
+		instance.Center[0] = cx;
+		instance.Center[1] = cy;
+		instance.AxisX[0] = axx;
+		instance.AxisX[1] = axy;
+		instance.AxisY[0] = ayx;
+		instance.AxisY[1] = ayy;
+		instance.Color = color[i];
+		instance.Uv[0] = uv0[i];
+		instance.Uv[1] = uv1[i];
+
+		write += QUAD_INSTANCE_FLOATS;
+	}
+
+	return (uint32_t) ((write - reinterpret_cast<float *>(out)) / QUAD_INSTANCE_FLOATS);
+
+}
@@ -0,0 +1,185 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <array>
+#include <unordered_map>
+#include <cstddef>
+#include <cstdint>
+
+#include "MemoryAllocator.h"
+#include "BindlessDescriptors.h"
+#include "VulkanHandle.h"
+
+enum class QuadBlend
+{
+	Opaque,
+	Alpha,
+	Count
+};
+
+// A screen space rectangle, positions and sizes are in pixels from the top left corner
+struct QuadDesc
+{
+	float Position[2] = { 0.0f, 0.0f };
+	float Size[2] = { 1.0f, 1.0f };
+
+	// Radians, clockwise on screen around Position, which is the center
+	float Rotation = 0.0f;
+
+	// RGBA8 with red in the lowest byte
+	uint32_t Color = 0xFFFFFFFF;
+
+	// Left, top, right and bottom of the texture region
+	float Uv[4] = { 0.0f, 0.0f, 1.0f, 1.0f };
+	uint32_t Texture = BindlessDescriptors::INVALID_HANDLE;
+
+	// Higher layers are drawn on top, within a layer opaque quads come first
+	uint16_t Layer = 0;
+	QuadBlend Blend = QuadBlend::Opaque;
+};
+
+// One instance in the vertex buffer, the six vertices of a quad are built from it in the shader
+struct QuadInstance
+{
+	// Clip space center and the half extents along the rotated axes
+	float Center[2];
+	float AxisX[2];
+	float AxisY[2];
+	uint32_t Color;
+
+	// Unorm16 pairs, left top and right bottom
+	uint32_t Uv[2];
+
+	static VkVertexInputBindingDescription GetBindingDescription()
+	{
+		VkVertexInputBindingDescription binding = {};
+		binding.binding = 0;
+		binding.stride = sizeof(QuadInstance);
+		binding.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+
+		return binding;
+	}
+
+	static std::array<VkVertexInputAttributeDescription, 5> GetAttributeDescriptions()
+	{
+		std::array<VkVertexInputAttributeDescription, 5> attributes = {};
+
+		attributes[0].binding = 0;
+		attributes[0].location = 0;
+		attributes[0].format = VK_FORMAT_R32G32_SFLOAT;
+		attributes[0].offset = offsetof(QuadInstance, Center);
+
+		attributes[1].binding = 0;
+		attributes[1].location = 1;
+		attributes[1].format = VK_FORMAT_R32G32_SFLOAT;
+		attributes[1].offset = offsetof(QuadInstance, AxisX);
+
+		attributes[2].binding = 0;
+		attributes[2].location = 2;
+		attributes[2].format = VK_FORMAT_R32G32_SFLOAT;
+		attributes[2].offset = offsetof(QuadInstance, AxisY);
+
+		attributes[3].binding = 0;
+		attributes[3].location = 3;
+		attributes[3].format = VK_FORMAT_R8G8B8A8_UNORM;
+		attributes[3].offset = offsetof(QuadInstance, Color);
+
+		attributes[4].binding = 0;
+		attributes[4].location = 4;
+		attributes[4].format = VK_FORMAT_R16G16B16A16_UNORM;
+		attributes[4].offset = offsetof(QuadInstance, Uv);
+
+		return attributes;
+	}
+};
+
+static_assert(sizeof(QuadInstance) == 36, "QuadInstance is written nine floats at a time");
+
+// Batched 2D quads. Quads are kept as structure of arrays, one batch per layer, blend
+// mode and texture, so every batch is a single instanced draw. Each frame the batches
+// are mapped to clip space, culled against the screen and compacted straight into a
+// persistently mapped vertex buffer, four or eight quads at a time with SSE2 or AVX.
+// Quads stay until cleared, so static ones are only added once.
+class QuadRenderer
+{
+
+public:
+	// Returns false when the pipelines cannot be created. The layout needs the bindless
+	// set at PIPELINE_SET_BINDLESS and 8 bytes of push constants for both stages.
+	bool Init(VkDevice device, MemoryAllocator &allocator, VkPipelineCache pipelineCache, VkPipelineLayout pipelineLayout,
+		VkRenderPass renderPass, uint32_t subpass, const std::vector<char> &vertexCode, const std::vector<char> &fragmentCode,
+		uint32_t maxQuads, uint32_t frameCount, uint32_t samplerHandle);
+	void Shutdown();
+
+	// Removes every quad, the batches keep their memory
+	void Clear();
+
+	// Returns false once maxQuads quads were added
+	bool Add(const QuadDesc &quad);
+
+	// Writes the visible quads into the frame's region, once its previous frame completed
+	void Prepare(uint32_t frameIndex, VkExtent2D extent);
+
+	// Inside the render pass, with the viewport, scissor and bindless set already bound
+	void Record(VkCommandBuffer commandBuffer) const;
+
+	inline bool IsEnabled() const { return m_Pipelines[0] != VK_NULL_HANDLE; }
+	inline uint32_t GetQuadCount() const { return m_QuadCount; }
+	inline uint32_t GetVisibleCount() const { return m_VisibleCount; }
+	inline uint32_t GetBatchCount() const { return (uint32_t) m_Batches.size(); }
+
+private:
+	struct Batch
+	{
+		uint64_t Key = 0;
+		uint32_t Texture = BindlessDescriptors::INVALID_HANDLE;
+		QuadBlend Blend = QuadBlend::Opaque;
+
+		// In pixels, the axes are rotated half extents
+		std::vector<float> PositionX;
+		std::vector<float> PositionY;
+		std::vector<float> AxisXx;
+		std::vector<float> AxisXy;
+		std::vector<float> AxisYx;
+		std::vector<float> AxisYy;
+		std::vector<uint32_t> Color;
+		std::vector<uint32_t> Uv0;
+		std::vector<uint32_t> Uv1;
+
+		// Written by Prepare
+		uint32_t FirstInstance = 0;
+		uint32_t VisibleCount = 0;
+	};
+
+	VkPipeline CreatePipeline(VkShaderModule vertexModule, VkShaderModule fragmentModule, QuadBlend blend,
+		VkPipelineCache pipelineCache, VkPipelineLayout pipelineLayout, VkRenderPass renderPass, uint32_t subpass) const;
+
+	Batch &GetBatch(const QuadDesc &quad);
+	void SortBatches();
+
+	// Writes the batch's visible quads to out and returns how many there were
+	static uint32_t TransformBatch(const Batch &batch, float scaleX, float scaleY, QuadInstance *out);
+
+private:
+	VkDevice m_Device = VK_NULL_HANDLE;
+	VkPipelineLayout m_PipelineLayout = VK_NULL_HANDLE;
+	UniquePipeline m_Pipelines[(size_t) QuadBlend::Count];
+
+	FrameLinearAllocator m_Memory;
+	VkBuffer m_FrameBuffer = VK_NULL_HANDLE;
+	VkDeviceSize m_FrameOffset = 0;
+
+	uint32_t m_SamplerHandle = BindlessDescriptors::INVALID_HANDLE;
+	uint32_t m_MaxQuads = 0;
+	uint32_t m_QuadCount = 0;
+	uint32_t m_VisibleCount = 0;
+
+	// Drawn in key order, which only changes when a batch is added
+	std::vector<Batch> m_Batches;
+	std::unordered_map<uint64_t, size_t> m_BatchIndices;
+	size_t m_LastBatch = SIZE_MAX;
+	bool m_Unsorted = false;
+
+};
@@ -0,0 +1,990 @@
+#include "RenderGraph.h"
+#include "GpuProfiler.h"
+#include "Log.h"
+
+#include <algorithm>
+
+static const VkAccessFlags WRITE_ACCESS = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT
+	| VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_HOST_WRITE_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+
+void RenderGraph::Init(VkDevice device, MemoryAllocator &allocator)
+{
+
+	this->m_Device = device;
+	this->m_Allocator = &allocator;
+
+}
+
+void RenderGraph::Shutdown()
+{
+
+	if (!this->m_Device)
+		return;
+
+	this->m_Targets.reset();
+	this->m_Groups.clear();
+	this->m_Passes.clear();
+	this->m_Resources.clear();
+	this->m_Compiled = false;
+
+	this->m_Device = VK_NULL_HANDLE;
+
+}
+
+RenderGraph::ResourceId RenderGraph::ImportImage(const std::string &name, VkFormat format, VkImageLayout finalLayout)
+{
+
+	Resource resource;
+	resource.Name = name;
+	resource.Format = format;
+	resource.Imported = true;
+	resource.FinalLayout = finalLayout;
+
+	this->m_Resources.push_back(std::move(resource));
+	return (ResourceId) this->m_Resources.size() - 1;
+
+}
+
+RenderGraph::ResourceId RenderGraph::CreateImage(const std::string &name, VkFormat format)
+{
+
+	Resource resource;
+	resource.Name = name;
+	resource.Format = format;
+
+	this->m_Resources.push_back(std::move(resource));
+	return (ResourceId) this->m_Resources.size() - 1;
+
+}
+
+RenderGraph::PassId RenderGraph::AddPass(const std::string &name, ExecuteFunction execute)
+{
+
+	Pass pass;
+	pass.Name = name;
+	pass.Execute = std::move(execute);
+
+	this->m_Passes.push_back(std::move(pass));
+	return (PassId) this->m_Passes.size() - 1;
+
+}
+
+void RenderGraph::WriteColor(PassId pass, ResourceId resource)
+{
+
+	this->m_Passes[pass].Accesses.push_back({ resource, AccessType::ColorWrite });
+
+}
+
+void RenderGraph::ClearColor(PassId pass, ResourceId resource, const VkClearColorValue &color)
+{
+
+	Access access = { resource, AccessType::ColorWrite };
+	access.Clear = true;
+	access.ClearValue.color = color;
+
+	this->m_Passes[pass].Accesses.push_back(access);
+
+}
+
+void RenderGraph::WriteDepth(PassId pass, ResourceId resource)
+{
+
+	this->m_Passes[pass].Accesses.push_back({ resource, AccessType::DepthWrite });
+
+}
+
+void RenderGraph::ClearDepth(PassId pass, ResourceId resource, float depth)
+{
+
+	Access access = { resource, AccessType::DepthWrite };
+	access.Clear = true;
+	access.ClearValue.depthStencil = { depth, 0 };
+
+	this->m_Passes[pass].Accesses.push_back(access);
+
+}
+
+void RenderGraph::ReadAttachment(PassId pass, ResourceId resource)
+{
+
+	this->m_Passes[pass].Accesses.push_back({ resource, AccessType::InputRead });
+
+}
+
+void RenderGraph::ReadTexture(PassId pass, ResourceId resource, VkPipelineStageFlags stages)
+{
+
+	Access access = { resource, AccessType::TextureRead };
+	access.Stages = stages;
+
+	this->m_Passes[pass].Accesses.push_back(access);
+
+}
+
+void RenderGraph::KeepPass(PassId pass)
+{
+
+	this->m_Passes[pass].Keep = true;
+
+}
+
+void RenderGraph::SetSecondaryContents(PassId pass, bool secondary)
+{
+
+	this->m_Passes[pass].Secondary = secondary;
+
+}
+
+void RenderGraph::Compile()
+{
+
+	this->CullPasses();
+	this->GroupPasses();
+
+	for (uint32_t i = 0; i < (uint32_t) this->m_Groups.size(); ++i)
+		this->CreateRenderPass(i);
+
+	this->m_Compiled = true;
+
+	uint32_t activeCount = 0;
+	for (const Pass &pass : this->m_Passes)
+	{
+		if (pass.Active)
+			++activeCount;
+		else
+			LOG_VK_TRACE("Render graph culled pass '{0}', nothing reads what it writes", pass.Name);
+	}
+
+	LOG_VK_INFO("Render graph: {0} of {1} passes in {2} render passes", activeCount, this->m_Passes.size(), this->m_Groups.size());
+
+}
+
+void RenderGraph::CullPasses()
+{
+
+	// Walks back from the imported images, a pass survives when a later one or the
+	// outside needs the contents it writes. A clear ends the need for older contents.
+	std::vector<bool> needed(this->m_Resources.size(), false);
+	for (size_t i = 0; i < this->m_Resources.size(); ++i)
+		needed[i] = this->m_Resources[i].Imported;
+
+	for (size_t i = this->m_Passes.size(); i-- > 0;)
+	{
+		Pass &pass = this->m_Passes[i];
+
+		pass.Active = pass.Keep;
+		for (const Access &access : pass.Accesses)
+			pass.Active |= IsWrite(access.Type) && needed[access.Resource];
+
+		if (!pass.Active)
+			continue;
+
+		for (const Access &access : pass.Accesses)
+		{
+			if (IsWrite(access.Type) && access.Clear)
+				needed[access.Resource] = false;
+		}
+
+		for (const Access &access : pass.Accesses)
+		{
+			if (!IsWrite(access.Type) || !access.Clear)
+				needed[access.Resource] = true;
+		}
+	}
+
+}
+
+void RenderGraph::GroupPasses()
+{
+
+	this->m_Groups.clear();
+
+	std::vector<bool> written(this->m_Resources.size(), false);
+	std::vector<bool> sampled(this->m_Resources.size(), false);
+
+	for (PassId id = 0; id < (PassId) this->m_Passes.size(); ++id)
+	{
+		Pass &pass = this->m_Passes[id];
+		if (!pass.Active)
+			continue;
+
+		// Sampling needs the writes finished and stored, which only the end of a render pass
+		// guarantees, and a sampled image cannot become an attachment within the same one
+		bool merge = !this->m_Groups.empty();
+		for (const Access &access : pass.Accesses)
+		{
+			if (access.Type == AccessType::TextureRead && written[access.Resource])
+				merge = false;
+
+			if (access.Type != AccessType::TextureRead && sampled[access.Resource])
+				merge = false;
+		}
+
+		if (!merge)
+		{
+			this->m_Groups.emplace_back();
+			std::fill(written.begin(), written.end(), false);
+			std::fill(sampled.begin(), sampled.end(), false);
+		}
+
+		Group &group = this->m_Groups.back();
+		pass.Group = (uint32_t) this->m_Groups.size() - 1;
+		pass.Subpass = (uint32_t) group.Passes.size();
+		group.Passes.push_back(id);
+
+		for (const Access &access : pass.Accesses)
+		{
+			Resource &resource = this->m_Resources[access.Resource];
+
+			if (!resource.Used)
+				resource.FirstGroup = pass.Group;
+
+			resource.Used = true;
+			resource.LastGroup = pass.Group;
+
+			switch (access.Type)
+			{
+			case AccessType::ColorWrite:	resource.Usage |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT; break;
+			case AccessType::DepthWrite:	resource.Usage |= VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT; break;
+			case AccessType::InputRead:		resource.Usage |= VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT; break;
+			case AccessType::TextureRead:	resource.Usage |= VK_IMAGE_USAGE_SAMPLED_BIT; break;
+			}
+
+			written[access.Resource] = written[access.Resource] || IsWrite(access.Type);
+			sampled[access.Resource] = sampled[access.Resource] || access.Type == AccessType::TextureRead;
+		}
+	}
+
+}
+
+void RenderGraph::CreateRenderPass(uint32_t groupIndex)
+{
+
+	Group &group = this->m_Groups[groupIndex];
+
+	std::vector<uint32_t> attachmentIndex(this->m_Resources.size(), UINT32_MAX);
+	for (PassId id : group.Passes)
+	{
+		for (const Access &access : this->m_Passes[id].Accesses)
+		{
+			if (access.Type == AccessType::TextureRead || attachmentIndex[access.Resource] != UINT32_MAX)
+				continue;
+
+			attachmentIndex[access.Resource] = (uint32_t) group.Attachments.size();
+			group.Attachments.push_back(access.Resource);
+			group.UsesImported |= this->m_Resources[access.Resource].Imported;
+		}
+	}
+
+	uint32_t attachmentCount = (uint32_t) group.Attachments.size();
+	uint32_t subpassCount = (uint32_t) group.Passes.size();
+
+	std::vector<VkAttachmentDescription> attachments(attachmentCount);
+	group.ClearValues.assign(attachmentCount, VkClearValue());
+
+	// Subpass of the first and last reference per attachment
+	std::vector<uint32_t> firstSubpass(attachmentCount, UINT32_MAX);
+	std::vector<uint32_t> lastSubpass(attachmentCount, 0);
+
+	for (uint32_t a = 0; a < attachmentCount; ++a)
+	{
+		ResourceId id = group.Attachments[a];
+		const Resource &resource = this->m_Resources[id];
+		bool depth = IsDepthFormat(resource.Format);
+
+		const Access *first = nullptr;
+		const Access *last = nullptr;
+
+		for (uint32_t s = 0; s < subpassCount; ++s)
+		{
+			for (const Access &access : this->m_Passes[group.Passes[s]].Accesses)
+			{
+				if (access.Resource != id || access.Type == AccessType::TextureRead)
+					continue;
+
+				if (!first)
+				{
+					first = &access;
+					firstSubpass[a] = s;
+				}
+
+				last = &access;
+				lastSubpass[a] = s;
+			}
+		}
+
+		// Stored when anything after this render pass reads the contents before clearing them
+		bool stored = resource.Imported;
+		bool found = false;
+
+		for (uint32_t g = groupIndex + 1; g < (uint32_t) this->m_Groups.size() && !found; ++g)
+		{
+			for (PassId passId : this->m_Groups[g].Passes)
+			{
+				for (const Access &access : this->m_Passes[passId].Accesses)
+				{
+					if (access.Resource != id || found)
+						continue;
+
+					found = true;
+					stored |= !(IsWrite(access.Type) && access.Clear);
+				}
+			}
+		}
+
+		VkAttachmentLoadOp loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		if (IsWrite(first->Type) && first->Clear)
+		{
+			loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+			group.ClearValues[a] = first->ClearValue;
+		}
+		else if (resource.FirstGroup < groupIndex)
+			loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+
+		VkAttachmentDescription &description = attachments[a];
+		description.format = resource.Format;
+		description.samples = VK_SAMPLE_COUNT_1_BIT;
+		description.loadOp = loadOp;
+		description.storeOp = stored ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		description.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		description.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+
+		// The barriers before the render pass already put it in the layout of its first use
+		description.initialLayout = GetAccessState(*first, depth).Layout;
+		description.finalLayout = GetAccessState(*last, depth).Layout;
+
+		// Saves a barrier after the last render pass using an imported image
+		if (resource.Imported && resource.LastGroup == groupIndex)
+			description.finalLayout = resource.FinalLayout;
+	}
+
+	// References have to stay alive until the render pass is created
+	std::vector<std::vector<VkAttachmentReference>> colorRefs(subpassCount);
+	std::vector<std::vector<VkAttachmentReference>> inputRefs(subpassCount);
+	std::vector<VkAttachmentReference> depthRefs(subpassCount);
+	std::vector<std::vector<uint32_t>> preserved(subpassCount);
+	std::vector<VkSubpassDescription> subpasses(subpassCount);
+	std::vector<VkSubpassDependency> dependencies;
+
+	auto addDependency = [&dependencies](uint32_t src, uint32_t dst, const ResourceState &before, const ResourceState &after)
+	{
+		for (VkSubpassDependency &dependency : dependencies)
+		{
+			if (dependency.srcSubpass != src || dependency.dstSubpass != dst)
+				continue;
+
+			dependency.srcStageMask |= before.Stages;
+			dependency.srcAccessMask |= before.Access;
+			dependency.dstStageMask |= after.Stages;
+			dependency.dstAccessMask |= after.Access;
+			return;
+		}
+
+		VkSubpassDependency dependency = {};
+		dependency.srcSubpass = src;
+		dependency.dstSubpass = dst;
+		dependency.srcStageMask = before.Stages;
+		dependency.srcAccessMask = before.Access;
+		dependency.dstStageMask = after.Stages;
+		dependency.dstAccessMask = after.Access;
+
+		// Attachments and input attachments only ever touch the pixel being shaded
+		if (dst != VK_SUBPASS_EXTERNAL)
+			dependency.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+		dependencies.push_back(dependency);
+	};
+
+	// Last access per attachment within the render pass so far
+	std::vector<const Access *> previous(attachmentCount, nullptr);
+	std::vector<uint32_t> previousSubpass(attachmentCount, 0);
+
+	for (uint32_t s = 0; s < subpassCount; ++s)
+	{
+		std::vector<bool> referenced(attachmentCount, false);
+		depthRefs[s] = { VK_ATTACHMENT_UNUSED, VK_IMAGE_LAYOUT_UNDEFINED };
+
+		for (const Access &access : this->m_Passes[group.Passes[s]].Accesses)
+		{
+			if (access.Type == AccessType::TextureRead)
+				continue;
+
+			uint32_t a = attachmentIndex[access.Resource];
+			bool depth = IsDepthFormat(this->m_Resources[access.Resource].Format);
+			ResourceState state = GetAccessState(access, depth);
+			VkAttachmentReference reference = { a, state.Layout };
+
+			switch (access.Type)
+			{
+			case AccessType::ColorWrite:	colorRefs[s].push_back(reference); break;
+			case AccessType::DepthWrite:	depthRefs[s] = reference; break;
+			default:						inputRefs[s].push_back(reference); break;
+			}
+
+			// Reads after reads need nothing
+			const Access *before = previous[a];
+			if (before && previousSubpass[a] != s && (IsWrite(before->Type) || IsWrite(access.Type)))
+				addDependency(previousSubpass[a], s, GetAccessState(*before, depth), state);
+
+			previous[a] = &access;
+			previousSubpass[a] = s;
+			referenced[a] = true;
+		}
+
+		for (uint32_t a = 0; a < attachmentCount; ++a)
+		{
+			if (!referenced[a] && firstSubpass[a] < s && lastSubpass[a] > s)
+				preserved[s].push_back(a);
+		}
+
+		VkSubpassDescription &subpass = subpasses[s];
+		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpass.colorAttachmentCount = (uint32_t) colorRefs[s].size();
+		subpass.pColorAttachments = colorRefs[s].data();
+		subpass.inputAttachmentCount = (uint32_t) inputRefs[s].size();
+		subpass.pInputAttachments = inputRefs[s].data();
+		subpass.pDepthStencilAttachment = depthRefs[s].attachment != VK_ATTACHMENT_UNUSED ? &depthRefs[s] : nullptr;
+		subpass.preserveAttachmentCount = (uint32_t) preserved[s].size();
+		subpass.pPreserveAttachments = preserved[s].data();
+	}
+
+	// Whatever consumes an imported image after the frame waits for its final layout
+	for (uint32_t a = 0; a < attachmentCount; ++a)
+	{
+		const Resource &resource = this->m_Resources[group.Attachments[a]];
+		if (!resource.Imported || resource.LastGroup != groupIndex)
+			continue;
+
+		bool depth = IsDepthFormat(resource.Format);
+		addDependency(lastSubpass[a], VK_SUBPASS_EXTERNAL, GetAccessState(*previous[a], depth), GetFinalState(resource.FinalLayout));
+	}
+
+	VkRenderPassCreateInfo createInfo = {};
+	createInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	createInfo.attachmentCount = attachmentCount;
+	createInfo.pAttachments = attachments.data();
+	createInfo.subpassCount = subpassCount;
+	createInfo.pSubpasses = subpasses.data();
+	createInfo.dependencyCount = (uint32_t) dependencies.size();
+	createInfo.pDependencies = dependencies.data();
+
+	if (vkCreateRenderPass(this->m_Device, &createInfo, nullptr, group.RenderPass.Replace(this->m_Device)) != VK_SUCCESS)
+	{
+		LOG_VK_CRITICAL("Failed to create render pass for render graph pass '{0}'!", this->m_Passes[group.Passes[0]].Name);
+		exit(-1);
+	}
+
+}
+
+void RenderGraph::SetImportedImages(ResourceId id, const std::vector<VkImage> &images, const std::vector<VkImageView> &views)
+{
+
+	Resource &resource = this->m_Resources[id];
+	resource.ImportedImages = images;
+	resource.ImportedViews = views;
+
+	this->m_ImportedImageCount = (uint32_t) images.size();
+
+}
+
+void RenderGraph::CreateTargets(VkExtent2D extent, DeletionQueue &deletionQueue, uint64_t lastUsedFrame)
+{
+
+	if (!this->m_Compiled)
+	{
+		LOG_VK_CRITICAL("Render graph targets created before the graph was compiled!");
+		exit(-1);
+	}
+
+	this->m_Extent = extent;
+
+	std::unique_ptr<Targets> targets = std::make_unique<Targets>();
+	targets->Allocator = this->m_Allocator;
+
+	this->AliasTransients(*targets);
+	targets->Framebuffers.resize(this->m_Groups.size());
+
+	for (size_t g = 0; g < this->m_Groups.size(); ++g)
+	{
+		const Group &group = this->m_Groups[g];
+		uint32_t framebufferCount = group.UsesImported ? this->m_ImportedImageCount : 1;
+
+		targets->Framebuffers[g].resize(framebufferCount);
+
+		for (uint32_t i = 0; i < framebufferCount; ++i)
+		{
+			std::vector<VkImageView> views;
+			for (ResourceId id : group.Attachments)
+			{
+				const Resource &resource = this->m_Resources[id];
+				views.push_back(resource.Imported ? resource.ImportedViews[i] : targets->Views[id].Get());
+			}
+
+			VkFramebufferCreateInfo createInfo = {};
+			createInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+			createInfo.renderPass = group.RenderPass;
+			createInfo.attachmentCount = (uint32_t) views.size();
+			createInfo.pAttachments = views.data();
+			createInfo.width = extent.width;
+			createInfo.height = extent.height;
+			createInfo.layers = 1;
+
+			if (vkCreateFramebuffer(this->m_Device, &createInfo, nullptr, targets->Framebuffers[g][i].Replace(this->m_Device)) != VK_SUCCESS)
+			{
+				LOG_VK_CRITICAL("Failed to create render graph framebuffer!");
+				exit(-1);
+			}
+		}
+	}
+
+	this->PlanBarriers(*targets);
+
+	// Frames in flight may still render into the previous ones
+	if (this->m_Targets)
+		deletionQueue.Retire(std::move(this->m_Targets), lastUsedFrame);
+
+	this->m_Targets = std::move(targets);
+
+}
+
+void RenderGraph::AliasTransients(Targets &targets)
+{
+
+	targets.Images.resize(this->m_Resources.size());
+	targets.Views.resize(this->m_Resources.size());
+	targets.MemorySlot.assign(this->m_Resources.size(), UINT32_MAX);
+
+	std::vector<std::pair<ResourceId, VkMemoryRequirements>> transients;
+	VkDeviceSize unaliasedSize = 0;
+
+	for (ResourceId id = 0; id < (ResourceId) this->m_Resources.size(); ++id)
+	{
+		const Resource &resource = this->m_Resources[id];
+		if (resource.Imported || !resource.Used)
+			continue;
+
+		// Attachment-only images never need their contents outside a render pass
+		VkImageUsageFlags usage = resource.Usage;
+		if (!(usage & VK_IMAGE_USAGE_SAMPLED_BIT))
+			usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+
+		VkImageCreateInfo imageInfo = {};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.format = resource.Format;
+		imageInfo.extent = { this->m_Extent.width, this->m_Extent.height, 1 };
+		imageInfo.mipLevels = 1;
+		imageInfo.arrayLayers = 1;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.usage = usage;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+		if (vkCreateImage(this->m_Device, &imageInfo, nullptr, targets.Images[id].Replace(this->m_Device)) != VK_SUCCESS)
+		{
+			LOG_VK_CRITICAL("Failed to create render graph image '{0}'!", resource.Name);
+			exit(-1);
+		}
+
+		VkMemoryRequirements requirements = {};
+		vkGetImageMemoryRequirements(this->m_Device, targets.Images[id], &requirements);
+
+		transients.emplace_back(id, requirements);
+		unaliasedSize += requirements.size;
+	}
+
+	// Largest first, each image goes into the first slot with a compatible memory
+	// type whose images are all dead or not yet alive while it is used
+	std::sort(transients.begin(), transients.end(), [](const auto &a, const auto &b) { return a.second.size > b.second.size; });
+
+	std::vector<VkMemoryRequirements> slots;
+
+	for (const auto &[id, requirements] : transients)
+	{
+		const Resource &resource = this->m_Resources[id];
+		uint32_t slot = 0;
+
+		for (; slot < (uint32_t) slots.size(); ++slot)
+		{
+			if (!(slots[slot].memoryTypeBits & requirements.memoryTypeBits))
+				continue;
+
+			bool overlaps = false;
+			for (ResourceId other : targets.SlotResources[slot])
+			{
+				const Resource &alias = this->m_Resources[other];
+				overlaps |= alias.FirstGroup <= resource.LastGroup && resource.FirstGroup <= alias.LastGroup;
+			}
+
+			if (!overlaps)
+				break;
+		}
+
+		if (slot == (uint32_t) slots.size())
+		{
+			slots.push_back(requirements);
+			targets.SlotResources.emplace_back();
+		}
+
+		VkMemoryRequirements &combined = slots[slot];
+		combined.size = std::max(combined.size, requirements.size);
+		combined.alignment = std::max(combined.alignment, requirements.alignment);
+		combined.memoryTypeBits &= requirements.memoryTypeBits;
+
+		targets.SlotResources[slot].push_back(id);
+		targets.MemorySlot[id] = slot;
+	}
+
+	AllocationCreateInfo allocInfo = {};
+	allocInfo.RequiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+	allocInfo.Category = MemoryCategory::Image;
+
+	VkDeviceSize aliasedSize = 0;
+	targets.Memory.resize(slots.size());
+
+	for (size_t slot = 0; slot < slots.size(); ++slot)
+	{
+		if (this->m_Allocator->Allocate(slots[slot], allocInfo, ResourceKind::Optimal, targets.Memory[slot]) != VK_SUCCESS)
+		{
+			LOG_VK_CRITICAL("Failed to allocate {0} bytes for render graph images!", slots[slot].size);
+			exit(-1);
+		}
+
+		aliasedSize += slots[slot].size;
+
+		for (ResourceId id : targets.SlotResources[slot])
+			vkBindImageMemory(this->m_Device, targets.Images[id], targets.Memory[slot].Memory, targets.Memory[slot].Offset);
+	}
+
+	for (const auto &[id, requirements] : transients)
+	{
+		VkImageViewCreateInfo viewInfo = {};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = targets.Images[id];
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = this->m_Resources[id].Format;
+		viewInfo.subresourceRange.aspectMask = this->GetAspect(id);
+		viewInfo.subresourceRange.levelCount = 1;
+		viewInfo.subresourceRange.layerCount = 1;
+
+		if (vkCreateImageView(this->m_Device, &viewInfo, nullptr, targets.Views[id].Replace(this->m_Device)) != VK_SUCCESS)
+		{
+			LOG_VK_CRITICAL("Failed to create render graph image view '{0}'!", this->m_Resources[id].Name);
+			exit(-1);
+		}
+	}
+
+	if (!transients.empty())
+	{
+		LOG_VK_INFO("Render graph targets ({0}x{1}): {2} transient images in {3} allocations, {4:.1f} MiB instead of {5:.1f} MiB",
+			this->m_Extent.width, this->m_Extent.height, transients.size(), slots.size(),
+			aliasedSize / (1024.0 * 1024.0), unaliasedSize / (1024.0 * 1024.0));
+	}
+
+}
+
+void RenderGraph::PlanBarriers(const Targets &targets)
+{
+
+	size_t resourceCount = this->m_Resources.size();
+
+	// State each image is left in by its last access of the frame
+	std::vector<ResourceState> lastState(resourceCount);
+	for (const Pass &pass : this->m_Passes)
+	{
+		if (!pass.Active)
+			continue;
+
+		for (const Access &access : pass.Accesses)
+			lastState[access.Resource] = GetAccessState(access, IsDepthFormat(this->m_Resources[access.Resource].Format));
+	}
+
+	// Transients start from garbage, but only once the previous frame and every image
+	// sharing their memory are done with it. Imported images become available at
+	// the color output stage.
+	std::vector<ResourceState> state(resourceCount);
+	for (ResourceId id = 0; id < (ResourceId) resourceCount; ++id)
+	{
+		if (this->m_Resources[id].Imported)
+		{
+			state[id].Stages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+			continue;
+		}
+
+		uint32_t slot = targets.MemorySlot[id];
+		if (slot == UINT32_MAX)
+			continue;
+
+		for (ResourceId alias : targets.SlotResources[slot])
+		{
+			state[id].Stages |= lastState[alias].Stages;
+			state[id].Access |= lastState[alias].Access;
+		}
+	}
+
+	for (uint32_t g = 0; g < (uint32_t) this->m_Groups.size(); ++g)
+	{
+		Group &group = this->m_Groups[g];
+		group.Barriers.clear();
+
+		std::vector<bool> seen(resourceCount, false);
+		std::vector<ResourceState> after(resourceCount);
+
+		for (PassId passId : group.Passes)
+		{
+			for (const Access &access : this->m_Passes[passId].Accesses)
+			{
+				ResourceId id = access.Resource;
+				const Resource &resource = this->m_Resources[id];
+				ResourceState needed = GetAccessState(access, IsDepthFormat(resource.Format));
+
+				after[id] = needed;
+				if (seen[id])
+					continue;
+
+				seen[id] = true;
+
+				ResourceState before = state[id];
+				if (resource.FirstGroup == g || (IsWrite(access.Type) && access.Clear))
+					before.Layout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+				// Reads in the same layout as an earlier read need no barrier
+				if (before.Layout != needed.Layout || (before.Access & WRITE_ACCESS) || (needed.Access & WRITE_ACCESS))
+					group.Barriers.push_back({ id, before, needed });
+			}
+		}
+
+		for (ResourceId id = 0; id < (ResourceId) resourceCount; ++id)
+		{
+			if (!seen[id])
+				continue;
+
+			const Resource &resource = this->m_Resources[id];
+			bool attachment = std::find(group.Attachments.begin(), group.Attachments.end(), id) != group.Attachments.end();
+
+			// The render pass already moved it into its final layout
+			if (resource.Imported && resource.LastGroup == g && attachment)
+				state[id] = GetFinalState(resource.FinalLayout);
+			else
+				state[id] = after[id];
+		}
+	}
+
+	this->m_FinalBarriers.clear();
+	for (ResourceId id = 0; id < (ResourceId) resourceCount; ++id)
+	{
+		const Resource &resource = this->m_Resources[id];
+		if (resource.Imported && state[id].Layout != resource.FinalLayout)
+			this->m_FinalBarriers.push_back({ id, state[id], GetFinalState(resource.FinalLayout) });
+	}
+
+}
+
+void RenderGraph::Execute(VkCommandBuffer commandBuffer, uint32_t imageIndex, GpuProfiler *profiler) const
+{
+
+	auto recordBarriers = [this, commandBuffer, imageIndex](const std::vector<Barrier> &barriers)
+	{
+		if (barriers.empty())
+			return;
+
+		VkPipelineStageFlags srcStages = 0;
+		VkPipelineStageFlags dstStages = 0;
+
+		std::vector<VkImageMemoryBarrier> imageBarriers(barriers.size());
+
+		for (size_t i = 0; i < barriers.size(); ++i)
+		{
+			const Barrier &barrier = barriers[i];
+
+			VkImageMemoryBarrier &imageBarrier = imageBarriers[i];
+			imageBarrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+			imageBarrier.srcAccessMask = barrier.Before.Access;
+			imageBarrier.dstAccessMask = barrier.After.Access;
+			imageBarrier.oldLayout = barrier.Before.Layout;
+			imageBarrier.newLayout = barrier.After.Layout;
+			imageBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			imageBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			imageBarrier.image = this->GetImage(barrier.Resource, imageIndex);
+			imageBarrier.subresourceRange = { this->GetAspect(barrier.Resource), 0, 1, 0, 1 };
+
+			srcStages |= barrier.Before.Stages;
+			dstStages |= barrier.After.Stages;
+		}
+
+		vkCmdPipelineBarrier(commandBuffer,
+			srcStages ? srcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+			dstStages ? dstStages : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+			0, 0, nullptr, 0, nullptr, (uint32_t) imageBarriers.size(), imageBarriers.data());
+	};
+
+	for (size_t g = 0; g < this->m_Groups.size(); ++g)
+	{
+		const Group &group = this->m_Groups[g];
+
+		// Pass names stay put once compiled, so they can name the zone. The barriers count towards it.
+		uint32_t zone = GpuProfiler::INVALID_ZONE;
+		if (profiler)
+			zone = profiler->BeginZone(commandBuffer, this->m_Passes[group.Passes[0]].Name.c_str());
+
+		recordBarriers(group.Barriers);
+
+		VkRenderPassBeginInfo beginInfo = {};
+		beginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		beginInfo.renderPass = group.RenderPass;
+		beginInfo.framebuffer = this->m_Targets->Framebuffers[g][group.UsesImported ? imageIndex : 0];
+		beginInfo.renderArea.offset = { 0, 0 };
+		beginInfo.renderArea.extent = this->m_Extent;
+		beginInfo.clearValueCount = (uint32_t) group.ClearValues.size();
+		beginInfo.pClearValues = group.ClearValues.data();
+
+		for (size_t s = 0; s < group.Passes.size(); ++s)
+		{
+			const Pass &pass = this->m_Passes[group.Passes[s]];
+			VkSubpassContents contents = pass.Secondary ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE;
+
+			if (s == 0)
+				vkCmdBeginRenderPass(commandBuffer, &beginInfo, contents);
+			else
+				vkCmdNextSubpass(commandBuffer, contents);
+
+			pass.Execute(commandBuffer, imageIndex);
+		}
+
+		vkCmdEndRenderPass(commandBuffer);
+
+		if (profiler)
+			profiler->EndZone(commandBuffer, zone);
+	}
+
+	recordBarriers(this->m_FinalBarriers);
+
+}
+
+bool RenderGraph::IsPassActive(PassId pass) const
+{
+
+	return this->m_Passes[pass].Active;
+
+}
+
+VkRenderPass RenderGraph::GetRenderPass(PassId pass) const
+{
+
+	const Pass &p = this->m_Passes[pass];
+	return p.Active ? this->m_Groups[p.Group].RenderPass.Get() : VK_NULL_HANDLE;
+
+}
+
+uint32_t RenderGraph::GetSubpass(PassId pass) const
+{
+
+	return this->m_Passes[pass].Subpass;
+
+}
+
+VkFramebuffer RenderGraph::GetFramebuffer(PassId pass, uint32_t imageIndex) const
+{
+
+	const Pass &p = this->m_Passes[pass];
+	if (!p.Active || !this->m_Targets)
+		return VK_NULL_HANDLE;
+
+	return this->m_Targets->Framebuffers[p.Group][this->m_Groups[p.Group].UsesImported ? imageIndex : 0];
+
+}
+
+RenderGraph::ResourceState RenderGraph::GetAccessState(const Access &access, bool depth)
+{
+
+	VkImageLayout readLayout = depth ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+	switch (access.Type)
+	{
+	case AccessType::ColorWrite:
+		return { VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+			VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT };
+	case AccessType::DepthWrite:
+		return { VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+			VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT };
+	case AccessType::InputRead:
+		return { readLayout, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_INPUT_ATTACHMENT_READ_BIT };
+	case AccessType::TextureRead:
+		return { readLayout, access.Stages, VK_ACCESS_SHADER_READ_BIT };
+	}
+
+	return {};
+
+}
+
+RenderGraph::ResourceState RenderGraph::GetFinalState(VkImageLayout layout)
+{
+
+	switch (layout)
+	{
+	case VK_IMAGE_LAYOUT_PRESENT_SRC_KHR:
+		return { layout, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0 };
+	case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
+		return { layout, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT };
+	case VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL:
+		return { layout, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT };
+	default:
+		return { layout, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT };
+	}
+
+}
+
+bool RenderGraph::IsDepthFormat(VkFormat format)
+{
+
+	switch (format)
+	{
+	case VK_FORMAT_D16_UNORM:
+	case VK_FORMAT_X8_D24_UNORM_PACK32:
+	case VK_FORMAT_D32_SFLOAT:
+	case VK_FORMAT_D16_UNORM_S8_UINT:
+	case VK_FORMAT_D24_UNORM_S8_UINT:
+	case VK_FORMAT_D32_SFLOAT_S8_UINT:
+		return true;
+	default:
+		return false;
+	}
+
+}
+
+VkImageAspectFlags RenderGraph::GetAspect(ResourceId resource) const
+{
+
+	VkFormat format = this->m_Resources[resource].Format;
+	if (!IsDepthFormat(format))
+		return VK_IMAGE_ASPECT_COLOR_BIT;
+
+	if (format == VK_FORMAT_D16_UNORM_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT || format == VK_FORMAT_D32_SFLOAT_S8_UINT)
+		return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+
+	return VK_IMAGE_ASPECT_DEPTH_BIT;
+
+}
+
+VkImage RenderGraph::GetImage(ResourceId resource, uint32_t imageIndex) const
+{
+
+	const Resource &r = this->m_Resources[resource];
+	return r.Imported ? r.ImportedImages[imageIndex] : this->m_Targets->Images[resource].Get();
+
+}
+
+RenderGraph::Targets::~Targets()
+{
+
+	// Framebuffers reference the views, the views the images, the images the memory
+	this->Framebuffers.clear();
+	this->Views.clear();
+	this->Images.clear();
+
+	for (MemoryAllocation &memory : this->Memory)
+		this->Allocator->Free(memory);
+
+}
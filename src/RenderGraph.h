@@ -0,0 +1,204 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <functional>
+#include <cstdint>
+
+#include "MemoryAllocator.h"
+#include "VulkanHandle.h"
+#include "DeletionQueue.h"
+
+class GpuProfiler;
+
+// The frame as a list of raster passes that declare which images they read and
+// write. Compile drops passes nothing imported depends on, merges consecutive passes
+// into subpasses of one render pass unless one samples an image written earlier in
+// it, and picks load/store ops and layouts. CreateTargets sizes the transient images,
+// lets those whose lifetimes do not overlap share memory, and plans the barriers
+// between render passes, so Execute only replays them. All images are 2D, single
+// sampled and as large as the targets.
+class RenderGraph
+{
+
+public:
+	using ResourceId = uint32_t;
+	using PassId = uint32_t;
+
+	// imageIndex selects the image of every imported resource
+	using ExecuteFunction = std::function<void(VkCommandBuffer commandBuffer, uint32_t imageIndex)>;
+
+	void Init(VkDevice device, MemoryAllocator &allocator);
+
+	// The device must be idle
+	void Shutdown();
+
+	// Images owned outside the graph, such as the swap chain. Their contents are discarded
+	// every frame and may only be written once the color output stage waits for them, like
+	// after an acquire semaphore. The graph leaves them in finalLayout.
+	ResourceId ImportImage(const std::string &name, VkFormat format, VkImageLayout finalLayout);
+
+	// Lives within a frame only, the graph owns its memory
+	ResourceId CreateImage(const std::string &name, VkFormat format);
+
+	// Passes run in the order they were added
+	PassId AddPass(const std::string &name, ExecuteFunction execute);
+
+	// Attachment writes keep the previous contents unless they clear
+	void WriteColor(PassId pass, ResourceId resource);
+	void ClearColor(PassId pass, ResourceId resource, const VkClearColorValue &color);
+	void WriteDepth(PassId pass, ResourceId resource);
+	void ClearDepth(PassId pass, ResourceId resource, float depth);
+
+	// Input attachment, only the pixel being shaded. Does not prevent merging.
+	void ReadAttachment(PassId pass, ResourceId resource);
+
+	// Sampled anywhere, ends the render pass that wrote it
+	void ReadTexture(PassId pass, ResourceId resource, VkPipelineStageFlags stages = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+
+	// Keeps a pass that affects something outside the graph
+	void KeepPass(PassId pass);
+
+	// Whether the pass records secondary command buffers, may change at any time
+	void SetSecondaryContents(PassId pass, bool secondary);
+
+	// Creates the render passes, only needs the formats. Declarations are fixed afterwards.
+	void Compile();
+
+	// One image and view per imageIndex, before CreateTargets
+	void SetImportedImages(ResourceId resource, const std::vector<VkImage> &images, const std::vector<VkImageView> &views);
+
+	// Replaces the transient images and framebuffers, the previous ones are retired with lastUsedFrame
+	void CreateTargets(VkExtent2D extent, DeletionQueue &deletionQueue, uint64_t lastUsedFrame);
+
+	// With a profiler every render pass is timed as one zone, named after its first pass
+	void Execute(VkCommandBuffer commandBuffer, uint32_t imageIndex, GpuProfiler *profiler = nullptr) const;
+
+	// Culled passes have no render pass and never execute
+	bool IsPassActive(PassId pass) const;
+	VkRenderPass GetRenderPass(PassId pass) const;
+	uint32_t GetSubpass(PassId pass) const;
+	VkFramebuffer GetFramebuffer(PassId pass, uint32_t imageIndex) const;
+
+private:
+	enum class AccessType { ColorWrite, DepthWrite, InputRead, TextureRead };
+
+	struct ResourceState
+	{
+		VkImageLayout Layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VkPipelineStageFlags Stages = 0;
+		VkAccessFlags Access = 0;
+	};
+
+	struct Access
+	{
+		ResourceId Resource;
+		AccessType Type;
+		bool Clear = false;
+		VkClearValue ClearValue = {};
+		VkPipelineStageFlags Stages = 0;
+	};
+
+	struct Resource
+	{
+		std::string Name;
+		VkFormat Format = VK_FORMAT_UNDEFINED;
+		bool Imported = false;
+		VkImageLayout FinalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+		// Filled by Compile, groups are indices into m_Groups
+		VkImageUsageFlags Usage = 0;
+		bool Used = false;
+		uint32_t FirstGroup = 0;
+		uint32_t LastGroup = 0;
+
+		std::vector<VkImage> ImportedImages;
+		std::vector<VkImageView> ImportedViews;
+	};
+
+	struct Pass
+	{
+		std::string Name;
+		ExecuteFunction Execute;
+		std::vector<Access> Accesses;
+		bool Keep = false;
+		bool Secondary = false;
+
+		bool Active = false;
+		uint32_t Group = 0;
+		uint32_t Subpass = 0;
+	};
+
+	struct Barrier
+	{
+		ResourceId Resource;
+		ResourceState Before;
+		ResourceState After;
+	};
+
+	// One VkRenderPass, its subpasses are the passes in order
+	struct Group
+	{
+		std::vector<PassId> Passes;
+		std::vector<ResourceId> Attachments;
+		std::vector<VkClearValue> ClearValues;
+		bool UsesImported = false;
+		UniqueRenderPass RenderPass;
+
+		// Planned by CreateTargets, recorded before the render pass begins
+		std::vector<Barrier> Barriers;
+	};
+
+	// Everything sized to the extent, retired as a whole when it changes
+	struct Targets
+	{
+		~Targets();
+
+		MemoryAllocator *Allocator = nullptr;
+		std::vector<MemoryAllocation> Memory;
+
+		// Memory each transient is bound to and the transients sharing it
+		std::vector<uint32_t> MemorySlot;
+		std::vector<std::vector<ResourceId>> SlotResources;
+
+		// Indexed by resource, empty for imported ones
+		std::vector<UniqueBoundImage> Images;
+		std::vector<UniqueImageView> Views;
+
+		// [group][imageIndex], a single one for groups without imported attachments
+		std::vector<std::vector<UniqueFramebuffer>> Framebuffers;
+	};
+
+	void CullPasses();
+	void GroupPasses();
+	void CreateRenderPass(uint32_t groupIndex);
+	void AliasTransients(Targets &targets);
+	void PlanBarriers(const Targets &targets);
+
+	static ResourceState GetAccessState(const Access &access, bool depth);
+	static ResourceState GetFinalState(VkImageLayout layout);
+	static bool IsDepthFormat(VkFormat format);
+	static bool IsWrite(AccessType type) { return type == AccessType::ColorWrite || type == AccessType::DepthWrite; }
+	VkImageAspectFlags GetAspect(ResourceId resource) const;
+	VkImage GetImage(ResourceId resource, uint32_t imageIndex) const;
+
+private:
+	VkDevice m_Device = VK_NULL_HANDLE;
+	MemoryAllocator *m_Allocator = nullptr;
+
+	std::vector<Resource> m_Resources;
+	std::vector<Pass> m_Passes;
+	std::vector<Group> m_Groups;
+	bool m_Compiled = false;
+
+	std::unique_ptr<Targets> m_Targets;
+	VkExtent2D m_Extent = {};
+	uint32_t m_ImportedImageCount = 1;
+
+	// Transitions imported images into their final layout when the last render pass could not
+	std::vector<Barrier> m_FinalBarriers;
+
+};
@@ -0,0 +1,217 @@
+#include "ShaderWatcher.h"
+#include "Log.h"
+
+#include <set>
+#include <chrono>
+#include <fstream>
+#include <cstdlib>
+#include <filesystem>
+
+#ifdef APP_PLATFORM_LINUX
+	#include <sys/inotify.h>
+	#include <poll.h>
+	#include <unistd.h>
+#endif
+
+// Editors often write a file in several steps, changes are only compiled after this much quiet time
+static const std::chrono::milliseconds SHADER_SETTLE_TIME(100);
+static const std::chrono::milliseconds SHADER_POLL_INTERVAL(100);
+
+ShaderWatcher::~ShaderWatcher()
+{
+
+	this->Stop();
+
+}
+
+void ShaderWatcher::Start(const std::string &directory, const std::map<std::string, std::string> &stages, ReloadCallback callback)
+{
+
+	this->Stop();
+
+	this->m_Directory = directory;
+	this->m_Stages = stages;
+	this->m_Callback = std::move(callback);
+
+	this->m_Running = true;
+	this->m_Thread = std::thread(&ShaderWatcher::WatchLoop, this);
+
+	LOG_INFO("Watching {0} for shader changes", directory);
+
+}
+
+void ShaderWatcher::Stop()
+{
+
+	this->m_Running = false;
+
+	if (this->m_Thread.joinable())
+		this->m_Thread.join();
+
+}
+
+void ShaderWatcher::WatchLoop()
+{
+
+	using Clock = std::chrono::steady_clock;
+
+	std::set<std::string> changed;
+	Clock::time_point lastChange;
+
+#ifdef APP_PLATFORM_LINUX
+	int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (fd < 0 || inotify_add_watch(fd, this->m_Directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+	{
+		LOG_ERROR("Failed to watch {0}, shader hot reload is disabled", this->m_Directory);
+
+		if (fd >= 0)
+			close(fd);
+
+		return;
+	}
+#else
+	std::map<std::string, std::filesystem::file_time_type> writeTimes;
+	for (const auto &[source, stage] : this->m_Stages)
+	{
+		std::error_code error;
+		writeTimes[source] = std::filesystem::last_write_time(std::filesystem::path(this->m_Directory) / source, error);
+	}
+#endif
+
+	while (this->m_Running)
+	{
+#ifdef APP_PLATFORM_LINUX
+		pollfd pollInfo = { fd, POLLIN, 0 };
+		if (poll(&pollInfo, 1, (int) SHADER_POLL_INTERVAL.count()) > 0)
+		{
+			alignas(inotify_event) char buffer[4096];
+			ssize_t length = 0;
+
+			while ((length = read(fd, buffer, sizeof(buffer))) > 0)
+			{
+				for (char *it = buffer; it < buffer + length;)
+				{
+					const inotify_event *event = reinterpret_cast<const inotify_event *>(it);
+
+					if (event->len && this->m_Stages.count(event->name))
+					{
+						changed.insert(event->name);
+						lastChange = Clock::now();
+					}
+
+					it += sizeof(inotify_event) + event->len;
+				}
+			}
+		}
+#else
+		std::this_thread::sleep_for(SHADER_POLL_INTERVAL);
+
+		for (auto &[source, writeTime] : writeTimes)
+		{
+			std::error_code error;
+			auto time = std::filesystem::last_write_time(std::filesystem::path(this->m_Directory) / source, error);
+
+			if (!error && time != writeTime)
+			{
+				writeTime = time;
+				changed.insert(source);
+				lastChange = Clock::now();
+			}
+		}
+#endif
+
+		if (changed.empty() || Clock::now() - lastChange < SHADER_SETTLE_TIME)
+			continue;
+
+		for (const std::string &source : changed)
+		{
+			std::vector<char> spirv;
+			if (Compile(this->m_Directory, source, this->m_Stages.at(source), spirv))
+				this->m_Callback(source, spirv);
+			else
+				LOG_ERROR("Keeping the current pipeline for {0}", source);
+		}
+
+		changed.clear();
+	}
+
+#ifdef APP_PLATFORM_LINUX
+	close(fd);
+#endif
+
+}
+
+bool ShaderWatcher::Compile(const std::string &directory, const std::string &source, const std::string &stage, std::vector<char> &spirv)
+{
+
+	std::filesystem::path sourcePath = std::filesystem::path(directory) / source;
+	std::filesystem::path outputPath = sourcePath;
+	outputPath.replace_extension(".spv");
+
+	// Compiled next to the output and renamed, so a failed compile never leaves a broken .spv behind
+	std::filesystem::path temporaryPath = outputPath;
+	temporaryPath += ".tmp";
+
+	const char *sdk = std::getenv("VULKAN_SDK");
+	std::string compiler = sdk ? (std::filesystem::path(sdk) / "bin" / "glslc").string() : "glslc";
+
+	std::string command = "\"" + compiler + "\" -c -fshader-stage=" + stage
+		+ " \"" + sourcePath.string() + "\" -o \"" + temporaryPath.string() + "\"";
+
+#ifdef APP_PLATFORM_WINDOWS
+	// std::system runs cmd /c, which strips the first and last quote of a command starting with one
+	command = "\"" + command + "\"";
+#endif
+
+	if (std::system(command.c_str()) != 0)
+	{
+		LOG_ERROR("Failed to compile {0}", source);
+		return false;
+	}
+
+	std::error_code error;
+	std::filesystem::rename(temporaryPath, outputPath, error);
+	if (error)
+	{
+		LOG_ERROR("Failed to replace {0}: {1}", outputPath.string(), error.message());
+		return false;
+	}
+
+	if (!ReadSpirv(outputPath.string(), spirv))
+		return false;
+
+	LOG_INFO("Compiled {0}", source);
+	return true;
+
+}
+
+std::vector<char> ShaderWatcher::LoadOrCompile(const std::string &directory, const std::string &source, const std::string &stage)
+{
+
+	std::filesystem::path outputPath = std::filesystem::path(directory) / source;
+	outputPath.replace_extension(".spv");
+
+	std::vector<char> spirv;
+	if (std::filesystem::exists(outputPath))
+		ReadSpirv(outputPath.string(), spirv);
+	else
+		Compile(directory, source, stage, spirv);
+
+	return spirv;
+
+}
+
+bool ShaderWatcher::ReadSpirv(const std::string &path, std::vector<char> &spirv)
+{
+
+	std::ifstream file(path, std::ios::ate | std::ios::binary);
+	if (!file.is_open())
+		return false;
+
+	spirv.resize((size_t) file.tellg());
+	file.seekg(0);
+	file.read(spirv.data(), spirv.size());
+
+	return !spirv.empty();
+
+}
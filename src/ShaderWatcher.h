@@ -0,0 +1,44 @@
+#pragma once
+
+#include <map>
+#include <vector>
+#include <string>
+#include <atomic>
+#include <thread>
+#include <functional>
+
+// Watches a shader directory (inotify on Linux, timestamps elsewhere) and
+// recompiles GLSL sources with glslc when they change. The SPIR-V is written
+// next to the source like compile.bat does and handed to the callback, which
+// runs on the watcher thread so pipelines can be built without stalling frames.
+class ShaderWatcher
+{
+
+public:
+	using ReloadCallback = std::function<void(const std::string &source, const std::vector<char> &spirv)>;
+
+	~ShaderWatcher();
+
+	// stages maps source file names to the glslc shader stage, e.g. "vertex.glsl" -> "vertex"
+	void Start(const std::string &directory, const std::map<std::string, std::string> &stages, ReloadCallback callback);
+	void Stop();
+
+	// Compiles directory/source into the .spv next to it and returns the SPIR-V
+	static bool Compile(const std::string &directory, const std::string &source, const std::string &stage, std::vector<char> &spirv);
+
+	// Reads the SPIR-V of source, compiling it first when only the GLSL is there. Empty when neither works.
+	static std::vector<char> LoadOrCompile(const std::string &directory, const std::string &source, const std::string &stage);
+
+private:
+	void WatchLoop();
+	static bool ReadSpirv(const std::string &path, std::vector<char> &spirv);
+
+private:
+	std::string m_Directory;
+	std::map<std::string, std::string> m_Stages;
+	ReloadCallback m_Callback;
+
+	std::atomic<bool> m_Running = { false };
+	std::thread m_Thread;
+
+};
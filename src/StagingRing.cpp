@@ -0,0 +1,365 @@
+#include "StagingRing.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <cstring>
+
+static const VkDeviceSize STAGING_ALIGNMENT = 16;
+
+static VkDeviceSize AlignStaging(VkDeviceSize size)
+{
+	return (size + STAGING_ALIGNMENT - 1) & ~(STAGING_ALIGNMENT - 1);
+}
+
+void StagingRing::Init(MemoryAllocator &allocator, VkDeviceSize size)
+{
+
+	this->m_Allocator = &allocator;
+	this->m_Size = size;
+
+	VkBufferCreateInfo bufferInfo = {};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = size;
+	bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	AllocationCreateInfo allocInfo = {};
+	allocInfo.RequiredFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	allocInfo.Category = MemoryCategory::Staging;
+
+	if (allocator.CreateBuffer(bufferInfo, allocInfo, this->m_Buffer, this->m_Allocation) != VK_SUCCESS)
+	{
+		LOG_VK_CRITICAL("Failed to create the staging ring buffer!");
+		exit(-1);
+	}
+
+}
+
+void StagingRing::Shutdown()
+{
+
+	if (this->HasPendingUploads())
+		LOG_VK_WARNING("Staging ring shut down with uploads that were never flushed!");
+
+	this->m_Allocator->DestroyBuffer(this->m_Buffer, this->m_Allocation);
+	this->m_Buffer = VK_NULL_HANDLE;
+
+	this->m_Copies.clear();
+	this->m_ImageCopies.clear();
+	this->m_Deferred.clear();
+	this->m_Batches.clear();
+	this->m_Acquires.clear();
+
+}
+
+bool StagingRing::TryAllocate(VkDeviceSize size, VkDeviceSize &offset)
+{
+
+	VkDeviceSize alignedSize = AlignStaging(size);
+	uint64_t head = this->m_Head;
+
+	// Copies need contiguous memory, so skip the remainder of the ring when it is too short
+	VkDeviceSize position = head % this->m_Size;
+	if (position + alignedSize > this->m_Size)
+		head += this->m_Size - position;
+
+	if (head + alignedSize - this->m_Tail > this->m_Size)
+		return false;
+
+	offset = head % this->m_Size;
+	this->m_Head = head + alignedSize;
+
+	return true;
+
+}
+
+void StagingRing::Enqueue(VkBuffer destination, VkDeviceSize destinationOffset, const char *data, VkDeviceSize size, VkSharingMode sharing,
+	uint64_t uploadId)
+{
+
+	VkDeviceSize offset = 0;
+
+	// Anything queued behind a deferred upload is deferred as well, so uploads keep their order
+	if (!this->m_Deferred.empty() || !this->TryAllocate(size, offset))
+	{
+		this->m_Deferred.push_back({ destination, destinationOffset, std::vector<char>(data, data + size), sharing, PendingImageCopy(), uploadId });
+		return;
+	}
+
+	std::memcpy(static_cast<char *>(this->m_Allocation.MappedData) + offset, data, (size_t) size);
+	this->m_Copies.push_back({ destination, { offset, destinationOffset, size }, sharing });
+
+}
+
+uint64_t StagingRing::Upload(VkBuffer destination, VkDeviceSize destinationOffset, const void *data, VkDeviceSize size, VkSharingMode sharing)
+{
+
+	// Chunks of a quarter ring keep large uploads from ever needing the whole ring at once
+	const char *bytes = static_cast<const char *>(data);
+	VkDeviceSize chunkSize = std::max<VkDeviceSize>(this->m_Size / 4, 1);
+
+	// A chunk the whole ring cannot hold would stay deferred, and block every later upload, forever
+	if (AlignStaging(std::min(chunkSize, size)) > this->m_Size)
+	{
+		LOG_VK_ERROR("Buffer upload of {0} bytes does not fit the {1} byte staging ring!", size, this->m_Size);
+		return INVALID_UPLOAD;
+	}
+
+	uint64_t uploadId = this->m_UploadCount++;
+
+	for (VkDeviceSize done = 0; done < size; done += chunkSize)
+		this->Enqueue(destination, destinationOffset + done, bytes + done, std::min(chunkSize, size - done), sharing, uploadId);
+
+	return uploadId;
+
+}
+
+void StagingRing::EnqueueImage(const PendingImageCopy &copy, const char *data, VkDeviceSize size, uint64_t uploadId)
+{
+
+	VkDeviceSize offset = 0;
+
+	if (!this->m_Deferred.empty() || !this->TryAllocate(size, offset))
+	{
+		this->m_Deferred.push_back({ VK_NULL_HANDLE, 0, std::vector<char>(data, data + size), VK_SHARING_MODE_CONCURRENT, copy, uploadId });
+		return;
+	}
+
+	std::memcpy(static_cast<char *>(this->m_Allocation.MappedData) + offset, data, (size_t) size);
+
+	this->m_ImageCopies.push_back(copy);
+	this->m_ImageCopies.back().Region.bufferOffset = offset;
+
+}
+
+uint64_t StagingRing::UploadImage(VkImage image, uint32_t mipLevel, VkExtent2D extent,
+	VkExtent2D blockExtent, uint32_t blockBytes, const void *data)
+{
+
+	// Chunks hold whole rows of blocks, so each one is a valid copy region on its own
+	const char *bytes = static_cast<const char *>(data);
+	uint32_t blockRows = (extent.height + blockExtent.height - 1) / blockExtent.height;
+	VkDeviceSize rowSize = (VkDeviceSize) ((extent.width + blockExtent.width - 1) / blockExtent.width) * blockBytes;
+	uint32_t chunkRows = (uint32_t) std::max<VkDeviceSize>(this->m_Size / 4 / rowSize, 1);
+
+	// Chunks never split a block row, so a row the whole ring cannot hold would stay deferred forever
+	if (AlignStaging(rowSize) > this->m_Size)
+	{
+		LOG_VK_ERROR("Mip level {0} ({1}x{2}) has {3} byte block rows, more than the {4} byte staging ring!",
+			mipLevel, extent.width, extent.height, rowSize, this->m_Size);
+		return INVALID_UPLOAD;
+	}
+
+	uint64_t uploadId = this->m_UploadCount++;
+
+	for (uint32_t row = 0; row < blockRows; row += chunkRows)
+	{
+		uint32_t rows = std::min(chunkRows, blockRows - row);
+		uint32_t top = row * blockExtent.height;
+
+		PendingImageCopy copy;
+		copy.Image = image;
+		copy.FirstChunk = row == 0;
+		copy.LastChunk = row + rows == blockRows;
+		copy.Region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		copy.Region.imageSubresource.mipLevel = mipLevel;
+		copy.Region.imageSubresource.baseArrayLayer = 0;
+		copy.Region.imageSubresource.layerCount = 1;
+		copy.Region.imageOffset = { 0, (int32_t) top, 0 };
+		copy.Region.imageExtent = { extent.width, std::min(rows * blockExtent.height, extent.height - top), 1 };
+
+		this->EnqueueImage(copy, bytes + row * rowSize, rows * rowSize, uploadId);
+	}
+
+	return uploadId;
+
+}
+
+void StagingRing::Flush(VkCommandBuffer commandBuffer, uint64_t frameIndex,
+	uint32_t sourceFamily, uint32_t destinationFamily, VkPipelineStageFlags localStages)
+{
+
+	while (!this->m_Deferred.empty())
+	{
+		DeferredUpload &upload = this->m_Deferred.front();
+
+		VkDeviceSize offset = 0;
+		if (!this->TryAllocate(upload.Data.size(), offset))
+			break;
+
+		std::memcpy(static_cast<char *>(this->m_Allocation.MappedData) + offset, upload.Data.data(), upload.Data.size());
+
+		if (upload.ImageCopy.Image)
+		{
+			this->m_ImageCopies.push_back(upload.ImageCopy);
+			this->m_ImageCopies.back().Region.bufferOffset = offset;
+		}
+		else
+			this->m_Copies.push_back({ upload.Destination, { offset, upload.DestinationOffset, upload.Data.size() }, upload.Sharing });
+
+		this->m_Deferred.pop_front();
+	}
+
+	if (this->m_Copies.empty() && this->m_ImageCopies.empty())
+		return;
+
+	this->RecordImageCopies(commandBuffer, localStages);
+
+	// One vkCmdCopyBuffer per destination with all of its regions
+	std::stable_sort(this->m_Copies.begin(), this->m_Copies.end(), [](const PendingCopy &a, const PendingCopy &b)
+	{
+		return a.Destination < b.Destination;
+	});
+
+	std::vector<VkBufferCopy> regions;
+	std::vector<VkBufferMemoryBarrier> releases;
+
+	for (size_t i = 0; i < this->m_Copies.size();)
+	{
+		VkBuffer destination = this->m_Copies[i].Destination;
+		VkSharingMode sharing = this->m_Copies[i].Sharing;
+
+		regions.clear();
+		for (; i < this->m_Copies.size() && this->m_Copies[i].Destination == destination; ++i)
+			regions.push_back(this->m_Copies[i].Region);
+
+		vkCmdCopyBuffer(commandBuffer, this->m_Buffer, destination, (uint32_t) regions.size(), regions.data());
+
+		if (sourceFamily == destinationFamily || sharing == VK_SHARING_MODE_CONCURRENT)
+			continue;
+
+		// The release and acquire barriers must describe the same transfer
+		VkBufferMemoryBarrier ownership = {};
+		ownership.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		ownership.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		ownership.dstAccessMask = 0;
+		ownership.srcQueueFamilyIndex = sourceFamily;
+		ownership.dstQueueFamilyIndex = destinationFamily;
+		ownership.buffer = destination;
+		ownership.offset = 0;
+		ownership.size = VK_WHOLE_SIZE;
+		releases.push_back(ownership);
+
+		ownership.srcAccessMask = 0;
+		ownership.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+		this->m_Acquires.push_back(ownership);
+	}
+
+	if (!releases.empty())
+	{
+		vkCmdPipelineBarrier(commandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+			0, nullptr, (uint32_t) releases.size(), releases.data(), 0, nullptr);
+	}
+
+	if (localStages)
+	{
+		VkMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+
+		vkCmdPipelineBarrier(commandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, localStages, 0,
+			1, &barrier, 0, nullptr, 0, nullptr);
+	}
+
+	// Whatever is still deferred keeps its upload, and every later one, from completing
+	uint64_t uploads = this->m_Deferred.empty() ? this->m_UploadCount : this->m_Deferred.front().UploadId;
+
+	this->m_Copies.clear();
+	this->m_Batches.push_back({ frameIndex, this->m_Head, uploads });
+
+}
+
+void StagingRing::RecordImageCopies(VkCommandBuffer commandBuffer, VkPipelineStageFlags localStages)
+{
+
+	if (this->m_ImageCopies.empty())
+		return;
+
+	VkImageMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.levelCount = 1;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = 1;
+
+	std::vector<VkImageMemoryBarrier> toTransfer;
+	std::vector<VkImageMemoryBarrier> toShader;
+
+	for (const PendingImageCopy &copy : this->m_ImageCopies)
+	{
+		barrier.image = copy.Image;
+		barrier.subresourceRange.baseMipLevel = copy.Region.imageSubresource.mipLevel;
+
+		if (copy.FirstChunk)
+		{
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			toTransfer.push_back(barrier);
+		}
+
+		// Another queue makes the level visible through the semaphore it waits on
+		if (copy.LastChunk)
+		{
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = localStages ? VK_ACCESS_SHADER_READ_BIT : 0;
+			barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			toShader.push_back(barrier);
+		}
+	}
+
+	if (!toTransfer.empty())
+	{
+		vkCmdPipelineBarrier(commandBuffer,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+			0, nullptr, 0, nullptr, (uint32_t) toTransfer.size(), toTransfer.data());
+	}
+
+	for (const PendingImageCopy &copy : this->m_ImageCopies)
+		vkCmdCopyBufferToImage(commandBuffer, this->m_Buffer, copy.Image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy.Region);
+
+	if (!toShader.empty())
+	{
+		vkCmdPipelineBarrier(commandBuffer,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, localStages ? localStages : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+			0, nullptr, 0, nullptr, (uint32_t) toShader.size(), toShader.data());
+	}
+
+	this->m_ImageCopies.clear();
+
+}
+
+void StagingRing::AcquireOwnership(VkCommandBuffer commandBuffer)
+{
+
+	if (this->m_Acquires.empty())
+		return;
+
+	// Source stages match the stages the semaphore wait blocks, which chains the acquire to the release
+	vkCmdPipelineBarrier(commandBuffer,
+		VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+		0, nullptr, (uint32_t) this->m_Acquires.size(), this->m_Acquires.data(), 0, nullptr);
+
+	this->m_Acquires.clear();
+
+}
+
+void StagingRing::Release(uint64_t completedFrames)
+{
+
+	while (!this->m_Batches.empty() && this->m_Batches.front().FrameIndex < completedFrames)
+	{
+		this->m_Tail = this->m_Batches.front().End;
+		this->m_CompletedUploads = this->m_Batches.front().Uploads;
+		this->m_Batches.pop_front();
+	}
+
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <deque>
+#include <cstdint>
+
+#include "MemoryAllocator.h"
+
+// Persistently mapped ring buffer that streams data into device-local buffers.
+// Uploads are copied into the ring right away and turned into vkCmdCopyBuffer
+// regions, which Flush records in one batch per destination buffer into the
+// frame's command buffer. Ring space is handed back once that frame completes,
+// uploads that do not fit are kept on the CPU and retried on later frames.
+// The ring can be flushed on a dedicated transfer queue, exclusive buffers
+// are then handed to the queue family that uses them with ownership transfers.
+// Image mip levels are streamed the same way, with their layout transitions.
+class StagingRing
+{
+
+public:
+	// Returned for uploads the ring can never hold, they are dropped
+	static constexpr uint64_t INVALID_UPLOAD = UINT64_MAX;
+
+	void Init(MemoryAllocator &allocator, VkDeviceSize size);
+	void Shutdown();
+
+	// Buffers created with VK_SHARING_MODE_CONCURRENT need no ownership transfer.
+	// Returns the id IsUploadComplete takes.
+	uint64_t Upload(VkBuffer destination, VkDeviceSize destinationOffset, const void *data, VkDeviceSize size,
+		VkSharingMode sharing = VK_SHARING_MODE_EXCLUSIVE);
+
+	// Copies one tightly packed mip level into image in chunks of whole block rows and moves
+	// the level from UNDEFINED to SHADER_READ_ONLY_OPTIMAL. Images flushed on another queue
+	// family than the one sampling them must be VK_SHARING_MODE_CONCURRENT.
+	// Returns the id IsUploadComplete takes.
+	uint64_t UploadImage(VkImage image, uint32_t mipLevel, VkExtent2D extent,
+		VkExtent2D blockExtent, uint32_t blockBytes, const void *data);
+
+	// Records every queued copy followed by a barrier that makes them visible to localStages
+	// of the flushing queue (none when 0). frameIndex identifies the submission the commands end up in.
+	// When sourceFamily differs from destinationFamily exclusive buffers are released to
+	// destinationFamily, which has to record AcquireOwnership after waiting on this submission.
+	void Flush(VkCommandBuffer commandBuffer, uint64_t frameIndex,
+		uint32_t sourceFamily, uint32_t destinationFamily, VkPipelineStageFlags localStages);
+
+	// Records the acquire half of the ownership transfers of the last flush, if any
+	void AcquireOwnership(VkCommandBuffer commandBuffer);
+
+	// Reclaims the space of every batch flushed before completedFrames
+	void Release(uint64_t completedFrames);
+
+	inline bool HasPendingUploads() const { return !m_Copies.empty() || !m_ImageCopies.empty() || !m_Deferred.empty(); }
+
+	// True once the GPU finished every copy of the upload, as of the last Release
+	inline bool IsUploadComplete(uint64_t uploadId) const { return uploadId < m_CompletedUploads; }
+
+private:
+	struct PendingImageCopy;
+
+	bool TryAllocate(VkDeviceSize size, VkDeviceSize &offset);
+	void Enqueue(VkBuffer destination, VkDeviceSize destinationOffset, const char *data, VkDeviceSize size, VkSharingMode sharing,
+		uint64_t uploadId);
+	void EnqueueImage(const PendingImageCopy &copy, const char *data, VkDeviceSize size, uint64_t uploadId);
+	void RecordImageCopies(VkCommandBuffer commandBuffer, VkPipelineStageFlags localStages);
+
+private:
+	struct PendingCopy
+	{
+		VkBuffer Destination;
+		VkBufferCopy Region;
+		VkSharingMode Sharing;
+	};
+
+	// The first chunk of a level transitions it for the copy, the last one for sampling
+	struct PendingImageCopy
+	{
+		VkImage Image = VK_NULL_HANDLE;
+		VkBufferImageCopy Region = {};
+		bool FirstChunk = false;
+		bool LastChunk = false;
+	};
+
+	// Image uploads have a non-null ImageCopy.Image
+	struct DeferredUpload
+	{
+		VkBuffer Destination;
+		VkDeviceSize DestinationOffset;
+		std::vector<char> Data;
+		VkSharingMode Sharing;
+		PendingImageCopy ImageCopy;
+		uint64_t UploadId;
+	};
+
+	// Uploads below Uploads were completely recorded in the batch or before it
+	struct FlushedBatch
+	{
+		uint64_t FrameIndex;
+		uint64_t End;
+		uint64_t Uploads;
+	};
+
+	MemoryAllocator *m_Allocator = nullptr;
+
+	VkBuffer m_Buffer = VK_NULL_HANDLE;
+	MemoryAllocation m_Allocation;
+	VkDeviceSize m_Size = 0;
+
+	// Monotonic positions, the ring offset is position % m_Size
+	uint64_t m_Head = 0;
+	uint64_t m_Tail = 0;
+
+	// Every Upload and UploadImage call gets the next id
+	uint64_t m_UploadCount = 0;
+	uint64_t m_CompletedUploads = 0;
+
+	std::vector<PendingCopy> m_Copies;
+	std::vector<PendingImageCopy> m_ImageCopies;
+	std::deque<DeferredUpload> m_Deferred;
+	std::deque<FlushedBatch> m_Batches;
+	std::vector<VkBufferMemoryBarrier> m_Acquires;
+
+};
@@ -0,0 +1,185 @@
+#include "TaskGraph.h"
+#include "Profiler.h"
+#include "Log.h"
+
+#include <thread>
+#include <algorithm>
+
+namespace util {
+
+	// Width of the bars drawn by LogTimeline
+	static const uint32_t TIMELINE_COLUMNS = 40;
+
+	TaskGraph::TaskId TaskGraph::Add(const std::string &name, std::function<void()> task,
+		const std::vector<TaskId> &dependencies, Affinity affinity)
+	{
+
+		TaskId id = (TaskId) this->m_Tasks.size();
+
+		Task entry;
+		entry.Name = name;
+		entry.Function = std::move(task);
+		entry.TaskAffinity = affinity;
+
+		for (TaskId dependency : dependencies)
+		{
+			if (dependency >= id)
+			{
+				LOG_CRITICAL("Task {0} depends on a task that was added after it!", name);
+				exit(-1);
+			}
+
+			this->m_Tasks[dependency].Dependents.push_back(id);
+			++entry.PendingDependencies;
+		}
+
+		this->m_Tasks.push_back(std::move(entry));
+		return id;
+
+	}
+
+	void TaskGraph::Run(uint32_t workerCount)
+	{
+
+		this->m_Timer.Reset();
+
+		{
+			std::lock_guard<std::mutex> lock(this->m_Mutex);
+			this->m_Remaining = (uint32_t) this->m_Tasks.size();
+
+			for (TaskId id = 0; id < this->m_Tasks.size(); ++id)
+			{
+				if (this->m_Tasks[id].PendingDependencies)
+					continue;
+
+				if (this->m_Tasks[id].TaskAffinity == Affinity::MainThread)
+					this->m_ReadyMain.push_back(id);
+				else
+					this->m_ReadyAny.push_back(id);
+			}
+		}
+
+		std::vector<std::thread> workers;
+		for (uint32_t i = 1; i <= workerCount; ++i)
+			workers.emplace_back(&TaskGraph::WorkerLoop, this, i);
+
+		// The main thread prefers its own tasks, those are usually the critical path
+		while (true)
+		{
+			TaskId id = 0;
+
+			{
+				std::unique_lock<std::mutex> lock(this->m_Mutex);
+				this->m_Changed.wait(lock, [this]()
+				{
+					return !this->m_Remaining || !this->m_ReadyMain.empty() || !this->m_ReadyAny.empty();
+				});
+
+				if (!this->m_Remaining)
+					break;
+
+				std::deque<TaskId> &queue = this->m_ReadyMain.empty() ? this->m_ReadyAny : this->m_ReadyMain;
+				id = queue.front();
+				queue.pop_front();
+			}
+
+			this->Execute(id, 0);
+		}
+
+		for (std::thread &worker : workers)
+			worker.join();
+
+		this->m_ElapsedMillis = this->m_Timer.ElapsedMillis();
+
+	}
+
+	void TaskGraph::WorkerLoop(uint32_t threadIndex)
+	{
+
+		Profiler::SetThreadName("startup worker " + std::to_string(threadIndex));
+
+		while (true)
+		{
+			TaskId id = 0;
+
+			{
+				std::unique_lock<std::mutex> lock(this->m_Mutex);
+				this->m_Changed.wait(lock, [this]() { return !this->m_Remaining || !this->m_ReadyAny.empty(); });
+
+				if (!this->m_Remaining)
+					return;
+
+				id = this->m_ReadyAny.front();
+				this->m_ReadyAny.pop_front();
+			}
+
+			this->Execute(id, threadIndex);
+		}
+
+	}
+
+	void TaskGraph::Execute(TaskId id, uint32_t threadIndex)
+	{
+
+		Task &task = this->m_Tasks[id];
+
+		task.ThreadIndex = threadIndex;
+		task.StartMillis = this->m_Timer.ElapsedMillis();
+		{
+			PROFILE_SCOPE_DYNAMIC(task.Name);
+			task.Function();
+		}
+		task.EndMillis = this->m_Timer.ElapsedMillis();
+
+		{
+			std::lock_guard<std::mutex> lock(this->m_Mutex);
+
+			for (TaskId dependent : task.Dependents)
+			{
+				Task &next = this->m_Tasks[dependent];
+				if (--next.PendingDependencies)
+					continue;
+
+				if (next.TaskAffinity == Affinity::MainThread)
+					this->m_ReadyMain.push_back(dependent);
+				else
+					this->m_ReadyAny.push_back(dependent);
+			}
+
+			--this->m_Remaining;
+		}
+
+		this->m_Changed.notify_all();
+
+	}
+
+	void TaskGraph::LogTimeline(const std::string &title) const
+	{
+
+		LOG_INFO("{0} took {1:.3f}ms:", title, this->m_ElapsedMillis);
+
+		std::vector<const Task *> tasks;
+		for (const Task &task : this->m_Tasks)
+			tasks.push_back(&task);
+
+		std::sort(tasks.begin(), tasks.end(), [](const Task *a, const Task *b) { return a->StartMillis < b->StartMillis; });
+
+		double scale = this->m_ElapsedMillis > 0.0 ? TIMELINE_COLUMNS / this->m_ElapsedMillis : 0.0;
+
+		for (const Task *task : tasks)
+		{
+			// Every task gets at least one column so short ones stay visible
+			uint32_t begin = std::min((uint32_t) (task->StartMillis * scale), TIMELINE_COLUMNS - 1);
+			uint32_t end = std::clamp((uint32_t) (task->EndMillis * scale), begin + 1, TIMELINE_COLUMNS);
+
+			std::string bar(TIMELINE_COLUMNS, ' ');
+			bar.replace(begin, end - begin, end - begin, '#');
+
+			LOG_INFO("\t|{0}| {1:>8.3f}ms {2:>8.3f}ms  {3:<20} {4}",
+				bar, task->StartMillis, task->EndMillis - task->StartMillis, task->Name,
+				task->ThreadIndex ? "worker " + std::to_string(task->ThreadIndex) : std::string("main"));
+		}
+
+	}
+
+}
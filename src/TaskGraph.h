@@ -0,0 +1,69 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <cstdint>
+
+#include "Timer.h"
+
+namespace util {
+
+	// Runs named tasks as soon as all of their dependencies finished. Tasks bound to
+	// the main thread run on the thread calling Run (GLFW window calls have to), the
+	// others on short-lived worker threads. Every task is timed, so a finished graph
+	// can be logged as a timeline of where the time went.
+	class TaskGraph
+	{
+
+	public:
+		using TaskId = uint32_t;
+
+		enum class Affinity { Any, MainThread };
+
+		// Dependencies have to be added first, which also rules out cycles
+		TaskId Add(const std::string &name, std::function<void()> task,
+			const std::vector<TaskId> &dependencies = {}, Affinity affinity = Affinity::Any);
+
+		// Blocks until every task ran. With no workers everything runs on the calling thread.
+		void Run(uint32_t workerCount);
+
+		void LogTimeline(const std::string &title) const;
+		inline double GetElapsedMillis() const { return m_ElapsedMillis; }
+
+	private:
+		struct Task
+		{
+			std::string Name;
+			std::function<void()> Function;
+			std::vector<TaskId> Dependents;
+			uint32_t PendingDependencies = 0;
+			Affinity TaskAffinity = Affinity::Any;
+
+			// Relative to the start of Run, thread 0 is the main thread
+			double StartMillis = 0.0;
+			double EndMillis = 0.0;
+			uint32_t ThreadIndex = 0;
+		};
+
+		void WorkerLoop(uint32_t threadIndex);
+		void Execute(TaskId id, uint32_t threadIndex);
+
+	private:
+		std::vector<Task> m_Tasks;
+
+		std::mutex m_Mutex;
+		std::condition_variable m_Changed;
+		std::deque<TaskId> m_ReadyMain;
+		std::deque<TaskId> m_ReadyAny;
+		uint32_t m_Remaining = 0;
+
+		Timer m_Timer;
+		double m_ElapsedMillis = 0.0;
+
+	};
+
+}
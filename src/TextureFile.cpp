@@ -0,0 +1,327 @@
+#include "TextureFile.h"
+
+#include <fstream>
+#include <cstring>
+#include <algorithm>
+
+static const uint8_t KTX2_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+static const size_t KTX2_LEVEL_INDEX_OFFSET = 80;
+
+static const size_t DDS_HEADER_SIZE = 4 + 124;
+static const size_t DDS_DX10_HEADER_SIZE = 20;
+static const uint32_t DDS_PIXELFORMAT_FOURCC = 0x4;
+static const uint32_t DDS_PIXELFORMAT_RGB = 0x40;
+static const uint32_t DDS_CAPS2_CUBEMAP = 0x200;
+static const uint32_t DDS_CAPS2_VOLUME = 0x200000;
+static const uint32_t DDS_DX10_MISC_TEXTURECUBE = 0x4;
+
+// Files may claim more levels than the chain has, Vulkan rejects those
+static uint32_t ClampLevelCount(uint32_t levelCount, uint32_t width, uint32_t height)
+{
+
+	uint32_t maxLevels = 1;
+	for (uint32_t size = std::max(width, height); size > 1; size >>= 1)
+		++maxLevels;
+
+	return std::clamp(levelCount, 1u, maxLevels);
+
+}
+
+static constexpr uint32_t FourCC(char a, char b, char c, char d)
+{
+	return (uint32_t) a | ((uint32_t) b << 8) | ((uint32_t) c << 16) | ((uint32_t) d << 24);
+}
+
+template<typename T>
+static T Read(const std::vector<char> &data, size_t offset)
+{
+
+	T value = {};
+	std::memcpy(&value, data.data() + offset, sizeof(T));
+	return value;
+
+}
+
+static VkFormat DxgiToVkFormat(uint32_t dxgiFormat)
+{
+	switch (dxgiFormat)
+	{
+	case 2:		return VK_FORMAT_R32G32B32A32_SFLOAT;
+	case 10:	return VK_FORMAT_R16G16B16A16_SFLOAT;
+	case 28:	return VK_FORMAT_R8G8B8A8_UNORM;
+	case 29:	return VK_FORMAT_R8G8B8A8_SRGB;
+	case 49:	return VK_FORMAT_R8G8_UNORM;
+	case 61:	return VK_FORMAT_R8_UNORM;
+	case 71:	return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+	case 72:	return VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+	case 74:	return VK_FORMAT_BC2_UNORM_BLOCK;
+	case 75:	return VK_FORMAT_BC2_SRGB_BLOCK;
+	case 77:	return VK_FORMAT_BC3_UNORM_BLOCK;
+	case 78:	return VK_FORMAT_BC3_SRGB_BLOCK;
+	case 80:	return VK_FORMAT_BC4_UNORM_BLOCK;
+	case 81:	return VK_FORMAT_BC4_SNORM_BLOCK;
+	case 83:	return VK_FORMAT_BC5_UNORM_BLOCK;
+	case 84:	return VK_FORMAT_BC5_SNORM_BLOCK;
+	case 87:	return VK_FORMAT_B8G8R8A8_UNORM;
+	case 91:	return VK_FORMAT_B8G8R8A8_SRGB;
+	case 95:	return VK_FORMAT_BC6H_UFLOAT_BLOCK;
+	case 96:	return VK_FORMAT_BC6H_SFLOAT_BLOCK;
+	case 98:	return VK_FORMAT_BC7_UNORM_BLOCK;
+	case 99:	return VK_FORMAT_BC7_SRGB_BLOCK;
+	default:	return VK_FORMAT_UNDEFINED;
+	}
+}
+
+bool TextureFile::GetBlockInfo(VkFormat format, uint32_t &blockWidth, uint32_t &blockHeight, uint32_t &blockBytes)
+{
+
+	blockWidth = 1;
+	blockHeight = 1;
+
+	switch (format)
+	{
+	case VK_FORMAT_R8_UNORM:
+		blockBytes = 1;
+		return true;
+	case VK_FORMAT_R8G8_UNORM:
+		blockBytes = 2;
+		return true;
+	case VK_FORMAT_R8G8B8A8_UNORM:
+	case VK_FORMAT_R8G8B8A8_SRGB:
+	case VK_FORMAT_B8G8R8A8_UNORM:
+	case VK_FORMAT_B8G8R8A8_SRGB:
+		blockBytes = 4;
+		return true;
+	case VK_FORMAT_R16G16B16A16_SFLOAT:
+		blockBytes = 8;
+		return true;
+	case VK_FORMAT_R32G32B32A32_SFLOAT:
+		blockBytes = 16;
+		return true;
+	default:
+		break;
+	}
+
+	blockWidth = 4;
+	blockHeight = 4;
+
+	switch (format)
+	{
+	case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+	case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+	case VK_FORMAT_BC4_UNORM_BLOCK:
+	case VK_FORMAT_BC4_SNORM_BLOCK:
+		blockBytes = 8;
+		return true;
+	case VK_FORMAT_BC2_UNORM_BLOCK:
+	case VK_FORMAT_BC2_SRGB_BLOCK:
+	case VK_FORMAT_BC3_UNORM_BLOCK:
+	case VK_FORMAT_BC3_SRGB_BLOCK:
+	case VK_FORMAT_BC5_UNORM_BLOCK:
+	case VK_FORMAT_BC5_SNORM_BLOCK:
+	case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+	case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+	case VK_FORMAT_BC7_UNORM_BLOCK:
+	case VK_FORMAT_BC7_SRGB_BLOCK:
+		blockBytes = 16;
+		return true;
+	default:
+		return false;
+	}
+
+}
+
+VkDeviceSize TextureFile::GetLevelSize(uint32_t width, uint32_t height) const
+{
+
+	VkDeviceSize blocksWide = (width + this->BlockWidth - 1) / this->BlockWidth;
+	VkDeviceSize blocksHigh = (height + this->BlockHeight - 1) / this->BlockHeight;
+	return blocksWide * blocksHigh * this->BlockBytes;
+
+}
+
+bool TextureFile::Load(const std::string &path, TextureFile &file, std::string &error)
+{
+
+	std::ifstream stream(path, std::ios::ate | std::ios::binary);
+	if (!stream.is_open())
+	{
+		error = "cannot open the file";
+		return false;
+	}
+
+	file = TextureFile();
+	file.Data.resize((size_t) stream.tellg());
+	stream.seekg(0);
+	stream.read(file.Data.data(), file.Data.size());
+
+	if (file.Data.size() >= sizeof(KTX2_IDENTIFIER) && !std::memcmp(file.Data.data(), KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)))
+		return file.ParseKtx2(error);
+
+	if (file.Data.size() >= 4 && Read<uint32_t>(file.Data, 0) == FourCC('D', 'D', 'S', ' '))
+		return file.ParseDds(error);
+
+	error = "not a KTX2 or DDS file";
+	return false;
+
+}
+
+bool TextureFile::ParseKtx2(std::string &error)
+{
+
+	if (this->Data.size() < KTX2_LEVEL_INDEX_OFFSET)
+	{
+		error = "truncated KTX2 header";
+		return false;
+	}
+
+	this->Format = (VkFormat) Read<uint32_t>(this->Data, 12);
+	this->Width = Read<uint32_t>(this->Data, 20);
+	this->Height = Read<uint32_t>(this->Data, 24);
+
+	uint32_t depth = Read<uint32_t>(this->Data, 28);
+	uint32_t layerCount = Read<uint32_t>(this->Data, 32);
+	uint32_t faceCount = Read<uint32_t>(this->Data, 36);
+	uint32_t levelCount = ClampLevelCount(Read<uint32_t>(this->Data, 40), this->Width, this->Height);
+	uint32_t supercompression = Read<uint32_t>(this->Data, 44);
+
+	if (depth > 1 || layerCount > 1 || faceCount > 1)
+	{
+		error = "only 2D textures without layers or faces are supported";
+		return false;
+	}
+
+	if (supercompression)
+	{
+		error = "supercompressed KTX2 (Basis, Zstd) is not supported";
+		return false;
+	}
+
+	if (!GetBlockInfo(this->Format, this->BlockWidth, this->BlockHeight, this->BlockBytes))
+	{
+		error = "unsupported format " + std::to_string((uint32_t) this->Format);
+		return false;
+	}
+
+	if (this->Data.size() < KTX2_LEVEL_INDEX_OFFSET + levelCount * 3 * sizeof(uint64_t))
+	{
+		error = "truncated KTX2 level index";
+		return false;
+	}
+
+	// Levels are usually stored smallest first, the index has every level's offset
+	for (uint32_t level = 0; level < levelCount; ++level)
+	{
+		uint64_t offset = Read<uint64_t>(this->Data, KTX2_LEVEL_INDEX_OFFSET + level * 3 * sizeof(uint64_t));
+		if (!this->AddMip(level, (size_t) offset, error))
+			return false;
+	}
+
+	return true;
+
+}
+
+bool TextureFile::ParseDds(std::string &error)
+{
+
+	if (this->Data.size() < DDS_HEADER_SIZE)
+	{
+		error = "truncated DDS header";
+		return false;
+	}
+
+	this->Height = Read<uint32_t>(this->Data, 12);
+	this->Width = Read<uint32_t>(this->Data, 16);
+	uint32_t levelCount = ClampLevelCount(Read<uint32_t>(this->Data, 28), this->Width, this->Height);
+	uint32_t pixelFlags = Read<uint32_t>(this->Data, 80);
+	uint32_t fourCC = Read<uint32_t>(this->Data, 84);
+	uint32_t bitCount = Read<uint32_t>(this->Data, 88);
+	uint32_t redMask = Read<uint32_t>(this->Data, 92);
+	uint32_t caps2 = Read<uint32_t>(this->Data, 112);
+
+	if (caps2 & (DDS_CAPS2_CUBEMAP | DDS_CAPS2_VOLUME))
+	{
+		error = "cube maps and volume textures are not supported";
+		return false;
+	}
+
+	size_t offset = DDS_HEADER_SIZE;
+
+	if ((pixelFlags & DDS_PIXELFORMAT_FOURCC) && fourCC == FourCC('D', 'X', '1', '0'))
+	{
+		if (this->Data.size() < DDS_HEADER_SIZE + DDS_DX10_HEADER_SIZE)
+		{
+			error = "truncated DX10 header";
+			return false;
+		}
+
+		uint32_t miscFlags = Read<uint32_t>(this->Data, DDS_HEADER_SIZE + 8);
+		uint32_t arraySize = Read<uint32_t>(this->Data, DDS_HEADER_SIZE + 12);
+
+		if ((miscFlags & DDS_DX10_MISC_TEXTURECUBE) || arraySize > 1)
+		{
+			error = "cube maps and texture arrays are not supported";
+			return false;
+		}
+
+		this->Format = DxgiToVkFormat(Read<uint32_t>(this->Data, DDS_HEADER_SIZE));
+		offset += DDS_DX10_HEADER_SIZE;
+	}
+	else if (pixelFlags & DDS_PIXELFORMAT_FOURCC)
+	{
+		switch (fourCC)
+		{
+		case FourCC('D', 'X', 'T', '1'):	this->Format = VK_FORMAT_BC1_RGBA_UNORM_BLOCK; break;
+		case FourCC('D', 'X', 'T', '3'):	this->Format = VK_FORMAT_BC2_UNORM_BLOCK; break;
+		case FourCC('D', 'X', 'T', '5'):	this->Format = VK_FORMAT_BC3_UNORM_BLOCK; break;
+		case FourCC('A', 'T', 'I', '1'):
+		case FourCC('B', 'C', '4', 'U'):	this->Format = VK_FORMAT_BC4_UNORM_BLOCK; break;
+		case FourCC('A', 'T', 'I', '2'):
+		case FourCC('B', 'C', '5', 'U'):	this->Format = VK_FORMAT_BC5_UNORM_BLOCK; break;
+		default:							break;
+		}
+	}
+	else if ((pixelFlags & DDS_PIXELFORMAT_RGB) && bitCount == 32)
+		this->Format = redMask == 0x000000FF ? VK_FORMAT_R8G8B8A8_UNORM : VK_FORMAT_B8G8R8A8_UNORM;
+
+	if (!GetBlockInfo(this->Format, this->BlockWidth, this->BlockHeight, this->BlockBytes))
+	{
+		error = "unsupported DDS pixel format";
+		return false;
+	}
+
+	// DDS stores the levels back to back, largest first
+	for (uint32_t level = 0; level < levelCount; ++level)
+	{
+		if (!this->AddMip(level, offset, error))
+			return false;
+
+		offset += this->Mips.back().Size;
+	}
+
+	return true;
+
+}
+
+bool TextureFile::AddMip(uint32_t level, size_t offset, std::string &error)
+{
+
+	TextureMip mip;
+	mip.Width = std::max(this->Width >> level, 1u);
+	mip.Height = std::max(this->Height >> level, 1u);
+	mip.Offset = offset;
+	mip.Size = (size_t) this->GetLevelSize(mip.Width, mip.Height);
+
+	// Offsets come from the file, so the check must not wrap around
+	if (!this->Width || !this->Height || offset > this->Data.size() || mip.Size > this->Data.size() - offset)
+	{
+		error = "mip level " + std::to_string(level) + " lies outside of the file";
+		return false;
+	}
+
+	this->Mips.push_back(mip);
+	return true;
+
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+struct TextureMip
+{
+	uint32_t Width = 0;
+	uint32_t Height = 0;
+
+	// Tightly packed rows of blocks within TextureFile::Data
+	size_t Offset = 0;
+	size_t Size = 0;
+};
+
+// A 2D texture with its mip chain as stored on disk, level 0 being the largest.
+// Reads KTX2 without supercompression and DDS (legacy FourCC and DX10 headers),
+// uncompressed and BC formats only. Cube maps and arrays are rejected.
+struct TextureFile
+{
+	VkFormat Format = VK_FORMAT_UNDEFINED;
+	uint32_t Width = 0;
+	uint32_t Height = 0;
+
+	// One texel for uncompressed formats, 4x4 for BC
+	uint32_t BlockWidth = 1;
+	uint32_t BlockHeight = 1;
+	uint32_t BlockBytes = 0;
+
+	std::vector<TextureMip> Mips;
+	std::vector<char> Data;
+
+	// Picks the parser by file signature, error describes why it failed
+	static bool Load(const std::string &path, TextureFile &file, std::string &error);
+
+	// False for formats the loader cannot size
+	static bool GetBlockInfo(VkFormat format, uint32_t &blockWidth, uint32_t &blockHeight, uint32_t &blockBytes);
+
+	// Size of a tightly packed level
+	VkDeviceSize GetLevelSize(uint32_t width, uint32_t height) const;
+
+private:
+	bool ParseKtx2(std::string &error);
+	bool ParseDds(std::string &error);
+	bool AddMip(uint32_t level, size_t offset, std::string &error);
+};
@@ -0,0 +1,527 @@
+#include "TextureStreamer.h"
+#include "Log.h"
+
+#include <algorithm>
+
+static const uint32_t LOADER_THREAD_COUNT = 2;
+
+void TextureStreamer::Init(VkDevice device, VkPhysicalDevice physicalDevice, MemoryAllocator &allocator, StagingRing &stagingRing,
+	BindlessDescriptors &bindless, const std::vector<uint32_t> &queueFamilies, VkDeviceSize budget, VkDeviceSize uploadBytesPerFrame)
+{
+
+	this->m_Device = device;
+	this->m_PhysicalDevice = physicalDevice;
+	this->m_Allocator = &allocator;
+	this->m_StagingRing = &stagingRing;
+	this->m_Bindless = &bindless;
+	this->m_QueueFamilies = queueFamilies;
+	this->m_Budget = budget;
+	this->m_UploadBytesPerFrame = uploadBytesPerFrame;
+
+	VkSamplerCreateInfo samplerInfo = {};
+	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter = VK_FILTER_LINEAR;
+	samplerInfo.minFilter = VK_FILTER_LINEAR;
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+	samplerInfo.minLod = 0.0f;
+	samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+	if (vkCreateSampler(device, &samplerInfo, nullptr, &this->m_Sampler) != VK_SUCCESS)
+	{
+		LOG_VK_CRITICAL("Failed to create the texture sampler!");
+		exit(-1);
+	}
+
+	this->m_SamplerHandle = bindless.AddSampler(this->m_Sampler);
+	this->CreateFallback(queueFamilies);
+
+	for (uint32_t i = 0; i < LOADER_THREAD_COUNT; ++i)
+		this->m_Loaders.emplace_back(&TextureStreamer::LoaderLoop, this);
+
+	LOG_VK_INFO("Texture streaming with a {0} MiB budget, uploading up to {1} MiB per frame",
+		budget / (1024 * 1024), uploadBytesPerFrame / (1024 * 1024));
+
+}
+
+void TextureStreamer::Shutdown()
+{
+
+	if (!this->m_Device)
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(this->m_LoadMutex);
+		this->m_Stopping = true;
+	}
+
+	this->m_LoadAvailable.notify_all();
+	for (std::thread &loader : this->m_Loaders)
+		loader.join();
+
+	this->m_Loaders.clear();
+	this->ReleaseRetired(UINT64_MAX);
+
+	for (Texture &texture : this->m_Textures)
+	{
+		if (texture.View)
+			vkDestroyImageView(this->m_Device, texture.View, nullptr);
+
+		if (texture.Image)
+			this->m_Allocator->DestroyImage(texture.Image, texture.Memory);
+	}
+
+	this->m_Textures.clear();
+
+	vkDestroyImageView(this->m_Device, this->m_FallbackView, nullptr);
+	this->m_Allocator->DestroyImage(this->m_FallbackImage, this->m_FallbackMemory);
+	vkDestroySampler(this->m_Device, this->m_Sampler, nullptr);
+
+	this->m_Device = VK_NULL_HANDLE;
+
+}
+
+TextureStreamer::TextureId TextureStreamer::Request(const std::string &path)
+{
+
+	TextureId id = (TextureId) this->m_Textures.size();
+
+	Texture texture;
+	texture.Path = path;
+	texture.Handle = this->m_Bindless->AddSampledImage(this->m_FallbackView);
+	this->m_Textures.push_back(std::move(texture));
+
+	this->QueueLoad(id);
+	return id;
+
+}
+
+void TextureStreamer::MarkUsed(TextureId id, uint64_t frame)
+{
+
+	Texture &texture = this->m_Textures[id];
+	texture.LastUsedFrame = frame;
+
+	if (texture.State == TextureState::Evicted)
+		this->QueueLoad(id);
+
+}
+
+void TextureStreamer::QueueLoad(TextureId id)
+{
+
+	Texture &texture = this->m_Textures[id];
+	texture.State = TextureState::Loading;
+	texture.LoadTimer.Reset();
+
+	{
+		std::lock_guard<std::mutex> lock(this->m_LoadMutex);
+		this->m_LoadQueue.emplace_back(id, texture.Path);
+	}
+
+	this->m_LoadAvailable.notify_one();
+
+}
+
+void TextureStreamer::LoaderLoop()
+{
+
+	while (true)
+	{
+		std::pair<TextureId, std::string> job;
+
+		{
+			std::unique_lock<std::mutex> lock(this->m_LoadMutex);
+			this->m_LoadAvailable.wait(lock, [this]() { return this->m_Stopping || !this->m_LoadQueue.empty(); });
+
+			if (this->m_Stopping)
+				return;
+
+			job = std::move(this->m_LoadQueue.front());
+			this->m_LoadQueue.pop_front();
+		}
+
+		LoadResult result;
+		result.Id = job.first;
+		result.File = std::make_unique<TextureFile>();
+
+		if (!TextureFile::Load(job.second, *result.File, result.Error))
+			result.File.reset();
+
+		std::lock_guard<std::mutex> lock(this->m_LoadMutex);
+		this->m_LoadResults.push_back(std::move(result));
+	}
+
+}
+
+void TextureStreamer::Update(uint64_t submittedFrames, uint64_t completedFrames)
+{
+
+	this->ReleaseRetired(completedFrames);
+	this->CollectLoads();
+	this->PublishMips(submittedFrames);
+	this->CreateImages(submittedFrames);
+	this->UploadMips();
+
+}
+
+void TextureStreamer::CollectLoads()
+{
+
+	std::vector<LoadResult> results;
+
+	{
+		std::lock_guard<std::mutex> lock(this->m_LoadMutex);
+		results.swap(this->m_LoadResults);
+	}
+
+	for (LoadResult &result : results)
+	{
+		Texture &texture = this->m_Textures[result.Id];
+
+		if (!result.File)
+		{
+			LOG_WARNING("Failed to load texture {0}: {1}", texture.Path, result.Error);
+			texture.State = TextureState::Failed;
+			continue;
+		}
+
+		VkFormatProperties properties = {};
+		vkGetPhysicalDeviceFormatProperties(this->m_PhysicalDevice, result.File->Format, &properties);
+
+		if (!(properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT))
+		{
+			LOG_WARNING("Texture {0} uses a format the device cannot sample ({1})", texture.Path, (uint32_t) result.File->Format);
+			texture.State = TextureState::Failed;
+			continue;
+		}
+
+		texture.File = std::move(result.File);
+		texture.State = TextureState::Loaded;
+	}
+
+}
+
+void TextureStreamer::CreateImages(uint64_t submittedFrames)
+{
+
+	for (Texture &texture : this->m_Textures)
+	{
+		if (texture.State != TextureState::Loaded)
+			continue;
+
+		const TextureFile &file = *texture.File;
+
+		VkDeviceSize size = 0;
+		for (const TextureMip &mip : file.Mips)
+			size += mip.Size;
+
+		if (size > this->m_Budget)
+		{
+			LOG_WARNING("Texture {0} needs {1:.1f} MiB, more than the whole budget", texture.Path, size / (1024.0 * 1024.0));
+			texture.State = TextureState::Failed;
+			texture.File.reset();
+			continue;
+		}
+
+		// Stays in memory until evicted textures are destroyed or something else can go
+		if (!this->EvictFor(size, submittedFrames))
+		{
+			if (!this->m_BudgetWarned && this->m_Retired.empty())
+			{
+				LOG_WARNING("Texture budget of {0} MiB is exhausted by textures in use", this->m_Budget / (1024 * 1024));
+				this->m_BudgetWarned = true;
+			}
+
+			return;
+		}
+
+		VkImageCreateInfo imageInfo = {};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.format = file.Format;
+		imageInfo.extent = { file.Width, file.Height, 1 };
+		imageInfo.mipLevels = (uint32_t) file.Mips.size();
+		imageInfo.arrayLayers = 1;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		imageInfo.sharingMode = this->m_QueueFamilies.size() > 1 ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+		imageInfo.queueFamilyIndexCount = (uint32_t) this->m_QueueFamilies.size();
+		imageInfo.pQueueFamilyIndices = this->m_QueueFamilies.data();
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+		AllocationCreateInfo allocInfo = {};
+		allocInfo.RequiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+		if (this->m_Allocator->CreateImage(imageInfo, allocInfo, texture.Image, texture.Memory) != VK_SUCCESS)
+		{
+			LOG_WARNING("Failed to allocate texture {0} ({1}x{2})", texture.Path, file.Width, file.Height);
+			texture.State = TextureState::Failed;
+			texture.File.reset();
+			continue;
+		}
+
+		this->m_ResidentBytes += texture.Memory.Size;
+		this->m_BudgetWarned = false;
+
+		texture.MipCount = (uint32_t) file.Mips.size();
+		texture.ResidentMip = texture.MipCount;
+		texture.NextMip = (int32_t) texture.MipCount - 1;
+		texture.State = TextureState::Streaming;
+	}
+
+}
+
+void TextureStreamer::UploadMips()
+{
+
+	// Always the smallest pending level of any texture, so everything gets a blurry
+	// version first. At least one level goes per frame even when it exceeds the limit.
+	VkDeviceSize uploaded = 0;
+
+	while (uploaded < this->m_UploadBytesPerFrame)
+	{
+		Texture *next = nullptr;
+		VkDeviceSize nextSize = 0;
+
+		for (Texture &texture : this->m_Textures)
+		{
+			if (texture.State != TextureState::Streaming || texture.NextMip < 0)
+				continue;
+
+			VkDeviceSize size = texture.File->Mips[texture.NextMip].Size;
+			if (!next || size < nextSize)
+			{
+				next = &texture;
+				nextSize = size;
+			}
+		}
+
+		if (!next || (uploaded && uploaded + nextSize > this->m_UploadBytesPerFrame))
+			return;
+
+		const TextureFile &file = *next->File;
+		const TextureMip &mip = file.Mips[next->NextMip];
+
+		uint64_t uploadId = this->m_StagingRing->UploadImage(next->Image, (uint32_t) next->NextMip, { mip.Width, mip.Height },
+			{ file.BlockWidth, file.BlockHeight }, file.BlockBytes, file.Data.data() + mip.Offset);
+
+		// Finer levels only get larger, so the texture stays at the levels it already has
+		if (uploadId == StagingRing::INVALID_UPLOAD)
+		{
+			next->NextMip = -1;
+			continue;
+		}
+
+		next->Uploads.push_back({ (uint32_t) next->NextMip, uploadId });
+		--next->NextMip;
+		uploaded += nextSize;
+	}
+
+}
+
+void TextureStreamer::PublishMips(uint64_t submittedFrames)
+{
+
+	for (Texture &texture : this->m_Textures)
+	{
+		if (texture.State != TextureState::Streaming)
+			continue;
+
+		// Uploads complete in order, so the resident levels stay contiguous
+		uint32_t residentMip = texture.ResidentMip;
+		while (!texture.Uploads.empty() && this->m_StagingRing->IsUploadComplete(texture.Uploads.front().UploadId))
+		{
+			residentMip = texture.Uploads.front().Level;
+			texture.Uploads.pop_front();
+		}
+
+		if (residentMip != texture.ResidentMip)
+		{
+			// Frames before this one may still sample the old view through their sets
+			if (texture.View)
+				this->m_Retired.push_back({ VK_NULL_HANDLE, MemoryAllocation(), texture.View, submittedFrames });
+
+			texture.ResidentMip = residentMip;
+			texture.View = this->CreateView(texture.Image, texture.File->Format, residentMip, texture.MipCount - residentMip);
+			this->m_Bindless->UpdateSampledImage(texture.Handle, texture.View);
+		}
+
+		if (texture.NextMip < 0 && texture.Uploads.empty())
+		{
+			LOG_INFO("Texture {0} is resident ({1}x{2}, {3} mips, {4:.1f}ms)",
+				texture.Path, texture.File->Width, texture.File->Height, texture.MipCount, texture.LoadTimer.ElapsedMillis());
+
+			texture.File.reset();
+			texture.State = TextureState::Resident;
+		}
+	}
+
+}
+
+bool TextureStreamer::EvictFor(VkDeviceSize size, uint64_t submittedFrames)
+{
+
+	// Retired images still count against the budget until they are destroyed,
+	// but evicting more for them would not help
+	VkDeviceSize budget = this->GetBudget();
+	VkDeviceSize remaining = this->m_ResidentBytes - this->GetRetiredBytes();
+
+	while (remaining + size > budget)
+	{
+		// Only fully streamed textures the current frame does not use
+		Texture *victim = nullptr;
+		for (Texture &texture : this->m_Textures)
+		{
+			if (texture.State != TextureState::Resident || texture.LastUsedFrame >= submittedFrames)
+				continue;
+
+			if (!victim || texture.LastUsedFrame < victim->LastUsedFrame)
+				victim = &texture;
+		}
+
+		if (!victim)
+			return false;
+
+		this->m_Bindless->UpdateSampledImage(victim->Handle, this->m_FallbackView);
+		this->m_Retired.push_back({ victim->Image, victim->Memory, victim->View, submittedFrames });
+		remaining -= victim->Memory.Size;
+
+		victim->Image = VK_NULL_HANDLE;
+		victim->Memory = MemoryAllocation();
+		victim->View = VK_NULL_HANDLE;
+		victim->State = TextureState::Evicted;
+		++this->m_EvictionCount;
+	}
+
+	return this->m_ResidentBytes + size <= budget;
+
+}
+
+VkDeviceSize TextureStreamer::GetBudget() const
+{
+
+	// Resident textures are part of the heap's usage already, only the headroom comes on top
+	VkDeviceSize available = this->m_ResidentBytes + this->m_Allocator->GetHeadroom(VK_MEMORY_HEAP_DEVICE_LOCAL_BIT);
+	return std::min(this->m_Budget, available);
+
+}
+
+VkDeviceSize TextureStreamer::GetRetiredBytes() const
+{
+
+	VkDeviceSize size = 0;
+	for (const RetiredTexture &retired : this->m_Retired)
+		size += retired.Memory.Size;
+
+	return size;
+
+}
+
+void TextureStreamer::ReleaseRetired(uint64_t completedFrames)
+{
+
+	auto it = std::remove_if(this->m_Retired.begin(), this->m_Retired.end(), [this, completedFrames](RetiredTexture &retired)
+	{
+		if (completedFrames <= retired.RetiredAtFrame)
+			return false;
+
+		if (retired.View)
+			vkDestroyImageView(this->m_Device, retired.View, nullptr);
+
+		if (retired.Image)
+		{
+			this->m_ResidentBytes -= retired.Memory.Size;
+			this->m_Allocator->DestroyImage(retired.Image, retired.Memory);
+		}
+
+		return true;
+	});
+
+	this->m_Retired.erase(it, this->m_Retired.end());
+
+}
+
+VkImageView TextureStreamer::CreateView(VkImage image, VkFormat format, uint32_t baseMip, uint32_t mipCount) const
+{
+
+	VkImageViewCreateInfo viewInfo = {};
+	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	viewInfo.image = image;
+	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	viewInfo.format = format;
+	viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	viewInfo.subresourceRange.baseMipLevel = baseMip;
+	viewInfo.subresourceRange.levelCount = mipCount;
+	viewInfo.subresourceRange.baseArrayLayer = 0;
+	viewInfo.subresourceRange.layerCount = 1;
+
+	VkImageView view = VK_NULL_HANDLE;
+	if (vkCreateImageView(this->m_Device, &viewInfo, nullptr, &view) != VK_SUCCESS)
+	{
+		LOG_VK_CRITICAL("Failed to create texture image view!");
+		exit(-1);
+	}
+
+	return view;
+
+}
+
+void TextureStreamer::CreateFallback(const std::vector<uint32_t> &queueFamilies)
+{
+
+	// Mid grey, so streaming textures neither flash white nor black
+	const uint32_t texel = 0xFF808080;
+
+	VkImageCreateInfo imageInfo = {};
+	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+	imageInfo.extent = { 1, 1, 1 };
+	imageInfo.mipLevels = 1;
+	imageInfo.arrayLayers = 1;
+	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageInfo.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	imageInfo.sharingMode = queueFamilies.size() > 1 ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE;
+	imageInfo.queueFamilyIndexCount = (uint32_t) queueFamilies.size();
+	imageInfo.pQueueFamilyIndices = queueFamilies.data();
+	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	AllocationCreateInfo allocInfo = {};
+	allocInfo.RequiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+	if (this->m_Allocator->CreateImage(imageInfo, allocInfo, this->m_FallbackImage, this->m_FallbackMemory) != VK_SUCCESS)
+	{
+		LOG_VK_CRITICAL("Failed to create the fallback texture!");
+		exit(-1);
+	}
+
+	// Flushed before the first frame that can sample it
+	this->m_StagingRing->UploadImage(this->m_FallbackImage, 0, { 1, 1 }, { 1, 1 }, sizeof(texel), &texel);
+	this->m_FallbackView = this->CreateView(this->m_FallbackImage, VK_FORMAT_R8G8B8A8_UNORM, 0, 1);
+
+}
+
+void TextureStreamer::LogStatistics() const
+{
+
+	uint32_t resident = 0;
+	uint32_t streaming = 0;
+	uint32_t failed = 0;
+
+	for (const Texture &texture : this->m_Textures)
+	{
+		resident += texture.State == TextureState::Resident;
+		streaming += texture.State == TextureState::Streaming;
+		failed += texture.State == TextureState::Failed;
+	}
+
+	LOG_INFO("Textures: {0} resident, {1} streaming, {2} failed of {3}; {4:.1f} of {5} MiB, {6} evictions",
+		resident, streaming, failed, this->m_Textures.size(),
+		this->m_ResidentBytes / (1024.0 * 1024.0), this->m_Budget / (1024 * 1024), this->m_EvictionCount);
+
+}
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+
+#include "MemoryAllocator.h"
+#include "StagingRing.h"
+#include "BindlessDescriptors.h"
+#include "TextureFile.h"
+#include "Timer.h"
+
+// Streams KTX2/DDS textures in the background. Files are read on loader threads,
+// then the main thread uploads their mips through the staging ring, smallest first
+// and a limited number of bytes per frame. Every texture has one bindless handle for
+// its whole life: it shows a small fallback until the first mip arrives, after that a
+// view clamped to the mips already resident, widened as larger ones land. Textures
+// not used in the current frame are evicted least recently used first whenever a
+// new one would not fit the memory budget, and load again once they are used.
+class TextureStreamer
+{
+
+public:
+	using TextureId = uint32_t;
+
+	// queueFamilies lists every family the staging ring is flushed on or that samples
+	// the textures, with more than one the images are shared concurrently.
+	void Init(VkDevice device, VkPhysicalDevice physicalDevice, MemoryAllocator &allocator, StagingRing &stagingRing,
+		BindlessDescriptors &bindless, const std::vector<uint32_t> &queueFamilies, VkDeviceSize budget, VkDeviceSize uploadBytesPerFrame);
+
+	// The device must be idle
+	void Shutdown();
+
+	// Main thread only. The texture starts loading right away.
+	TextureId Request(const std::string &path);
+
+	// Stable bindless sampled image handle, valid from Request on
+	inline uint32_t GetHandle(TextureId id) const { return m_Textures[id].Handle; }
+	inline uint32_t GetSamplerHandle() const { return m_SamplerHandle; }
+
+	// Protects the texture from eviction during frame and reloads it when it was evicted
+	void MarkUsed(TextureId id, uint64_t frame);
+
+	// Main thread, once per frame before the staging ring is flushed. submittedFrames is
+	// the frame being recorded, completedFrames comes from the frame pacer.
+	void Update(uint64_t submittedFrames, uint64_t completedFrames);
+
+	void LogStatistics() const;
+
+private:
+	enum class TextureState { Loading, Loaded, Streaming, Resident, Evicted, Failed };
+
+	struct PendingMip
+	{
+		uint32_t Level;
+		uint64_t UploadId;
+	};
+
+	struct Texture
+	{
+		std::string Path;
+		uint32_t Handle = BindlessDescriptors::INVALID_HANDLE;
+		TextureState State = TextureState::Loading;
+		std::unique_ptr<TextureFile> File;
+
+		VkImage Image = VK_NULL_HANDLE;
+		MemoryAllocation Memory;
+		VkImageView View = VK_NULL_HANDLE;
+
+		// ResidentMip is MipCount until the smallest level arrived, NextMip the next level to upload
+		uint32_t MipCount = 0;
+		uint32_t ResidentMip = 0;
+		int32_t NextMip = -1;
+		std::deque<PendingMip> Uploads;
+
+		uint64_t LastUsedFrame = 0;
+		util::Timer LoadTimer;
+	};
+
+	struct LoadResult
+	{
+		TextureId Id;
+		std::unique_ptr<TextureFile> File;
+		std::string Error;
+	};
+
+	// Destroyed once every frame that could still sample them completed
+	struct RetiredTexture
+	{
+		VkImage Image = VK_NULL_HANDLE;
+		MemoryAllocation Memory;
+		VkImageView View = VK_NULL_HANDLE;
+		uint64_t RetiredAtFrame = 0;
+	};
+
+	void LoaderLoop();
+	void QueueLoad(TextureId id);
+
+	void CollectLoads();
+	void CreateImages(uint64_t submittedFrames);
+	void UploadMips();
+	void PublishMips(uint64_t submittedFrames);
+	bool EvictFor(VkDeviceSize size, uint64_t submittedFrames);
+	void ReleaseRetired(uint64_t completedFrames);
+	VkDeviceSize GetRetiredBytes() const;
+
+	// The configured budget, or less once the device-local heap is short of its memory budget
+	VkDeviceSize GetBudget() const;
+
+	VkImageView CreateView(VkImage image, VkFormat format, uint32_t baseMip, uint32_t mipCount) const;
+	void CreateFallback(const std::vector<uint32_t> &queueFamilies);
+
+private:
+	VkDevice m_Device = VK_NULL_HANDLE;
+	VkPhysicalDevice m_PhysicalDevice = VK_NULL_HANDLE;
+	MemoryAllocator *m_Allocator = nullptr;
+	StagingRing *m_StagingRing = nullptr;
+	BindlessDescriptors *m_Bindless = nullptr;
+	std::vector<uint32_t> m_QueueFamilies;
+
+	VkDeviceSize m_Budget = 0;
+	VkDeviceSize m_UploadBytesPerFrame = 0;
+
+	// Includes retired images until they are actually destroyed
+	VkDeviceSize m_ResidentBytes = 0;
+	uint32_t m_EvictionCount = 0;
+	bool m_BudgetWarned = false;
+
+	std::vector<Texture> m_Textures;
+	std::vector<RetiredTexture> m_Retired;
+
+	VkImage m_FallbackImage = VK_NULL_HANDLE;
+	MemoryAllocation m_FallbackMemory;
+	VkImageView m_FallbackView = VK_NULL_HANDLE;
+	VkSampler m_Sampler = VK_NULL_HANDLE;
+	uint32_t m_SamplerHandle = BindlessDescriptors::INVALID_HANDLE;
+
+	std::vector<std::thread> m_Loaders;
+	std::mutex m_LoadMutex;
+	std::condition_variable m_LoadAvailable;
+	std::deque<std::pair<TextureId, std::string>> m_LoadQueue;
+	std::vector<LoadResult> m_LoadResults;
+	bool m_Stopping = false;
+
+};
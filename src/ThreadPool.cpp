@@ -0,0 +1,84 @@
+#include "ThreadPool.h"
+#include "Profiler.h"
+
+namespace util {
+
+	ThreadPool::ThreadPool(uint32_t threadCount)
+	{
+
+		for (uint32_t i = 1; i < threadCount; ++i)
+			this->m_Threads.emplace_back(&ThreadPool::WorkerLoop, this, i);
+
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+
+		{
+			std::lock_guard<std::mutex> lock(this->m_Mutex);
+			this->m_Stopping = true;
+		}
+
+		this->m_WorkAvailable.notify_all();
+
+		for (std::thread &thread : this->m_Threads)
+			thread.join();
+
+	}
+
+	void ThreadPool::Execute(const std::function<void(uint32_t)> &task)
+	{
+
+		{
+			std::lock_guard<std::mutex> lock(this->m_Mutex);
+			this->m_Task = &task;
+			this->m_Pending = (uint32_t) this->m_Threads.size();
+			++this->m_Generation;
+		}
+
+		this->m_WorkAvailable.notify_all();
+
+		task(0);
+
+		std::unique_lock<std::mutex> lock(this->m_Mutex);
+		this->m_WorkDone.wait(lock, [this]() { return this->m_Pending == 0; });
+		this->m_Task = nullptr;
+
+	}
+
+	void ThreadPool::WorkerLoop(uint32_t threadIndex)
+	{
+
+		Profiler::SetThreadName("record worker " + std::to_string(threadIndex));
+		uint64_t generation = 0;
+
+		while (true)
+		{
+			const std::function<void(uint32_t)> *task = nullptr;
+
+			{
+				std::unique_lock<std::mutex> lock(this->m_Mutex);
+				this->m_WorkAvailable.wait(lock, [this, generation]() { return this->m_Stopping || this->m_Generation != generation; });
+
+				if (this->m_Stopping)
+					return;
+
+				generation = this->m_Generation;
+				task = this->m_Task;
+			}
+
+			(*task)(threadIndex);
+
+			bool last = false;
+			{
+				std::lock_guard<std::mutex> lock(this->m_Mutex);
+				last = --this->m_Pending == 0;
+			}
+
+			if (last)
+				this->m_WorkDone.notify_one();
+		}
+
+	}
+
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <cstdint>
+
+namespace util {
+
+	// Fixed set of threads that all run the same task, each with its own index.
+	// The calling thread takes part as thread 0, so a pool of one thread
+	// simply runs the task inline.
+	class ThreadPool
+	{
+
+	public:
+		ThreadPool(uint32_t threadCount);
+		~ThreadPool();
+
+		ThreadPool(const ThreadPool &) = delete;
+		ThreadPool &operator=(const ThreadPool &) = delete;
+
+		// Runs task(threadIndex) once on every thread and returns when all are done
+		void Execute(const std::function<void(uint32_t)> &task);
+
+		inline uint32_t GetThreadCount() const { return (uint32_t) m_Threads.size() + 1; }
+
+	private:
+		void WorkerLoop(uint32_t threadIndex);
+
+	private:
+		std::vector<std::thread> m_Threads;
+
+		std::mutex m_Mutex;
+		std::condition_variable m_WorkAvailable;
+		std::condition_variable m_WorkDone;
+
+		const std::function<void(uint32_t)> *m_Task = nullptr;
+		uint64_t m_Generation = 0;
+		uint32_t m_Pending = 0;
+		bool m_Stopping = false;
+
+	};
+
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <chrono>
+
+namespace util {
+
+	class Timer
+	{
+
+	public:
+		Timer() { Reset(); }
+
+		inline void Reset() { m_Start = std::chrono::steady_clock::now(); }
+
+		inline double ElapsedMillis() const
+		{
+			return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_Start).count();
+		}
+
+		inline double ElapsedSeconds() const { return ElapsedMillis() / 1000.0; }
+
+	private:
+		std::chrono::steady_clock::time_point m_Start;
+
+	};
+
+}
@@ -0,0 +1,151 @@
+#include "UniformRing.h"
+#include "Log.h"
+
+#include <algorithm>
+#include <cstring>
+
+static const uint32_t UNIFORM_BINDING_COUNT = 2;
+
+void UniformRing::Init(VkDevice device, MemoryAllocator &allocator, const VkPhysicalDeviceLimits &limits,
+	VkDeviceSize frameSize, uint32_t frameCount)
+{
+
+	this->m_Device = device;
+	this->m_Alignment = std::max<VkDeviceSize>(limits.minUniformBufferOffsetAlignment, 16);
+
+	this->m_Memory.Init(allocator, frameSize, frameCount, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT);
+	this->m_LastOffset = this->m_Memory.GetFrameSize() * frameCount - MAX_UNIFORM_SIZE;
+
+	this->CreateDescriptors();
+	this->BeginFrame(0);
+
+	LOG_VK_INFO("Uniform ring: {0} KiB per frame, {1} byte alignment", this->m_Memory.GetFrameSize() / 1024, this->m_Alignment);
+
+}
+
+void UniformRing::Shutdown()
+{
+
+	if (!this->m_Device)
+		return;
+
+	vkDestroyDescriptorPool(this->m_Device, this->m_Pool, nullptr);
+	vkDestroyDescriptorSetLayout(this->m_Device, this->m_Layout, nullptr);
+	this->m_Memory.Shutdown();
+
+	this->m_Device = VK_NULL_HANDLE;
+
+}
+
+void UniformRing::BeginFrame(uint32_t frameIndex)
+{
+
+	this->m_Memory.BeginFrame(frameIndex);
+	this->m_Overflowed = false;
+
+}
+
+uint32_t UniformRing::Push(const void *data, VkDeviceSize size)
+{
+
+	if (size > MAX_UNIFORM_SIZE)
+	{
+		LOG_VK_ERROR("Uniform block of {0} bytes is larger than the bound range of {1} bytes!", size, MAX_UNIFORM_SIZE);
+		return INVALID_OFFSET;
+	}
+
+	// The bound range may reach into the next partition, but never past the end of the buffer
+	FrameLinearAllocator::Slice slice = this->m_Memory.Allocate(size, this->m_Alignment);
+	if (!slice.Data || slice.Offset > this->m_LastOffset)
+	{
+		if (!this->m_Overflowed.exchange(true))
+			LOG_VK_WARNING("Uniform ring partition of {0} KiB is full, skipping the rest of this frame's uniforms", this->m_Memory.GetFrameSize() / 1024);
+
+		return INVALID_OFFSET;
+	}
+
+	std::memcpy(slice.Data, data, (size_t) size);
+	return (uint32_t) slice.Offset;
+
+}
+
+void UniformRing::Bind(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout layout, uint32_t setIndex,
+	uint32_t frameOffset, uint32_t objectOffset) const
+{
+
+	uint32_t offsets[UNIFORM_BINDING_COUNT] = { frameOffset, objectOffset };
+	vkCmdBindDescriptorSets(commandBuffer, bindPoint, layout, setIndex, 1, &this->m_Set, UNIFORM_BINDING_COUNT, offsets);
+
+}
+
+void UniformRing::CreateDescriptors()
+{
+
+	VkDescriptorSetLayoutBinding bindings[UNIFORM_BINDING_COUNT] = {};
+	for (uint32_t i = 0; i < UNIFORM_BINDING_COUNT; ++i)
+	{
+		bindings[i].binding = i;
+		bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+	}
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = UNIFORM_BINDING_COUNT;
+	layoutInfo.pBindings = bindings;
+
+	if (vkCreateDescriptorSetLayout(this->m_Device, &layoutInfo, nullptr, &this->m_Layout) != VK_SUCCESS)
+	{
+		LOG_VK_CRITICAL("Failed to create uniform ring descriptor set layout!");
+		exit(-1);
+	}
+
+	VkDescriptorPoolSize poolSize = {};
+	poolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+	poolSize.descriptorCount = UNIFORM_BINDING_COUNT;
+
+	VkDescriptorPoolCreateInfo poolInfo = {};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.maxSets = 1;
+	poolInfo.poolSizeCount = 1;
+	poolInfo.pPoolSizes = &poolSize;
+
+	if (vkCreateDescriptorPool(this->m_Device, &poolInfo, nullptr, &this->m_Pool) != VK_SUCCESS)
+	{
+		LOG_VK_CRITICAL("Failed to create uniform ring descriptor pool!");
+		exit(-1);
+	}
+
+	VkDescriptorSetAllocateInfo allocInfo = {};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = this->m_Pool;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &this->m_Layout;
+
+	if (vkAllocateDescriptorSets(this->m_Device, &allocInfo, &this->m_Set) != VK_SUCCESS)
+	{
+		LOG_VK_CRITICAL("Failed to allocate uniform ring descriptor set!");
+		exit(-1);
+	}
+
+	// The only descriptor write, every later update just moves the dynamic offsets
+	VkDescriptorBufferInfo bufferInfo = {};
+	bufferInfo.buffer = this->m_Memory.GetBuffer();
+	bufferInfo.offset = 0;
+	bufferInfo.range = MAX_UNIFORM_SIZE;
+
+	VkWriteDescriptorSet writes[UNIFORM_BINDING_COUNT] = {};
+	for (uint32_t i = 0; i < UNIFORM_BINDING_COUNT; ++i)
+	{
+		writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[i].dstSet = this->m_Set;
+		writes[i].dstBinding = i;
+		writes[i].descriptorCount = 1;
+		writes[i].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+		writes[i].pBufferInfo = &bufferInfo;
+	}
+
+	vkUpdateDescriptorSets(this->m_Device, UNIFORM_BINDING_COUNT, writes, 0, nullptr);
+
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <atomic>
+#include <cstdint>
+
+#include "MemoryAllocator.h"
+
+// Uniform data bump allocated from a FrameLinearAllocator, so every frame in flight
+// has its own partition of one persistently mapped buffer. Blocks are copied straight
+// into the mapping and shaders find them through the dynamic offsets
+// of a single descriptor set that is written once at startup. Per-object updates
+// cost one memcpy and a bind with new offsets: no mapping and no descriptor writes.
+class UniformRing
+{
+
+public:
+	static constexpr uint32_t INVALID_OFFSET = UINT32_MAX;
+
+	// Range of both bindings, the largest block a single Push may hold
+	static constexpr VkDeviceSize MAX_UNIFORM_SIZE = 256;
+
+	// Binding 0 holds per-frame data, binding 1 per-object data. Both are dynamic
+	// uniform buffers pointing into the ring, which is sized for frameSize bytes per frame.
+	void Init(VkDevice device, MemoryAllocator &allocator, const VkPhysicalDeviceLimits &limits,
+		VkDeviceSize frameSize, uint32_t frameCount);
+	void Shutdown();
+
+	// Hands the partition of frameIndex back to the allocator, its last frame must have completed
+	void BeginFrame(uint32_t frameIndex);
+
+	// Copies size bytes (at most MAX_UNIFORM_SIZE) into the current partition and returns
+	// the dynamic offset, INVALID_OFFSET once the partition is full. Thread safe.
+	uint32_t Push(const void *data, VkDeviceSize size);
+
+	template<typename T>
+	inline uint32_t Push(const T &value) { return this->Push(&value, sizeof(T)); }
+
+	void Bind(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout layout, uint32_t setIndex,
+		uint32_t frameOffset, uint32_t objectOffset) const;
+
+	inline VkDescriptorSetLayout GetLayout() const { return m_Layout; }
+
+private:
+	void CreateDescriptors();
+
+private:
+	VkDevice m_Device = VK_NULL_HANDLE;
+	FrameLinearAllocator m_Memory;
+	VkDeviceSize m_Alignment = 0;
+
+	// Offsets past this leave no room for the bound range before the end of the buffer
+	VkDeviceSize m_LastOffset = 0;
+	std::atomic<bool> m_Overflowed = { false };
+
+	VkDescriptorSetLayout m_Layout = VK_NULL_HANDLE;
+	VkDescriptorPool m_Pool = VK_NULL_HANDLE;
+	VkDescriptorSet m_Set = VK_NULL_HANDLE;
+
+};
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <utility>
+
+#include "MemoryAllocator.h"
+
+// Owns a handle created from a device and destroys it with Destroy when it goes
+// out of scope or is replaced. Move only. Converts to the raw handle, so it can be
+// passed to Vulkan directly. Handles still used by frames in flight are moved into
+// a DeletionQueue instead of being reset.
+template<typename T, void (VKAPI_PTR *Destroy)(VkDevice, T, const VkAllocationCallbacks *)>
+class VulkanHandle
+{
+
+public:
+	VulkanHandle() = default;
+	VulkanHandle(VkDevice device, T handle) : m_Device(device), m_Handle(handle) {}
+	~VulkanHandle() { Reset(); }
+
+	VulkanHandle(const VulkanHandle &) = delete;
+	VulkanHandle &operator=(const VulkanHandle &) = delete;
+
+	VulkanHandle(VulkanHandle &&other) noexcept : m_Device(other.m_Device), m_Handle(other.Release()) {}
+	VulkanHandle &operator=(VulkanHandle &&other) noexcept
+	{
+		if (this != &other)
+		{
+			Reset();
+			m_Device = other.m_Device;
+			m_Handle = other.Release();
+		}
+
+		return *this;
+	}
+
+	inline T Get() const { return m_Handle; }
+	inline operator T() const { return m_Handle; }
+
+	// For the Vulkan arrays of one element, such as pWaitSemaphores
+	inline const T *GetAddress() const { return &m_Handle; }
+
+	// Destroys the current handle and returns the slot for a vkCreate* call to fill
+	T *Replace(VkDevice device)
+	{
+		Reset();
+		m_Device = device;
+		return &m_Handle;
+	}
+
+	// Gives up ownership without destroying the handle
+	T Release()
+	{
+		T handle = m_Handle;
+		m_Handle = VK_NULL_HANDLE;
+		return handle;
+	}
+
+	void Reset()
+	{
+		if (m_Handle)
+			Destroy(m_Device, m_Handle, nullptr);
+
+		m_Handle = VK_NULL_HANDLE;
+	}
+
+private:
+	VkDevice m_Device = VK_NULL_HANDLE;
+	T m_Handle = VK_NULL_HANDLE;
+
+};
+
+using UniqueSwapchain = VulkanHandle<VkSwapchainKHR, vkDestroySwapchainKHR>;
+using UniqueBoundImage = VulkanHandle<VkImage, vkDestroyImage>;
+using UniqueImageView = VulkanHandle<VkImageView, vkDestroyImageView>;
+using UniqueSampler = VulkanHandle<VkSampler, vkDestroySampler>;
+using UniqueFramebuffer = VulkanHandle<VkFramebuffer, vkDestroyFramebuffer>;
+using UniqueRenderPass = VulkanHandle<VkRenderPass, vkDestroyRenderPass>;
+using UniquePipeline = VulkanHandle<VkPipeline, vkDestroyPipeline>;
+using UniquePipelineLayout = VulkanHandle<VkPipelineLayout, vkDestroyPipelineLayout>;
+using UniqueShaderModule = VulkanHandle<VkShaderModule, vkDestroyShaderModule>;
+using UniqueSemaphore = VulkanHandle<VkSemaphore, vkDestroySemaphore>;
+using UniqueFence = VulkanHandle<VkFence, vkDestroyFence>;
+using UniqueCommandPool = VulkanHandle<VkCommandPool, vkDestroyCommandPool>;
+using UniqueDescriptorPool = VulkanHandle<VkDescriptorPool, vkDestroyDescriptorPool>;
+using UniqueDescriptorSetLayout = VulkanHandle<VkDescriptorSetLayout, vkDestroyDescriptorSetLayout>;
+using UniqueQueryPool = VulkanHandle<VkQueryPool, vkDestroyQueryPool>;
+
+// Buffer or image together with its memory, both returned to the allocator on destruction.
+// The allocator must outlive it.
+template<typename T, void (MemoryAllocator::*Destroy)(T, MemoryAllocation &)>
+class AllocatedHandle
+{
+
+public:
+	AllocatedHandle() = default;
+	AllocatedHandle(MemoryAllocator &allocator, T handle, const MemoryAllocation &memory) : m_Allocator(&allocator), m_Handle(handle), m_Memory(memory) {}
+	~AllocatedHandle() { Reset(); }
+
+	AllocatedHandle(const AllocatedHandle &) = delete;
+	AllocatedHandle &operator=(const AllocatedHandle &) = delete;
+
+	AllocatedHandle(AllocatedHandle &&other) noexcept : m_Allocator(other.m_Allocator), m_Handle(other.m_Handle), m_Memory(other.m_Memory)
+	{
+		other.m_Handle = VK_NULL_HANDLE;
+		other.m_Memory = MemoryAllocation();
+	}
+
+	AllocatedHandle &operator=(AllocatedHandle &&other) noexcept
+	{
+		if (this != &other)
+		{
+			Reset();
+			m_Allocator = other.m_Allocator;
+			m_Handle = other.m_Handle;
+			m_Memory = other.m_Memory;
+
+			other.m_Handle = VK_NULL_HANDLE;
+			other.m_Memory = MemoryAllocation();
+		}
+
+		return *this;
+	}
+
+	inline T Get() const { return m_Handle; }
+	inline operator T() const { return m_Handle; }
+	inline const T *GetAddress() const { return &m_Handle; }
+	inline const MemoryAllocation &GetMemory() const { return m_Memory; }
+
+	void Reset()
+	{
+		if (m_Handle)
+			(m_Allocator->*Destroy)(m_Handle, m_Memory);
+
+		m_Handle = VK_NULL_HANDLE;
+		m_Memory = MemoryAllocation();
+	}
+
+private:
+	MemoryAllocator *m_Allocator = nullptr;
+	T m_Handle = VK_NULL_HANDLE;
+	MemoryAllocation m_Memory;
+
+};
+
+using UniqueBuffer = AllocatedHandle<VkBuffer, &MemoryAllocator::DestroyBuffer>;
+using UniqueImage = AllocatedHandle<VkImage, &MemoryAllocator::DestroyImage>;